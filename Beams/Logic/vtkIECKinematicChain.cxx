@@ -0,0 +1,311 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// Beams includes
+#include "vtkIECKinematicChain.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  void SetIdentity(double matrix[16])
+  {
+    std::fill(matrix, matrix + 16, 0.0);
+    matrix[0] = matrix[5] = matrix[10] = matrix[15] = 1.0;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Set rotation around a coordinate axis (0: X, 1: Y, 2: Z) with the same convention as vtkTransform
+  void SetRotation(int axis, double angleDegrees, double matrix[16])
+  {
+    SetIdentity(matrix);
+    double angle = vtkMath::RadiansFromDegrees(angleDegrees);
+    double c = std::cos(angle);
+    double s = std::sin(angle);
+    int first = (axis + 1) % 3;
+    int second = (axis + 2) % 3;
+    matrix[4 * first + first] = c;
+    matrix[4 * first + second] = -s;
+    matrix[4 * second + first] = s;
+    matrix[4 * second + second] = c;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Compute c = a * b for row-major 4x4 matrices (c may not alias a or b)
+  void Multiply(const double a[16], const double b[16], double c[16])
+  {
+    for (int row = 0; row < 4; ++row)
+    {
+      for (int column = 0; column < 4; ++column)
+      {
+        c[4 * row + column] = a[4 * row] * b[column] + a[4 * row + 1] * b[4 + column]
+          + a[4 * row + 2] * b[8 + column] + a[4 * row + 3] * b[12 + column];
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Invert a rigid transform (rotation and translation)
+  void InvertRigid(const double matrix[16], double inverse[16])
+  {
+    SetIdentity(inverse);
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int column = 0; column < 3; ++column)
+      {
+        inverse[4 * row + column] = matrix[4 * column + row];
+      }
+    }
+    for (int row = 0; row < 3; ++row)
+    {
+      inverse[4 * row + 3] = -( inverse[4 * row] * matrix[3] + inverse[4 * row + 1] * matrix[7] + inverse[4 * row + 2] * matrix[11] );
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkIECKinematicChain);
+
+//----------------------------------------------------------------------------
+vtkIECKinematicChain::vtkIECKinematicChain()
+{
+  this->IsocenterPosition[0] = 0.0;
+  this->IsocenterPosition[1] = 0.0;
+  this->IsocenterPosition[2] = 0.0;
+  this->GantryAngle = 0.0;
+  this->CollimatorAngle = 0.0;
+  this->PatientSupportRotationAngle = 0.0;
+  this->TableTopEccentricRotationAngle = 0.0;
+  this->TableTopDisplacement[0] = 0.0;
+  this->TableTopDisplacement[1] = 0.0;
+  this->TableTopDisplacement[2] = 0.0;
+
+  for (int frame = 0; frame < NumberOfFrames; ++frame)
+  {
+    SetIdentity(this->FrameToRasTransforms[frame]);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkIECKinematicChain::~vtkIECKinematicChain() = default;
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "IsocenterPosition: (" << this->IsocenterPosition[0] << ", " << this->IsocenterPosition[1] << ", " << this->IsocenterPosition[2] << ")\n";
+  os << indent << "GantryAngle: " << this->GantryAngle << "\n";
+  os << indent << "CollimatorAngle: " << this->CollimatorAngle << "\n";
+  os << indent << "PatientSupportRotationAngle: " << this->PatientSupportRotationAngle << "\n";
+  os << indent << "TableTopEccentricRotationAngle: " << this->TableTopEccentricRotationAngle << "\n";
+  os << indent << "TableTopDisplacement: (" << this->TableTopDisplacement[0] << ", " << this->TableTopDisplacement[1] << ", " << this->TableTopDisplacement[2] << ")\n";
+}
+
+//----------------------------------------------------------------------------
+vtkIECKinematicChain::Frame vtkIECKinematicChain::GetParentFrame(Frame frame)
+{
+  switch (frame)
+  {
+    case FixedReference:
+      return RAS;
+    case Gantry:
+    case PatientSupportRotation:
+      return FixedReference;
+    case Collimator:
+    case LeftImagingPanel:
+    case RightImagingPanel:
+    case FlatPanel:
+      return Gantry;
+    case PatientSupport:
+    case TableTopEccentricRotation:
+      return PatientSupportRotation;
+    case TableTop:
+      return TableTopEccentricRotation;
+    default:
+      return RAS;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::GetPose(Pose& pose)
+{
+  pose.GantryAngle = this->GantryAngle;
+  pose.CollimatorAngle = this->CollimatorAngle;
+  pose.PatientSupportRotationAngle = this->PatientSupportRotationAngle;
+  pose.TableTopEccentricRotationAngle = this->TableTopEccentricRotationAngle;
+  std::copy(this->TableTopDisplacement, this->TableTopDisplacement + 3, pose.TableTopDisplacement);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::SetPose(const Pose& pose)
+{
+  this->SetGantryAngle(pose.GantryAngle);
+  this->SetCollimatorAngle(pose.CollimatorAngle);
+  this->SetPatientSupportRotationAngle(pose.PatientSupportRotationAngle);
+  this->SetTableTopEccentricRotationAngle(pose.TableTopEccentricRotationAngle);
+  this->SetTableTopDisplacement(pose.TableTopDisplacement[0], pose.TableTopDisplacement[1], pose.TableTopDisplacement[2]);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::ComputeTransformToParent(Frame frame, const Pose& pose, const double isocenter[3], double matrix[16])
+{
+  switch (frame)
+  {
+    case FixedReference:
+    {
+      // Translate to isocenter, then the "S" direction in RAS is the "A" direction in FixedReference,
+      // and the "S" direction is toward the gantry (head first position)
+      double rotationX[16] = { 0.0 };
+      double rotationZ[16] = { 0.0 };
+      SetRotation(0, -90.0, rotationX);
+      SetRotation(2, 180.0, rotationZ);
+      Multiply(rotationX, rotationZ, matrix);
+      matrix[3] = isocenter[0];
+      matrix[7] = isocenter[1];
+      matrix[11] = isocenter[2];
+      break;
+    }
+    case Gantry:
+      SetRotation(1, pose.GantryAngle, matrix);
+      break;
+    case Collimator:
+      SetRotation(2, pose.CollimatorAngle, matrix);
+      break;
+    case PatientSupportRotation:
+      SetRotation(2, pose.PatientSupportRotationAngle, matrix);
+      break;
+    case TableTopEccentricRotation:
+      SetRotation(2, pose.TableTopEccentricRotationAngle, matrix);
+      break;
+    case TableTop:
+      SetIdentity(matrix);
+      matrix[3] = pose.TableTopDisplacement[0];
+      matrix[7] = pose.TableTopDisplacement[1];
+      matrix[11] = pose.TableTopDisplacement[2];
+      break;
+    default:
+      SetIdentity(matrix);
+      break;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::ComputeFrameToRasTransforms(const Pose& pose, const double isocenter[3], double frameToRas[NumberOfFrames][16])
+{
+  // Parents precede their children in the frame enumeration, so one pass in order is enough
+  SetIdentity(frameToRas[RAS]);
+  double toParent[16] = { 0.0 };
+  for (int frame = RAS + 1; frame < NumberOfFrames; ++frame)
+  {
+    ComputeTransformToParent(static_cast<Frame>(frame), pose, isocenter, toParent);
+    Multiply(frameToRas[GetParentFrame(static_cast<Frame>(frame))], toParent, frameToRas[frame]);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::ComputeTransformBetween(const double fromFrameToRas[16], const double toFrameToRas[16], double matrix[16])
+{
+  double rasToToFrame[16] = { 0.0 };
+  InvertRigid(toFrameToRas, rasToToFrame);
+  Multiply(rasToToFrame, fromFrameToRas, matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::UpdateFrameToRasTransforms()
+{
+  if (this->FrameToRasTransformsTime > this->GetMTime())
+  {
+    return;
+  }
+
+  Pose pose;
+  this->GetPose(pose);
+  ComputeFrameToRasTransforms(pose, this->IsocenterPosition, this->FrameToRasTransforms);
+  this->FrameToRasTransformsTime.Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::GetTransformToParent(Frame frame, double matrix[16])
+{
+  Pose pose;
+  this->GetPose(pose);
+  ComputeTransformToParent(frame, pose, this->IsocenterPosition, matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::GetTransformBetween(Frame fromFrame, Frame toFrame, double matrix[16])
+{
+  if (fromFrame < RAS || fromFrame >= NumberOfFrames || toFrame < RAS || toFrame >= NumberOfFrames)
+  {
+    vtkErrorMacro("GetTransformBetween: Invalid frame");
+    SetIdentity(matrix);
+    return;
+  }
+
+  this->UpdateFrameToRasTransforms();
+  ComputeTransformBetween(this->FrameToRasTransforms[fromFrame], this->FrameToRasTransforms[toFrame], matrix);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::GetTransformBetween(Frame fromFrame, Frame toFrame, vtkMatrix4x4* matrix)
+{
+  if (!matrix)
+  {
+    vtkErrorMacro("GetTransformBetween: Invalid output matrix");
+    return;
+  }
+
+  double elements[16] = { 0.0 };
+  this->GetTransformBetween(fromFrame, toFrame, elements);
+  matrix->DeepCopy(elements);
+}
+
+//----------------------------------------------------------------------------
+void vtkIECKinematicChain::GetTransformsBetweenForPoses(Frame fromFrame, Frame toFrame, const std::vector<Pose>& poses, std::vector<double>& matrices)
+{
+  matrices.resize(16 * poses.size());
+  if (fromFrame < RAS || fromFrame >= NumberOfFrames || toFrame < RAS || toFrame >= NumberOfFrames)
+  {
+    vtkErrorMacro("GetTransformsBetweenForPoses: Invalid frame");
+    return;
+  }
+
+  const double* isocenter = this->IsocenterPosition;
+  vtkSMPTools::For(0, static_cast<vtkIdType>(poses.size()),
+    [&](vtkIdType beginPose, vtkIdType endPose)
+    {
+      double frameToRas[NumberOfFrames][16];
+      for (vtkIdType poseIndex = beginPose; poseIndex < endPose; ++poseIndex)
+      {
+        ComputeFrameToRasTransforms(poses[poseIndex], isocenter, frameToRas);
+        ComputeTransformBetween(frameToRas[fromFrame], frameToRas[toFrame], &matrices[16 * poseIndex]);
+      }
+    });
+}
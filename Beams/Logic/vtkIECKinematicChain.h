@@ -0,0 +1,156 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#ifndef __vtkIECKinematicChain_h
+#define __vtkIECKinematicChain_h
+
+#include "vtkSlicerBeamsModuleLogicExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkTimeStamp.h>
+
+// STD includes
+#include <vector>
+
+class vtkMatrix4x4;
+
+/// \ingroup SlicerRt_QtModules_Beams
+/// \brief Kinematic chain of the IEC 61217 coordinate systems, computed analytically without MRML.
+///
+/// The transforms between the coordinate frames are composed from the machine parameters (isocenter,
+/// gantry, collimator, patient support and table top), so any frame-to-frame transform can be evaluated
+/// for many machine configurations quickly (e.g. for animation or collision checks along an arc).
+/// The frame hierarchy and the conventions are the same as in \sa vtkSlicerIECTransformLogic.
+/// Transforms that depend on device models (imaging panels, patient support scaling) are identity.
+class VTK_SLICER_BEAMS_LOGIC_EXPORT vtkIECKinematicChain : public vtkObject
+{
+public:
+  enum Frame
+  {
+    RAS = 0,
+    FixedReference,
+    Gantry,
+    Collimator,
+    LeftImagingPanel,
+    RightImagingPanel,
+    PatientSupportRotation,
+    PatientSupport,
+    TableTopEccentricRotation,
+    TableTop,
+    FlatPanel,
+    NumberOfFrames
+  };
+
+  /// Machine configuration that the transforms depend on (in addition to the isocenter)
+  struct Pose
+  {
+    double GantryAngle;
+    double CollimatorAngle;
+    double PatientSupportRotationAngle;
+    double TableTopEccentricRotationAngle;
+    double TableTopDisplacement[3];
+  };
+
+public:
+  static vtkIECKinematicChain *New();
+  vtkTypeMacro(vtkIECKinematicChain, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Get parent of a frame in the IEC hierarchy. The root frame (RAS) is its own parent
+  static Frame GetParentFrame(Frame frame);
+
+  /// Get transform from a frame to its parent frame for the current configuration
+  /// \param matrix Output matrix elements in row-major order
+  void GetTransformToParent(Frame frame, double matrix[16]);
+
+  /// Get transform from one frame to another for the current configuration
+  /// \param matrix Output matrix elements in row-major order
+  void GetTransformBetween(Frame fromFrame, Frame toFrame, double matrix[16]);
+  /// Get transform from one frame to another for the current configuration
+  void GetTransformBetween(Frame fromFrame, Frame toFrame, vtkMatrix4x4* matrix);
+
+  /// Get transforms from one frame to another for many machine configurations. The isocenter is
+  /// the current one. The poses are evaluated in parallel.
+  /// \param matrices Output matrix elements, 16 for each pose in row-major order
+  void GetTransformsBetweenForPoses(Frame fromFrame, Frame toFrame, const std::vector<Pose>& poses, std::vector<double>& matrices);
+
+  /// Get current machine configuration
+  void GetPose(Pose& pose);
+  /// Set current machine configuration
+  void SetPose(const Pose& pose);
+
+  /// Isocenter position in RAS
+  vtkSetVector3Macro(IsocenterPosition, double);
+  vtkGetVector3Macro(IsocenterPosition, double);
+
+  /// Gantry angle (degrees)
+  vtkSetMacro(GantryAngle, double);
+  vtkGetMacro(GantryAngle, double);
+
+  /// Collimator angle (degrees)
+  vtkSetMacro(CollimatorAngle, double);
+  vtkGetMacro(CollimatorAngle, double);
+
+  /// Patient support (couch) rotation angle (degrees)
+  vtkSetMacro(PatientSupportRotationAngle, double);
+  vtkGetMacro(PatientSupportRotationAngle, double);
+
+  /// Table top eccentric rotation angle (degrees)
+  vtkSetMacro(TableTopEccentricRotationAngle, double);
+  vtkGetMacro(TableTopEccentricRotationAngle, double);
+
+  /// Table top displacement (lateral, longitudinal, vertical) in the eccentric rotation frame (mm)
+  vtkSetVector3Macro(TableTopDisplacement, double);
+  vtkGetVector3Macro(TableTopDisplacement, double);
+
+protected:
+  /// Compute transform from a frame to its parent frame for a configuration
+  static void ComputeTransformToParent(Frame frame, const Pose& pose, const double isocenter[3], double matrix[16]);
+  /// Compute transforms from all frames to RAS for a configuration
+  static void ComputeFrameToRasTransforms(const Pose& pose, const double isocenter[3], double frameToRas[NumberOfFrames][16]);
+  /// Compute transform between two frames from their transforms to RAS
+  static void ComputeTransformBetween(const double fromFrameToRas[16], const double toFrameToRas[16], double matrix[16]);
+
+  /// Recompute the cached frame to RAS transforms if the configuration changed
+  void UpdateFrameToRasTransforms();
+
+protected:
+  double IsocenterPosition[3];
+  double GantryAngle;
+  double CollimatorAngle;
+  double PatientSupportRotationAngle;
+  double TableTopEccentricRotationAngle;
+  double TableTopDisplacement[3];
+
+  /// Transforms from all frames to RAS for the current configuration
+  double FrameToRasTransforms[NumberOfFrames][16];
+  vtkTimeStamp FrameToRasTransformsTime;
+
+protected:
+  vtkIECKinematicChain();
+  ~vtkIECKinematicChain() override;
+
+private:
+  vtkIECKinematicChain(const vtkIECKinematicChain&) = delete;
+  void operator=(const vtkIECKinematicChain&) = delete;
+};
+
+#endif
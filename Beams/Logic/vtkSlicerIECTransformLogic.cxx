@@ -65,6 +65,8 @@ vtkSlicerIECTransformLogic::vtkSlicerIECTransformLogic()
   this->IecTransforms.push_back(std::make_pair(TableTopEccentricRotation, PatientSupportRotation)); // NOTE: Currently not supported by REV
   this->IecTransforms.push_back(std::make_pair(TableTop, TableTopEccentricRotation));
   this->IecTransforms.push_back(std::make_pair(FlatPanel, Gantry));
+
+  this->KinematicChain = vtkIECKinematicChain::New();
 }
 
 //-----------------------------------------------------------------------------
@@ -72,6 +74,13 @@ vtkSlicerIECTransformLogic::~vtkSlicerIECTransformLogic()
 {
   this->CoordinateSystemsMap.clear();
   this->IecTransforms.clear();
+  this->TransformNodeCache.clear();
+
+  if (this->KinematicChain)
+  {
+    this->KinematicChain->Delete();
+    this->KinematicChain = nullptr;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -116,9 +125,9 @@ void vtkSlicerIECTransformLogic::BuildIECTransformHierarchy()
   std::vector< std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier> >::iterator transformIt;
   for (transformIt=this->IecTransforms.begin(); transformIt!=this->IecTransforms.end(); ++transformIt)
   {
-    std::string transformNodeName = this->GetTransformNodeNameBetween(transformIt->first, transformIt->second);
-    if (!this->GetMRMLScene()->GetFirstNodeByName(transformNodeName.c_str()))
+    if (!this->GetTransformNodeBetween(transformIt->first, transformIt->second))
     {
+      std::string transformNodeName = this->GetTransformNodeNameBetween(transformIt->first, transformIt->second);
       vtkSmartPointer<vtkMRMLLinearTransformNode> transformNode = vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
       transformNode->SetName(transformNodeName.c_str());
       transformNode->SetHideFromEditors(1);
@@ -219,48 +228,31 @@ void vtkSlicerIECTransformLogic::UpdateIECTransformsFromBeam(vtkMRMLRTBeamNode*
   // Make sure the transform hierarchy is set up
   this->BuildIECTransformHierarchy();
 
-  //TODO: Code duplication (RevLogic::Update...)
-  vtkMRMLLinearTransformNode* gantryToFixedReferenceTransformNode =
-    this->GetTransformNodeBetween(Gantry, FixedReference);
-  vtkTransform* gantryToFixedReferenceTransform = vtkTransform::SafeDownCast(gantryToFixedReferenceTransformNode->GetTransformToParent());
-  gantryToFixedReferenceTransform->Identity();
-  gantryToFixedReferenceTransform->RotateY(beamNode->GetGantryAngle());
-  gantryToFixedReferenceTransform->Modified();
-
-  vtkMRMLLinearTransformNode* collimatorToGantryTransformNode =
-    this->GetTransformNodeBetween(Collimator, Gantry);
-  vtkTransform* collimatorToGantryTransform = vtkTransform::SafeDownCast(collimatorToGantryTransformNode->GetTransformToParent());
-  collimatorToGantryTransform->Identity();
-  collimatorToGantryTransform->RotateZ(beamNode->GetCollimatorAngle());
-  collimatorToGantryTransform->Modified();
-
-  vtkMRMLLinearTransformNode* patientSupportRotationToFixedReferenceTransformNode =
-    this->GetTransformNodeBetween(PatientSupportRotation, FixedReference);
-  vtkTransform* patientSupportToFixedReferenceTransform = vtkTransform::SafeDownCast(patientSupportRotationToFixedReferenceTransformNode->GetTransformToParent());
-  patientSupportToFixedReferenceTransform->Identity();
-  patientSupportToFixedReferenceTransform->RotateZ(beamNode->GetCouchAngle());
-  patientSupportToFixedReferenceTransform->Modified();
-
-  // Update IEC FixedReference to RAS transform based on the isocenter defined in the beam's parent plan
-  vtkMRMLLinearTransformNode* fixedReferenceToRasTransformNode =
-    this->GetTransformNodeBetween(FixedReference, RAS);
-  vtkTransform* fixedReferenceToRasTransform = vtkTransform::SafeDownCast(fixedReferenceToRasTransformNode->GetTransformToParent());
-  fixedReferenceToRasTransform->Identity();
-  // Apply isocenter translation
+  // Update kinematic chain from beam parameters
   double isocenterPosition[3] = { 0.0, 0.0, 0.0 };
-  if (beamNode->GetPlanIsocenterPosition(isocenterPosition))
+  if (!beamNode->GetPlanIsocenterPosition(isocenterPosition))
   {
-    fixedReferenceToRasTransform->Translate(isocenterPosition[0], isocenterPosition[1], isocenterPosition[2]);
+    vtkErrorMacro("UpdateIECTransformsFromBeam: Failed to get isocenter position for beam " << beamNode->GetName());
   }
-  else
+  this->KinematicChain->SetIsocenterPosition(isocenterPosition);
+  this->KinematicChain->SetGantryAngle(beamNode->GetGantryAngle());
+  this->KinematicChain->SetCollimatorAngle(beamNode->GetCollimatorAngle());
+  this->KinematicChain->SetPatientSupportRotationAngle(beamNode->GetCouchAngle());
+
+  // Set the transforms affected by the beam parameters to the nodes
+  //TODO: Code duplication (RevLogic::Update...)
+  CoordinateSystemIdentifier beamFrames[4] = { FixedReference, Gantry, Collimator, PatientSupportRotation };
+  double matrix[16] = { 0.0 };
+  for (CoordinateSystemIdentifier frame : beamFrames)
   {
-    vtkErrorMacro("UpdateIECTransformsFromBeam: Failed to get isocenter position for beam " << beamNode->GetName());
+    CoordinateSystemIdentifier parentFrame = static_cast<CoordinateSystemIdentifier>(
+      vtkIECKinematicChain::GetParentFrame(static_cast<vtkIECKinematicChain::Frame>(frame)) );
+    vtkMRMLLinearTransformNode* transformNode = this->GetTransformNodeBetween(frame, parentFrame);
+    vtkTransform* transform = vtkTransform::SafeDownCast(transformNode->GetTransformToParent());
+    this->KinematicChain->GetTransformToParent(static_cast<vtkIECKinematicChain::Frame>(frame), matrix);
+    transform->SetMatrix(matrix);
+    transform->Modified();
   }
-  // The "S" direction in RAS is the "A" direction in FixedReference
-  fixedReferenceToRasTransform->RotateX(-90.0);
-  // The "S" direction to be toward the gantry (head first position) by default
-  fixedReferenceToRasTransform->RotateZ(180.0);
-  fixedReferenceToRasTransform->Modified();
 }
 
 //-----------------------------------------------------------------------------
@@ -280,8 +272,22 @@ vtkMRMLLinearTransformNode* vtkSlicerIECTransformLogic::GetTransformNodeBetween(
     return nullptr;
   }
 
-  return vtkMRMLLinearTransformNode::SafeDownCast(
+  // Use cached node if it is still in the current scene
+  std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier> framePair(fromFrame, toFrame);
+  std::map< std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier>, vtkWeakPointer<vtkMRMLLinearTransformNode> >::iterator cacheIt =
+    this->TransformNodeCache.find(framePair);
+  if (cacheIt != this->TransformNodeCache.end() && cacheIt->second && cacheIt->second->GetScene() == this->GetMRMLScene())
+  {
+    return cacheIt->second;
+  }
+
+  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(
     this->GetMRMLScene()->GetFirstNodeByName( this->GetTransformNodeNameBetween(fromFrame, toFrame).c_str() ) );
+  if (transformNode)
+  {
+    this->TransformNodeCache[framePair] = transformNode;
+  }
+  return transformNode;
 }
 
 //-----------------------------------------------------------------------------
@@ -298,15 +304,31 @@ bool vtkSlicerIECTransformLogic::GetTransformBetween(CoordinateSystemIdentifier
     return false;
   }
 
-  //TODO: !!! IMPLEMENT DYNAMICALLY !!!
+  if (fromFrame < RAS || fromFrame >= LastIECCoordinateFrame || toFrame < RAS || toFrame >= LastIECCoordinateFrame)
+  {
+    vtkErrorMacro("GetTransformBetween: Invalid coordinate frame");
+    return false;
+  }
 
-  if (fromFrame == Collimator && toFrame == RAS)
+  // Get the transform node of each frame in the hierarchy (RAS is the world, represented by nullptr)
+  vtkMRMLLinearTransformNode* frameNodes[2] = { nullptr, nullptr };
+  CoordinateSystemIdentifier frames[2] = { fromFrame, toFrame };
+  for (int i = 0; i < 2; ++i)
   {
-    vtkMRMLTransformNode::GetTransformBetweenNodes(
-      this->GetTransformNodeBetween(Collimator, Gantry), nullptr, outputTransform );
-    return true;
+    if (frames[i] == RAS)
+    {
+      continue;
+    }
+    CoordinateSystemIdentifier parentFrame = static_cast<CoordinateSystemIdentifier>(
+      vtkIECKinematicChain::GetParentFrame(static_cast<vtkIECKinematicChain::Frame>(frames[i])) );
+    frameNodes[i] = this->GetTransformNodeBetween(frames[i], parentFrame);
+    if (!frameNodes[i])
+    {
+      vtkErrorMacro("GetTransformBetween: Failed to get transform " << this->GetTransformNodeNameBetween(frames[i], parentFrame));
+      return false;
+    }
   }
 
-  vtkErrorMacro("GetTransformBetween: Failed to get transform " << this->GetTransformNodeNameBetween(fromFrame, toFrame));
-  return false;
+  vtkMRMLTransformNode::GetTransformBetweenNodes(frameNodes[0], frameNodes[1], outputTransform);
+  return true;
 }
@@ -23,10 +23,14 @@
 #define __vtkSlicerIECTransformLogic_h
 
 #include "vtkSlicerBeamsModuleLogicExport.h"
+#include "vtkIECKinematicChain.h"
 
 // Slicer includes
 #include "vtkMRMLAbstractLogic.h"
 
+// VTK includes
+#include <vtkWeakPointer.h>
+
 // STD includes
 #include <map>
 #include <vector>
@@ -51,18 +55,18 @@ class VTK_SLICER_BEAMS_LOGIC_EXPORT vtkSlicerIECTransformLogic : public vtkMRMLA
 public:
   enum CoordinateSystemIdentifier
   {
-    RAS = 0,
-    FixedReference,
-    Gantry,
-    Collimator,
-    LeftImagingPanel,
-    RightImagingPanel,
-    PatientSupportRotation, // Not part of the standard, but useful for visualization
-    PatientSupport,
-    TableTopEccentricRotation,
-    TableTop,
-    FlatPanel,
-    LastIECCoordinateFrame // Last index used for adding more coordinate systems externally
+    RAS = vtkIECKinematicChain::RAS,
+    FixedReference = vtkIECKinematicChain::FixedReference,
+    Gantry = vtkIECKinematicChain::Gantry,
+    Collimator = vtkIECKinematicChain::Collimator,
+    LeftImagingPanel = vtkIECKinematicChain::LeftImagingPanel,
+    RightImagingPanel = vtkIECKinematicChain::RightImagingPanel,
+    PatientSupportRotation = vtkIECKinematicChain::PatientSupportRotation, // Not part of the standard, but useful for visualization
+    PatientSupport = vtkIECKinematicChain::PatientSupport,
+    TableTopEccentricRotation = vtkIECKinematicChain::TableTopEccentricRotation,
+    TableTop = vtkIECKinematicChain::TableTop,
+    FlatPanel = vtkIECKinematicChain::FlatPanel,
+    LastIECCoordinateFrame = vtkIECKinematicChain::NumberOfFrames // Last index used for adding more coordinate systems externally
   };
 
 public:
@@ -79,7 +83,7 @@ public:
   vtkMRMLLinearTransformNode* GetTransformNodeBetween(
     CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame );
 
-  /// Get transform from one coordinate frame to another
+  /// Get transform from one coordinate frame to another by concatenating the transform nodes in the hierarchy
   /// \return Success flag (false on any error)
   bool GetTransformBetween(CoordinateSystemIdentifier fromFrame, CoordinateSystemIdentifier toFrame, vtkGeneralTransform* outputTransform);
 
@@ -88,6 +92,10 @@ public:
   /// Update IEC transforms according to beam node
   void UpdateIECTransformsFromBeam(vtkMRMLRTBeamNode* beamNode);
 
+  /// Get kinematic chain holding the current machine pose. It computes transforms between any
+  /// coordinate frames without MRML access, so it can be used for evaluating many poses quickly.
+  vtkGetObjectMacro(KinematicChain, vtkIECKinematicChain);
+
 protected:
   /// Get name of transform node between two coordinate systems
   /// \return Transform node name between the specified coordinate frames.
@@ -101,6 +109,12 @@ protected:
   /// List of IEC transforms
   std::vector< std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier> > IecTransforms;
 
+  /// Transform nodes found by \sa GetTransformNodeBetween, so that the scene is not searched by name on every call
+  std::map< std::pair<CoordinateSystemIdentifier, CoordinateSystemIdentifier>, vtkWeakPointer<vtkMRMLLinearTransformNode> > TransformNodeCache;
+
+  /// Analytic model of the IEC transform hierarchy
+  vtkIECKinematicChain* KinematicChain;
+
 protected:
   vtkSlicerIECTransformLogic();
   ~vtkSlicerIECTransformLogic() override;
@@ -46,6 +46,10 @@
 #include <vtkDoubleArray.h>
 #include <vtkTable.h>
 #include <vtkCellArray.h>
+#include <vtkVariant.h>
+
+// STD includes
+#include <sstream>
 
 //------------------------------------------------------------------------------
 const char* vtkMRMLRTBeamNode::NEW_BEAM_NODE_NAME_PREFIX = "NewBeam_";
@@ -56,6 +60,7 @@ static const char* MLCBOUNDARY_REFERENCE_ROLE = "MLCBoundaryRef";
 static const char* MLCPOSITION_REFERENCE_ROLE = "MLCPositionRef";
 static const char* DRR_REFERENCE_ROLE = "DRRRef";
 static const char* CONTOUR_BEV_REFERENCE_ROLE = "contourBEVRef";
+static const char* WED_REFERENCE_ROLE = "WEDRef";
 
 //------------------------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLRTBeamNode);
@@ -111,6 +116,9 @@ void vtkMRMLRTBeamNode::ReadXMLAttributes(const char** atts)
 {
   vtkMRMLNode::ReadXMLAttributes(atts);
 
+  // Dose engine parameters are parsed from the attributes when requested
+  this->DoseEngineParameters.clear();
+
   // Read all MRML node attributes from two arrays of names and values
   const char* attName = nullptr;
   const char* attValue = nullptr;
@@ -208,6 +216,18 @@ void vtkMRMLRTBeamNode::Copy(vtkMRMLNode *anode)
   this->SetCollimatorAngle(node->GetCollimatorAngle());
   this->SetCouchAngle(node->GetCouchAngle());
 
+  // The store is mutable, so it is not shared between the beams
+  vtkSmartPointer<vtkRTBeamControlPointStore> controlPointStore;
+  if (node->GetControlPointStore())
+  {
+    controlPointStore = vtkSmartPointer<vtkRTBeamControlPointStore>::New();
+    controlPointStore->DeepCopy(node->GetControlPointStore());
+  }
+  this->SetControlPointStore(controlPointStore);
+
+  // Attributes have been copied by the base class
+  this->DoseEngineParameters = node->DoseEngineParameters;
+
   this->DisableModifiedEventOff();
   this->InvokePendingModifiedEvent();
 }
@@ -250,6 +270,7 @@ void vtkMRMLRTBeamNode::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << " GantryAngle:   " << this->GantryAngle << "\n";
   os << indent << " CollimatorAngle:   " << this->CollimatorAngle << "\n";
   os << indent << " CouchAngle:   " << this->CouchAngle << "\n";
+  os << indent << " NumberOfControlPoints:   " << (this->ControlPointStore ? this->ControlPointStore->GetNumberOfControlPoints() : 0) << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -339,6 +360,199 @@ void vtkMRMLRTBeamNode::SetAndObserveMLCPositionTableNode(vtkMRMLTableNode* node
   this->InvokeCustomModifiedEvent(vtkMRMLRTBeamNode::BeamGeometryModified);
 }
 
+//----------------------------------------------------------------------------
+void vtkMRMLRTBeamNode::SetControlPointStore(vtkRTBeamControlPointStore* store)
+{
+  if (this->ControlPointStore == store)
+  {
+    return;
+  }
+  this->ControlPointStore = store;
+  this->Modified();
+  this->InvokeCustomModifiedEvent(vtkMRMLRTBeamNode::BeamGeometryModified);
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLRTBeamNode::DoseEngineParameter::DoseEngineParameter()
+  : DoubleValue(0.0)
+  , IntegerValue(0)
+  , BooleanValue(false)
+{
+  for (int type = 0; type < NumberOfTypes; ++type)
+  {
+    this->Parsed[type] = false;
+    this->Valid[type] = false;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLRTBeamNode::SetDoseEngineDoubleParameter(const std::string& name, double value)
+{
+  DoseEngineParameter parameter;
+  std::ostringstream valueStream;
+  valueStream.precision(15);
+  valueStream << value;
+  parameter.ValueString = valueStream.str();
+  parameter.DoubleValue = value;
+  parameter.Parsed[DoseEngineParameter::Double] = parameter.Valid[DoseEngineParameter::Double] = true;
+  this->SetDoseEngineParameter(name, parameter);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLRTBeamNode::SetDoseEngineIntegerParameter(const std::string& name, int value)
+{
+  DoseEngineParameter parameter;
+  std::ostringstream valueStream;
+  valueStream << value;
+  parameter.ValueString = valueStream.str();
+  parameter.IntegerValue = value;
+  parameter.Parsed[DoseEngineParameter::Integer] = parameter.Valid[DoseEngineParameter::Integer] = true;
+  this->SetDoseEngineParameter(name, parameter);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLRTBeamNode::SetDoseEngineBooleanParameter(const std::string& name, bool value)
+{
+  DoseEngineParameter parameter;
+  parameter.ValueString = (value ? "true" : "false");
+  parameter.BooleanValue = value;
+  parameter.Parsed[DoseEngineParameter::Boolean] = parameter.Valid[DoseEngineParameter::Boolean] = true;
+  this->SetDoseEngineParameter(name, parameter);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLRTBeamNode::SetDoseEngineStringParameter(const std::string& name, const std::string& value)
+{
+  // Typed values are parsed from the string when requested
+  DoseEngineParameter parameter;
+  parameter.ValueString = value;
+  this->SetDoseEngineParameter(name, parameter);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLRTBeamNode::SetDoseEngineParameter(const std::string& name, const DoseEngineParameter& parameter)
+{
+  const char* oldValueString = this->GetAttribute(name.c_str());
+  bool changed = (!oldValueString || parameter.ValueString != oldValueString);
+
+  this->DoseEngineParameters[name] = parameter;
+  if (!changed)
+  {
+    return;
+  }
+
+  // Only DoseEngineParameterModified is invoked, not the generic modified event of the attribute change
+  int disabledModify = this->GetDisableModifiedEvent();
+  this->SetDisableModifiedEvent(1);
+  this->SetAttribute(name.c_str(), parameter.ValueString.c_str());
+  this->SetDisableModifiedEvent(disabledModify);
+
+  // Compressed into one event if between StartModify and EndModify
+  this->InvokeCustomModifiedEvent(vtkMRMLRTBeamNode::DoseEngineParameterModified);
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLRTBeamNode::DoseEngineParameter* vtkMRMLRTBeamNode::GetDoseEngineParameter(
+  const std::string& name, DoseEngineParameter::ParameterType type)
+{
+  const char* valueString = this->GetAttribute(name.c_str());
+  if (!valueString)
+  {
+    // Attribute may have been removed directly
+    this->DoseEngineParameters.erase(name);
+    return nullptr;
+  }
+
+  // Start over if the parameter only exists as attribute (e.g. after loading the scene)
+  // or the attribute has been changed directly
+  DoseEngineParameter& parameter = this->DoseEngineParameters[name];
+  if (parameter.ValueString != valueString)
+  {
+    parameter = DoseEngineParameter();
+    parameter.ValueString = valueString;
+  }
+
+  if (!parameter.Parsed[type])
+  {
+    bool valid = true;
+    switch (type)
+    {
+      case DoseEngineParameter::Double:
+        parameter.DoubleValue = vtkVariant(valueString).ToDouble(&valid);
+        break;
+      case DoseEngineParameter::Integer:
+        parameter.IntegerValue = vtkVariant(valueString).ToInt(&valid);
+        break;
+      case DoseEngineParameter::Boolean:
+        valid = (!strcmp(valueString, "true") || !strcmp(valueString, "false"));
+        parameter.BooleanValue = !strcmp(valueString, "true");
+        break;
+      default:
+        valid = false;
+        break;
+    }
+    parameter.Parsed[type] = true;
+    parameter.Valid[type] = valid;
+  }
+
+  return (parameter.Valid[type] ? &parameter : nullptr);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLRTBeamNode::GetDoseEngineDoubleParameter(const std::string& name, double& value)
+{
+  DoseEngineParameter* parameter = this->GetDoseEngineParameter(name, DoseEngineParameter::Double);
+  if (!parameter)
+  {
+    return false;
+  }
+  value = parameter->DoubleValue;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLRTBeamNode::GetDoseEngineIntegerParameter(const std::string& name, int& value)
+{
+  DoseEngineParameter* parameter = this->GetDoseEngineParameter(name, DoseEngineParameter::Integer);
+  if (!parameter)
+  {
+    return false;
+  }
+  value = parameter->IntegerValue;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLRTBeamNode::GetDoseEngineBooleanParameter(const std::string& name, bool& value)
+{
+  DoseEngineParameter* parameter = this->GetDoseEngineParameter(name, DoseEngineParameter::Boolean);
+  if (!parameter)
+  {
+    return false;
+  }
+  value = parameter->BooleanValue;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLRTBeamNode::GetDoseEngineStringParameter(const std::string& name, std::string& value)
+{
+  // The attribute is the string value itself, no need to parse
+  const char* valueString = this->GetAttribute(name.c_str());
+  if (!valueString)
+  {
+    return false;
+  }
+  value = valueString;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLRTBeamNode::HasDoseEngineParameter(const std::string& name)
+{
+  return (this->GetAttribute(name.c_str()) != nullptr);
+}
+
 //----------------------------------------------------------------------------
 vtkMRMLScalarVolumeNode* vtkMRMLRTBeamNode::GetDRRVolumeNode()
 {
@@ -375,6 +589,24 @@ void vtkMRMLRTBeamNode::SetAndObserveContourBEVVolumeNode(vtkMRMLScalarVolumeNod
   this->SetNodeReferenceID(CONTOUR_BEV_REFERENCE_ROLE, (node ? node->GetID() : nullptr));
 }
 
+//----------------------------------------------------------------------------
+vtkMRMLScalarVolumeNode* vtkMRMLRTBeamNode::GetWEDVolumeNode()
+{
+  return vtkMRMLScalarVolumeNode::SafeDownCast( this->GetNodeReference(WED_REFERENCE_ROLE) );
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLRTBeamNode::SetAndObserveWEDVolumeNode(vtkMRMLScalarVolumeNode* node)
+{
+  if (node && this->Scene != node->GetScene())
+    {
+    vtkErrorMacro("Cannot set reference: the referenced and referencing node are not in the same scene");
+    return;
+    }
+
+  this->SetNodeReferenceID(WED_REFERENCE_ROLE, (node ? node->GetID() : nullptr));
+}
+
 //----------------------------------------------------------------------------
 vtkMRMLRTPlanNode* vtkMRMLRTBeamNode::GetParentPlanNode()
 {
@@ -455,6 +687,11 @@ void vtkMRMLRTBeamNode::SetGantryAngle(double angle)
   this->GantryAngle = angle;
   this->Modified();
   this->InvokeCustomModifiedEvent(vtkMRMLRTBeamNode::BeamTransformModified);
+  if (this->ControlPointStore)
+  {
+    // MLC aperture is interpolated at the gantry angle
+    this->InvokeCustomModifiedEvent(vtkMRMLRTBeamNode::BeamGeometryModified);
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -504,316 +741,82 @@ void vtkMRMLRTBeamNode::CreateBeamPolyData(vtkPolyData* beamModelPolyData/*=null
     return;
   }
 
-  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
-  vtkSmartPointer<vtkCellArray> cellArray = vtkSmartPointer<vtkCellArray>::New();
-
-  vtkMRMLTableNode* mlcTableNode = nullptr;
-
-  vtkIdType nofLeaves = 0;
-
-  // MLC boundary data
-  vtkMRMLDoubleArrayNode* arrayNode = this->GetMLCBoundaryDoubleArrayNode();
-  vtkDoubleArray* mlcBoundArray = nullptr;
-  if (arrayNode)
+  // Leaf positions are taken from the control point geometry if available, so that the MLC table is not accessed.
+  // The jaw positions of the node are used in both cases, so that they can be edited
+  int mlcType = vtkRTBeamControlPointStore::NoMLC;
+  vtkRTBeamControlPointStore::LeafDataVector mlc;
+  if ( this->ControlPointStore && this->ControlPointStore->GetNumberOfControlPoints() > 0
+    && this->ControlPointStore->GetNumberOfLeafPairs() > 0
+    && this->ControlPointStore->GetLeafDataAtGantryAngle(this->GantryAngle, mlc) )
   {
-    mlcBoundArray = arrayNode->GetArray();
-    nofLeaves = mlcBoundArray ? (mlcBoundArray->GetNumberOfTuples() - 1) : 0;
+    mlcType = this->ControlPointStore->GetMLCType();
   }
-
-  // MLC position data
-  if (nofLeaves)
+  else
   {
-    mlcTableNode = this->GetMLCPositionTableNode();
-    if (mlcTableNode && (mlcTableNode->GetNumberOfRows() == nofLeaves))
-    {
-      vtkDebugMacro("CreateBeamPolyData: Valid MLC nodes, number of leaves: " << nofLeaves);
-    }
-    else
-    {
-      vtkErrorMacro("CreateBeamPolyData: Invalid MLC nodes, or " \
-        "number of MLC boundaries and positions are different");
-      mlcTableNode = nullptr; // draw beam polydata without MLC
-    }
-  }
-
-  // static function ptr
-  bool(*AreEqual)(double, double) = vtkSlicerRtCommon::AreEqualWithTolerance;
-
-  bool xOpened = !AreEqual( this->X2Jaw, this->X1Jaw);
-  bool yOpened = !AreEqual( this->Y2Jaw, this->Y1Jaw);
+    vtkMRMLTableNode* mlcTableNode = nullptr;
 
-  // Check that we have MLC with Jaws opening
-  if (mlcTableNode && xOpened && yOpened)
-  {
-    using PointVector = std::vector< std::pair< double, double > >;
-    using LeafDataVector = std::vector< std::array< double, 4 > >;
-    
-    LeafDataVector mlc; // temporary MLC vector (Boundary and Position)
-    PointVector side12; // real points for side "1" and "2"
-
-    const char* mlcName = mlcTableNode->GetName();
-    bool typeMLCX = !strncmp( "MLCX", mlcName, strlen("MLCX"));
-    bool typeMLCY = !strncmp( "MLCY", mlcName, strlen("MLCY"));
-
-    // copy MLC data for easier processing
-    for ( vtkIdType leaf = 0; leaf < nofLeaves; leaf++)
-    {
-      vtkTable* table = mlcTableNode->GetTable();
-      double boundBegin = mlcBoundArray->GetTuple1(leaf);
-      double boundEnd = mlcBoundArray->GetTuple1(leaf + 1);
-      double pos1 = table->GetValue( leaf, 0).ToDouble();
-      double pos2 = table->GetValue( leaf, 1).ToDouble();
-      
-      mlc.push_back({ boundBegin, boundEnd, pos1, pos2 });
-    }
+    vtkIdType nofLeaves = 0;
 
-    auto firstLeafIterator = mlc.end();
-    auto lastLeafIterator = mlc.end();
-    double& jawBegin = this->Y1Jaw;
-    double& jawEnd = this->Y2Jaw;
-    if (typeMLCX)
-    {
-      jawBegin = this->Y1Jaw;
-      jawEnd = this->Y2Jaw;
-    }
-    else if (typeMLCY)
+    // MLC boundary data
+    vtkMRMLDoubleArrayNode* arrayNode = this->GetMLCBoundaryDoubleArrayNode();
+    vtkDoubleArray* mlcBoundArray = nullptr;
+    if (arrayNode)
     {
-      jawBegin = this->X1Jaw;
-      jawEnd = this->X2Jaw;
+      mlcBoundArray = arrayNode->GetArray();
+      nofLeaves = mlcBoundArray ? (mlcBoundArray->GetNumberOfTuples() - 1) : 0;
     }
 
-    // find first and last opened leaves visible within jaws
-    PointVector side1, side2; // temporary vectors to save visible points
-    for ( auto it = mlc.begin(); it != mlc.end(); ++it)
+    // MLC position data
+    vtkDataArray* positionArray1 = nullptr;
+    vtkDataArray* positionArray2 = nullptr;
+    if (nofLeaves)
     {
-      double& pos1 = (*it)[2]; // leaf position "1"
-      double& pos2 = (*it)[3]; // leaf position "2"
-      bool mlcOpened = !AreEqual( pos1, pos2);
-      bool withinJaw = false;
-      if (typeMLCX)
+      mlcTableNode = this->GetMLCPositionTableNode();
+      vtkTable* table = (mlcTableNode ? mlcTableNode->GetTable() : nullptr);
+      if (table && table->GetNumberOfColumns() >= 2)
       {
-        withinJaw = ((pos1 < this->X1Jaw && pos2 >= this->X1Jaw && pos2 <= this->X2Jaw) || 
-          (pos1 >= this->X1Jaw && pos1 <= this->X2Jaw && pos2 > this->X2Jaw) || 
-          (pos1 <= this->X1Jaw && pos2 >= this->X2Jaw) || 
-          (pos1 >= this->X1Jaw && pos1 <= this->X2Jaw && 
-            pos2 >= this->X1Jaw && pos2 <= this->X2Jaw));
+        positionArray1 = vtkDataArray::SafeDownCast(table->GetColumn(0));
+        positionArray2 = vtkDataArray::SafeDownCast(table->GetColumn(1));
       }
-      else if (typeMLCY)
+      if (positionArray1 && positionArray2 && (mlcTableNode->GetNumberOfRows() == nofLeaves))
       {
-        withinJaw = ((pos1 < this->Y1Jaw && pos2 >= this->Y1Jaw && pos2 <= this->Y2Jaw) || 
-          (pos1 >= this->Y1Jaw && pos1 <= this->Y2Jaw && pos2 > this->Y2Jaw) || 
-          (pos1 <= this->Y1Jaw && pos2 >= this->Y2Jaw) || 
-          (pos1 >= this->Y1Jaw && pos1 <= this->Y2Jaw && 
-            pos2 >= this->Y1Jaw && pos2 <= this->Y2Jaw));
+        vtkDebugMacro("CreateBeamPolyData: Valid MLC nodes, number of leaves: " << nofLeaves);
       }
-
-      if (withinJaw && mlcOpened && firstLeafIterator == mlc.end())
-      {
-        firstLeafIterator = it;
-      }
-      else if (withinJaw && mlcOpened && firstLeafIterator != mlc.end())
+      else
       {
-        lastLeafIterator = it;
+        vtkErrorMacro("CreateBeamPolyData: Invalid MLC nodes, or " \
+          "number of MLC boundaries and positions are different");
+        mlcTableNode = nullptr; // draw beam polydata without MLC
       }
     }
-    
-    // iterate through visible leaves to fill temporary points vectors
-    if (firstLeafIterator != mlc.end() && lastLeafIterator != mlc.end())
-    {
-      auto firstLeafIteratorJaws = firstLeafIterator;
-      auto lastLeafIteratorJaws = lastLeafIterator;
-      // find first and last visible leaves using Jaws data
-      for ( auto it = firstLeafIterator; it <= lastLeafIterator; ++it)
-      {
-        double& bound1 = (*it)[0]; // leaf begin boundary
-        double& bound2 = (*it)[1]; // leaf end boundary
-        if (bound1 <= jawBegin && bound2 > jawBegin)
-        {
-          firstLeafIteratorJaws = it;
-        }
-        else if (bound1 <= jawEnd && bound2 > jawEnd)
-        {
-          lastLeafIteratorJaws = it;
-        }
-      }
-
-      // find opened MLC leaves into Jaws opening (logical AND)
-      if (firstLeafIteratorJaws != firstLeafIterator)
-      {
-        firstLeafIterator = std::max( firstLeafIteratorJaws, firstLeafIterator);
-      }
-      if (lastLeafIteratorJaws != lastLeafIterator)
-      {
-        lastLeafIterator = std::min( lastLeafIteratorJaws, lastLeafIterator);
-      }
 
-      // add points for the visible leaves of side "1" and "2"
-      // into side1 and side2 points vectors
-      for ( auto it = firstLeafIterator; it <= lastLeafIterator; ++it)
+    // Copy MLC data in one pass over the arrays
+    if (mlcTableNode)
+    {
+      const char* mlcName = mlcTableNode->GetName();
+      if (mlcName && !strncmp( "MLCX", mlcName, strlen("MLCX")))
       {
-        double& bound1 = (*it)[0]; // leaf begin boundary
-        double& bound2 = (*it)[1]; // leaf end boundary
-        double& pos1 = (*it)[2]; // leaf position "1"
-        double& pos2 = (*it)[3]; // leaf position "2"
-        if (typeMLCX)
-        {
-          side1.push_back({ std::max( pos1, this->X1Jaw), bound1});
-          side1.push_back({ std::max( pos1, this->X1Jaw), bound2});
-          side2.push_back({ std::min( pos2, this->X2Jaw), bound1});
-          side2.push_back({ std::min( pos2, this->X2Jaw), bound2});
-        }
-        else if (typeMLCY)
-        {
-          side1.push_back({ bound1, std::max( pos1, this->Y1Jaw)});
-          side1.push_back({ bound2, std::max( pos1, this->Y1Jaw)});
-          side2.push_back({ bound1, std::min( pos2, this->Y2Jaw)});
-          side2.push_back({ bound2, std::min( pos2, this->Y2Jaw)});
-        }
+        mlcType = vtkRTBeamControlPointStore::MLCX;
       }
-      mlc.clear(); // doesn't need anymore
-
-      // intersection between Jaws and MLC boundary (logical AND) lambda
-      auto intersectJawsMLC = [ jawBegin, jawEnd, typeMLCX, typeMLCY](PointVector::value_type& point)
+      else if (mlcName && !strncmp( "MLCY", mlcName, strlen("MLCY")))
       {
-        double& leafBoundary = point.second;
-        if (typeMLCX) // JawsY and MLCX
-        {
-          leafBoundary = point.second;
-        }
-        else if (typeMLCY) // JawsX and MLCY
-        {
-          leafBoundary = point.first;
-        }
-
-        if (leafBoundary <= jawBegin)
-        {
-          leafBoundary = jawBegin;
-        }
-        else if (leafBoundary >= jawEnd)
-        {
-          leafBoundary = jawEnd;
-        }
-      };
-      // apply lambda to side "1"
-      std::for_each( side1.begin(), side1.end(), intersectJawsMLC);
-      // apply lambda to side "2"
-      std::for_each( side2.begin(), side2.end(), intersectJawsMLC);
-
-      // reverse side "2"
-      std::reverse( side2.begin(), side2.end());
-
-      // fill real points vector side12 without excessive points from side1 vector
-      PointVector::value_type& p = side1.front(); // start point
-      double& px = p.first; // x coordinate of p point
-      double& py = p.second; // y coordinate of p point
-      side12.push_back(p);
-      for ( size_t i = 1; i < side1.size() - 1; ++i)
-      {
-        double& pxNext = side1[i + 1].first; // x coordinate of next point
-        double& pyNext = side1[i + 1].second; // y coordinate of next point
-        if (!AreEqual( px, pxNext) && !AreEqual( py, pyNext))
-        {
-          p = side1[i];
-          side12.push_back(p);
-        }
+        mlcType = vtkRTBeamControlPointStore::MLCY;
       }
-      side12.push_back(side1.back()); // end point
 
-      // same for the side2 vector
-      p = side2.front();
-      side12.push_back(p);
-      for ( size_t i = 1; i < side2.size() - 1; ++i)
+      mlc.resize(nofLeaves);
+      for ( vtkIdType leaf = 0; leaf < nofLeaves; leaf++)
       {
-        double& pxNext = side2[i + 1].first;
-        double& pyNext = side2[i + 1].second;
-        if (!AreEqual( px, pxNext) && !AreEqual( py, pyNext))
-        {
-          p = side2[i];
-          side12.push_back(p);
-        }
+        mlc[leaf] = { mlcBoundArray->GetValue(leaf), mlcBoundArray->GetValue(leaf + 1),
+          positionArray1->GetComponent(leaf, 0), positionArray2->GetComponent(leaf, 0) };
       }
-      side12.push_back(side2.back());
-    }
-    else
-    {
-      vtkErrorMacro("CreateBeamPolyData: Unable to calculate MLC visible data");
-      return;
-    }
-
-    // fill vtk points
-    points->InsertPoint( 0, 0, 0, this->SAD); // source
-
-    // side "1" and "2" points vector
-    vtkIdType pointIds = 0;
-    for ( PointVector::value_type& point : side12)
-    {
-      double& x = point.first;
-      double& y = point.second;
-      points->InsertPoint( pointIds + 1, 2. * x, 2. * y, -this->SAD);
-      pointIds++;
-    }
-    side12.clear(); // doesn't need anymore
-
-    // fill cell array for side "1" and "2"
-    for ( vtkIdType i = 1; i < pointIds; ++i)
-    {
-      cellArray->InsertNextCell(3);
-      cellArray->InsertCellPoint(0);
-      cellArray->InsertCellPoint(i);
-      cellArray->InsertCellPoint(i + 1);
-    }
-
-    // fill cell connection between side "2" -> side "1"
-    cellArray->InsertNextCell(3);
-    cellArray->InsertCellPoint(0);
-    cellArray->InsertCellPoint(1);
-    cellArray->InsertCellPoint(pointIds);
-
-    // Add the cap to the bottom
-    cellArray->InsertNextCell(pointIds);
-    for ( vtkIdType i = 1; i <= pointIds; i++)
-    {
-      cellArray->InsertCellPoint(i);
     }
   }
-  else
+
+  double jaws[4] = { this->X1Jaw, this->X2Jaw, this->Y1Jaw, this->Y2Jaw };
+  if (!vtkRTBeamControlPointStore::BuildBeamPolyData(this->SAD, jaws, mlcType, mlc, beamModelPolyData))
   {
-    points->InsertPoint(0,0,0,this->SAD);
-    points->InsertPoint(1, 2*this->X1Jaw, 2*this->Y1Jaw, -this->SAD );
-    points->InsertPoint(2, 2*this->X1Jaw, 2*this->Y2Jaw, -this->SAD );
-    points->InsertPoint(3, 2*this->X2Jaw, 2*this->Y2Jaw, -this->SAD );
-    points->InsertPoint(4, 2*this->X2Jaw, 2*this->Y1Jaw, -this->SAD );
-
-    cellArray->InsertNextCell(3);
-    cellArray->InsertCellPoint(0);
-    cellArray->InsertCellPoint(1);
-    cellArray->InsertCellPoint(2);
-
-    cellArray->InsertNextCell(3);
-    cellArray->InsertCellPoint(0);
-    cellArray->InsertCellPoint(2);
-    cellArray->InsertCellPoint(3);
-
-    cellArray->InsertNextCell(3);
-    cellArray->InsertCellPoint(0);
-    cellArray->InsertCellPoint(3);
-    cellArray->InsertCellPoint(4);
-
-    cellArray->InsertNextCell(3);
-    cellArray->InsertCellPoint(0);
-    cellArray->InsertCellPoint(4);
-    cellArray->InsertCellPoint(1);
-
-    // Add the cap to the bottom
-    cellArray->InsertNextCell(4);
-    cellArray->InsertCellPoint(1);
-    cellArray->InsertCellPoint(2);
-    cellArray->InsertCellPoint(3);
-    cellArray->InsertCellPoint(4);
+    vtkErrorMacro("CreateBeamPolyData: Unable to calculate MLC visible data");
   }
-
-  beamModelPolyData->SetPoints(points);
-  beamModelPolyData->SetPolys(cellArray);
 }
 
 //---------------------------------------------------------------------------
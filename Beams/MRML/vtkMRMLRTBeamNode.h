@@ -24,10 +24,18 @@
 
 // Beams includes
 #include "vtkSlicerBeamsModuleMRMLExport.h"
+#include "vtkRTBeamControlPointStore.h"
 
 // MRML includes
 #include <vtkMRMLModelNode.h>
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+#include <string>
+
 class vtkPolyData;
 class vtkMRMLScene;
 class vtkMRMLDoubleArrayNode;
@@ -51,7 +59,9 @@ public:
     BeamTransformModified,
     /// Invoke if the beam is to be cloned.
     /// External Beam Planning logic processes the event if exists
-    CloningRequested
+    CloningRequested,
+    /// Fired if a dose engine parameter is changed through the typed parameter functions
+    DoseEngineParameterModified
   };
 
 public:
@@ -111,6 +121,35 @@ public:
   /// Triggers \sa BeamGeometryModified event and re-generation of beam model
   void SetAndObserveMLCPositionTableNode(vtkMRMLTableNode* node);
 
+  /// Get geometry of all control points of the beam (e.g. an arc), nullptr if only the beam parameters are available.
+  /// If available, the MLC leaf positions of the beam model are interpolated from it at the gantry angle of the beam
+  /// instead of being read from the MLC position table. Not saved in the scene
+  vtkRTBeamControlPointStore* GetControlPointStore() { return this->ControlPointStore; };
+  /// Set geometry of all control points of the beam
+  /// Triggers \sa BeamGeometryModified event and re-generation of beam model
+  void SetControlPointStore(vtkRTBeamControlPointStore* store);
+
+  /// Set dose engine parameter. The name is "<engine name>.<parameter name>", same as the node attribute
+  /// that stores the parameter value as a string for serialization. The attribute is updated without
+  /// invoking modified event. Invokes \sa DoseEngineParameterModified if the value changes.
+  /// Call between StartModify and EndModify to set multiple parameters with a single event.
+  void SetDoseEngineDoubleParameter(const std::string& name, double value);
+  void SetDoseEngineIntegerParameter(const std::string& name, int value);
+  void SetDoseEngineBooleanParameter(const std::string& name, bool value);
+  void SetDoseEngineStringParameter(const std::string& name, const std::string& value);
+
+  /// Get dose engine parameter. The attribute is the source of truth: its value is parsed once for each
+  /// requested type, and the typed value is kept until the attribute changes (also if it is changed
+  /// directly with SetAttribute, e.g. by a Python dose engine).
+  /// \return Success flag. False if parameter does not exist or cannot be converted to the requested type
+  bool GetDoseEngineDoubleParameter(const std::string& name, double& value);
+  bool GetDoseEngineIntegerParameter(const std::string& name, int& value);
+  bool GetDoseEngineBooleanParameter(const std::string& name, bool& value);
+  bool GetDoseEngineStringParameter(const std::string& name, std::string& value);
+
+  /// Determine whether dose engine parameter exists, i.e. its attribute is set
+  bool HasDoseEngineParameter(const std::string& name);
+
   /// Get DRR volume node
   vtkMRMLScalarVolumeNode* GetDRRVolumeNode();
   /// Set and observe DRR volume node
@@ -121,6 +160,11 @@ public:
   /// Set and observe contour BEV node
   void SetAndObserveContourBEVVolumeNode(vtkMRMLScalarVolumeNode* node);
 
+  /// Get water-equivalent depth volume node
+  vtkMRMLScalarVolumeNode* GetWEDVolumeNode();
+  /// Set and observe water-equivalent depth volume node
+  void SetAndObserveWEDVolumeNode(vtkMRMLScalarVolumeNode* node);
+
   /// Get isocenter position from parent plan
   /// \return Success flag
   bool GetPlanIsocenterPosition(double isocenter[3]);
@@ -191,6 +235,34 @@ protected:
   /// \param beamModelPolyData Output polydata. If none given then the beam node's own polydata is used
   void CreateBeamPolyData(vtkPolyData* beamModelPolyData=nullptr);
 
+  /// Typed values of a dose engine parameter, parsed from the attribute value when first requested
+  struct DoseEngineParameter
+  {
+    enum ParameterType
+    {
+      Double = 0,
+      Integer,
+      Boolean,
+      NumberOfTypes
+    };
+    DoseEngineParameter();
+    /// Attribute value the typed values belong to. The typed values are discarded if the attribute differs
+    std::string ValueString;
+    /// Flags indicating whether the value of the given type has been parsed, and whether it is valid
+    bool Parsed[NumberOfTypes];
+    bool Valid[NumberOfTypes];
+    double DoubleValue;
+    int IntegerValue;
+    bool BooleanValue;
+  };
+
+  /// Get typed values of a parameter that are up to date with its attribute. Parse the attribute in
+  /// the given type if it has not been parsed yet
+  /// \return Typed values if the attribute exists and can be converted to the given type, nullptr otherwise
+  DoseEngineParameter* GetDoseEngineParameter(const std::string& name, DoseEngineParameter::ParameterType type);
+  /// Store the attribute and the typed values of a parameter, and invoke event if the attribute changed
+  void SetDoseEngineParameter(const std::string& name, const DoseEngineParameter& parameter);
+
 protected:
   vtkMRMLRTBeamNode();
   ~vtkMRMLRTBeamNode();
@@ -223,6 +295,12 @@ protected:
   double CollimatorAngle;
   /// Couch angle
   double CouchAngle;
+
+  /// Geometry of all control points
+  vtkSmartPointer<vtkRTBeamControlPointStore> ControlPointStore;
+
+  /// Cache of dose engine parameters in typed form. The values are stored as node attributes
+  std::map<std::string, DoseEngineParameter> DoseEngineParameters;
 };
 
 #endif // __vtkMRMLRTBeamNode_h
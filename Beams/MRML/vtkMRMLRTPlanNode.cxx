@@ -31,16 +31,27 @@
 #include <vtkMRMLSegmentationNode.h>
 #include <vtkSlicerSegmentationsModuleLogic.h>
 #include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLTransformNode.h>
 
 // VTK includes
 #include <vtkCollection.h>
 #include <vtkDataArray.h>
+#include <vtkIntArray.h>
+#include <vtkMath.h>
 #include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
 #include <vtkSmartPointer.h>
 #include <vtkVariant.h>
 
+// STD includes
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
 //------------------------------------------------------------------------------
 const char* vtkMRMLRTPlanNode::ISOCENTER_FIDUCIAL_NAME = "Isocenter";
 const int vtkMRMLRTPlanNode::ISOCENTER_FIDUCIAL_INDEX = 0;
@@ -51,6 +62,296 @@ static const char* SEGMENTATION_REFERENCE_ROLE = "segmentationRef";
 static const char* POIS_MARKUPS_REFERENCE_ROLE = "posMarkupsRef";
 static const char* OUTPUT_TOTAL_DOSE_VOLUME_REFERENCE_ROLE = "outputTotalDoseVolumeRef";
 
+//------------------------------------------------------------------------------
+namespace
+{
+
+/// Sums of the voxel indices and their products for the voxels of one label.
+/// Indices are relative to the first voxel of the extent
+struct LabelmapMomentSums
+{
+  LabelmapMomentSums()
+    : NumberOfVoxels(0)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      this->Sum[i] = 0;
+      this->MinIndex[i] = std::numeric_limits<int>::max();
+      this->MaxIndex[i] = std::numeric_limits<int>::min();
+    }
+    for (int i = 0; i < 6; ++i)
+    {
+      this->SumProducts[i] = 0;
+    }
+  }
+
+  void Add(const LabelmapMomentSums& other)
+  {
+    this->NumberOfVoxels += other.NumberOfVoxels;
+    for (int i = 0; i < 3; ++i)
+    {
+      this->Sum[i] += other.Sum[i];
+      this->MinIndex[i] = std::min(this->MinIndex[i], other.MinIndex[i]);
+      this->MaxIndex[i] = std::max(this->MaxIndex[i], other.MaxIndex[i]);
+    }
+    for (int i = 0; i < 6; ++i)
+    {
+      this->SumProducts[i] += other.SumProducts[i];
+    }
+  }
+
+  vtkTypeInt64 NumberOfVoxels;
+  vtkTypeInt64 Sum[3];
+  /// Order: ii, jj, kk, ij, ik, jk
+  vtkTypeInt64 SumProducts[6];
+  int MinIndex[3];
+  int MaxIndex[3];
+};
+
+/// Accumulates the moment sums of a label slice by slice in parallel
+template <class T>
+class LabelmapMomentsFunctor
+{
+public:
+  LabelmapMomentsFunctor(vtkImageData* labelmap, bool useLabelValue, double labelValue)
+    : UseLabelValue(useLabelValue)
+    , LabelValue(static_cast<T>(labelValue))
+  {
+    int extent[6] = { 0, -1, 0, -1, 0, -1 };
+    labelmap->GetExtent(extent);
+    this->Dimensions[0] = extent[1] - extent[0] + 1;
+    this->Dimensions[1] = extent[3] - extent[2] + 1;
+    this->Scalars = static_cast<const T*>(labelmap->GetScalarPointer());
+    labelmap->GetIncrements(this->Increments);
+  }
+
+  void Initialize()
+  {
+    this->LocalSums.Local() = LabelmapMomentSums();
+  }
+
+  void operator()(vtkIdType beginSlice, vtkIdType endSlice)
+  {
+    LabelmapMomentSums& sums = this->LocalSums.Local();
+    for (vtkIdType k = beginSlice; k < endSlice; ++k)
+    {
+      for (vtkIdType j = 0; j < this->Dimensions[1]; ++j)
+      {
+        const T* rowPtr = this->Scalars + k * this->Increments[2] + j * this->Increments[1];
+
+        // Moments of the row are accumulated first, so that the inner loop only has to deal with the i index
+        vtkTypeInt64 count = 0;
+        vtkTypeInt64 sumI = 0;
+        vtkTypeInt64 sumII = 0;
+        int firstI = -1;
+        int lastI = -1;
+        for (int i = 0; i < this->Dimensions[0]; ++i)
+        {
+          T value = rowPtr[i * this->Increments[0]];
+          if (this->UseLabelValue ? (value == this->LabelValue) : (value != 0))
+          {
+            if (firstI < 0)
+            {
+              firstI = i;
+            }
+            lastI = i;
+            ++count;
+            sumI += i;
+            sumII += static_cast<vtkTypeInt64>(i) * i;
+          }
+        }
+        if (count == 0)
+        {
+          continue;
+        }
+
+        sums.NumberOfVoxels += count;
+        sums.Sum[0] += sumI;
+        sums.Sum[1] += count * j;
+        sums.Sum[2] += count * k;
+        sums.SumProducts[0] += sumII;
+        sums.SumProducts[1] += count * j * j;
+        sums.SumProducts[2] += count * k * k;
+        sums.SumProducts[3] += sumI * j;
+        sums.SumProducts[4] += sumI * k;
+        sums.SumProducts[5] += count * j * k;
+        sums.MinIndex[0] = std::min(sums.MinIndex[0], firstI);
+        sums.MaxIndex[0] = std::max(sums.MaxIndex[0], lastI);
+        sums.MinIndex[1] = std::min(sums.MinIndex[1], static_cast<int>(j));
+        sums.MaxIndex[1] = std::max(sums.MaxIndex[1], static_cast<int>(j));
+        sums.MinIndex[2] = std::min(sums.MinIndex[2], static_cast<int>(k));
+        sums.MaxIndex[2] = std::max(sums.MaxIndex[2], static_cast<int>(k));
+      }
+    }
+  }
+
+  void Reduce()
+  {
+    for (typename vtkSMPThreadLocal<LabelmapMomentSums>::iterator it = this->LocalSums.begin(); it != this->LocalSums.end(); ++it)
+    {
+      this->Result.Add(*it);
+    }
+  }
+
+  LabelmapMomentSums Result;
+
+private:
+  bool UseLabelValue;
+  T LabelValue;
+  const T* Scalars;
+  vtkIdType Increments[3];
+  vtkIdType Dimensions[2];
+  vtkSMPThreadLocal<LabelmapMomentSums> LocalSums;
+};
+
+//----------------------------------------------------------------------------
+template <class T>
+void ComputeLabelmapMomentSums(vtkImageData* labelmap, bool useLabelValue, double labelValue, LabelmapMomentSums& sums)
+{
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  labelmap->GetExtent(extent);
+  LabelmapMomentsFunctor<T> functor(labelmap, useLabelValue, labelValue);
+  vtkSMPTools::For(0, extent[5] - extent[4] + 1, functor);
+  sums = functor.Result;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+class vtkMRMLRTPlanNode::vtkInternal
+{
+public:
+  /// Beam number and name at the time the beam was indexed
+  struct BeamEntry
+  {
+    int Number;
+    std::string Name;
+  };
+
+public:
+  vtkInternal()
+    : Valid(false)
+  {
+  }
+
+  void Clear()
+  {
+    this->SortedBeams.clear();
+    this->BeamsByNumber.clear();
+    this->BeamsByName.clear();
+    this->Entries.clear();
+  }
+
+  bool Contains(vtkMRMLRTBeamNode* beamNode)
+  {
+    return this->Entries.find(beamNode) != this->Entries.end();
+  }
+
+  /// Determine whether number and name of an indexed beam have changed since indexing
+  bool IsEntryUpToDate(vtkMRMLRTBeamNode* beamNode)
+  {
+    const BeamEntry& entry = this->Entries[beamNode];
+    return entry.Number == beamNode->GetBeamNumber() && entry.Name == (beamNode->GetName() ? beamNode->GetName() : "");
+  }
+
+  /// Build index from an unsorted list of beams
+  void Build(vtkCollection* beams)
+  {
+    this->Clear();
+    for (int i=0; i<beams->GetNumberOfItems(); ++i)
+    {
+      vtkMRMLRTBeamNode* beamNode = vtkMRMLRTBeamNode::SafeDownCast(beams->GetItemAsObject(i));
+      if (beamNode)
+      {
+        this->AddEntry(beamNode);
+        this->SortedBeams.push_back(beamNode);
+      }
+    }
+    std::stable_sort(this->SortedBeams.begin(), this->SortedBeams.end(),
+      [this](vtkMRMLRTBeamNode* a, vtkMRMLRTBeamNode* b) { return this->Entries[a].Number < this->Entries[b].Number; } );
+    for (vtkMRMLRTBeamNode* beamNode : this->SortedBeams)
+    {
+      // If numbers or names are not unique, the first beam in sorted order is found
+      this->BeamsByNumber.insert(std::make_pair(this->Entries[beamNode].Number, beamNode));
+      this->BeamsByName.insert(std::make_pair(this->Entries[beamNode].Name, beamNode));
+    }
+    this->Valid = true;
+  }
+
+  void Insert(vtkMRMLRTBeamNode* beamNode)
+  {
+    const BeamEntry& entry = this->AddEntry(beamNode);
+    std::vector<vtkMRMLRTBeamNode*>::iterator position = std::upper_bound(
+      this->SortedBeams.begin(), this->SortedBeams.end(), entry.Number,
+      [this](int number, vtkMRMLRTBeamNode* b) { return number < this->Entries[b].Number; } );
+    this->SortedBeams.insert(position, beamNode);
+    this->BeamsByNumber.insert(std::make_pair(entry.Number, beamNode));
+    this->BeamsByName.insert(std::make_pair(entry.Name, beamNode));
+  }
+
+  void Remove(vtkMRMLRTBeamNode* beamNode)
+  {
+    std::unordered_map<vtkMRMLRTBeamNode*, BeamEntry>::iterator entryIt = this->Entries.find(beamNode);
+    if (entryIt == this->Entries.end())
+    {
+      return;
+    }
+    BeamEntry entry = entryIt->second;
+    this->Entries.erase(entryIt);
+    this->SortedBeams.erase(std::find(this->SortedBeams.begin(), this->SortedBeams.end(), beamNode));
+
+    // Another beam with the same number or name may need to take its place in the lookup tables
+    if (Find(this->BeamsByNumber, entry.Number) == beamNode)
+    {
+      this->BeamsByNumber.erase(entry.Number);
+      for (vtkMRMLRTBeamNode* otherBeamNode : this->SortedBeams)
+      {
+        if (this->Entries[otherBeamNode].Number == entry.Number)
+        {
+          this->BeamsByNumber[entry.Number] = otherBeamNode;
+          break;
+        }
+      }
+    }
+    if (Find(this->BeamsByName, entry.Name) == beamNode)
+    {
+      this->BeamsByName.erase(entry.Name);
+      for (vtkMRMLRTBeamNode* otherBeamNode : this->SortedBeams)
+      {
+        if (this->Entries[otherBeamNode].Name == entry.Name)
+        {
+          this->BeamsByName[entry.Name] = otherBeamNode;
+          break;
+        }
+      }
+    }
+  }
+
+  template <class KeyType>
+  static vtkMRMLRTBeamNode* Find(const std::unordered_map<KeyType, vtkMRMLRTBeamNode*>& table, const KeyType& key)
+  {
+    typename std::unordered_map<KeyType, vtkMRMLRTBeamNode*>::const_iterator it = table.find(key);
+    return (it != table.end() ? it->second : nullptr);
+  }
+
+public:
+  /// Flag indicating whether the index reflects the current state of the subject hierarchy
+  bool Valid;
+  std::vector<vtkMRMLRTBeamNode*> SortedBeams;
+  std::unordered_map<int, vtkMRMLRTBeamNode*> BeamsByNumber;
+  std::unordered_map<std::string, vtkMRMLRTBeamNode*> BeamsByName;
+  std::unordered_map<vtkMRMLRTBeamNode*, BeamEntry> Entries;
+
+private:
+  const BeamEntry& AddEntry(vtkMRMLRTBeamNode* beamNode)
+  {
+    BeamEntry& entry = this->Entries[beamNode];
+    entry.Number = beamNode->GetBeamNumber();
+    entry.Name = (beamNode->GetName() ? beamNode->GetName() : "");
+    return entry;
+  }
+};
+
 //------------------------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLRTPlanNode);
 
@@ -70,6 +371,13 @@ vtkMRMLRTPlanNode::vtkMRMLRTPlanNode()
   this->DoseGrid[0] = 0;
   this->DoseGrid[1] = 0;
   this->DoseGrid[2] = 0;
+
+  this->TargetMomentsCache.NumberOfVoxels = 0;
+  this->TargetMomentsCacheSegmentationNode = nullptr;
+  this->TargetMomentsCacheTime = 0;
+
+  this->Internal = new vtkInternal();
+  this->BeamIndexSubjectHierarchyNode = nullptr;
 }
 
 //----------------------------------------------------------------------------
@@ -77,6 +385,9 @@ vtkMRMLRTPlanNode::~vtkMRMLRTPlanNode()
 {
   this->SetTargetSegmentID(nullptr);
   this->SetDoseEngineName(nullptr);
+
+  vtkSetAndObserveMRMLObjectMacro(this->BeamIndexSubjectHierarchyNode, nullptr);
+  delete this->Internal;
 }
 
 //----------------------------------------------------------------------------
@@ -230,6 +541,21 @@ void vtkMRMLRTPlanNode::ProcessMRMLEvents(vtkObject *caller, unsigned long event
 {
   Superclass::ProcessMRMLEvents(caller, eventID, callData);
 
+  // Keep beam index up to date with the subject hierarchy
+  if (caller && caller == this->BeamIndexSubjectHierarchyNode)
+  {
+    vtkIdType* itemIdPtr = reinterpret_cast<vtkIdType*>(callData);
+    if (itemIdPtr)
+    {
+      this->UpdateBeamIndexForSubjectHierarchyItem(eventID, *itemIdPtr);
+    }
+    else
+    {
+      this->Internal->Valid = false;
+    }
+    return;
+  }
+
   if (!this->Scene)
   {
     vtkErrorMacro("ProcessMRMLEvents: Invalid MRML scene");
@@ -439,130 +765,198 @@ void vtkMRMLRTPlanNode::SetAndObserveOutputTotalDoseVolumeNode(vtkMRMLScalarVolu
 }
 
 //---------------------------------------------------------------------------
-void vtkMRMLRTPlanNode::GetBeams(vtkCollection *beams)
+bool vtkMRMLRTPlanNode::UpdateBeamIndex()
 {
-  if (!beams)
+  // Subject hierarchy node is different if the plan has been moved to another scene
+  if (this->BeamIndexSubjectHierarchyNode && this->BeamIndexSubjectHierarchyNode->GetScene() != this->GetScene())
   {
-    vtkErrorMacro("GetBeams: Invalid input beam collection");
-    return;
+    this->Internal->Valid = false;
+  }
+  if (this->Internal->Valid)
+  {
+    return true;
   }
-  beams->RemoveAllItems();
 
   vtkMRMLSubjectHierarchyNode* shNode = vtkMRMLSubjectHierarchyNode::GetSubjectHierarchyNode(this->GetScene());
   if (!shNode)
   {
-    vtkErrorMacro("GetBeams: Failed to access subject hierarchy node");
-    return;
+    vtkErrorMacro("UpdateBeamIndex: Failed to access subject hierarchy node");
+    return false;
+  }
+  if (shNode != this->BeamIndexSubjectHierarchyNode)
+  {
+    vtkNew<vtkIntArray> events;
+    events->InsertNextValue(vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemAddedEvent);
+    events->InsertNextValue(vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemAboutToBeRemovedEvent);
+    events->InsertNextValue(vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemModifiedEvent);
+    events->InsertNextValue(vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemReparentedEvent);
+    vtkSetAndObserveMRMLObjectEventsMacro(this->BeamIndexSubjectHierarchyNode, shNode, events);
   }
 
   vtkIdType planShItemID = this->GetPlanSubjectHierarchyItemID();
   if (planShItemID == vtkMRMLSubjectHierarchyNode::INVALID_ITEM_ID)
   {
-    vtkErrorMacro("GetBeams: Failed to access RT plan subject hierarchy item, although it should always be available");
-    return;
+    vtkErrorMacro("UpdateBeamIndex: Failed to access RT plan subject hierarchy item, although it should always be available");
+    return false;
   }
 
-  shNode->GetDataNodesInBranch(planShItemID, beams, "vtkMRMLRTBeamNode");
+  vtkNew<vtkCollection> beamCollection;
+  shNode->GetDataNodesInBranch(planShItemID, beamCollection, "vtkMRMLRTBeamNode");
+  this->Internal->Build(beamCollection);
+  return true;
 }
 
 //---------------------------------------------------------------------------
-void vtkMRMLRTPlanNode::GetBeams(std::vector<vtkMRMLRTBeamNode*>& beams)
+void vtkMRMLRTPlanNode::UpdateBeamIndexForSubjectHierarchyItem(unsigned long eventID, vtkIdType itemID)
 {
-  beams.clear();
-
-  // Get unsorted list from hierarchy
-  vtkNew<vtkCollection> beamCollection;
-  this->GetBeams(beamCollection);
+  if (!this->Internal->Valid)
+  {
+    // Index will be built from scratch when needed
+    return;
+  }
+  if (this->Scene && this->Scene->IsBatchProcessing())
+  {
+    this->Internal->Valid = false;
+    return;
+  }
 
-  // Insertion sort puts them into vector sorted by beam number
-  beamCollection->InitTraversal();
-  for (int i=0; i<beamCollection->GetNumberOfItems(); ++i)
+  vtkMRMLRTBeamNode* beamNode = vtkMRMLRTBeamNode::SafeDownCast(this->BeamIndexSubjectHierarchyNode->GetItemDataNode(itemID));
+  if (!beamNode)
   {
-    vtkMRMLRTBeamNode* beamNode = vtkMRMLRTBeamNode::SafeDownCast(beamCollection->GetItemAsObject(i));
-    int newBeamNumber = beamNode->GetBeamNumber();
-    std::vector<vtkMRMLRTBeamNode*>::iterator it = beams.begin();
-    while (it != beams.end())
+    // Removing or moving a non-beam item in the plan branch (e.g. a folder) may affect the beams under it
+    if ( eventID == vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemReparentedEvent
+      || (eventID == vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemAboutToBeRemovedEvent && this->IsItemInPlanBranch(itemID)) )
     {
-      int thisBeamNumber = (*it)->GetBeamNumber();
-      if (thisBeamNumber > newBeamNumber)
+      this->Internal->Valid = false;
+    }
+    return;
+  }
+
+  bool indexed = this->Internal->Contains(beamNode);
+  switch (eventID)
+  {
+    case vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemAddedEvent:
+      if (!indexed && this->IsItemInPlanBranch(itemID))
       {
-        break;
+        this->Internal->Insert(beamNode);
       }
-      ++it;
-    }
-    beams.insert(it, beamNode);
+      break;
+    case vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemAboutToBeRemovedEvent:
+      if (indexed)
+      {
+        this->Internal->Remove(beamNode);
+      }
+      break;
+    case vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemReparentedEvent:
+      {
+        bool inPlan = this->IsItemInPlanBranch(itemID);
+        if (indexed && !inPlan)
+        {
+          this->Internal->Remove(beamNode);
+        }
+        else if (!indexed && inPlan)
+        {
+          this->Internal->Insert(beamNode);
+        }
+      }
+      break;
+    case vtkMRMLSubjectHierarchyNode::SubjectHierarchyItemModifiedEvent:
+      // Re-index beam if its number or name has changed
+      if (indexed && !this->Internal->IsEntryUpToDate(beamNode))
+      {
+        this->Internal->Remove(beamNode);
+        this->Internal->Insert(beamNode);
+      }
+      break;
+    default:
+      break;
   }
 }
 
 //---------------------------------------------------------------------------
-int vtkMRMLRTPlanNode::GetNumberOfBeams()
+bool vtkMRMLRTPlanNode::IsItemInPlanBranch(vtkIdType itemID)
 {
-  vtkNew<vtkCollection> beamCollection;
-  this->GetBeams(beamCollection);
-  return beamCollection->GetNumberOfItems();
+  vtkMRMLSubjectHierarchyNode* shNode = this->BeamIndexSubjectHierarchyNode;
+  vtkIdType planShItemID = (shNode ? shNode->GetItemByDataNode(this) : vtkMRMLSubjectHierarchyNode::INVALID_ITEM_ID);
+  if (planShItemID == vtkMRMLSubjectHierarchyNode::INVALID_ITEM_ID)
+  {
+    return false;
+  }
+  for ( vtkIdType parentItemID = shNode->GetItemParent(itemID); parentItemID != vtkMRMLSubjectHierarchyNode::INVALID_ITEM_ID;
+    parentItemID = shNode->GetItemParent(parentItemID) )
+  {
+    if (parentItemID == planShItemID)
+    {
+      return true;
+    }
+  }
+  return false;
 }
 
 //---------------------------------------------------------------------------
-vtkMRMLRTBeamNode* vtkMRMLRTPlanNode::GetBeamByName(const std::string& beamName)
+void vtkMRMLRTPlanNode::GetBeams(vtkCollection *beams)
 {
-  vtkIdType planShItemID = this->GetPlanSubjectHierarchyItemID();
-  if (planShItemID == vtkMRMLSubjectHierarchyNode::INVALID_ITEM_ID)
+  if (!beams)
   {
-    vtkErrorMacro("GetBeamByName: Failed to access RT plan subject hierarchy item, although it should always be available");
-    return nullptr;
+    vtkErrorMacro("GetBeams: Invalid input beam collection");
+    return;
   }
-  vtkMRMLSubjectHierarchyNode* shNode = vtkMRMLSubjectHierarchyNode::GetSubjectHierarchyNode(this->GetScene());
-  if (!shNode)
+  beams->RemoveAllItems();
+
+  if (!this->UpdateBeamIndex())
   {
-    vtkErrorMacro("GetBeamByName: Failed to access subject hierarchy node");
-    return nullptr;
+    vtkErrorMacro("GetBeams: Failed to get beams of plan " << (this->Name ? this->Name : ""));
+    return;
   }
+  for (vtkMRMLRTBeamNode* beamNode : this->Internal->SortedBeams)
+  {
+    beams->AddItem(beamNode);
+  }
+}
 
-  vtkNew<vtkCollection> beamCollection;
-  shNode->GetDataNodesInBranch(planShItemID, beamCollection, "vtkMRMLRTBeamNode");
+//---------------------------------------------------------------------------
+void vtkMRMLRTPlanNode::GetBeams(std::vector<vtkMRMLRTBeamNode*>& beams)
+{
+  beams.clear();
 
-  beamCollection->InitTraversal();
-  for (int i=0; i<beamCollection->GetNumberOfItems(); ++i)
+  if (!this->UpdateBeamIndex())
   {
-    vtkMRMLRTBeamNode* beamNode = vtkMRMLRTBeamNode::SafeDownCast(beamCollection->GetItemAsObject(i));
-    if ( beamNode && beamNode->GetName()
-      && !strcmp(beamNode->GetName(), beamName.c_str()) )
-    {
-      return beamNode;
-    }
+    vtkErrorMacro("GetBeams: Failed to get beams of plan " << (this->Name ? this->Name : ""));
+    return;
   }
-  return nullptr;
+  beams = this->Internal->SortedBeams;
 }
 
 //---------------------------------------------------------------------------
-vtkMRMLRTBeamNode* vtkMRMLRTPlanNode::GetBeamByNumber(int beamNumber)
+int vtkMRMLRTPlanNode::GetNumberOfBeams()
 {
-  vtkIdType planShItemID = this->GetPlanSubjectHierarchyItemID();
-  if (planShItemID == vtkMRMLSubjectHierarchyNode::INVALID_ITEM_ID)
+  if (!this->UpdateBeamIndex())
   {
-    vtkErrorMacro("GetBeamByName: Failed to access RT plan subject hierarchy item, although it should always be available");
-    return nullptr;
+    return 0;
   }
-  vtkMRMLSubjectHierarchyNode* shNode = vtkMRMLSubjectHierarchyNode::GetSubjectHierarchyNode(this->GetScene());
-  if (!shNode)
+  return static_cast<int>(this->Internal->SortedBeams.size());
+}
+
+//---------------------------------------------------------------------------
+vtkMRMLRTBeamNode* vtkMRMLRTPlanNode::GetBeamByName(const std::string& beamName)
+{
+  if (!this->UpdateBeamIndex())
   {
-    vtkErrorMacro("GetBeamByName: Failed to access subject hierarchy node");
+    vtkErrorMacro("GetBeamByName: Failed to get beams of plan " << (this->Name ? this->Name : ""));
     return nullptr;
   }
+  return vtkInternal::Find(this->Internal->BeamsByName, beamName);
+}
 
-  vtkNew<vtkCollection> beamCollection;
-  shNode->GetDataNodesInBranch(planShItemID, beamCollection, "vtkMRMLRTBeamNode");
-
-  beamCollection->InitTraversal();
-  for (int i=0; i<beamCollection->GetNumberOfItems(); ++i)
+//---------------------------------------------------------------------------
+vtkMRMLRTBeamNode* vtkMRMLRTPlanNode::GetBeamByNumber(int beamNumber)
+{
+  if (!this->UpdateBeamIndex())
   {
-    vtkMRMLRTBeamNode* beamNode = vtkMRMLRTBeamNode::SafeDownCast(beamCollection->GetItemAsObject(i));
-    if (beamNode && beamNode->GetBeamNumber() == beamNumber)
-    {
-      return beamNode;
-    }
+    vtkErrorMacro("GetBeamByNumber: Failed to get beams of plan " << (this->Name ? this->Name : ""));
+    return nullptr;
   }
-  return nullptr;
+  return vtkInternal::Find(this->Internal->BeamsByNumber, beamNumber);
 }
 
 //---------------------------------------------------------------------------
@@ -807,54 +1201,199 @@ bool vtkMRMLRTPlanNode::ComputeTargetVolumeCenter(double center[3])
     return false;
   }
 
-  // Get a labelmap for the target
-  vtkSmartPointer<vtkOrientedImageData> targetLabelmap = this->GetTargetOrientedImageData();
-  if (targetLabelmap.GetPointer() == nullptr)
+  TargetLabelmapMoments moments;
+  if (!this->GetTargetLabelmapMoments(moments))
   {
     return false;
   }
 
-  // Compute image center
-  int extent[6] = {0,-1,0,-1,0,-1};
-  targetLabelmap->GetExtent(extent);
-  unsigned long numOfNonZeroVoxels = 0;
-  unsigned long sumX = 0;
-  unsigned long sumY = 0;
-  unsigned long sumZ = 0;
-  for (int z=extent[4]; z<extent[5]; ++z)
+  if (moments.NumberOfVoxels > 0)
   {
-    for (int y=extent[2]; y<extent[3]; ++y)
+    center[0] = moments.Centroid[0];
+    center[1] = moments.Centroid[1];
+    center[2] = moments.Centroid[2];
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLRTPlanNode::GetTargetLabelmapMoments(TargetLabelmapMoments& moments)
+{
+  moments.NumberOfVoxels = 0;
+
+  vtkMRMLSegmentationNode* segmentationNode = this->GetSegmentationNode();
+  if (!segmentationNode || !segmentationNode->GetSegmentation())
+  {
+    vtkErrorMacro("GetTargetLabelmapMoments: Failed to get target segmentation");
+    return false;
+  }
+  if (!this->TargetSegmentID)
+  {
+    vtkErrorMacro("GetTargetLabelmapMoments: No target segment specified");
+    return false;
+  }
+  vtkSegment* segment = segmentationNode->GetSegmentation()->GetSegment(this->TargetSegmentID);
+  if (!segment)
+  {
+    vtkErrorMacro("GetTargetLabelmapMoments: Failed to get segment");
+    return false;
+  }
+
+  // Use the binary labelmap representation of the segment directly if available and it only
+  // needs a linear transform to get to world coordinates. Otherwise get a converted/transformed copy
+  vtkSmartPointer<vtkOrientedImageData> labelmap = vtkOrientedImageData::SafeDownCast(
+    segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) );
+  vtkMRMLTransformNode* parentTransformNode = segmentationNode->GetParentTransformNode();
+  if (parentTransformNode && !parentTransformNode->IsTransformToWorldLinear())
+  {
+    labelmap = nullptr;
+  }
+
+  // The parent transform is part of the key, because setting another, unmodified transform may not increase the time
+  std::string parentTransformNodeID = (parentTransformNode && parentTransformNode->GetID() ? parentTransformNode->GetID() : "");
+  vtkMTimeType targetTime = std::max(segment->GetMTime(), segmentationNode->GetMTime());
+  if (labelmap)
+  {
+    targetTime = std::max(targetTime, labelmap->GetMTime());
+  }
+  if (parentTransformNode)
+  {
+    targetTime = std::max(targetTime, parentTransformNode->GetTransformToWorldMTime());
+  }
+  if ( this->TargetMomentsCacheSegmentationNode == segmentationNode && this->TargetMomentsCacheSegmentID == this->TargetSegmentID
+    && this->TargetMomentsCacheParentTransformNodeID == parentTransformNodeID && this->TargetMomentsCacheTime == targetTime )
+  {
+    moments = this->TargetMomentsCache;
+    return true;
+  }
+
+  vtkNew<vtkMatrix4x4> imageToWorldMatrix;
+  bool useLabelValue = false;
+  double labelValue = 0.0;
+  if (labelmap)
+  {
+    labelmap->GetImageToWorldMatrix(imageToWorldMatrix);
+    if (parentTransformNode)
     {
-      for (int x=extent[0]; x<extent[1]; ++x)
-      {
-        unsigned char value = targetLabelmap->GetScalarComponentAsDouble(x, y, z, 0);
-        if (value)
-        {
-          numOfNonZeroVoxels++;
-          sumX += x;
-          sumY += y;
-          sumZ += z;
-        }
-      }
+      vtkNew<vtkMatrix4x4> segmentationToWorldMatrix;
+      parentTransformNode->GetMatrixTransformToWorld(segmentationToWorldMatrix);
+      vtkMatrix4x4::Multiply4x4(segmentationToWorldMatrix, imageToWorldMatrix, imageToWorldMatrix);
+    }
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+    // Labelmap may be shared between segments
+    useLabelValue = true;
+    labelValue = segment->GetLabelValue();
+#endif
+  }
+  else
+  {
+    labelmap = this->GetTargetOrientedImageData();
+    if (!labelmap)
+    {
+      return false;
+    }
+    labelmap->GetImageToWorldMatrix(imageToWorldMatrix);
+  }
+
+  LabelmapMomentSums sums;
+  if (labelmap->GetPointData()->GetScalars() && !labelmap->IsEmpty())
+  {
+    switch (labelmap->GetScalarType())
+    {
+      vtkTemplateMacro(ComputeLabelmapMomentSums<VTK_TT>(labelmap, useLabelValue, labelValue, sums));
+      default:
+        vtkErrorMacro("GetTargetLabelmapMoments: Unsupported labelmap scalar type " << labelmap->GetScalarTypeAsString());
+        return false;
     }
   }
-  double centerIjk[4] = {0.0};
-  if (numOfNonZeroVoxels > 0)
+
+  moments.NumberOfVoxels = sums.NumberOfVoxels;
+  if (sums.NumberOfVoxels > 0)
   {
-    centerIjk[0] = (double)sumX / (double)numOfNonZeroVoxels;
-    centerIjk[1] = (double)sumY / (double)numOfNonZeroVoxels;
-    centerIjk[2] = (double)sumZ / (double)numOfNonZeroVoxels;
-    centerIjk[3] = 1.0;
+    int extent[6] = { 0, -1, 0, -1, 0, -1 };
+    labelmap->GetExtent(extent);
+    double numberOfVoxels = static_cast<double>(sums.NumberOfVoxels);
+
+    // Centroid
+    double centroidIjk[4] = { 0.0, 0.0, 0.0, 1.0 };
+    for (int i = 0; i < 3; ++i)
+    {
+      centroidIjk[i] = extent[2 * i] + sums.Sum[i] / numberOfVoxels;
+    }
+    double centroidRas[4] = { 0.0, 0.0, 0.0, 1.0 };
+    imageToWorldMatrix->MultiplyPoint(centroidIjk, centroidRas);
+
+    // Bounds of the transformed bounding box of the voxels
+    moments.Bounds[0] = moments.Bounds[2] = moments.Bounds[4] = VTK_DOUBLE_MAX;
+    moments.Bounds[1] = moments.Bounds[3] = moments.Bounds[5] = VTK_DOUBLE_MIN;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+      double cornerIjk[4] = { 0.0, 0.0, 0.0, 1.0 };
+      for (int i = 0; i < 3; ++i)
+      {
+        cornerIjk[i] = extent[2 * i] + ((corner >> i) & 1 ? sums.MaxIndex[i] : sums.MinIndex[i]);
+      }
+      double cornerRas[4] = { 0.0, 0.0, 0.0, 1.0 };
+      imageToWorldMatrix->MultiplyPoint(cornerIjk, cornerRas);
+      for (int i = 0; i < 3; ++i)
+      {
+        moments.Bounds[2 * i] = std::min(moments.Bounds[2 * i], cornerRas[i]);
+        moments.Bounds[2 * i + 1] = std::max(moments.Bounds[2 * i + 1], cornerRas[i]);
+      }
+    }
 
-    vtkNew<vtkMatrix4x4> imageToWorldMatrix;
-    targetLabelmap->GetImageToWorldMatrix(imageToWorldMatrix);
-    double centerRas[4] = {0.0};
-    imageToWorldMatrix->MultiplyPoint(centerIjk, centerRas);
+    // Covariance in IJK, then in RAS: C_ras = M * C_ijk * M^T
+    static const int productIndices[3][3] = { { 0, 3, 4 }, { 3, 1, 5 }, { 4, 5, 2 } };
+    double covarianceIjk[3][3] = { { 0.0 } };
+    for (int r = 0; r < 3; ++r)
+    {
+      for (int c = 0; c < 3; ++c)
+      {
+        double meanR = sums.Sum[r] / numberOfVoxels;
+        double meanC = sums.Sum[c] / numberOfVoxels;
+        covarianceIjk[r][c] = sums.SumProducts[productIndices[r][c]] / numberOfVoxels - meanR * meanC;
+      }
+    }
+    double directions[3][3] = { { 0.0 } };
+    for (int r = 0; r < 3; ++r)
+    {
+      for (int c = 0; c < 3; ++c)
+      {
+        directions[r][c] = imageToWorldMatrix->GetElement(r, c);
+      }
+    }
+    double temp[3][3] = { { 0.0 } };
+    double covarianceRas[3][3] = { { 0.0 } };
+    vtkMath::Multiply3x3(directions, covarianceIjk, temp);
+    vtkMath::Transpose3x3(directions, directions);
+    vtkMath::Multiply3x3(temp, directions, covarianceRas);
+
+    // Principal axes are the eigenvectors of the covariance matrix (sorted by decreasing eigenvalue)
+    double* covarianceRows[3] = { covarianceRas[0], covarianceRas[1], covarianceRas[2] };
+    double eigenvectors[3][3] = { { 0.0 } };
+    double* eigenvectorRows[3] = { eigenvectors[0], eigenvectors[1], eigenvectors[2] };
+    vtkMath::Jacobi(covarianceRows, moments.PrincipalMoments, eigenvectorRows);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      for (int i = 0; i < 3; ++i)
+      {
+        moments.PrincipalAxes[axis][i] = eigenvectors[i][axis];
+      }
+    }
 
-    center[0] = centerRas[0];
-    center[1] = centerRas[1];
-    center[2] = centerRas[2];
+    // Volume from the voxel size (determinant of the image to world direction matrix)
+    moments.Volume = numberOfVoxels * fabs(vtkMath::Determinant3x3(directions));
+    for (int i = 0; i < 3; ++i)
+    {
+      moments.Centroid[i] = centroidRas[i];
+    }
   }
 
+  this->TargetMomentsCache = moments;
+  this->TargetMomentsCacheSegmentationNode = segmentationNode;
+  this->TargetMomentsCacheSegmentID = this->TargetSegmentID;
+  this->TargetMomentsCacheParentTransformNodeID = parentTransformNodeID;
+  this->TargetMomentsCacheTime = targetTime;
   return true;
 }
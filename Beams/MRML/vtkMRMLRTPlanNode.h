@@ -32,11 +32,18 @@
 // SegmentationCore includes
 #include "vtkOrientedImageData.h"
 
+// VTK includes
+#include <vtkWeakPointer.h>
+
+// STD includes
+#include <string>
+
 class vtkCollection;
 class vtkMRMLMarkupsFiducialNode;
 class vtkMRMLRTBeamNode;
 class vtkMRMLScalarVolumeNode;
 class vtkMRMLSegmentationNode;
+class vtkMRMLSubjectHierarchyNode;
 
 /// \ingroup SlicerRt_QtModules_Beams
 class VTK_SLICER_BEAMS_MODULE_MRML_EXPORT vtkMRMLRTPlanNode : public vtkMRMLNode
@@ -48,6 +55,23 @@ public:
     ArbitraryPoint
   };
 
+  /// Geometric moments of the target segment labelmap, in world (RAS) coordinates
+  struct TargetLabelmapMoments
+  {
+    /// Number of voxels in the target. All other values are undefined if it is zero
+    vtkIdType NumberOfVoxels;
+    /// Volume of the target (mm^3)
+    double Volume;
+    /// Center of gravity of the target voxels
+    double Centroid[3];
+    /// Bounds of the target voxel centers (xmin, xmax, ymin, ymax, zmin, zmax)
+    double Bounds[6];
+    /// Principal axes (unit vectors) in order of decreasing spread
+    double PrincipalAxes[3][3];
+    /// Variance of the voxel positions along the principal axes (mm^2)
+    double PrincipalMoments[3];
+  };
+
   static const char* ISOCENTER_FIDUCIAL_NAME;
   static const int ISOCENTER_FIDUCIAL_INDEX;
 
@@ -119,11 +143,17 @@ public:
   /// or false if no target segment has been specified
   bool ComputeTargetVolumeCenter(double center[3]);
 
+  /// Get centroid, bounds, voxel count and principal axes of the target segment.
+  /// The labelmap is processed in place (in a single multithreaded pass), and the result is cached
+  /// until the target segment, its labelmap, the segmentation node or its parent transform changes.
+  /// \return Success flag. False if no valid target segment has been specified
+  bool GetTargetLabelmapMoments(TargetLabelmapMoments& moments);
+
 // Set/get functions
 public:
-  /// Get beam nodes belonging to this plan
+  /// Get beam nodes belonging to this plan, sorted by beam number
   void GetBeams(vtkCollection* beams);
-  /// Get beam nodes belonging to this plan
+  /// Get beam nodes belonging to this plan, sorted by beam number
   void GetBeams(std::vector<vtkMRMLRTBeamNode*>& beams);
   /// Get number of beams
   int GetNumberOfBeams();
@@ -189,6 +219,15 @@ protected:
   /// Create default plan POIs markups node
   vtkMRMLMarkupsFiducialNode* CreateMarkupsFiducialNode();
 
+  /// Build beam index from the subject hierarchy if it is not valid,
+  /// and start observing the subject hierarchy to keep it up to date
+  /// \return Success flag
+  bool UpdateBeamIndex();
+  /// Update beam index after a subject hierarchy event of the given item
+  void UpdateBeamIndexForSubjectHierarchyItem(unsigned long eventID, vtkIdType itemID);
+  /// Determine whether a subject hierarchy item is in the branch of the plan
+  bool IsItemInPlanBranch(vtkIdType itemID);
+
 protected:
   vtkMRMLRTPlanNode();
   ~vtkMRMLRTPlanNode();
@@ -215,6 +254,20 @@ protected:
   ///TODO: Allow user to specify dose volume resolution different from reference volume
   /// (currently output dose volume has the same spacing as the reference anatomy)
   double DoseGrid[3];
+
+  /// Cached target labelmap moments \sa GetTargetLabelmapMoments
+  TargetLabelmapMoments TargetMomentsCache;
+  /// Segmentation node, target segment ID, parent transform node ID and modified time that the cached target moments belong to
+  vtkWeakPointer<vtkMRMLSegmentationNode> TargetMomentsCacheSegmentationNode;
+  std::string TargetMomentsCacheSegmentID;
+  std::string TargetMomentsCacheParentTransformNodeID;
+  vtkMTimeType TargetMomentsCacheTime;
+
+  /// Beams of the plan indexed by number and name, and sorted by number
+  class vtkInternal;
+  vtkInternal* Internal;
+  /// Subject hierarchy node observed for keeping the beam index up to date
+  vtkMRMLSubjectHierarchyNode* BeamIndexSubjectHierarchyNode;
 };
 
 #endif // __vtkMRMLRTPlanNode_h
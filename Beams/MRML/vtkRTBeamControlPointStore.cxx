@@ -0,0 +1,565 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// Beams includes
+#include "vtkRTBeamControlPointStore.h"
+
+// SlicerRT includes
+#include "vtkSlicerRtCommon.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Collect leaf pair data (boundaries and positions) for building the beam model
+  template<typename T>
+  void FillLeafData(int numberOfLeafPairs, const float* boundaries, const T* leafPositions,
+    vtkRTBeamControlPointStore::LeafDataVector& leafData)
+  {
+    leafData.resize(leafPositions ? numberOfLeafPairs : 0);
+    for (size_t leaf = 0; leaf < leafData.size(); ++leaf)
+    {
+      leafData[leaf] = { boundaries[leaf], boundaries[leaf + 1],
+        static_cast<double>(leafPositions[leaf]), static_cast<double>(leafPositions[leaf + numberOfLeafPairs]) };
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /// Angle difference normalized to [0, 360)
+  double PositiveAngleDifference(double angle1, double angle2)
+  {
+    double difference = std::fmod(angle1 - angle2, 360.0);
+    return (difference < 0.0 ? difference + 360.0 : difference);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkRTBeamControlPointStore);
+
+//----------------------------------------------------------------------------
+vtkRTBeamControlPointStore::vtkRTBeamControlPointStore()
+{
+  this->NumberOfControlPoints = 0;
+  this->NumberOfLeafPairs = 0;
+  this->MLCType = NoMLC;
+}
+
+//----------------------------------------------------------------------------
+vtkRTBeamControlPointStore::~vtkRTBeamControlPointStore() = default;
+
+//----------------------------------------------------------------------------
+void vtkRTBeamControlPointStore::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfControlPoints: " << this->NumberOfControlPoints << "\n";
+  os << indent << "NumberOfLeafPairs: " << this->NumberOfLeafPairs << "\n";
+  os << indent << "MLCType: " << (this->MLCType == MLCX ? "MLCX" : (this->MLCType == MLCY ? "MLCY" : "None")) << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkRTBeamControlPointStore::Allocate(int numberOfControlPoints, int numberOfLeafPairs)
+{
+  this->NumberOfControlPoints = std::max(0, numberOfControlPoints);
+  this->NumberOfLeafPairs = std::max(0, numberOfLeafPairs);
+  this->Angles.assign(3 * this->NumberOfControlPoints, 0.0f);
+  this->JawPositions.assign(4 * this->NumberOfControlPoints, 0.0f);
+  this->LeafPositions.assign(2 * static_cast<size_t>(this->NumberOfLeafPairs) * this->NumberOfControlPoints, 0.0f);
+  this->LeafBoundaries.assign(this->NumberOfLeafPairs > 0 ? this->NumberOfLeafPairs + 1 : 0, 0.0f);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkRTBeamControlPointStore::DeepCopy(vtkRTBeamControlPointStore* source)
+{
+  if (!source || source == this)
+  {
+    return;
+  }
+  this->NumberOfControlPoints = source->NumberOfControlPoints;
+  this->NumberOfLeafPairs = source->NumberOfLeafPairs;
+  this->MLCType = source->MLCType;
+  this->Angles = source->Angles;
+  this->JawPositions = source->JawPositions;
+  this->LeafPositions = source->LeafPositions;
+  this->LeafBoundaries = source->LeafBoundaries;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkRTBeamControlPointStore::SetLeafBoundaries(const double* boundaries)
+{
+  if (!boundaries)
+  {
+    vtkErrorMacro("SetLeafBoundaries: Invalid boundaries");
+    return;
+  }
+  std::copy(boundaries, boundaries + this->LeafBoundaries.size(), this->LeafBoundaries.begin());
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkRTBeamControlPointStore::SetControlPoint(int index, double gantryAngle, double collimatorAngle, double couchAngle,
+  const double jaws[4], const double* leafPositions/*=nullptr*/)
+{
+  if (index < 0 || index >= this->NumberOfControlPoints)
+  {
+    vtkErrorMacro("SetControlPoint: Invalid control point index " << index);
+    return;
+  }
+
+  this->Angles[3 * index] = static_cast<float>(gantryAngle);
+  this->Angles[3 * index + 1] = static_cast<float>(collimatorAngle);
+  this->Angles[3 * index + 2] = static_cast<float>(couchAngle);
+  std::copy(jaws, jaws + 4, this->JawPositions.begin() + 4 * index);
+  if (leafPositions)
+  {
+    size_t numberOfPositions = 2 * static_cast<size_t>(this->NumberOfLeafPairs);
+    std::copy(leafPositions, leafPositions + numberOfPositions, this->LeafPositions.begin() + numberOfPositions * index);
+  }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+const float* vtkRTBeamControlPointStore::GetLeafPositions(int index)
+{
+  if (this->NumberOfLeafPairs == 0 || index < 0 || index >= this->NumberOfControlPoints)
+  {
+    return nullptr;
+  }
+  return this->LeafPositions.data() + 2 * static_cast<size_t>(this->NumberOfLeafPairs) * index;
+}
+
+//----------------------------------------------------------------------------
+bool vtkRTBeamControlPointStore::InterpolateAtGantryAngle(double gantryAngle, double jaws[4], std::vector<double>& leafPositions)
+{
+  if (this->NumberOfControlPoints == 0)
+  {
+    vtkErrorMacro("InterpolateAtGantryAngle: No control points");
+    return false;
+  }
+
+  // Find the segment of the arc containing the angle
+  int segmentStart = -1;
+  double weight = 0.0;
+  if (this->NumberOfControlPoints == 1)
+  {
+    if (vtkSlicerRtCommon::AreEqualWithTolerance(PositiveAngleDifference(gantryAngle, this->GetGantryAngle(0)), 0.0))
+    {
+      segmentStart = 0;
+    }
+  }
+  for (int index = 0; index + 1 < this->NumberOfControlPoints && segmentStart < 0; ++index)
+  {
+    double startAngle = this->GetGantryAngle(index);
+    double endAngle = this->GetGantryAngle(index + 1);
+    // Rotation of the gantry in the segment, and offset of the angle from the segment start, both in the direction of rotation
+    double clockwiseRotation = PositiveAngleDifference(endAngle, startAngle);
+    bool clockwise = (clockwiseRotation <= 180.0);
+    double rotation = (clockwise ? clockwiseRotation : 360.0 - clockwiseRotation);
+    double offset = (clockwise ? PositiveAngleDifference(gantryAngle, startAngle) : PositiveAngleDifference(startAngle, gantryAngle));
+    if (offset > 360.0 - EPSILON)
+    {
+      offset = 0.0;
+    }
+    if (rotation < EPSILON)
+    {
+      if (offset < EPSILON)
+      {
+        segmentStart = index;
+      }
+    }
+    else if (offset <= rotation + EPSILON)
+    {
+      segmentStart = index;
+      weight = std::min(1.0, offset / rotation);
+    }
+  }
+  if (segmentStart < 0)
+  {
+    return false;
+  }
+
+  int segmentEnd = std::min(segmentStart + 1, this->NumberOfControlPoints - 1);
+  const float* startJaws = this->GetJawPositions(segmentStart);
+  const float* endJaws = this->GetJawPositions(segmentEnd);
+  for (int jaw = 0; jaw < 4; ++jaw)
+  {
+    jaws[jaw] = (1.0 - weight) * startJaws[jaw] + weight * endJaws[jaw];
+  }
+
+  const float* startLeaves = this->GetLeafPositions(segmentStart);
+  const float* endLeaves = this->GetLeafPositions(segmentEnd);
+  leafPositions.resize(startLeaves ? 2 * this->NumberOfLeafPairs : 0);
+  for (size_t leaf = 0; leaf < leafPositions.size(); ++leaf)
+  {
+    leafPositions[leaf] = (1.0 - weight) * startLeaves[leaf] + weight * endLeaves[leaf];
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkRTBeamControlPointStore::GetLeafDataAtGantryAngle(double gantryAngle, LeafDataVector& leafData)
+{
+  double jaws[4] = { 0.0, 0.0, 0.0, 0.0 };
+  std::vector<double> leafPositions;
+  if (!this->InterpolateAtGantryAngle(gantryAngle, jaws, leafPositions))
+  {
+    leafData.clear();
+    return false;
+  }
+  FillLeafData(this->NumberOfLeafPairs, this->LeafBoundaries.data(), (leafPositions.empty() ? nullptr : leafPositions.data()), leafData);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkRTBeamControlPointStore::CreateBeamPolyData(int index, double sourceAxisDistance, vtkPolyData* beamModelPolyData)
+{
+  if (index < 0 || index >= this->NumberOfControlPoints || !beamModelPolyData)
+  {
+    vtkErrorMacro("CreateBeamPolyData: Invalid control point index " << index << " or output poly data");
+    return false;
+  }
+
+  const float* jawPositions = this->GetJawPositions(index);
+  double jaws[4] = { jawPositions[0], jawPositions[1], jawPositions[2], jawPositions[3] };
+  LeafDataVector leafData;
+  FillLeafData(this->NumberOfLeafPairs, this->LeafBoundaries.data(), this->GetLeafPositions(index), leafData);
+  if (!BuildBeamPolyData(sourceAxisDistance, jaws, this->MLCType, leafData, beamModelPolyData))
+  {
+    vtkErrorMacro("CreateBeamPolyData: Unable to calculate MLC visible data for control point " << index);
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkRTBeamControlPointStore::CreateBeamPolyDataAtGantryAngle(double gantryAngle, double sourceAxisDistance, vtkPolyData* beamModelPolyData)
+{
+  if (!beamModelPolyData)
+  {
+    vtkErrorMacro("CreateBeamPolyDataAtGantryAngle: Invalid output poly data");
+    return false;
+  }
+
+  double jaws[4] = { 0.0, 0.0, 0.0, 0.0 };
+  std::vector<double> leafPositions;
+  if (!this->InterpolateAtGantryAngle(gantryAngle, jaws, leafPositions))
+  {
+    vtkErrorMacro("CreateBeamPolyDataAtGantryAngle: Gantry angle " << gantryAngle << " is not covered by the control points");
+    return false;
+  }
+  LeafDataVector leafData;
+  FillLeafData(this->NumberOfLeafPairs, this->LeafBoundaries.data(), (leafPositions.empty() ? nullptr : leafPositions.data()), leafData);
+  if (!BuildBeamPolyData(sourceAxisDistance, jaws, this->MLCType, leafData, beamModelPolyData))
+  {
+    vtkErrorMacro("CreateBeamPolyDataAtGantryAngle: Unable to calculate MLC visible data at gantry angle " << gantryAngle);
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkRTBeamControlPointStore::BuildBeamPolyData(double sourceAxisDistance, const double jaws[4], int mlcType,
+  const LeafDataVector& leafData, vtkPolyData* beamModelPolyData)
+{
+  if (!beamModelPolyData)
+  {
+    return false;
+  }
+
+  double x1Jaw = jaws[0];
+  double x2Jaw = jaws[1];
+  double y1Jaw = jaws[2];
+  double y2Jaw = jaws[3];
+
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  vtkSmartPointer<vtkCellArray> cellArray = vtkSmartPointer<vtkCellArray>::New();
+
+  // static function ptr
+  bool(*AreEqual)(double, double) = vtkSlicerRtCommon::AreEqualWithTolerance;
+
+  bool xOpened = !AreEqual( x2Jaw, x1Jaw);
+  bool yOpened = !AreEqual( y2Jaw, y1Jaw);
+
+  // Check that we have MLC with Jaws opening
+  if (mlcType != NoMLC && !leafData.empty() && xOpened && yOpened)
+  {
+    using PointVector = std::vector< std::pair< double, double > >;
+
+    LeafDataVector mlc(leafData); // temporary MLC vector (Boundary and Position)
+    PointVector side12; // real points for side "1" and "2"
+
+    bool typeMLCX = (mlcType == MLCX);
+    bool typeMLCY = (mlcType == MLCY);
+
+    auto firstLeafIterator = mlc.end();
+    auto lastLeafIterator = mlc.end();
+    double jawBegin = y1Jaw;
+    double jawEnd = y2Jaw;
+    if (typeMLCY)
+    {
+      jawBegin = x1Jaw;
+      jawEnd = x2Jaw;
+    }
+
+    // find first and last opened leaves visible within jaws
+    PointVector side1, side2; // temporary vectors to save visible points
+    for ( auto it = mlc.begin(); it != mlc.end(); ++it)
+    {
+      double& pos1 = (*it)[2]; // leaf position "1"
+      double& pos2 = (*it)[3]; // leaf position "2"
+      bool mlcOpened = !AreEqual( pos1, pos2);
+      bool withinJaw = false;
+      if (typeMLCX)
+      {
+        withinJaw = ((pos1 < x1Jaw && pos2 >= x1Jaw && pos2 <= x2Jaw) || 
+          (pos1 >= x1Jaw && pos1 <= x2Jaw && pos2 > x2Jaw) || 
+          (pos1 <= x1Jaw && pos2 >= x2Jaw) || 
+          (pos1 >= x1Jaw && pos1 <= x2Jaw && 
+            pos2 >= x1Jaw && pos2 <= x2Jaw));
+      }
+      else if (typeMLCY)
+      {
+        withinJaw = ((pos1 < y1Jaw && pos2 >= y1Jaw && pos2 <= y2Jaw) || 
+          (pos1 >= y1Jaw && pos1 <= y2Jaw && pos2 > y2Jaw) || 
+          (pos1 <= y1Jaw && pos2 >= y2Jaw) || 
+          (pos1 >= y1Jaw && pos1 <= y2Jaw && 
+            pos2 >= y1Jaw && pos2 <= y2Jaw));
+      }
+
+      if (withinJaw && mlcOpened && firstLeafIterator == mlc.end())
+      {
+        firstLeafIterator = it;
+      }
+      else if (withinJaw && mlcOpened && firstLeafIterator != mlc.end())
+      {
+        lastLeafIterator = it;
+      }
+    }
+    
+    // iterate through visible leaves to fill temporary points vectors
+    if (firstLeafIterator != mlc.end() && lastLeafIterator != mlc.end())
+    {
+      auto firstLeafIteratorJaws = firstLeafIterator;
+      auto lastLeafIteratorJaws = lastLeafIterator;
+      // find first and last visible leaves using Jaws data
+      for ( auto it = firstLeafIterator; it <= lastLeafIterator; ++it)
+      {
+        double& bound1 = (*it)[0]; // leaf begin boundary
+        double& bound2 = (*it)[1]; // leaf end boundary
+        if (bound1 <= jawBegin && bound2 > jawBegin)
+        {
+          firstLeafIteratorJaws = it;
+        }
+        else if (bound1 <= jawEnd && bound2 > jawEnd)
+        {
+          lastLeafIteratorJaws = it;
+        }
+      }
+
+      // find opened MLC leaves into Jaws opening (logical AND)
+      if (firstLeafIteratorJaws != firstLeafIterator)
+      {
+        firstLeafIterator = std::max( firstLeafIteratorJaws, firstLeafIterator);
+      }
+      if (lastLeafIteratorJaws != lastLeafIterator)
+      {
+        lastLeafIterator = std::min( lastLeafIteratorJaws, lastLeafIterator);
+      }
+
+      // add points for the visible leaves of side "1" and "2"
+      // into side1 and side2 points vectors
+      for ( auto it = firstLeafIterator; it <= lastLeafIterator; ++it)
+      {
+        double& bound1 = (*it)[0]; // leaf begin boundary
+        double& bound2 = (*it)[1]; // leaf end boundary
+        double& pos1 = (*it)[2]; // leaf position "1"
+        double& pos2 = (*it)[3]; // leaf position "2"
+        if (typeMLCX)
+        {
+          side1.push_back({ std::max( pos1, x1Jaw), bound1});
+          side1.push_back({ std::max( pos1, x1Jaw), bound2});
+          side2.push_back({ std::min( pos2, x2Jaw), bound1});
+          side2.push_back({ std::min( pos2, x2Jaw), bound2});
+        }
+        else if (typeMLCY)
+        {
+          side1.push_back({ bound1, std::max( pos1, y1Jaw)});
+          side1.push_back({ bound2, std::max( pos1, y1Jaw)});
+          side2.push_back({ bound1, std::min( pos2, y2Jaw)});
+          side2.push_back({ bound2, std::min( pos2, y2Jaw)});
+        }
+      }
+      mlc.clear(); // doesn't need anymore
+
+      // intersection between Jaws and MLC boundary (logical AND) lambda
+      auto intersectJawsMLC = [ jawBegin, jawEnd, typeMLCX, typeMLCY](PointVector::value_type& point)
+      {
+        double& leafBoundary = point.second;
+        if (typeMLCX) // JawsY and MLCX
+        {
+          leafBoundary = point.second;
+        }
+        else if (typeMLCY) // JawsX and MLCY
+        {
+          leafBoundary = point.first;
+        }
+
+        if (leafBoundary <= jawBegin)
+        {
+          leafBoundary = jawBegin;
+        }
+        else if (leafBoundary >= jawEnd)
+        {
+          leafBoundary = jawEnd;
+        }
+      };
+      // apply lambda to side "1"
+      std::for_each( side1.begin(), side1.end(), intersectJawsMLC);
+      // apply lambda to side "2"
+      std::for_each( side2.begin(), side2.end(), intersectJawsMLC);
+
+      // reverse side "2"
+      std::reverse( side2.begin(), side2.end());
+
+      // fill real points vector side12 without excessive points from side1 vector
+      PointVector::value_type& p = side1.front(); // start point
+      double& px = p.first; // x coordinate of p point
+      double& py = p.second; // y coordinate of p point
+      side12.push_back(p);
+      for ( size_t i = 1; i < side1.size() - 1; ++i)
+      {
+        double& pxNext = side1[i + 1].first; // x coordinate of next point
+        double& pyNext = side1[i + 1].second; // y coordinate of next point
+        if (!AreEqual( px, pxNext) && !AreEqual( py, pyNext))
+        {
+          p = side1[i];
+          side12.push_back(p);
+        }
+      }
+      side12.push_back(side1.back()); // end point
+
+      // same for the side2 vector
+      p = side2.front();
+      side12.push_back(p);
+      for ( size_t i = 1; i < side2.size() - 1; ++i)
+      {
+        double& pxNext = side2[i + 1].first;
+        double& pyNext = side2[i + 1].second;
+        if (!AreEqual( px, pxNext) && !AreEqual( py, pyNext))
+        {
+          p = side2[i];
+          side12.push_back(p);
+        }
+      }
+      side12.push_back(side2.back());
+    }
+    else
+    {
+      return false;
+    }
+
+    // fill vtk points
+    points->InsertPoint( 0, 0, 0, sourceAxisDistance); // source
+
+    // side "1" and "2" points vector
+    vtkIdType pointIds = 0;
+    for ( PointVector::value_type& point : side12)
+    {
+      double& x = point.first;
+      double& y = point.second;
+      points->InsertPoint( pointIds + 1, 2. * x, 2. * y, -sourceAxisDistance);
+      pointIds++;
+    }
+    side12.clear(); // doesn't need anymore
+
+    // fill cell array for side "1" and "2"
+    for ( vtkIdType i = 1; i < pointIds; ++i)
+    {
+      cellArray->InsertNextCell(3);
+      cellArray->InsertCellPoint(0);
+      cellArray->InsertCellPoint(i);
+      cellArray->InsertCellPoint(i + 1);
+    }
+
+    // fill cell connection between side "2" -> side "1"
+    cellArray->InsertNextCell(3);
+    cellArray->InsertCellPoint(0);
+    cellArray->InsertCellPoint(1);
+    cellArray->InsertCellPoint(pointIds);
+
+    // Add the cap to the bottom
+    cellArray->InsertNextCell(pointIds);
+    for ( vtkIdType i = 1; i <= pointIds; i++)
+    {
+      cellArray->InsertCellPoint(i);
+    }
+  }
+  else
+  {
+    points->InsertPoint(0,0,0,sourceAxisDistance);
+    points->InsertPoint(1, 2*x1Jaw, 2*y1Jaw, -sourceAxisDistance );
+    points->InsertPoint(2, 2*x1Jaw, 2*y2Jaw, -sourceAxisDistance );
+    points->InsertPoint(3, 2*x2Jaw, 2*y2Jaw, -sourceAxisDistance );
+    points->InsertPoint(4, 2*x2Jaw, 2*y1Jaw, -sourceAxisDistance );
+
+    cellArray->InsertNextCell(3);
+    cellArray->InsertCellPoint(0);
+    cellArray->InsertCellPoint(1);
+    cellArray->InsertCellPoint(2);
+
+    cellArray->InsertNextCell(3);
+    cellArray->InsertCellPoint(0);
+    cellArray->InsertCellPoint(2);
+    cellArray->InsertCellPoint(3);
+
+    cellArray->InsertNextCell(3);
+    cellArray->InsertCellPoint(0);
+    cellArray->InsertCellPoint(3);
+    cellArray->InsertCellPoint(4);
+
+    cellArray->InsertNextCell(3);
+    cellArray->InsertCellPoint(0);
+    cellArray->InsertCellPoint(4);
+    cellArray->InsertCellPoint(1);
+
+    // Add the cap to the bottom
+    cellArray->InsertNextCell(4);
+    cellArray->InsertCellPoint(1);
+    cellArray->InsertCellPoint(2);
+    cellArray->InsertCellPoint(3);
+    cellArray->InsertCellPoint(4);
+  }
+
+  beamModelPolyData->SetPoints(points);
+  beamModelPolyData->SetPolys(cellArray);
+  return true;
+}
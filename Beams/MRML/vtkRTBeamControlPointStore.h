@@ -0,0 +1,155 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// .NAME vtkRTBeamControlPointStore - Compact storage of the control point geometry of a beam
+// .SECTION Description
+
+#ifndef __vtkRTBeamControlPointStore_h
+#define __vtkRTBeamControlPointStore_h
+
+// Beams includes
+#include "vtkSlicerBeamsModuleMRMLExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <array>
+#include <vector>
+
+class vtkPolyData;
+
+/// \ingroup SlicerRt_QtModules_Beams
+/// \brief Stores the geometry of all control points of a beam (e.g. a VMAT arc) in contiguous arrays.
+///
+/// Gantry, collimator and couch angles, jaw positions and MLC leaf positions are kept in flat float
+/// arrays indexed by control point, so that the beam model of any control point (or of any gantry angle
+/// between two control points, by linear interpolation) can be generated without accessing MRML nodes.
+/// Leaf positions of a control point are stored in DICOM order: side "1" of all leaf pairs, then side "2".
+class VTK_SLICER_BEAMS_MODULE_MRML_EXPORT vtkRTBeamControlPointStore : public vtkObject
+{
+public:
+  /// Type of the multi-leaf collimator
+  enum MLCType
+  {
+    NoMLC = 0,
+    /// Leaves move along the X axis
+    MLCX,
+    /// Leaves move along the Y axis
+    MLCY
+  };
+
+  /// Leaf pair data used for building beam models: begin and end boundary, position of side "1" and "2"
+  typedef std::vector< std::array<double, 4> > LeafDataVector;
+
+public:
+  static vtkRTBeamControlPointStore *New();
+  vtkTypeMacro(vtkRTBeamControlPointStore, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Allocate storage for the given number of control points and leaf pairs. Previous content is discarded
+  void Allocate(int numberOfControlPoints, int numberOfLeafPairs);
+
+  /// Copy all control point geometry from another store
+  void DeepCopy(vtkRTBeamControlPointStore* source);
+
+  /// Get number of control points
+  vtkGetMacro(NumberOfControlPoints, int);
+  /// Get number of MLC leaf pairs (0 if there is no MLC)
+  vtkGetMacro(NumberOfLeafPairs, int);
+
+  /// Type of the MLC (\sa MLCType)
+  vtkSetMacro(MLCType, int);
+  vtkGetMacro(MLCType, int);
+
+  /// Set leaf pair boundaries (number of leaf pairs + 1 values)
+  void SetLeafBoundaries(const double* boundaries);
+  /// Get leaf pair boundaries (number of leaf pairs + 1 values)
+  const float* GetLeafBoundaries() { return this->LeafBoundaries.data(); };
+
+  /// Set geometry of a control point
+  /// \param jaws Jaw positions in X1, X2, Y1, Y2 order
+  /// \param leafPositions Leaf positions in DICOM order (2 * number of leaf pairs values). Not used if nullptr
+  void SetControlPoint(int index, double gantryAngle, double collimatorAngle, double couchAngle,
+    const double jaws[4], const double* leafPositions=nullptr);
+
+  /// Get gantry angle of a control point
+  double GetGantryAngle(int index) { return this->Angles[3 * index]; };
+  /// Get collimator angle of a control point
+  double GetCollimatorAngle(int index) { return this->Angles[3 * index + 1]; };
+  /// Get couch angle of a control point
+  double GetCouchAngle(int index) { return this->Angles[3 * index + 2]; };
+  /// Get jaw positions of a control point in X1, X2, Y1, Y2 order
+  const float* GetJawPositions(int index) { return this->JawPositions.data() + 4 * index; };
+  /// Get leaf positions of a control point in DICOM order, nullptr if there is no MLC
+  const float* GetLeafPositions(int index);
+
+  /// Interpolate jaw and leaf positions at a gantry angle between the two control points enclosing it.
+  /// The direction of the arc is taken into account, and angles are compared modulo 360 degrees.
+  /// \param jaws Output jaw positions in X1, X2, Y1, Y2 order
+  /// \param leafPositions Output leaf positions in DICOM order
+  /// \return False if the gantry angle is not covered by the control points
+  bool InterpolateAtGantryAngle(double gantryAngle, double jaws[4], std::vector<double>& leafPositions);
+
+  /// Get leaf pair data for building the beam model at a gantry angle, interpolated between the control points
+  /// \param leafData Output leaf pair data. Empty if there is no MLC
+  /// \return False if the gantry angle is not covered by the control points
+  bool GetLeafDataAtGantryAngle(double gantryAngle, LeafDataVector& leafData);
+
+  /// Create beam model of a control point
+  /// \return Success flag
+  bool CreateBeamPolyData(int index, double sourceAxisDistance, vtkPolyData* beamModelPolyData);
+
+  /// Create beam model at a gantry angle, interpolated between the control points (\sa InterpolateAtGantryAngle)
+  /// \return Success flag
+  bool CreateBeamPolyDataAtGantryAngle(double gantryAngle, double sourceAxisDistance, vtkPolyData* beamModelPolyData);
+
+  /// Build beam model from jaw and MLC geometry. The source is at (0, 0, SAD), the field is projected to
+  /// twice the source-axis distance below it
+  /// \param jaws Jaw positions in X1, X2, Y1, Y2 order
+  /// \param mlcType Type of the MLC (\sa MLCType). If NoMLC or if leaf data is empty then the model is built from the jaws only
+  /// \return Success flag. False if no MLC leaf pair is open within the jaws
+  static bool BuildBeamPolyData(double sourceAxisDistance, const double jaws[4], int mlcType,
+    const LeafDataVector& leafData, vtkPolyData* beamModelPolyData);
+
+protected:
+  int NumberOfControlPoints;
+  int NumberOfLeafPairs;
+  int MLCType;
+
+  /// Gantry, collimator and couch angles of each control point
+  std::vector<float> Angles;
+  /// Jaw positions of each control point (X1, X2, Y1, Y2)
+  std::vector<float> JawPositions;
+  /// Leaf positions of each control point (side "1" then side "2")
+  std::vector<float> LeafPositions;
+  /// Leaf pair boundaries
+  std::vector<float> LeafBoundaries;
+
+protected:
+  vtkRTBeamControlPointStore();
+  ~vtkRTBeamControlPointStore() override;
+
+private:
+  vtkRTBeamControlPointStore(const vtkRTBeamControlPointStore&) = delete;
+  void operator=(const vtkRTBeamControlPointStore&) = delete;
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Beams includes
+#include "vtkMRMLRTBeamNode.h"
+
+// MRML includes
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  void CountEvent(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eid), void* clientData, void* vtkNotUsed(callData))
+  {
+    ++(*static_cast<int*>(clientData));
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLRTBeamNodeTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkMRMLScene> mrmlScene;
+  vtkSmartPointer<vtkMRMLRTBeamNode> beamNode = vtkSmartPointer<vtkMRMLRTBeamNode>::New();
+  mrmlScene->AddNode(beamNode);
+
+  int numberOfParameterEvents = 0;
+  vtkNew<vtkCallbackCommand> parameterCallback;
+  parameterCallback->SetCallback(CountEvent);
+  parameterCallback->SetClientData(&numberOfParameterEvents);
+  beamNode->AddObserver(vtkMRMLRTBeamNode::DoseEngineParameterModified, parameterCallback);
+
+  // Typed value is returned as set, and also stored as attribute
+  const std::string doubleParameterName("TestEngine.DoubleParameter");
+  beamNode->SetDoseEngineDoubleParameter(doubleParameterName, 2.5);
+  double doubleValue = 0.0;
+  if (!beamNode->GetDoseEngineDoubleParameter(doubleParameterName, doubleValue) || doubleValue != 2.5)
+  {
+    std::cerr << __LINE__ << ": Double parameter value " << doubleValue << " does not match expected value 2.5" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!beamNode->GetAttribute(doubleParameterName.c_str()) || strcmp(beamNode->GetAttribute(doubleParameterName.c_str()), "2.5"))
+  {
+    std::cerr << __LINE__ << ": Double parameter is not stored as attribute" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Setting the same value does not invoke event
+  beamNode->SetDoseEngineDoubleParameter(doubleParameterName, 2.5);
+  if (numberOfParameterEvents != 1)
+  {
+    std::cerr << __LINE__ << ": Number of parameter modified events " << numberOfParameterEvents << " does not match expected value 1" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Changing the attribute directly invalidates the typed value
+  beamNode->SetAttribute(doubleParameterName.c_str(), "3.5");
+  if (!beamNode->GetDoseEngineDoubleParameter(doubleParameterName, doubleValue) || doubleValue != 3.5)
+  {
+    std::cerr << __LINE__ << ": Double parameter value " << doubleValue << " after setting the attribute does not match expected value 3.5" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Removing the attribute removes the parameter
+  beamNode->RemoveAttribute(doubleParameterName.c_str());
+  if (beamNode->HasDoseEngineParameter(doubleParameterName) || beamNode->GetDoseEngineDoubleParameter(doubleParameterName, doubleValue))
+  {
+    std::cerr << __LINE__ << ": Double parameter still exists after removing the attribute" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Parameter set as string can be read in numeric types
+  const std::string stringParameterName("TestEngine.StringParameter");
+  beamNode->SetDoseEngineStringParameter(stringParameterName, "7");
+  int integerValue = 0;
+  if ( !beamNode->GetDoseEngineIntegerParameter(stringParameterName, integerValue) || integerValue != 7
+    || !beamNode->GetDoseEngineDoubleParameter(stringParameterName, doubleValue) || doubleValue != 7.0 )
+  {
+    std::cerr << __LINE__ << ": Parameter set as string '7' cannot be read as integer and double" << std::endl;
+    return EXIT_FAILURE;
+  }
+  bool booleanValue = false;
+  if (beamNode->GetDoseEngineBooleanParameter(stringParameterName, booleanValue))
+  {
+    std::cerr << __LINE__ << ": Parameter set as string '7' should not be readable as boolean" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Typed setter after string setter updates the value in all types
+  beamNode->SetDoseEngineIntegerParameter(stringParameterName, 8);
+  std::string stringValue;
+  if ( !beamNode->GetDoseEngineStringParameter(stringParameterName, stringValue) || stringValue != "8"
+    || !beamNode->GetDoseEngineDoubleParameter(stringParameterName, doubleValue) || doubleValue != 8.0 )
+  {
+    std::cerr << __LINE__ << ": Parameter set as integer 8 does not match in string and double form" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Boolean parameter
+  const std::string booleanParameterName("TestEngine.BooleanParameter");
+  beamNode->SetDoseEngineBooleanParameter(booleanParameterName, true);
+  if (!beamNode->GetDoseEngineBooleanParameter(booleanParameterName, booleanValue) || !booleanValue)
+  {
+    std::cerr << __LINE__ << ": Boolean parameter value does not match expected value true" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Multiple parameters set between StartModify and EndModify invoke a single event
+  numberOfParameterEvents = 0;
+  int wasModifying = beamNode->StartModify();
+  beamNode->SetDoseEngineDoubleParameter(doubleParameterName, 1.0);
+  beamNode->SetDoseEngineIntegerParameter(stringParameterName, 9);
+  beamNode->SetDoseEngineBooleanParameter(booleanParameterName, false);
+  beamNode->EndModify(wasModifying);
+  if (numberOfParameterEvents != 1)
+  {
+    std::cerr << __LINE__ << ": Number of compressed parameter modified events " << numberOfParameterEvents << " does not match expected value 1" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Parameters are copied with the node
+  vtkSmartPointer<vtkMRMLRTBeamNode> copiedBeamNode = vtkSmartPointer<vtkMRMLRTBeamNode>::New();
+  copiedBeamNode->Copy(beamNode);
+  if ( !copiedBeamNode->GetDoseEngineIntegerParameter(stringParameterName, integerValue) || integerValue != 9
+    || !copiedBeamNode->GetDoseEngineBooleanParameter(booleanParameterName, booleanValue) || booleanValue )
+  {
+    std::cerr << __LINE__ << ": Parameters of the copied beam do not match the original" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  beamNode->RemoveObserver(parameterCallback);
+
+  std::cout << "Beam node dose engine parameter test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
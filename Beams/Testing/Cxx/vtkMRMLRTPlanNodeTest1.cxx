@@ -0,0 +1,169 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Beams includes
+#include "vtkMRMLRTPlanNode.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSegmentationNode.h>
+
+// SegmentationCore includes
+#include <vtkOrientedImageData.h>
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  bool AreEqualWithTolerance(double a, double b)
+  {
+    return std::fabs(a - b) < 1e-4;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Check centroid, volume and first principal axis (direction only, sign is arbitrary) of the target
+  bool AreMomentsEqualTo(vtkMRMLRTPlanNode* planNode, const double expectedCentroid[3], double expectedVolume,
+    const double expectedFirstAxis[3])
+  {
+    vtkMRMLRTPlanNode::TargetLabelmapMoments moments;
+    if (!planNode->GetTargetLabelmapMoments(moments) || moments.NumberOfVoxels == 0)
+    {
+      std::cerr << "Failed to compute target moments" << std::endl;
+      return false;
+    }
+    if ( !AreEqualWithTolerance(moments.Centroid[0], expectedCentroid[0]) || !AreEqualWithTolerance(moments.Centroid[1], expectedCentroid[1])
+      || !AreEqualWithTolerance(moments.Centroid[2], expectedCentroid[2]) )
+    {
+      std::cerr << "Target centroid (" << moments.Centroid[0] << ", " << moments.Centroid[1] << ", " << moments.Centroid[2]
+        << ") does not match expected centroid (" << expectedCentroid[0] << ", " << expectedCentroid[1] << ", " << expectedCentroid[2] << ")" << std::endl;
+      return false;
+    }
+    if (!AreEqualWithTolerance(moments.Volume, expectedVolume))
+    {
+      std::cerr << "Target volume " << moments.Volume << " does not match expected volume " << expectedVolume << std::endl;
+      return false;
+    }
+    if (!AreEqualWithTolerance(std::fabs(vtkMath::Dot(moments.PrincipalAxes[0], expectedFirstAxis)), 1.0))
+    {
+      std::cerr << "First principal axis (" << moments.PrincipalAxes[0][0] << ", " << moments.PrincipalAxes[0][1] << ", " << moments.PrincipalAxes[0][2]
+        << ") does not match expected axis (" << expectedFirstAxis[0] << ", " << expectedFirstAxis[1] << ", " << expectedFirstAxis[2] << ")" << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLRTPlanNodeTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkMRMLScene> mrmlScene;
+
+  // Box shaped target of 10x4x2 voxels with 1x1x2 mm spacing, elongated along the first axis
+  vtkNew<vtkOrientedImageData> labelmap;
+  labelmap->SetExtent(0, 19, 0, 9, 0, 4);
+  labelmap->SetSpacing(1.0, 1.0, 2.0);
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  unsigned char* voxels = static_cast<unsigned char*>(labelmap->GetScalarPointer());
+  for (int k = 0; k <= 4; ++k)
+  {
+    for (int j = 0; j <= 9; ++j)
+    {
+      for (int i = 0; i <= 19; ++i)
+      {
+        bool inside = (i >= 2 && i <= 11 && j >= 2 && j <= 5 && k >= 1 && k <= 2);
+        voxels[(k * 10 + j) * 20 + i] = (inside ? 1 : 0);
+      }
+    }
+  }
+
+  vtkSmartPointer<vtkMRMLSegmentationNode> segmentationNode = vtkSmartPointer<vtkMRMLSegmentationNode>::New();
+  mrmlScene->AddNode(segmentationNode);
+  std::string targetSegmentID = segmentationNode->AddSegmentFromBinaryLabelmapRepresentation(labelmap, "Target");
+
+  vtkSmartPointer<vtkMRMLRTPlanNode> planNode = vtkSmartPointer<vtkMRMLRTPlanNode>::New();
+  mrmlScene->AddNode(planNode);
+  planNode->SetAndObserveSegmentationNode(segmentationNode);
+  planNode->SetTargetSegmentID(targetSegmentID.c_str());
+
+  // Untransformed target
+  const double expectedVolume = 160.0;
+  double expectedCentroid[3] = { 6.5, 3.5, 3.0 };
+  double expectedFirstAxis[3] = { 1.0, 0.0, 0.0 };
+  if (!AreMomentsEqualTo(planNode, expectedCentroid, expectedVolume, expectedFirstAxis))
+  {
+    std::cerr << __LINE__ << ": Moments of untransformed target do not match baseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Create two transforms before using them. The translation is created first, so that switching
+  // to it from the rotation does not increase the transform modified time
+  vtkSmartPointer<vtkMRMLLinearTransformNode> translationTransformNode = vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
+  mrmlScene->AddNode(translationTransformNode);
+  vtkNew<vtkMatrix4x4> translationMatrix;
+  translationMatrix->SetElement(0, 3, -5.0);
+  translationTransformNode->SetMatrixTransformToParent(translationMatrix);
+
+  vtkSmartPointer<vtkMRMLLinearTransformNode> rotationTransformNode = vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
+  mrmlScene->AddNode(rotationTransformNode);
+  vtkNew<vtkMatrix4x4> rotationMatrix; // 90 degrees around the third axis, then translation
+  rotationMatrix->SetElement(0, 0, 0.0);
+  rotationMatrix->SetElement(0, 1, -1.0);
+  rotationMatrix->SetElement(1, 0, 1.0);
+  rotationMatrix->SetElement(1, 1, 0.0);
+  rotationMatrix->SetElement(0, 3, 10.0);
+  rotationMatrix->SetElement(1, 3, 20.0);
+  rotationMatrix->SetElement(2, 3, 30.0);
+  rotationTransformNode->SetMatrixTransformToParent(rotationMatrix);
+
+  // Rotated and translated target
+  segmentationNode->SetAndObserveTransformNodeID(rotationTransformNode->GetID());
+  double rotatedCentroid[3] = { 10.0 - 3.5, 20.0 + 6.5, 30.0 + 3.0 };
+  double rotatedFirstAxis[3] = { 0.0, 1.0, 0.0 };
+  if (!AreMomentsEqualTo(planNode, rotatedCentroid, expectedVolume, rotatedFirstAxis))
+  {
+    std::cerr << __LINE__ << ": Moments of rotated target do not match baseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Switch to the older, unmodified transform
+  segmentationNode->SetAndObserveTransformNodeID(translationTransformNode->GetID());
+  double translatedCentroid[3] = { 6.5 - 5.0, 3.5, 3.0 };
+  if (!AreMomentsEqualTo(planNode, translatedCentroid, expectedVolume, expectedFirstAxis))
+  {
+    std::cerr << __LINE__ << ": Moments of translated target do not match baseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Remove transform
+  segmentationNode->SetAndObserveTransformNodeID(nullptr);
+  if (!AreMomentsEqualTo(planNode, expectedCentroid, expectedVolume, expectedFirstAxis))
+  {
+    std::cerr << __LINE__ << ": Moments of target after removing the transform do not match baseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Plan node target moments test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Beams includes
+#include "vtkMRMLRTBeamNode.h"
+#include "vtkRTBeamControlPointStore.h"
+
+// MRML includes
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  bool AreEqualWithTolerance(double a, double b)
+  {
+    return std::fabs(a - b) < 1e-4;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Check bounds of a beam model against expected field bounds in the isocenter plane
+  bool AreBeamBoundsEqualTo(vtkPolyData* beamPolyData, double sad, double x1, double x2, double y1, double y2)
+  {
+    double bounds[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    beamPolyData->GetBounds(bounds);
+    // The field is projected to twice the source-axis distance
+    double expectedBounds[6] = { 2.0 * x1, 2.0 * x2, 2.0 * y1, 2.0 * y2, -sad, sad };
+    for (int i = 0; i < 6; ++i)
+    {
+      if (!AreEqualWithTolerance(bounds[i], expectedBounds[i]))
+      {
+        std::cerr << "Beam model bounds (" << bounds[0] << ", " << bounds[1] << ", " << bounds[2] << ", " << bounds[3]
+          << ", " << bounds[4] << ", " << bounds[5] << ") do not match expected bounds (" << expectedBounds[0] << ", "
+          << expectedBounds[1] << ", " << expectedBounds[2] << ", " << expectedBounds[3] << ", " << expectedBounds[4]
+          << ", " << expectedBounds[5] << ")" << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkRTBeamControlPointStoreTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  const int numberOfLeafPairs = 4;
+  const double sad = 1000.0;
+
+  // Clockwise arc from 0 to 180 degrees. The MLCX aperture closes from +/-10 to +/-30 mm in the first segment
+  vtkSmartPointer<vtkRTBeamControlPointStore> store = vtkSmartPointer<vtkRTBeamControlPointStore>::New();
+  store->Allocate(3, numberOfLeafPairs);
+  store->SetMLCType(vtkRTBeamControlPointStore::MLCX);
+  double boundaries[numberOfLeafPairs + 1] = { -20.0, -10.0, 0.0, 10.0, 20.0 };
+  store->SetLeafBoundaries(boundaries);
+  double jaws0[4] = { -50.0, 50.0, -50.0, 50.0 };
+  double leaves0[2 * numberOfLeafPairs] = { -10.0, -10.0, -10.0, -10.0, 10.0, 10.0, 10.0, 10.0 };
+  store->SetControlPoint(0, 0.0, 0.0, 0.0, jaws0, leaves0);
+  double jaws1[4] = { -30.0, 30.0, -50.0, 50.0 };
+  double leaves1[2 * numberOfLeafPairs] = { -30.0, -30.0, -30.0, -30.0, 30.0, 30.0, 30.0, 30.0 };
+  store->SetControlPoint(1, 90.0, 0.0, 0.0, jaws1, leaves1);
+  store->SetControlPoint(2, 180.0, 0.0, 0.0, jaws1, leaves1);
+
+  // Halfway in the first segment
+  double jaws[4] = { 0.0, 0.0, 0.0, 0.0 };
+  std::vector<double> leafPositions;
+  if (!store->InterpolateAtGantryAngle(45.0, jaws, leafPositions))
+  {
+    std::cerr << __LINE__ << ": Gantry angle 45 is not found in the arc" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ( !AreEqualWithTolerance(jaws[0], -40.0) || !AreEqualWithTolerance(jaws[1], 40.0)
+    || !AreEqualWithTolerance(jaws[2], -50.0) || !AreEqualWithTolerance(jaws[3], 50.0) )
+  {
+    std::cerr << __LINE__ << ": Interpolated jaw positions (" << jaws[0] << ", " << jaws[1] << ", " << jaws[2] << ", " << jaws[3]
+      << ") do not match expected positions (-40, 40, -50, 50)" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (leafPositions.size() != 2 * numberOfLeafPairs)
+  {
+    std::cerr << __LINE__ << ": Number of interpolated leaf positions " << leafPositions.size() << " does not match expected value " << 2 * numberOfLeafPairs << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (int leaf = 0; leaf < numberOfLeafPairs; ++leaf)
+  {
+    if (!AreEqualWithTolerance(leafPositions[leaf], -20.0) || !AreEqualWithTolerance(leafPositions[leaf + numberOfLeafPairs], 20.0))
+    {
+      std::cerr << __LINE__ << ": Interpolated positions of leaf pair " << leaf << " (" << leafPositions[leaf] << ", "
+        << leafPositions[leaf + numberOfLeafPairs] << ") do not match expected positions (-20, 20)" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Angle outside the arc
+  if (store->InterpolateAtGantryAngle(270.0, jaws, leafPositions))
+  {
+    std::cerr << __LINE__ << ": Gantry angle 270 should not be covered by the arc" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Beam model at the interpolated control point: the leaves limit the field in X, the leaf boundaries in Y
+  vtkNew<vtkPolyData> beamPolyData;
+  if ( !store->CreateBeamPolyDataAtGantryAngle(45.0, sad, beamPolyData)
+    || !AreBeamBoundsEqualTo(beamPolyData, sad, -20.0, 20.0, -20.0, 20.0) )
+  {
+    std::cerr << __LINE__ << ": Interpolated beam model does not match baseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Counter-clockwise arc crossing 0 degrees
+  vtkSmartPointer<vtkRTBeamControlPointStore> counterClockwiseStore = vtkSmartPointer<vtkRTBeamControlPointStore>::New();
+  counterClockwiseStore->Allocate(2, 0);
+  counterClockwiseStore->SetControlPoint(0, 10.0, 0.0, 0.0, jaws0);
+  counterClockwiseStore->SetControlPoint(1, 350.0, 0.0, 0.0, jaws1);
+  if ( !counterClockwiseStore->InterpolateAtGantryAngle(0.0, jaws, leafPositions)
+    || !AreEqualWithTolerance(jaws[0], -40.0) || !leafPositions.empty() )
+  {
+    std::cerr << __LINE__ << ": Interpolation in counter-clockwise arc does not match baseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Beam node builds its model from the control points, using its own jaws
+  vtkNew<vtkMRMLScene> mrmlScene;
+  vtkSmartPointer<vtkMRMLRTBeamNode> beamNode = vtkSmartPointer<vtkMRMLRTBeamNode>::New();
+  mrmlScene->AddNode(beamNode);
+  beamNode->SetSAD(sad);
+  beamNode->SetX1Jaw(-15.0);
+  beamNode->SetX2Jaw(50.0);
+  beamNode->SetY1Jaw(-50.0);
+  beamNode->SetY2Jaw(50.0);
+  beamNode->SetGantryAngle(45.0);
+  beamNode->SetControlPointStore(store);
+  beamNode->UpdateGeometry();
+  if (!AreBeamBoundsEqualTo(beamNode->GetPolyData(), sad, -15.0, 20.0, -20.0, 20.0))
+  {
+    std::cerr << __LINE__ << ": Beam node model does not match interpolated control point geometry" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Copied beam has its own copy of the control points
+  vtkSmartPointer<vtkMRMLRTBeamNode> copiedBeamNode = vtkSmartPointer<vtkMRMLRTBeamNode>::New();
+  copiedBeamNode->Copy(beamNode);
+  vtkRTBeamControlPointStore* copiedStore = copiedBeamNode->GetControlPointStore();
+  if ( !copiedStore || copiedStore == store || copiedStore->GetNumberOfControlPoints() != 3
+    || copiedStore->GetNumberOfLeafPairs() != numberOfLeafPairs || !AreEqualWithTolerance(copiedStore->GetGantryAngle(1), 90.0) )
+  {
+    std::cerr << __LINE__ << ": Control points of the copied beam are not a separate copy of the original" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Beam control point store test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
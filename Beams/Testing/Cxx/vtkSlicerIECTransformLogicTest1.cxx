@@ -22,6 +22,7 @@
 #include "vtkMRMLRTBeamNode.h"
 #include "vtkMRMLRTPlanNode.h"
 #include "vtkSlicerIECTransformLogic.h"
+#include "vtkIECKinematicChain.h"
 #include "vtkSlicerBeamsModuleLogic.h"
 
 // MRML includes
@@ -32,6 +33,7 @@
 #include <vtkNew.h>
 #include <vtkTransform.h>
 #include <vtkMatrix4x4.h>
+#include <vtkGeneralTransform.h>
 
 
 //----------------------------------------------------------------------------
@@ -258,6 +260,53 @@ int vtkSlicerIECTransformLogicTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)
     return EXIT_FAILURE;
     }
 
+  // Kinematic chain, analytic transform between frames
+  vtkIECKinematicChain* kinematicChain = iecLogic->GetKinematicChain();
+  vtkNew<vtkMatrix4x4> chainCollimatorToRasMatrix;
+  kinematicChain->GetTransformBetween(vtkIECKinematicChain::Collimator, vtkIECKinematicChain::RAS, chainCollimatorToRasMatrix);
+  vtkNew<vtkMatrix4x4> expectedBeamTransform_Collimator90_Matrix;
+  expectedBeamTransform_Collimator90_Matrix->DeepCopy(expectedBeamTransform_Collimator90_MatrixElements);
+  if (!IsEqual(chainCollimatorToRasMatrix, expectedBeamTransform_Collimator90_Matrix))
+    {
+    std::cerr << __LINE__ << ": Kinematic chain collimator to RAS transform does not match baseline" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Kinematic chain, same transform computed in batch mode
+  std::vector<vtkIECKinematicChain::Pose> poses(3);
+  for (vtkIECKinematicChain::Pose& pose : poses)
+    {
+    kinematicChain->GetPose(pose);
+    }
+  poses[1].GantryAngle = 1.0;
+  std::vector<double> batchMatrices;
+  kinematicChain->GetTransformsBetweenForPoses(vtkIECKinematicChain::Collimator, vtkIECKinematicChain::RAS, poses, batchMatrices);
+  if (batchMatrices.size() != 48)
+    {
+    std::cerr << __LINE__ << ": Kinematic chain batch transform count " << batchMatrices.size() / 16 << " does not match number of poses" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkNew<vtkMatrix4x4> batchCollimatorToRasMatrix;
+  batchCollimatorToRasMatrix->DeepCopy(&batchMatrices[32]);
+  if (!IsEqual(batchCollimatorToRasMatrix, expectedBeamTransform_Collimator90_Matrix))
+    {
+    std::cerr << __LINE__ << ": Kinematic chain batch transform does not match baseline" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Dynamic transform between frames using the transform nodes
+  vtkNew<vtkGeneralTransform> gantryToCollimatorTransform;
+  vtkNew<vtkMatrix4x4> chainGantryToCollimatorMatrix;
+  kinematicChain->GetTransformBetween(vtkIECKinematicChain::Gantry, vtkIECKinematicChain::Collimator, chainGantryToCollimatorMatrix);
+  vtkNew<vtkTransform> gantryToCollimatorLinearTransform;
+  if ( !iecLogic->GetTransformBetween(vtkSlicerIECTransformLogic::Gantry, vtkSlicerIECTransformLogic::Collimator, gantryToCollimatorTransform)
+    || !vtkMRMLTransformNode::IsGeneralTransformLinear(gantryToCollimatorTransform, gantryToCollimatorLinearTransform)
+    || !IsEqual(gantryToCollimatorLinearTransform->GetMatrix(), chainGantryToCollimatorMatrix) )
+    {
+    std::cerr << __LINE__ << ": Gantry to collimator transform does not match kinematic chain" << std::endl;
+    return EXIT_FAILURE;
+    }
+
   //TODO: Test code to print all non-identity transforms (useful to add more test cases)
   //std::cout << "ZZZ after collimator angle 90:" << std::endl;
   //PrintLinearTransformNodeMatrices(mrmlScene, false, true);
@@ -120,6 +120,9 @@ void qMRMLBeamParametersTabWidget::setBeamNode(vtkMRMLNode* node)
   // Connect display modified event to population of the table
   qvtkReconnect( d->BeamNode, beamNode, vtkCommand::ModifiedEvent,
                  this, SLOT( updateWidgetFromMRML() ) );
+  // Dose engine parameter setters only invoke the custom event
+  qvtkReconnect( d->BeamNode, beamNode, vtkMRMLRTBeamNode::DoseEngineParameterModified,
+                 this, SLOT( updateWidgetFromMRML() ) );
 
   d->BeamNode = beamNode;
   this->updateWidgetFromMRML();
@@ -182,9 +185,13 @@ void qMRMLBeamParametersTabWidget::updateWidgetFromMRML()
         QCheckBox* checkBox = qobject_cast<QCheckBox*>(currentParameterFieldWidget);
         if (lineEdit)
         {
-          lineEdit->blockSignals(true);
-          lineEdit->setText(parameterValue);
-          lineEdit->blockSignals(false);
+          // Only set if different so that the cursor does not jump while the user is typing
+          if (lineEdit->text() != parameterValue)
+          {
+            lineEdit->blockSignals(true);
+            lineEdit->setText(parameterValue);
+            lineEdit->blockSignals(false);
+          }
         }
         else if (slider)
         {
@@ -451,12 +458,8 @@ void qMRMLBeamParametersTabWidget::doubleBeamParameterChanged(double newValue)
   // Get attribute name that belongs to the widget in which the value was changed
   QString attributeName = this->sender()->property(BEAM_PARAMETER_NODE_ATTRIBUTE_PROPERTY).toString();
 
-  // Set parameter as attribute in beam node
-  d->BeamNode->DisableModifiedEventOn();
-  d->BeamNode->SetAttribute(
-    attributeName.toLatin1().constData(),
-    QString::number(newValue).toLatin1().constData() );
-  d->BeamNode->DisableModifiedEventOff();
+  // Set parameter in beam node (also stored as attribute)
+  d->BeamNode->SetDoseEngineDoubleParameter(attributeName.toStdString(), newValue);
 }
 
 //-----------------------------------------------------------------------------
@@ -472,12 +475,8 @@ void qMRMLBeamParametersTabWidget::integerBeamParameterChanged(int newValue)
   // Get attribute name that belongs to the widget in which the value was changed
   QString attributeName = this->sender()->property(BEAM_PARAMETER_NODE_ATTRIBUTE_PROPERTY).toString();
 
-  // Set parameter as attribute in beam node
-  d->BeamNode->DisableModifiedEventOn();
-  d->BeamNode->SetAttribute(
-    attributeName.toLatin1().constData(),
-    QString::number(newValue).toLatin1().constData() );
-  d->BeamNode->DisableModifiedEventOff();
+  // Set parameter in beam node (also stored as attribute)
+  d->BeamNode->SetDoseEngineIntegerParameter(attributeName.toStdString(), newValue);
 }
 
 //-----------------------------------------------------------------------------
@@ -493,12 +492,8 @@ void qMRMLBeamParametersTabWidget::booleanBeamParameterChanged(int newValue)
   // Get attribute name that belongs to the widget in which the value was changed
   QString attributeName = this->sender()->property(BEAM_PARAMETER_NODE_ATTRIBUTE_PROPERTY).toString();
 
-  // Set parameter as attribute in beam node
-  d->BeamNode->DisableModifiedEventOn();
-  d->BeamNode->SetAttribute(
-    attributeName.toLatin1().constData(),
-    QVariant(newValue != 0).toString().toLatin1().constData() );
-  d->BeamNode->DisableModifiedEventOff();
+  // Set parameter in beam node (also stored as attribute)
+  d->BeamNode->SetDoseEngineBooleanParameter(attributeName.toStdString(), newValue != 0);
 
   // Enable/disable dependent parameters
   this->updateDependentParameterWidgetsForCheckbox( qobject_cast<QCheckBox*>(this->sender()) );
@@ -517,12 +512,8 @@ void qMRMLBeamParametersTabWidget::stringBeamParameterChanged(QString newValue)
   // Get attribute name that belongs to the widget in which the value was changed
   QString attributeName = this->sender()->property(BEAM_PARAMETER_NODE_ATTRIBUTE_PROPERTY).toString();
 
-  // Set parameter as attribute in beam node
-  d->BeamNode->DisableModifiedEventOn();
-  d->BeamNode->SetAttribute(
-    attributeName.toLatin1().constData(),
-    newValue.toLatin1().constData() );
-  d->BeamNode->DisableModifiedEventOff();
+  // Set parameter in beam node (also stored as attribute)
+  d->BeamNode->SetDoseEngineStringParameter(attributeName.toStdString(), newValue.toStdString());
 }
 
 //-----------------------------------------------------------------------------
@@ -802,7 +793,6 @@ void qMRMLBeamParametersTabWidget::updateDRRClicked()
     return;
   }
 
-  //TODO: Fix DRR code (it is in EBP logic and it is commented out)
-  //d->logic()->UpdateDRR(beamNode->GetName());
-  qCritical() << Q_FUNC_INFO << ": Not implemented!";
+  // DRR is computed by the External Beam Planning module logic, which the Beams module cannot access
+  qCritical() << Q_FUNC_INFO << ": Not implemented! Use Calculate DRR in the External Beam Planning module";
 }
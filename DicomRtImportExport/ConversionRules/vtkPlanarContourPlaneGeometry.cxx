@@ -0,0 +1,318 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// DicomRtImportExport includes
+#include "vtkPlanarContourPlaneGeometry.h"
+
+// SlicerRt includes
+#include "vtkSlicerRtCommon.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkInformation.h>
+#include <vtkInformationObjectBaseKey.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkPlanarContourPlaneGeometry);
+vtkInformationKeyMacro(vtkPlanarContourPlaneGeometry, CONTOUR_PLANE_GEOMETRY, ObjectBase);
+
+//----------------------------------------------------------------------------
+vtkPlanarContourPlaneGeometry::vtkPlanarContourPlaneGeometry()
+{
+  this->ReferenceNormal[0] = 0.0;
+  this->ReferenceNormal[1] = 0.0;
+  this->ReferenceNormal[2] = 1.0;
+  this->ReferenceOrigin[0] = 0.0;
+  this->ReferenceOrigin[1] = 0.0;
+  this->ReferenceOrigin[2] = 0.0;
+  this->PlaneSpacingMode = -1.0;
+  this->ConsistentPlaneSpacing = true;
+  this->ContourPlanesParallel = true;
+}
+
+//----------------------------------------------------------------------------
+vtkPlanarContourPlaneGeometry::~vtkPlanarContourPlaneGeometry() = default;
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourPlaneGeometry::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfContours: " << this->Contours.size() << "\n";
+  os << indent << "ReferenceNormal: (" << this->ReferenceNormal[0] << ", " << this->ReferenceNormal[1] << ", " << this->ReferenceNormal[2] << ")\n";
+  os << indent << "ReferenceOrigin: (" << this->ReferenceOrigin[0] << ", " << this->ReferenceOrigin[1] << ", " << this->ReferenceOrigin[2] << ")\n";
+  os << indent << "NumberOfPlanePositions: " << this->OrderedPlanePositions.size() << "\n";
+  os << indent << "PlaneSpacingMode: " << this->PlaneSpacingMode << "\n";
+  os << indent << "ConsistentPlaneSpacing: " << (this->ConsistentPlaneSpacing ? "true" : "false") << "\n";
+  os << indent << "ContourPlanesParallel: " << (this->ContourPlanesParallel ? "true" : "false") << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkPlanarContourPlaneGeometry* vtkPlanarContourPlaneGeometry::GetContourPlaneGeometry(vtkPolyData* planarContours)
+{
+  if (!planarContours)
+  {
+    return nullptr;
+  }
+
+  vtkInformation* information = planarContours->GetInformation();
+  vtkPlanarContourPlaneGeometry* geometry = vtkPlanarContourPlaneGeometry::SafeDownCast(information->Get(CONTOUR_PLANE_GEOMETRY()));
+  if (!geometry)
+  {
+    vtkSmartPointer<vtkPlanarContourPlaneGeometry> newGeometry = vtkSmartPointer<vtkPlanarContourPlaneGeometry>::New();
+    information->Set(CONTOUR_PLANE_GEOMETRY(), newGeometry);
+    geometry = newGeometry;
+  }
+  if (geometry->GetComputeTime() < planarContours->GetMTime())
+  {
+    geometry->Compute(planarContours);
+  }
+  return geometry;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourPlaneGeometry::Compute(vtkPolyData* planarContours)
+{
+  this->Contours.clear();
+  this->OrderedPlanePositions.clear();
+  this->PlaneSpacingValues.clear();
+  this->ContourSpacingValues.clear();
+  this->PlaneSpacingMode = -1.0;
+  this->ConsistentPlaneSpacing = true;
+  this->ContourPlanesParallel = true;
+
+  vtkPoints* points = (planarContours ? planarContours->GetPoints() : nullptr);
+  vtkCellArray* lines = (planarContours ? planarContours->GetLines() : nullptr);
+  if (!points || !lines)
+  {
+    this->ComputeTime.Modified();
+    return;
+  }
+
+  // Compute the normal (using Newell's method), first point, centroid and size of each contour in one traversal
+  vtkSmartPointer<vtkIdList> contourPointIds = vtkSmartPointer<vtkIdList>::New();
+  this->Contours.reserve(lines->GetNumberOfCells());
+  lines->InitTraversal();
+  while (lines->GetNextCell(contourPointIds))
+  {
+    ContourGeometry contour;
+    contour.Valid = false;
+    contour.NumberOfPointIds = 0;
+    contour.NumberOfPoints = 0;
+    contour.Normal[0] = contour.Normal[1] = contour.Normal[2] = 0.0;
+    contour.Origin[0] = contour.Origin[1] = contour.Origin[2] = 0.0;
+    contour.Centroid[0] = contour.Centroid[1] = contour.Centroid[2] = 0.0;
+
+    vtkIdType numberOfIds = contourPointIds->GetNumberOfIds();
+    contour.NumberOfPointIds = numberOfIds;
+    if (numberOfIds > 0)
+    {
+      bool closed = (numberOfIds > 1 && contourPointIds->GetId(0) == contourPointIds->GetId(numberOfIds - 1));
+      contour.NumberOfPoints = (closed ? numberOfIds - 1 : numberOfIds);
+
+      points->GetPoint(contourPointIds->GetId(0), contour.Origin);
+      double previousPoint[3] = { contour.Origin[0], contour.Origin[1], contour.Origin[2] };
+      for (vtkIdType pointIndex = 0; pointIndex < contour.NumberOfPoints; ++pointIndex)
+      {
+        double point[3] = { 0.0, 0.0, 0.0 };
+        points->GetPoint(contourPointIds->GetId((pointIndex + 1) % contour.NumberOfPoints), point);
+        contour.Normal[0] += (previousPoint[1] - point[1]) * (previousPoint[2] + point[2]);
+        contour.Normal[1] += (previousPoint[2] - point[2]) * (previousPoint[0] + point[0]);
+        contour.Normal[2] += (previousPoint[0] - point[0]) * (previousPoint[1] + point[1]);
+        vtkMath::Add(contour.Centroid, previousPoint, contour.Centroid);
+        std::copy(point, point + 3, previousPoint);
+      }
+      vtkMath::MultiplyScalar(contour.Centroid, 1.0 / contour.NumberOfPoints);
+
+      if (contour.NumberOfPoints >= 3 && vtkMath::Normalize(contour.Normal) > 0.0)
+      {
+        // Make the orientation of the normal independent of the winding of the contour
+        int largestComponent = 0;
+        for (int axis = 1; axis < 3; ++axis)
+        {
+          if (std::abs(contour.Normal[axis]) > std::abs(contour.Normal[largestComponent]))
+          {
+            largestComponent = axis;
+          }
+        }
+        if (contour.Normal[largestComponent] < 0.0)
+        {
+          vtkMath::MultiplyScalar(contour.Normal, -1.0);
+        }
+        contour.Valid = true;
+      }
+    }
+    this->Contours.push_back(contour);
+  }
+
+  // Measure plane positions along the normal of the first valid contour
+  bool referenceFound = false;
+  for (const ContourGeometry& contour : this->Contours)
+  {
+    if (!contour.Valid)
+    {
+      continue;
+    }
+    if (!referenceFound)
+    {
+      std::copy(contour.Normal, contour.Normal + 3, this->ReferenceNormal);
+      std::copy(contour.Origin, contour.Origin + 3, this->ReferenceOrigin);
+      referenceFound = true;
+    }
+    else if (std::abs(std::abs(vtkMath::Dot(contour.Normal, this->ReferenceNormal)) - 1.0) >= EPSILON)
+    {
+      this->ContourPlanesParallel = false;
+    }
+    double originToCentroid[3] = { 0.0, 0.0, 0.0 };
+    vtkMath::Subtract(contour.Centroid, this->ReferenceOrigin, originToCentroid);
+    this->OrderedPlanePositions.push_back(vtkMath::Dot(originToCentroid, this->ReferenceNormal));
+  }
+  std::sort(this->OrderedPlanePositions.begin(), this->OrderedPlanePositions.end());
+
+  // Distances between all adjacent contours that are lines, whether or not a plane could be fitted on them
+  std::vector<double> contourPositions;
+  for (const ContourGeometry& contour : this->Contours)
+  {
+    if (contour.NumberOfPointIds < 2)
+    {
+      continue;
+    }
+    double originToCentroid[3] = { 0.0, 0.0, 0.0 };
+    vtkMath::Subtract(contour.Centroid, this->ReferenceOrigin, originToCentroid);
+    contourPositions.push_back(vtkMath::Dot(originToCentroid, this->ReferenceNormal));
+  }
+  std::sort(contourPositions.begin(), contourPositions.end());
+  for (size_t contourIndex = 1; contourIndex < contourPositions.size(); ++contourIndex)
+  {
+    this->ContourSpacingValues.push_back(contourPositions[contourIndex] - contourPositions[contourIndex - 1]);
+  }
+
+  // Distances between adjacent distinct planes, and the most frequent distance
+  // (distances within tolerance are considered the same)
+  std::map<double, int> spacingValueFrequencies;
+  for (size_t planeIndex = 1; planeIndex < this->OrderedPlanePositions.size(); ++planeIndex)
+  {
+    double spacing = this->OrderedPlanePositions[planeIndex] - this->OrderedPlanePositions[planeIndex - 1];
+    if (spacing < EPSILON)
+    {
+      // Multiple contours may be drawn on the same plane
+      continue;
+    }
+    if (!this->PlaneSpacingValues.empty() && std::abs(spacing - this->PlaneSpacingValues.front()) >= EPSILON)
+    {
+      this->ConsistentPlaneSpacing = false;
+    }
+    this->PlaneSpacingValues.push_back(spacing);
+    spacingValueFrequencies[vtkMath::Round(spacing / EPSILON) * EPSILON]++;
+  }
+  if (this->ConsistentPlaneSpacing)
+  {
+    this->PlaneSpacingMode = (this->PlaneSpacingValues.empty() ? -1.0 : this->PlaneSpacingValues.front());
+  }
+  else
+  {
+    int majorityCount = -1;
+    for (std::map<double, int>::iterator frequencyIt = spacingValueFrequencies.begin(); frequencyIt != spacingValueFrequencies.end(); ++frequencyIt)
+    {
+      if (frequencyIt->second > majorityCount)
+      {
+        this->PlaneSpacingMode = frequencyIt->first;
+        majorityCount = frequencyIt->second;
+      }
+    }
+  }
+
+  this->ComputeTime.Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlanarContourPlaneGeometry::IsContourPlaneValid(int contourIndex)
+{
+  if (contourIndex < 0 || contourIndex >= this->GetNumberOfContours())
+  {
+    vtkErrorMacro("IsContourPlaneValid: Invalid contour index " << contourIndex);
+    return false;
+  }
+  return this->Contours[contourIndex].Valid;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkPlanarContourPlaneGeometry::GetNumberOfContourPoints(int contourIndex)
+{
+  if (contourIndex < 0 || contourIndex >= this->GetNumberOfContours())
+  {
+    vtkErrorMacro("GetNumberOfContourPoints: Invalid contour index " << contourIndex);
+    return 0;
+  }
+  return this->Contours[contourIndex].NumberOfPoints;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourPlaneGeometry::GetContourNormal(int contourIndex, double normal[3])
+{
+  if (contourIndex < 0 || contourIndex >= this->GetNumberOfContours())
+  {
+    vtkErrorMacro("GetContourNormal: Invalid contour index " << contourIndex);
+    return;
+  }
+  std::copy(this->Contours[contourIndex].Normal, this->Contours[contourIndex].Normal + 3, normal);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlanarContourPlaneGeometry::GetContourOrigin(int contourIndex, double origin[3])
+{
+  if (contourIndex < 0 || contourIndex >= this->GetNumberOfContours())
+  {
+    vtkErrorMacro("GetContourOrigin: Invalid contour index " << contourIndex);
+    return;
+  }
+  std::copy(this->Contours[contourIndex].Origin, this->Contours[contourIndex].Origin + 3, origin);
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlanarContourPlaneGeometry::GetAverageContourNormal(int minimumContourSize, double normal[3])
+{
+  double normalSum[3] = { 0.0, 0.0, 0.0 };
+  int numberOfAveragedContours = 0;
+  for (const ContourGeometry& contour : this->Contours)
+  {
+    if (contour.Valid && contour.NumberOfPoints > minimumContourSize)
+    {
+      vtkMath::Add(normalSum, contour.Normal, normalSum);
+      ++numberOfAveragedContours;
+    }
+  }
+  if (numberOfAveragedContours == 0 || vtkMath::Normalize(normalSum) == 0.0)
+  {
+    return false;
+  }
+  std::copy(normalSum, normalSum + 3, normal);
+  return true;
+}
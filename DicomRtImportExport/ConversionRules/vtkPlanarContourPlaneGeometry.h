@@ -0,0 +1,147 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// .NAME vtkPlanarContourPlaneGeometry - Cached plane geometry of planar contours
+// .SECTION Description
+
+#ifndef __vtkPlanarContourPlaneGeometry_h
+#define __vtkPlanarContourPlaneGeometry_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkTimeStamp.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerDicomRtImportExportConversionRulesExport.h"
+
+class vtkInformationObjectBaseKey;
+class vtkPolyData;
+
+/// \ingroup DicomRtImportImportExportConversionRules
+/// \brief Plane geometry of a planar contour representation: contour normals, ordered plane positions
+///   and plane spacing, computed in a single pass over the contours.
+///
+/// The geometry is attached to the information of the contour poly data by \sa GetContourPlaneGeometry,
+/// and is only recomputed when the poly data is modified, so the conversion rules can share it
+/// instead of each analyzing all contours again.
+class VTK_SLICER_DICOMRTIMPORTEXPORT_CONVERSIONRULES_EXPORT vtkPlanarContourPlaneGeometry : public vtkObject
+{
+public:
+  static vtkPlanarContourPlaneGeometry* New();
+  vtkTypeMacro(vtkPlanarContourPlaneGeometry, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Key used to attach the geometry to the information of the contour poly data
+  static vtkInformationObjectBaseKey* CONTOUR_PLANE_GEOMETRY();
+
+  /// Get the plane geometry of planar contours. The geometry is computed on first access and stored
+  /// in the information of the poly data. It is recomputed only if the poly data has been modified since.
+  /// \return Plane geometry of the contours, nullptr if the poly data is invalid
+  static vtkPlanarContourPlaneGeometry* GetContourPlaneGeometry(vtkPolyData* planarContours);
+
+  /// Compute the geometry of the lines in the given poly data
+  void Compute(vtkPolyData* planarContours);
+
+  /// Get time of the last computation
+  vtkMTimeType GetComputeTime() { return this->ComputeTime.GetMTime(); };
+
+  /// Get number of contours (lines)
+  int GetNumberOfContours() { return static_cast<int>(this->Contours.size()); };
+
+  /// Determine if a plane could be computed for a contour (it has at least three non-collinear points)
+  bool IsContourPlaneValid(int contourIndex);
+
+  /// Get number of distinct points of a contour (the closing point is not counted twice)
+  vtkIdType GetNumberOfContourPoints(int contourIndex);
+
+  /// Get unit normal of a contour plane. The largest component of the normal is positive.
+  void GetContourNormal(int contourIndex, double normal[3]);
+
+  /// Get the first point of a contour
+  void GetContourOrigin(int contourIndex, double origin[3]);
+
+  /// Get the average normal of the contours with more than the given number of points
+  /// \param minimumContourSize Contours with at most this many points are ignored
+  /// \param normal Output normalized average normal. Not changed if there is no contour with valid plane.
+  /// \return True if there was at least one contour to average
+  bool GetAverageContourNormal(int minimumContourSize, double normal[3]);
+
+  /// Get normal of the first contour with a valid plane, along which the plane positions are measured
+  vtkGetVector3Macro(ReferenceNormal, double);
+  /// Get origin of the first contour with a valid plane
+  vtkGetVector3Macro(ReferenceOrigin, double);
+
+  /// Get signed positions of the contour planes along the reference normal, relative to the reference origin.
+  /// One value for each contour with a valid plane, in ascending order.
+  const std::vector<double>& GetOrderedPlanePositions() { return this->OrderedPlanePositions; };
+
+  /// Get distances between adjacent distinct contour planes, in plane order.
+  /// Contours on the same plane (within tolerance) do not add a spacing value.
+  const std::vector<double>& GetPlaneSpacingValues() { return this->PlaneSpacingValues; };
+
+  /// Get distances between adjacent contours ordered by their position along the reference normal.
+  /// Unlike \sa GetPlaneSpacingValues, all contours with at least two point IDs are included (also the ones
+  /// without a valid plane), and contours on the same plane add a zero distance.
+  const std::vector<double>& GetContourSpacingValues() { return this->ContourSpacingValues; };
+
+  /// Get the most frequent distance between adjacent contour planes. -1 if there are less than two distinct planes.
+  vtkGetMacro(PlaneSpacingMode, double);
+
+  /// Determine if all distances between adjacent contour planes are equal
+  vtkGetMacro(ConsistentPlaneSpacing, bool);
+
+  /// Determine if all contour planes are parallel
+  vtkGetMacro(ContourPlanesParallel, bool);
+
+protected:
+  /// Geometry of one contour
+  struct ContourGeometry
+  {
+    bool Valid;
+    vtkIdType NumberOfPointIds;
+    vtkIdType NumberOfPoints;
+    double Normal[3];
+    double Origin[3];
+    double Centroid[3];
+  };
+
+  std::vector<ContourGeometry> Contours;
+  double ReferenceNormal[3];
+  double ReferenceOrigin[3];
+  std::vector<double> OrderedPlanePositions;
+  std::vector<double> PlaneSpacingValues;
+  std::vector<double> ContourSpacingValues;
+  double PlaneSpacingMode;
+  bool ConsistentPlaneSpacing;
+  bool ContourPlanesParallel;
+  vtkTimeStamp ComputeTime;
+
+protected:
+  vtkPlanarContourPlaneGeometry();
+  ~vtkPlanarContourPlaneGeometry() override;
+
+private:
+  vtkPlanarContourPlaneGeometry(const vtkPlanarContourPlaneGeometry&) = delete;
+  void operator=(const vtkPlanarContourPlaneGeometry&) = delete;
+};
+
+#endif
@@ -19,9 +19,9 @@
 ==============================================================================*/
 
 #include "vtkPlanarContourToClosedSurfaceConversionRule.h"
+#include "vtkPlanarContourPlaneGeometry.h"
 
 // VTK includes
-#include <vtkExtractCells.h>
 #include <vtkImageAccumulate.h>
 #include <vtkImageData.h>
 #include <vtkImageDilateErode3D.h>
@@ -31,14 +31,17 @@
 #include <vtkPolyDataToImageStencil.h>
 #include <vtkPolygon.h>
 #include <vtkPriorityQueue.h>
+#include <vtkSMPTools.h>
+#include <vtkStaticPointLocator.h>
 #include <vtkStripper.h>
-#include <vtkTextureMapToPlane.h>
 #include <vtkTransform.h>
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkUnstructuredGrid.h>
+#include <vtkVariant.h>
 
 // STD includes
 #include <algorithm>
+#include <cmath>
 
 // SegmentationCore includes
 #if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
@@ -78,6 +81,8 @@ vtkPlanarContourToClosedSurfaceConversionRule::vtkPlanarContourToClosedSurfaceCo
 
   this->ConversionParameters[this->GetDefaultSliceThicknessParameterName()] = std::make_pair("0.0",
     "Default thickness for contours if slice spacing cannot be calculated.");
+  this->ConversionParameters[this->GetIncrementalConversionParameterName()] = std::make_pair("0",
+    "Reuse triangulations of unchanged contour plane pairs from the previous conversion of the same contours (1) or triangulate all plane pairs (0).");
 }
 
 //----------------------------------------------------------------------------
@@ -150,6 +155,9 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
     return false;
   }
 
+  // Spacing is computed on the original contours, so that the plane geometry cached on them is used
+  double spacing = this->GetSpacingBetweenLines(planarContoursPolyData);
+
   // Copy the contours so that we can make modifications without affecting the original
   vtkSmartPointer<vtkPolyData> inputContoursCopy = vtkSmartPointer<vtkPolyData>::New();
 
@@ -167,11 +175,8 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
   // Make sure the contours are in the right order.
   this->SortContours(inputContoursCopy);
 
-  // remove keyholes from the lines
-  this->FixKeyholes(inputContoursCopy, 0.001, 3);
-
-  // set all lines to be counter-clockwise
-  this->SetLinesCounterClockwise(inputContoursCopy);
+  // remove keyholes from the lines and set all lines to be counter-clockwise
+  this->FixKeyholesAndSetLinesCounterClockwise(inputContoursCopy, 0.001, 3);
 
   vtkSmartPointer<vtkPoints> outputPoints = inputContoursCopy->GetPoints();
   vtkSmartPointer<vtkCellArray> outputLines = inputContoursCopy->GetLines();
@@ -180,134 +185,230 @@ bool vtkPlanarContourToClosedSurfaceConversionRule::Convert(vtkDataObject* sourc
   // Total number of lines in the contours
   int numberOfLines = inputContoursCopy->GetNumberOfLines();
 
-  double spacing = this->GetSpacingBetweenLines(inputContoursCopy);
-
-  std::vector<vtkSmartPointer<vtkPointLocator> > pointLocators(numberOfLines);
-  std::vector<vtkSmartPointer<vtkIdList> > linePointIdLists(numberOfLines);
-  for (int lineIndex = 0; lineIndex < numberOfLines; ++lineIndex)
+  // Cache contiguous point coordinates and line geometry
+  vtkIdType numberOfPoints = outputPoints->GetNumberOfPoints();
+  std::vector<double> coordinates(3 * numberOfPoints);
+  for (vtkIdType pointId = 0; pointId < numberOfPoints; ++pointId)
   {
-    vtkSmartPointer<vtkLine> currentLine = vtkSmartPointer<vtkLine>::New();
-    currentLine->DeepCopy(inputContoursCopy->GetCell(lineIndex));
-    linePointIdLists[lineIndex] = currentLine->GetPointIds();
-    vtkSmartPointer<vtkPolyData> linePolyData = vtkSmartPointer<vtkPolyData>::New();
-    linePolyData->SetPoints(currentLine->GetPoints());
-    pointLocators[lineIndex] = vtkSmartPointer<vtkPointLocator>::New();
-    pointLocators[lineIndex]->SetDataSet(linePolyData);
-    pointLocators[lineIndex]->BuildLocator();
+    outputPoints->GetPoint(pointId, &coordinates[3 * pointId]);
   }
-
-  // Vector of booleans to determine which lines are triangulated from above and from below.
-  std::vector< bool > lineTriganulatedToAbove(numberOfLines);
-  std::vector< bool > lineTriganulatedToBelow(numberOfLines);
-  for (int i = 0; i < numberOfLines; ++i)
+  std::vector<ContourLineGeometry> lineGeometries(numberOfLines);
+  vtkNew<vtkIdList> linePointIds;
+  outputLines->InitTraversal();
+  for (int lineIndex = 0; lineIndex < numberOfLines && outputLines->GetNextCell(linePointIds); ++lineIndex)
   {
-    lineTriganulatedToAbove[i] = false;
-    lineTriganulatedToBelow[i] = false;
+    this->ComputeContourLineGeometry(coordinates.data(), linePointIds, lineGeometries[lineIndex]);
   }
 
-  // Get two consecutive planes.
-  vtkIdType firstLineOnPlane1Index = 0; // pointer to first line on plane 1.
-  int numberOfLinesInPlane1 = this->GetNumberOfLinesOnPlane(inputContoursCopy, 0, spacing);
-
-  // Loop through all of the contours in the polydata
-  while (firstLineOnPlane1Index + numberOfLinesInPlane1 < numberOfLines)
-  {
-    vtkIdType firstLineOnPlane2Index = firstLineOnPlane1Index + numberOfLinesInPlane1; // pointer to first line on plane 2
-    int numberOfLinesInPlane2 = this->GetNumberOfLinesOnPlane(inputContoursCopy, firstLineOnPlane2Index, spacing); // number of lines on plane 2
-
-    // initialize overlaps lists. - list of list
-    // Each internal list represents a line from the plane and will store the pointers to the overlap lines
+  // Group the lines into planes. Lines are sorted by Z, so each plane is a range of lines.
+  // The last element is the end of the last plane.
+  std::vector<vtkIdType> firstLineOnPlaneIndices;
+  double contourPlaneThreshold = 0.1*spacing;
+  vtkIdType currentLineIndex = 0;
+  while (currentLineIndex < numberOfLines)
+  {
+    firstLineOnPlaneIndices.push_back(currentLineIndex);
+    double planePosition = lineGeometries[currentLineIndex].PlanePosition;
+    ++currentLineIndex;
+    while (currentLineIndex < numberOfLines
+      && std::abs(lineGeometries[currentLineIndex].PlanePosition - planePosition) < contourPlaneThreshold)
+    {
+      ++currentLineIndex;
+    }
+  }
+  firstLineOnPlaneIndices.push_back(numberOfLines);
+  vtkIdType numberOfPlanePairs = std::max<vtkIdType>(static_cast<vtkIdType>(firstLineOnPlaneIndices.size()) - 2, 0);
 
-    // List of Overlaps for lines that overlap with other lines from plane 1 and 2
-    std::vector< std::vector< vtkIdType > > plane1Overlaps(numberOfLinesInPlane1);
-    std::vector< std::vector< vtkIdType > > plane2Overlaps(numberOfLinesInPlane2);
+  // Flags to determine which lines are triangulated from above and from below.
+  // Stored as char so that the plane pairs can set them concurrently.
+  std::vector<char> lineTriangulatedToAboveFlags(numberOfLines, 0);
+  std::vector<char> lineTriangulatedToBelowFlags(numberOfLines, 0);
 
-    // Loop through the lines in the first plane
-    for (int line1Index = 0; line1Index < numberOfLinesInPlane1; ++line1Index)
+  // In incremental mode the triangulations of the previous conversion of the same contours are looked up
+  // by plane pair content hash, and only the plane pairs with modified contours are triangulated
+  bool incrementalConversion = (vtkVariant(this->ConversionParameters[this->GetIncrementalConversionParameterName()].first).ToInt() != 0);
+  const std::map<vtkTypeUInt64, PlanePairTriangulation>* previousPlanePairTriangulations = nullptr;
+  if (incrementalConversion)
+  {
+    // Remove caches of deleted representations
+    for (auto cacheIt = this->IncrementalConversionCaches.begin(); cacheIt != this->IncrementalConversionCaches.end();)
     {
-      vtkSmartPointer<vtkLine> line1 = vtkSmartPointer<vtkLine>::New();
-      line1->DeepCopy(inputContoursCopy->GetCell(firstLineOnPlane1Index + line1Index));
-
-      // Loop through the lines in the second plane
-      for (int line2Index = 0; line2Index < numberOfLinesInPlane2; ++line2Index)
+      if (!cacheIt->second.SourceRepresentation)
       {
-        vtkSmartPointer<vtkLine> line2 = vtkSmartPointer<vtkLine>::New();
-        line2->DeepCopy(inputContoursCopy->GetCell(firstLineOnPlane2Index + line2Index));
-
-        // If the two lines overlap, then add them to the lists
-        if (this->DoLinesOverlap(line1, line2))
-        {
-          // line from plane 1 overlaps with line from plane 2
-          plane1Overlaps[line1Index].push_back(firstLineOnPlane2Index + line2Index);
-          plane2Overlaps[line2Index].push_back(firstLineOnPlane1Index + line1Index);
-        }
+        cacheIt = this->IncrementalConversionCaches.erase(cacheIt);
       }
-    }
-
-    // Loop through all of the lines in the first plane
-    for (int line1Index = firstLineOnPlane1Index; line1Index < firstLineOnPlane1Index + numberOfLinesInPlane1; ++line1Index)
-    {
-      vtkSmartPointer<vtkLine> line1 = vtkSmartPointer<vtkLine>::New();
-      line1->DeepCopy(inputContoursCopy->GetCell(line1Index));
-
-      std::vector<vtkSmartPointer<vtkPointLocator> > overlap1PointLocators(plane1Overlaps[line1Index - firstLineOnPlane1Index].size());
-      std::vector<vtkSmartPointer<vtkIdList> > overlap1PointIds(plane1Overlaps[line1Index - firstLineOnPlane1Index].size());
-
-      // Loop through all of the lines in the second plane that overlap with the current line in the first plane
-      for (size_t overlapIndex = 0; overlapIndex < plane1Overlaps[line1Index - firstLineOnPlane1Index].size(); ++overlapIndex) // lines on plane 2 that overlap with line 1
+      else
       {
-        vtkIdType j = plane1Overlaps[line1Index - firstLineOnPlane1Index][overlapIndex];
-        overlap1PointLocators[overlapIndex] = pointLocators[j];
-        overlap1PointIds[overlapIndex] = linePointIdLists[j];
+        ++cacheIt;
       }
+    }
+    auto cacheIt = this->IncrementalConversionCaches.find(planarContoursPolyData);
+    if (cacheIt != this->IncrementalConversionCaches.end())
+    {
+      previousPlanePairTriangulations = &cacheIt->second.PlanePairTriangulations;
+    }
+  }
+  else
+  {
+    this->IncrementalConversionCaches.clear();
+  }
+  std::vector<vtkTypeUInt64> planePairSignatures(numberOfPlanePairs, 0);
+  std::vector<PlanePairTriangulation> newPlanePairTriangulations(incrementalConversion ? numberOfPlanePairs : 0);
+  std::vector<char> planePairReused(numberOfPlanePairs, 0);
 
-      // Loop through all of the lines in the second plane that overlap with the current line in the first plane
-      for (size_t overlapIndex = 0; overlapIndex < plane1Overlaps[line1Index - firstLineOnPlane1Index].size(); ++overlapIndex) // lines on plane 2 that overlap with line 1
+  // Triangulate two consecutive planes at a time. The plane pairs are processed in parallel,
+  // each into its own triangle list, which are merged in order afterwards.
+  std::vector<std::vector<vtkIdType> > planePairTriangles(numberOfPlanePairs);
+  vtkSMPTools::For(0, numberOfPlanePairs, 1,
+    [&](vtkIdType beginPlanePair, vtkIdType endPlanePair)
+    {
+      TriangulationScratch scratch;
+      std::vector<vtkIdType> dividedPointsInLine1;
+      std::vector<vtkIdType> dividedPointsInLine2;
+      std::vector<vtkIdType> pairPointIds;
+      std::map<vtkIdType, vtkIdType> pointIdToPosition;
+      for (vtkIdType planePairIndex = beginPlanePair; planePairIndex < endPlanePair; ++planePairIndex)
       {
-        vtkIdType line2Index = plane1Overlaps[line1Index - firstLineOnPlane1Index][overlapIndex];
-
-        vtkSmartPointer<vtkLine> line2 = vtkSmartPointer<vtkLine>::New();
-        line2->DeepCopy(inputContoursCopy->GetCell(line2Index));
+        vtkIdType firstLineOnPlane1Index = firstLineOnPlaneIndices[planePairIndex];
+        vtkIdType firstLineOnPlane2Index = firstLineOnPlaneIndices[planePairIndex + 1];
+        vtkIdType endLineOnPlane2Index = firstLineOnPlaneIndices[planePairIndex + 2];
+        vtkIdType numberOfLinesInPlane1 = firstLineOnPlane2Index - firstLineOnPlane1Index;
+        vtkIdType numberOfLinesInPlane2 = endLineOnPlane2Index - firstLineOnPlane2Index;
 
-        std::vector<vtkSmartPointer<vtkPointLocator> > overlap2PointLocators(plane2Overlaps[line2Index - firstLineOnPlane2Index].size());
-        std::vector<vtkSmartPointer<vtkIdList> > overlap2PointIds(plane2Overlaps[line2Index - firstLineOnPlane2Index].size());
-
-        for (size_t i = 0; i < plane2Overlaps[line2Index - firstLineOnPlane2Index].size(); ++i)
+        if (incrementalConversion)
         {
-          int j = plane2Overlaps[line2Index - firstLineOnPlane2Index][i];
-          overlap2PointLocators[i] = pointLocators[j];
-          overlap2PointIds[i] = linePointIdLists[j];
+          planePairSignatures[planePairIndex] = this->ComputePlanePairSignature(coordinates.data(), lineGeometries,
+            firstLineOnPlane1Index, firstLineOnPlane2Index, endLineOnPlane2Index, pairPointIds, pointIdToPosition);
+          if (previousPlanePairTriangulations)
+          {
+            auto previousIt = previousPlanePairTriangulations->find(planePairSignatures[planePairIndex]);
+            if (previousIt != previousPlanePairTriangulations->end())
+            {
+              // Contours of the plane pair are unchanged, reuse the triangulation
+              const PlanePairTriangulation& previousTriangulation = previousIt->second;
+              std::vector<vtkIdType>& triangles = planePairTriangles[planePairIndex];
+              triangles.reserve(previousTriangulation.TrianglePointPositions.size());
+              for (vtkIdType position : previousTriangulation.TrianglePointPositions)
+              {
+                triangles.push_back(pairPointIds[position]);
+              }
+              for (vtkIdType lineIndex = firstLineOnPlane1Index; lineIndex < endLineOnPlane2Index; ++lineIndex)
+              {
+                std::vector<char>& lineFlags = (lineIndex < firstLineOnPlane2Index ? lineTriangulatedToAboveFlags : lineTriangulatedToBelowFlags);
+                lineFlags[lineIndex] = previousTriangulation.LinesTriangulated[lineIndex - firstLineOnPlane1Index];
+              }
+              planePairReused[planePairIndex] = 1;
+              continue;
+            }
+          }
         }
 
-        // Get the portion of line 1 that is close to line 2,
-        vtkSmartPointer<vtkLine> dividedLine1 = vtkSmartPointer<vtkLine>::New();
-        this->Branch(inputContoursCopy, line1, line2Index, plane1Overlaps[line1Index - firstLineOnPlane1Index], overlap1PointLocators, overlap1PointIds, dividedLine1);
-        vtkSmartPointer<vtkIdList> dividedPointsInLine1 = dividedLine1->GetPointIds();
-        int numberOfdividedPointsInLine1 = dividedLine1->GetNumberOfPoints();
+        // Each internal list represents a line from the plane and stores the indices of the overlapping lines
+        std::vector< std::vector< vtkIdType > > plane1Overlaps(numberOfLinesInPlane1);
+        std::vector< std::vector< vtkIdType > > plane2Overlaps(numberOfLinesInPlane2);
+        for (vtkIdType line1Index = 0; line1Index < numberOfLinesInPlane1; ++line1Index)
+        {
+          const double* bounds1 = lineGeometries[firstLineOnPlane1Index + line1Index].Bounds;
+          for (vtkIdType line2Index = 0; line2Index < numberOfLinesInPlane2; ++line2Index)
+          {
+            const double* bounds2 = lineGeometries[firstLineOnPlane2Index + line2Index].Bounds;
+            if (bounds1[0] < bounds2[1] && bounds1[1] > bounds2[0] && bounds1[2] < bounds2[3] && bounds1[3] > bounds2[2])
+            {
+              plane1Overlaps[line1Index].push_back(firstLineOnPlane2Index + line2Index);
+              plane2Overlaps[line2Index].push_back(firstLineOnPlane1Index + line1Index);
+            }
+          }
+        }
 
-        // Get the portion of line 2 that is close to line 1.
-        vtkSmartPointer<vtkLine> dividedLine2 = vtkSmartPointer<vtkLine>::New();
-        this->Branch(inputContoursCopy, line2, line1Index, plane2Overlaps[line2Index - firstLineOnPlane2Index], overlap2PointLocators, overlap2PointIds, dividedLine2);
-        vtkSmartPointer<vtkIdList> dividedPointsInLine2 = dividedLine2->GetPointIds();
-        int numberOfdividedPointsInLine2 = dividedLine2->GetNumberOfPoints();
+        std::vector<vtkIdType>& triangles = planePairTriangles[planePairIndex];
+        for (vtkIdType line1Index = firstLineOnPlane1Index; line1Index < firstLineOnPlane2Index; ++line1Index)
+        {
+          const std::vector<vtkIdType>& line1Overlaps = plane1Overlaps[line1Index - firstLineOnPlane1Index];
+          for (vtkIdType line2Index : line1Overlaps)
+          {
+            // Get the portions of the lines that are close to each other
+            this->BranchContourLine(coordinates.data(), lineGeometries, line1Index, line2Index, line1Overlaps, dividedPointsInLine1);
+            this->BranchContourLine(coordinates.data(), lineGeometries, line2Index, line1Index,
+              plane2Overlaps[line2Index - firstLineOnPlane2Index], dividedPointsInLine2);
+
+            vtkIdType numberOfDividedPointsInLine1 = static_cast<vtkIdType>(dividedPointsInLine1.size());
+            vtkIdType numberOfDividedPointsInLine2 = static_cast<vtkIdType>(dividedPointsInLine2.size());
+            if (numberOfDividedPointsInLine1 > 1 && numberOfDividedPointsInLine2 > 1)
+            {
+              lineTriangulatedToAboveFlags[line1Index] = 1;
+              lineTriangulatedToBelowFlags[line2Index] = 1;
+
+              scratch.Line1Coordinates.resize(3 * numberOfDividedPointsInLine1);
+              for (vtkIdType pointIndex = 0; pointIndex < numberOfDividedPointsInLine1; ++pointIndex)
+              {
+                std::copy_n(&coordinates[3 * dividedPointsInLine1[pointIndex]], 3, &scratch.Line1Coordinates[3 * pointIndex]);
+              }
+              scratch.Line2Coordinates.resize(3 * numberOfDividedPointsInLine2);
+              for (vtkIdType pointIndex = 0; pointIndex < numberOfDividedPointsInLine2; ++pointIndex)
+              {
+                std::copy_n(&coordinates[3 * dividedPointsInLine2[pointIndex]], 3, &scratch.Line2Coordinates[3 * pointIndex]);
+              }
+              this->TriangulateBetweenContourCoordinates(
+                dividedPointsInLine1.data(), scratch.Line1Coordinates.data(), numberOfDividedPointsInLine1,
+                dividedPointsInLine2.data(), scratch.Line2Coordinates.data(), numberOfDividedPointsInLine2,
+                scratch, triangles);
+            }
+          }
+        }
 
-        if (numberOfdividedPointsInLine1 > 1 && numberOfdividedPointsInLine2 > 1)
+        if (incrementalConversion)
         {
-          lineTriganulatedToAbove[line1Index] = true;
-          lineTriganulatedToBelow[line2Index] = true;
-          this->TriangulateBetweenContours(inputContoursCopy, dividedPointsInLine1, dividedPointsInLine2, outputPolygons);
+          // Store the triangulation for the next conversion
+          PlanePairTriangulation& newTriangulation = newPlanePairTriangulations[planePairIndex];
+          newTriangulation.TrianglePointPositions.reserve(triangles.size());
+          for (vtkIdType pointId : triangles)
+          {
+            newTriangulation.TrianglePointPositions.push_back(pointIdToPosition[pointId]);
+          }
+          for (vtkIdType lineIndex = firstLineOnPlane1Index; lineIndex < endLineOnPlane2Index; ++lineIndex)
+          {
+            const std::vector<char>& lineFlags = (lineIndex < firstLineOnPlane2Index ? lineTriangulatedToAboveFlags : lineTriangulatedToBelowFlags);
+            newTriangulation.LinesTriangulated.push_back(lineFlags[lineIndex]);
+          }
         }
+      }
+    });
 
+  if (incrementalConversion)
+  {
+    // Keep only the triangulations of the current plane pairs
+    std::map<vtkTypeUInt64, PlanePairTriangulation> planePairTriangulations;
+    for (vtkIdType planePairIndex = 0; planePairIndex < numberOfPlanePairs; ++planePairIndex)
+    {
+      if (planePairReused[planePairIndex])
+      {
+        planePairTriangulations[planePairSignatures[planePairIndex]] = previousPlanePairTriangulations->at(planePairSignatures[planePairIndex]);
+      }
+      else
+      {
+        planePairTriangulations[planePairSignatures[planePairIndex]] = std::move(newPlanePairTriangulations[planePairIndex]);
       }
     }
+    IncrementalConversionCache& cache = this->IncrementalConversionCaches[planarContoursPolyData];
+    cache.SourceRepresentation = planarContoursPolyData;
+    cache.PlanePairTriangulations.swap(planePairTriangulations);
+  }
 
-    // Advance the points
-    firstLineOnPlane1Index = firstLineOnPlane2Index;
-    numberOfLinesInPlane1 = numberOfLinesInPlane2;
+  // Merge the triangles of the plane pairs into the output
+  for (const std::vector<vtkIdType>& triangles : planePairTriangles)
+  {
+    for (size_t triangleIndex = 0; triangleIndex < triangles.size(); triangleIndex += 3)
+    {
+      outputPolygons->InsertNextCell(3, &triangles[triangleIndex]);
+    }
   }
+  planePairTriangles.clear();
+
+  std::vector< bool > lineTriganulatedToAbove(lineTriangulatedToAboveFlags.begin(), lineTriangulatedToAboveFlags.end());
+  std::vector< bool > lineTriganulatedToBelow(lineTriangulatedToBelowFlags.begin(), lineTriangulatedToBelowFlags.end());
 
   // Triangulate all contours which are exposed.
-  this->EndCapping(inputContoursCopy, outputPolygons, lineTriganulatedToAbove, lineTriganulatedToBelow);
+  this->EndCapping(inputContoursCopy, outputPolygons, lineTriganulatedToAbove, lineTriganulatedToBelow, spacing);
 
   // Initialize the output data.
   closedSurfacePolyData->SetPoints(outputPoints);
@@ -353,93 +454,129 @@ void vtkPlanarContourToClosedSurfaceConversionRule::TriangulateBetweenContours(v
     return;
   }
 
-  int numberOfPointsInLine1 = pointsInLine1->GetNumberOfIds();
-  int numberOfPointsInLine2 = pointsInLine2->GetNumberOfIds();
+  vtkIdType numberOfPointsInLine1 = pointsInLine1->GetNumberOfIds();
+  vtkIdType numberOfPointsInLine2 = pointsInLine2->GetNumberOfIds();
+
+  TriangulationScratch scratch;
+  scratch.Line1Coordinates.resize(3 * numberOfPointsInLine1);
+  for (vtkIdType pointIndex = 0; pointIndex < numberOfPointsInLine1; ++pointIndex)
+  {
+    inputROIPoints->GetPoint(pointsInLine1->GetId(pointIndex), &scratch.Line1Coordinates[3 * pointIndex]);
+  }
+  scratch.Line2Coordinates.resize(3 * numberOfPointsInLine2);
+  for (vtkIdType pointIndex = 0; pointIndex < numberOfPointsInLine2; ++pointIndex)
+  {
+    inputROIPoints->GetPoint(pointsInLine2->GetId(pointIndex), &scratch.Line2Coordinates[3 * pointIndex]);
+  }
+
+  std::vector<vtkIdType> triangles;
+  this->TriangulateBetweenContourCoordinates(
+    pointsInLine1->GetPointer(0), scratch.Line1Coordinates.data(), numberOfPointsInLine1,
+    pointsInLine2->GetPointer(0), scratch.Line2Coordinates.data(), numberOfPointsInLine2,
+    scratch, triangles);
 
-  // Pre-calculate and store the closest points.
+  for (size_t triangleIndex = 0; triangleIndex < triangles.size(); triangleIndex += 3)
+  {
+    outputPolygons->InsertNextCell(3, &triangles[triangleIndex]);
+  }
+}
 
-  // Closest point from line 1 to line 2
-  std::vector< int > closestPointFromLine1ToLine2Ids(numberOfPointsInLine1);
-  for (int line1PointIndex = 0; line1PointIndex < numberOfPointsInLine1; ++line1PointIndex)
+//----------------------------------------------------------------------------
+void vtkPlanarContourToClosedSurfaceConversionRule::TriangulateBetweenContourCoordinates(
+  const vtkIdType* pointIdsInLine1, const double* line1Coordinates, vtkIdType numberOfPointsInLine1,
+  const vtkIdType* pointIdsInLine2, const double* line2Coordinates, vtkIdType numberOfPointsInLine2,
+  TriangulationScratch& scratch, std::vector<vtkIdType>& outputTriangles)
+{
+  if (numberOfPointsInLine1 == 0 || numberOfPointsInLine2 == 0)
   {
-    double line1Point[3] = { 0,0,0 };
-    inputROIPoints->GetPoint(pointsInLine1->GetId(line1PointIndex), line1Point);
-    closestPointFromLine1ToLine2Ids[line1PointIndex] = this->GetClosestPoint(inputROIPoints, line1Point, pointsInLine2);
+    return;
   }
 
-  // Closest from line 2 to line 1
-  std::vector< int > closestPointFromLine2ToLine1Ids(numberOfPointsInLine2);
-  for (int line2PointIndex = 0; line2PointIndex < numberOfPointsInLine2; ++line2PointIndex)
+  // Pre-calculate and store the closest points (index within the other line).
+  std::vector<vtkIdType>& closestPointFromLine1ToLine2Ids = scratch.ClosestPointFromLine1ToLine2;
+  std::vector<vtkIdType>& closestPointFromLine2ToLine1Ids = scratch.ClosestPointFromLine2ToLine1;
+  closestPointFromLine1ToLine2Ids.resize(numberOfPointsInLine1);
+  closestPointFromLine2ToLine1Ids.resize(numberOfPointsInLine2);
+  for (vtkIdType line1PointIndex = 0; line1PointIndex < numberOfPointsInLine1; ++line1PointIndex)
+  {
+    const double* line1Point = line1Coordinates + 3 * line1PointIndex;
+    double minimumDistance = VTK_DOUBLE_MAX;
+    closestPointFromLine1ToLine2Ids[line1PointIndex] = 0;
+    for (vtkIdType line2PointIndex = 0; line2PointIndex < numberOfPointsInLine2; ++line2PointIndex)
+    {
+      double distance = vtkMath::Distance2BetweenPoints(line1Point, line2Coordinates + 3 * line2PointIndex);
+      if (distance < minimumDistance)
+      {
+        minimumDistance = distance;
+        closestPointFromLine1ToLine2Ids[line1PointIndex] = line2PointIndex;
+      }
+    }
+  }
+  for (vtkIdType line2PointIndex = 0; line2PointIndex < numberOfPointsInLine2; ++line2PointIndex)
   {
-    double line2Point[3] = { 0,0,0 };
-    inputROIPoints->GetPoint(pointsInLine2->GetId(line2PointIndex), line2Point);
-    closestPointFromLine2ToLine1Ids[line2PointIndex] = this->GetClosestPoint(inputROIPoints, line2Point, pointsInLine1);
+    const double* line2Point = line2Coordinates + 3 * line2PointIndex;
+    double minimumDistance = VTK_DOUBLE_MAX;
+    closestPointFromLine2ToLine1Ids[line2PointIndex] = 0;
+    for (vtkIdType line1PointIndex = 0; line1PointIndex < numberOfPointsInLine1; ++line1PointIndex)
+    {
+      double distance = vtkMath::Distance2BetweenPoints(line2Point, line1Coordinates + 3 * line1PointIndex);
+      if (distance < minimumDistance)
+      {
+        minimumDistance = distance;
+        closestPointFromLine2ToLine1Ids[line2PointIndex] = line1PointIndex;
+      }
+    }
   }
 
   // Orient loops.
   // Use the 0th point on line 1 and the closest point on line 2.
   vtkIdType startLine1PointId = 0;
   vtkIdType startLine2PointId = closestPointFromLine1ToLine2Ids[0];
-
-  double firstPointLine1[3] = { 0,0,0 }; // first point on line 1;
-  inputROIPoints->GetPoint(pointsInLine1->GetId(startLine1PointId), firstPointLine1);
-
-  double firstPointLine2[3] = { 0,0,0 }; // first point on line 2;
-  inputROIPoints->GetPoint(pointsInLine2->GetId(startLine2PointId), firstPointLine2);
+  const double* firstPointLine1 = line1Coordinates + 3 * startLine1PointId;
+  const double* firstPointLine2 = line2Coordinates + 3 * startLine2PointId;
 
   // Determine if the loops are closed.
   // A loop is closed if the first point is repeated as the last point.
-  bool line1Closed = (pointsInLine1->GetId(0) == pointsInLine1->GetId(numberOfPointsInLine1 - 1));
-  bool line2Closed = (pointsInLine2->GetId(0) == pointsInLine2->GetId(numberOfPointsInLine2 - 1));
+  bool line1Closed = (pointIdsInLine1[0] == pointIdsInLine1[numberOfPointsInLine1 - 1]);
+  bool line2Closed = (pointIdsInLine2[0] == pointIdsInLine2[numberOfPointsInLine2 - 1]);
 
   // Determine the ending points.
-  int line1EndPoint = this->GetEndLoop(startLine1PointId, numberOfPointsInLine1, line1Closed);
-  int line2EndPoint = this->GetEndLoop(startLine2PointId, numberOfPointsInLine2, line2Closed);
+  vtkIdType line1EndPoint = this->GetEndLoop(startLine1PointId, numberOfPointsInLine1, line1Closed);
+  vtkIdType line2EndPoint = this->GetEndLoop(startLine2PointId, numberOfPointsInLine2, line2Closed);
 
   // Initialize the Dynamic Programming table.
   // Rows represent line 1. Columns represent line 2.
-
-  // Initialize the score table.
-  std::vector< std::vector< double > > scoreTable(numberOfPointsInLine1, std::vector< double >(numberOfPointsInLine2));
-  scoreTable[0][0] = vtkMath::Distance2BetweenPoints(firstPointLine1, firstPointLine2);
-
-  std::vector< std::vector< BacktrackDirection > > backtrackTable(numberOfPointsInLine1, std::vector< BacktrackDirection >(numberOfPointsInLine2));
-  backtrackTable[0][0] = DYNAMIC_BACKTRACK_UP;
+  // The full backtrack table is needed, but only the previous and the current row of the score table.
+  std::vector<char>& backtrackTable = scratch.BacktrackTable;
+  backtrackTable.assign(numberOfPointsInLine1 * numberOfPointsInLine2, DYNAMIC_BACKTRACK_UP);
+  std::vector<double>& previousRowScores = scratch.PreviousRowScores;
+  std::vector<double>& currentRowScores = scratch.CurrentRowScores;
+  previousRowScores.resize(numberOfPointsInLine2);
+  currentRowScores.resize(numberOfPointsInLine2);
 
   // Initialize the first row in the table.
+  previousRowScores[0] = vtkMath::Distance2BetweenPoints(firstPointLine1, firstPointLine2);
   vtkIdType currentPointIdLine2 = this->GetNextLocation(startLine2PointId, numberOfPointsInLine2, line2Closed);
-  for (int line2PointIndex = 1; line2PointIndex < numberOfPointsInLine2; ++line2PointIndex)
+  for (vtkIdType line2PointIndex = 1; line2PointIndex < numberOfPointsInLine2; ++line2PointIndex)
   {
-    double currentPointLine2[3] = { 0,0,0 }; // current point on line 2
-    inputROIPoints->GetPoint(pointsInLine2->GetId(currentPointIdLine2), currentPointLine2);
-
     // Use the distance between first point on line 1 and current point on line 2.
-    double distance = vtkMath::Distance2BetweenPoints(firstPointLine1, currentPointLine2);
-
-    scoreTable[0][line2PointIndex] = scoreTable[0][line2PointIndex - 1] + distance;
-    backtrackTable[0][line2PointIndex] = DYNAMIC_BACKTRACK_LEFT;
-
+    double distance = vtkMath::Distance2BetweenPoints(firstPointLine1, line2Coordinates + 3 * currentPointIdLine2);
+    previousRowScores[line2PointIndex] = previousRowScores[line2PointIndex - 1] + distance;
+    backtrackTable[line2PointIndex] = DYNAMIC_BACKTRACK_LEFT;
     currentPointIdLine2 = this->GetNextLocation(currentPointIdLine2, numberOfPointsInLine2, line2Closed);
   }
 
   // Initialize the first column in the table.
+  // Note: the first step uses the number of points in line 2, as the original table-based implementation did.
+  std::vector<double>& firstColumnScores = scratch.FirstColumnScores;
+  firstColumnScores.resize(numberOfPointsInLine1);
+  firstColumnScores[0] = previousRowScores[0];
   vtkIdType currentPointIdLine1 = this->GetNextLocation(startLine1PointId, numberOfPointsInLine2, line1Closed);
-  for (int line1PointIndex = 1; line1PointIndex < numberOfPointsInLine1; ++line1PointIndex)
+  for (vtkIdType line1PointIndex = 1; line1PointIndex < numberOfPointsInLine1; ++line1PointIndex)
   {
-    double currentPointLine1[3] = { 0,0,0 }; // current point on line 1
-    inputROIPoints->GetPoint(pointsInLine1->GetId(currentPointIdLine1), currentPointLine1);
-
     // Use the distance between first point on line 2 and current point on line 1.
-    double distance = vtkMath::Distance2BetweenPoints(currentPointLine1, firstPointLine2);
-
-    scoreTable[line1PointIndex][0] = scoreTable[line1PointIndex - 1][0] + distance;
-    backtrackTable[line1PointIndex][0] = DYNAMIC_BACKTRACK_UP;
-    for (int line2PointIndex = 1; line2PointIndex < numberOfPointsInLine2; ++line2PointIndex)
-    {
-      scoreTable[line1PointIndex][line2PointIndex] = 0;
-      backtrackTable[line1PointIndex][line2PointIndex] = DYNAMIC_BACKTRACK_UP;
-    }
-
+    double distance = vtkMath::Distance2BetweenPoints(line1Coordinates + 3 * currentPointIdLine1, firstPointLine2);
+    firstColumnScores[line1PointIndex] = firstColumnScores[line1PointIndex - 1] + distance;
     currentPointIdLine1 = this->GetNextLocation(currentPointIdLine1, numberOfPointsInLine1, line1Closed);
   }
 
@@ -454,42 +591,44 @@ void vtkPlanarContourToClosedSurfaceConversionRule::TriangulateBetweenContours(v
   vtkIdType line2PointIndex = 1;
   for (line1PointIndex = 1; line1PointIndex < numberOfPointsInLine1; ++line1PointIndex)
   {
-    double pointOnLine1[3] = { 0,0,0 };
-    inputROIPoints->GetPoint(pointsInLine1->GetId(currentPointIdLine1), pointOnLine1);
+    const double* pointOnLine1 = line1Coordinates + 3 * currentPointIdLine1;
+    char* backtrackRow = &backtrackTable[line1PointIndex * numberOfPointsInLine2];
+    currentRowScores[0] = firstColumnScores[line1PointIndex];
 
     for (line2PointIndex = 1; line2PointIndex < numberOfPointsInLine2; ++line2PointIndex)
     {
-      double pointOnLine2[3] = { 0,0,0 };
-      inputROIPoints->GetPoint(pointsInLine2->GetId(currentPointIdLine2), pointOnLine2);
-
-      double distance = vtkMath::Distance2BetweenPoints(pointOnLine1, pointOnLine2);
+      double distance = vtkMath::Distance2BetweenPoints(pointOnLine1, line2Coordinates + 3 * currentPointIdLine2);
+      double leftScore = currentRowScores[line2PointIndex - 1];
+      double upScore = previousRowScores[line2PointIndex];
 
       // Use the pre-calculated closest point.
       if (currentPointIdLine1 == closestPointFromLine2ToLine1Ids[previousLine2])
       {
-        scoreTable[line1PointIndex][line2PointIndex] = scoreTable[line1PointIndex][line2PointIndex - 1] + distance;
-        backtrackTable[line1PointIndex][line2PointIndex] = DYNAMIC_BACKTRACK_LEFT;
+        currentRowScores[line2PointIndex] = leftScore + distance;
+        backtrackRow[line2PointIndex] = DYNAMIC_BACKTRACK_LEFT;
       }
       else if (currentPointIdLine2 == closestPointFromLine1ToLine2Ids[previousLine1])
       {
-        scoreTable[line1PointIndex][line2PointIndex] = scoreTable[line1PointIndex - 1][line2PointIndex] + distance;
-        backtrackTable[line1PointIndex][line2PointIndex] = DYNAMIC_BACKTRACK_UP;
+        currentRowScores[line2PointIndex] = upScore + distance;
+        backtrackRow[line2PointIndex] = DYNAMIC_BACKTRACK_UP;
       }
-      else if (scoreTable[line1PointIndex][line2PointIndex - 1] <= scoreTable[line1PointIndex - 1][line2PointIndex])
+      else if (leftScore <= upScore)
       {
-        scoreTable[line1PointIndex][line2PointIndex] = scoreTable[line1PointIndex][line2PointIndex - 1] + distance;
-        backtrackTable[line1PointIndex][line2PointIndex] = DYNAMIC_BACKTRACK_LEFT;
+        currentRowScores[line2PointIndex] = leftScore + distance;
+        backtrackRow[line2PointIndex] = DYNAMIC_BACKTRACK_LEFT;
       }
       else
       {
-        scoreTable[line1PointIndex][line2PointIndex] = scoreTable[line1PointIndex - 1][line2PointIndex] + distance;
-        backtrackTable[line1PointIndex][line2PointIndex] = DYNAMIC_BACKTRACK_UP;
+        currentRowScores[line2PointIndex] = upScore + distance;
+        backtrackRow[line2PointIndex] = DYNAMIC_BACKTRACK_UP;
       }
 
       // Advance the pointers
       previousLine2 = currentPointIdLine2;
       currentPointIdLine2 = this->GetNextLocation(currentPointIdLine2, numberOfPointsInLine2, line2Closed);
     }
+    previousRowScores.swap(currentRowScores);
+
     previousLine1 = currentPointIdLine1;
     currentPointIdLine1 = this->GetNextLocation(currentPointIdLine1, numberOfPointsInLine1, line1Closed);
   }
@@ -499,93 +638,182 @@ void vtkPlanarContourToClosedSurfaceConversionRule::TriangulateBetweenContours(v
   currentPointIdLine2 = line2EndPoint;
   --line1PointIndex;
   --line2PointIndex;
+  outputTriangles.reserve(outputTriangles.size() + 3 * (line1PointIndex + line2PointIndex));
   while (line1PointIndex > 0 || line2PointIndex > 0)
   {
-    double line1Point[3] = { 0,0,0 }; // current point on line 1
-    inputROIPoints->GetPoint(pointsInLine1->GetId(currentPointIdLine1), line1Point);
-
-    double line2Point[3] = { 0,0,0 }; // current point on line 2
-    inputROIPoints->GetPoint(pointsInLine2->GetId(currentPointIdLine2), line2Point);
-
-    vtkIdType currentTriangle[3] = { 0,0,0 };
-    currentTriangle[0] = pointsInLine1->GetId(currentPointIdLine1);
-    currentTriangle[1] = pointsInLine2->GetId(currentPointIdLine2);
-    if (backtrackTable[line1PointIndex][line2PointIndex] == DYNAMIC_BACKTRACK_LEFT)
+    outputTriangles.push_back(pointIdsInLine1[currentPointIdLine1]);
+    outputTriangles.push_back(pointIdsInLine2[currentPointIdLine2]);
+    if (backtrackTable[line1PointIndex * numberOfPointsInLine2 + line2PointIndex] == DYNAMIC_BACKTRACK_LEFT)
     {
       vtkIdType previousPointIndexLine2 = this->GetPreviousLocation(currentPointIdLine2, numberOfPointsInLine2, line2Closed);
-      currentTriangle[2] = pointsInLine2->GetId(previousPointIndexLine2);
+      outputTriangles.push_back(pointIdsInLine2[previousPointIndexLine2]);
       line2PointIndex -= 1;
       currentPointIdLine2 = previousPointIndexLine2;
     }
     else // DYNAMIC_BACKTRACK_UP
     {
       vtkIdType previousPointIndexLine1 = this->GetPreviousLocation(currentPointIdLine1, numberOfPointsInLine1, line1Closed);
-      currentTriangle[2] = pointsInLine1->GetId(previousPointIndexLine1);
+      outputTriangles.push_back(pointIdsInLine1[previousPointIndexLine1]);
       line1PointIndex -= 1;
       currentPointIdLine1 = previousPointIndexLine1;
     }
-
-    outputPolygons->InsertNextCell(3);
-    outputPolygons->InsertCellPoint(currentTriangle[0]);
-    outputPolygons->InsertCellPoint(currentTriangle[1]);
-    outputPolygons->InsertCellPoint(currentTriangle[2]);
   }
 }
 
 //----------------------------------------------------------------------------
-vtkIdType vtkPlanarContourToClosedSurfaceConversionRule::GetEndLoop(vtkIdType startLoopIndex, int numberOfPoints, bool loopClosed)
+void vtkPlanarContourToClosedSurfaceConversionRule::ComputeContourLineGeometry(const double* coordinates, vtkIdList* linePointIds, ContourLineGeometry& lineGeometry)
 {
-  if (startLoopIndex != 0)
-  {
-    if (loopClosed)
+  vtkIdType numberOfPointsInLine = linePointIds->GetNumberOfIds();
+  lineGeometry.PointIds.assign(linePointIds->GetPointer(0), linePointIds->GetPointer(0) + numberOfPointsInLine);
+  lineGeometry.Closed = (numberOfPointsInLine > 0 && lineGeometry.PointIds.front() == lineGeometry.PointIds.back());
+
+  vtkNew<vtkPoints> linePoints;
+  linePoints->SetDataTypeToDouble();
+  linePoints->SetNumberOfPoints(numberOfPointsInLine);
+  vtkMath::UninitializeBounds(lineGeometry.Bounds);
+  for (vtkIdType pointIndex = 0; pointIndex < numberOfPointsInLine; ++pointIndex)
+  {
+    const double* point = coordinates + 3 * lineGeometry.PointIds[pointIndex];
+    linePoints->SetPoint(pointIndex, point);
+    for (int axis = 0; axis < 3; ++axis)
     {
-      return startLoopIndex;
+      if (pointIndex == 0 || point[axis] < lineGeometry.Bounds[2 * axis])
+      {
+        lineGeometry.Bounds[2 * axis] = point[axis];
+      }
+      if (pointIndex == 0 || point[axis] > lineGeometry.Bounds[2 * axis + 1])
+      {
+        lineGeometry.Bounds[2 * axis + 1] = point[axis];
+      }
     }
-
-    return startLoopIndex - 1;
   }
+  lineGeometry.PlanePosition = (lineGeometry.Bounds[4] + lineGeometry.Bounds[5]) / 2.0;
 
-  // If startLoop was 0, then it doesn't matter whether or not the loop was closed.
-  return numberOfPoints - 1;
+  vtkNew<vtkPolyData> linePolyData;
+  linePolyData->SetPoints(linePoints);
+  lineGeometry.Locator = vtkSmartPointer<vtkStaticPointLocator>::New();
+  lineGeometry.Locator->SetDataSet(linePolyData);
+  lineGeometry.Locator->BuildLocator();
 }
 
 //----------------------------------------------------------------------------
-vtkIdType vtkPlanarContourToClosedSurfaceConversionRule::GetClosestPoint(vtkPolyData* inputROIPoints, double* originalPoint, vtkIdList* linePointIds)
+void vtkPlanarContourToClosedSurfaceConversionRule::BranchContourLine(const double* coordinates, const std::vector<ContourLineGeometry>& lineGeometries,
+  vtkIdType branchingLineIndex, vtkIdType currentLineIndex, const std::vector<vtkIdType>& overlappingLineIndices, std::vector<vtkIdType>& outputPointIds)
 {
-  if (!inputROIPoints)
+  const std::vector<vtkIdType>& branchingLinePointIds = lineGeometries[branchingLineIndex].PointIds;
+  if (overlappingLineIndices.size() == 1)
   {
-    vtkErrorMacro("inputROIPoints: Invalid vtkPolyData!");
-    return 0;
+    outputPointIds = branchingLinePointIds;
+    return;
   }
 
-  if (!linePointIds)
+  outputPointIds.clear();
+
+  // Discard some points on the trunk so that the branch connects to only a part of the trunk.
+  bool previousPointOnBranch = false;
+  for (vtkIdType currentPointId : branchingLinePointIds)
   {
-    vtkErrorMacro("GetClosestPoint: Invalid vtkIdList!");
-    return 0;
+    const double* currentPoint = coordinates + 3 * currentPointId;
+
+    // Find the closest overlapping line
+    double minimumDistanceSquared = VTK_DOUBLE_MAX;
+    vtkIdType closestLineIndex = overlappingLineIndices[0];
+    for (vtkIdType overlappingLineIndex : overlappingLineIndices)
+    {
+      const ContourLineGeometry& overlappingLine = lineGeometries[overlappingLineIndex];
+      vtkIdType closestPointIndex = overlappingLine.Locator->FindClosestPoint(currentPoint);
+      if (closestPointIndex < 0)
+      {
+        continue;
+      }
+      double currentDistanceToLineSquared = vtkMath::Distance2BetweenPoints(
+        coordinates + 3 * overlappingLine.PointIds[closestPointIndex], currentPoint);
+      if (currentDistanceToLineSquared < minimumDistanceSquared)
+      {
+        minimumDistanceSquared = currentDistanceToLineSquared;
+        closestLineIndex = overlappingLineIndex;
+      }
+    }
+
+    // See if the point's closest branch is the input branch.
+    if (closestLineIndex == currentLineIndex)
+    {
+      outputPointIds.push_back(currentPointId);
+      previousPointOnBranch = true;
+    }
+    else
+    {
+      if (previousPointOnBranch)
+      {
+        // Add one extra point to close up the surface.
+        outputPointIds.push_back(currentPointId);
+      }
+      previousPointOnBranch = false;
+    }
   }
 
-  double pointOnLine[3] = { 0,0,0 }; // point from the given line
-  inputROIPoints->GetPoint(linePointIds->GetId(0), pointOnLine);
+  // Make the divided line a closed contour as well if the trunk was closed
+  if (outputPointIds.size() > 1 && lineGeometries[branchingLineIndex].Closed && outputPointIds.front() != outputPointIds.back())
+  {
+    outputPointIds.push_back(outputPointIds.front());
+  }
+}
 
-  double minimumDistance = vtkMath::Distance2BetweenPoints(originalPoint, pointOnLine); // minimum distance from the point to the line
-  double closestPointIndex = 0;
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkPlanarContourToClosedSurfaceConversionRule::ComputePlanePairSignature(const double* coordinates,
+  const std::vector<ContourLineGeometry>& lineGeometries, vtkIdType firstLineIndex, vtkIdType firstLineOnPlane2Index, vtkIdType endLineIndex,
+  std::vector<vtkIdType>& pairPointIds, std::map<vtkIdType, vtkIdType>& pointIdToPosition)
+{
+  pairPointIds.clear();
+  pointIdToPosition.clear();
 
-  int numberOfPoints = linePointIds->GetNumberOfIds();
+  // FNV-1a hash of the values describing the plane pair
+  vtkTypeUInt64 hash = 14695981039346656037ULL;
+  auto hashValue = [&hash](const void* data, size_t size)
+  {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t byteIndex = 0; byteIndex < size; ++byteIndex)
+    {
+      hash = (hash ^ bytes[byteIndex]) * 1099511628211ULL;
+    }
+  };
 
-  // Loop through all of the points in the current line
-  for (int currentPointIndex = 1; currentPointIndex < numberOfPoints; ++currentPointIndex)
+  vtkIdType numberOfLinesInPlane1 = firstLineOnPlane2Index - firstLineIndex;
+  hashValue(&numberOfLinesInPlane1, sizeof(numberOfLinesInPlane1));
+  for (vtkIdType lineIndex = firstLineIndex; lineIndex < endLineIndex; ++lineIndex)
   {
-    inputROIPoints->GetPoint(linePointIds->GetId(currentPointIndex), pointOnLine);
+    const std::vector<vtkIdType>& linePointIds = lineGeometries[lineIndex].PointIds;
+    vtkIdType numberOfPointsInLine = static_cast<vtkIdType>(linePointIds.size());
+    hashValue(&numberOfPointsInLine, sizeof(numberOfPointsInLine));
+    for (vtkIdType pointId : linePointIds)
+    {
+      // Shared points are identified by the position of their first occurrence
+      vtkIdType position = static_cast<vtkIdType>(pairPointIds.size());
+      position = pointIdToPosition.insert(std::make_pair(pointId, position)).first->second;
+      pairPointIds.push_back(pointId);
+      hashValue(&position, sizeof(position));
+      hashValue(coordinates + 3 * pointId, 3 * sizeof(double));
+    }
+  }
+
+  return hash;
+}
 
-    double distanceBetweenPoints = vtkMath::Distance2BetweenPoints(originalPoint, pointOnLine);
-    if (distanceBetweenPoints < minimumDistance)
+//----------------------------------------------------------------------------
+vtkIdType vtkPlanarContourToClosedSurfaceConversionRule::GetEndLoop(vtkIdType startLoopIndex, int numberOfPoints, bool loopClosed)
+{
+  if (startLoopIndex != 0)
+  {
+    if (loopClosed)
     {
-      minimumDistance = distanceBetweenPoints;
-      closestPointIndex = currentPointIndex;
+      return startLoopIndex;
     }
+
+    return startLoopIndex - 1;
   }
 
-  return closestPointIndex;
+  // If startLoop was 0, then it doesn't matter whether or not the loop was closed.
+  return numberOfPoints - 1;
 }
 
 //----------------------------------------------------------------------------
@@ -628,220 +856,213 @@ void vtkPlanarContourToClosedSurfaceConversionRule::SortContours(vtkPolyData* in
 }
 
 //----------------------------------------------------------------------------
-void vtkPlanarContourToClosedSurfaceConversionRule::FixKeyholes(vtkPolyData* inputROIPoints, double epsilon, int minimumSeperation)
+void vtkPlanarContourToClosedSurfaceConversionRule::FixKeyholesAndSetLinesCounterClockwise(vtkPolyData* inputROIPoints, double epsilon, int minimumSeperation)
 {
-  if (!inputROIPoints)
+  if (!inputROIPoints || !inputROIPoints->GetPoints())
   {
-    vtkErrorMacro("inputROIPoints: Invalid vtkPolyData!");
+    vtkErrorMacro("FixKeyholesAndSetLinesCounterClockwise: Invalid vtkPolyData!");
     return;
   }
 
-  vtkSmartPointer<vtkLine> originalLine;
-  std::vector<vtkSmartPointer<vtkLine> > newLines;
-  int pointsOfSeperation;
-
-  int numberOfLines = inputROIPoints->GetNumberOfLines();
-
-  // Loop through all of the lines
-  for (vtkIdType currentLineId = 0; currentLineId < numberOfLines; ++currentLineId)
+  // Read the point coordinates and the line point ids into contiguous arrays
+  vtkPoints* points = inputROIPoints->GetPoints();
+  vtkIdType numberOfPoints = points->GetNumberOfPoints();
+  std::vector<double> coordinates(3 * numberOfPoints);
+  for (vtkIdType pointId = 0; pointId < numberOfPoints; ++pointId)
   {
-    originalLine = vtkSmartPointer<vtkLine>::New();
-    originalLine->DeepCopy(inputROIPoints->GetCell(currentLineId));
-
-    vtkSmartPointer<vtkPoints> originalLinePoints = originalLine->GetPoints();
-    int numberOfPointsInLine = originalLine->GetNumberOfPoints();
-
-    vtkSmartPointer<vtkPolyData> linePolyData = vtkSmartPointer<vtkPolyData>::New();
-    linePolyData->SetPoints(originalLinePoints);
-
-    vtkSmartPointer<vtkPointLocator> pointLocator = vtkSmartPointer<vtkPointLocator>::New();
-    pointLocator->SetDataSet(linePolyData);
-    pointLocator->BuildLocator();
-
-    bool keyHoleExists = false;
-
-    // If the value of flags[i] is -1, the point is not part of a keyhole
-    // If the value of flags[i] is >= 0, it represents a point that is
-    // close enough that it could be considered part of a keyhole.
-    std::vector< int > flags(numberOfPointsInLine);
+    points->GetPoint(pointId, &coordinates[3 * pointId]);
+  }
+  std::vector<vtkIdType> lineOffsets(1, 0);
+  std::vector<vtkIdType> linePointIds;
+  vtkNew<vtkIdList> currentLinePointIds;
+  vtkCellArray* inputLines = inputROIPoints->GetLines();
+  inputLines->InitTraversal();
+  while (inputLines->GetNextCell(currentLinePointIds))
+  {
+    linePointIds.insert(linePointIds.end(), currentLinePointIds->GetPointer(0),
+      currentLinePointIds->GetPointer(0) + currentLinePointIds->GetNumberOfIds());
+    lineOffsets.push_back(static_cast<vtkIdType>(linePointIds.size()));
+  }
+  vtkIdType numberOfLines = static_cast<vtkIdType>(lineOffsets.size()) - 1;
 
-    // Loop through and initialize the list of flags to -1.
-    for (int i = 0; i < numberOfPointsInLine; ++i)
-    {
-      flags[i] = -1;
-    }
+  // Points closer than epsilon are in the same or in a neighboring grid cell
+  double gridCellSize = (epsilon > 0.0 ? epsilon : 1.0);
+  double epsilonSquared = epsilon * epsilon;
 
-    for (int point1Id = 0; point1Id < numberOfPointsInLine; ++point1Id)
+  std::vector<std::vector<std::vector<vtkIdType> > > outputLinesOfInputLines(numberOfLines);
+  vtkSMPTools::For(0, numberOfLines,
+    [&](vtkIdType beginLine, vtkIdType endLine)
     {
-      double point1[3] = { 0,0,0 };
-      originalLinePoints->GetPoint(point1Id, point1);
-
-      vtkSmartPointer<vtkIdList> pointsWithinRadius = vtkSmartPointer<vtkIdList>::New();
-      pointsWithinRadius->Initialize();
-      pointLocator->FindPointsWithinRadius(epsilon, point1, pointsWithinRadius);
-
-      for (vtkIdType currentPointIndex = 0; currentPointIndex < pointsWithinRadius->GetNumberOfIds(); ++currentPointIndex)
+      std::vector<vtkTypeInt64> pointGridCells;
+      std::vector<std::pair<vtkTypeUInt64, vtkIdType> > sortedGridCellKeys;
+      std::vector<int> closePointIndices;
+      std::vector<int> flags;
+      for (vtkIdType lineIndex = beginLine; lineIndex < endLine; ++lineIndex)
       {
-        int point2Id = pointsWithinRadius->GetId(currentPointIndex);
+        const vtkIdType* originalLinePointIds = linePointIds.data() + lineOffsets[lineIndex];
+        int numberOfPointsInLine = static_cast<int>(lineOffsets[lineIndex + 1] - lineOffsets[lineIndex]);
 
-        // Make sure the points are not too close together on the line index-wise
-        pointsOfSeperation = std::min(point2Id - point1Id, numberOfPointsInLine - 1 - point2Id + point1Id);
-        if (pointsOfSeperation > minimumSeperation)
+        // Hash the points of the line into a uniform grid
+        auto gridCellKey = [](vtkTypeInt64 i, vtkTypeInt64 j, vtkTypeInt64 k)
+        {
+          return static_cast<vtkTypeUInt64>(i * 73856093) ^ static_cast<vtkTypeUInt64>(j * 19349663) ^ static_cast<vtkTypeUInt64>(k * 83492791);
+        };
+        pointGridCells.resize(3 * numberOfPointsInLine);
+        sortedGridCellKeys.resize(numberOfPointsInLine);
+        for (int pointIndex = 0; pointIndex < numberOfPointsInLine; ++pointIndex)
         {
-          keyHoleExists = true;
-          flags[point1Id] = point2Id;
-          flags[point2Id] = point1Id;
+          const double* point = &coordinates[3 * originalLinePointIds[pointIndex]];
+          vtkTypeInt64* gridCell = &pointGridCells[3 * pointIndex];
+          for (int axis = 0; axis < 3; ++axis)
+          {
+            gridCell[axis] = static_cast<vtkTypeInt64>(std::floor(point[axis] / gridCellSize));
+          }
+          sortedGridCellKeys[pointIndex] = std::make_pair(gridCellKey(gridCell[0], gridCell[1], gridCell[2]), pointIndex);
         }
-
-      }
-    }
-
-    if (!keyHoleExists)
-    {
-      newLines.push_back(originalLine);
-    }
-    else
-    {
-      size_t currentLayer = 0;
-      bool pointInChannel = false;
-
-      std::vector<vtkSmartPointer<vtkIdList> > rawLinePointIds;
-      std::vector<vtkSmartPointer<vtkIdList> > finishedLinePointIds;
-
-      // Loop through all of the points in the line
-      for (int currentPointIndex = 0; currentPointIndex < numberOfPointsInLine; ++currentPointIndex)
-      {
-
-        // Add a new line if necessary
-        if (currentLayer == rawLinePointIds.size())
+        std::sort(sortedGridCellKeys.begin(), sortedGridCellKeys.end());
+
+        // If the value of flags[i] is -1, the point is not part of a keyhole
+        // If the value of flags[i] is >= 0, it represents a point that is
+        // close enough that it could be considered part of a keyhole.
+        flags.assign(numberOfPointsInLine, -1);
+        bool keyHoleExists = false;
+        for (int point1Id = 0; point1Id < numberOfPointsInLine; ++point1Id)
         {
-          vtkSmartPointer<vtkLine> newLine = vtkSmartPointer<vtkLine>::New();
-          newLine->GetPoints()->SetData(originalLinePoints->GetData());
-
-          vtkSmartPointer<vtkIdList> newLineIds = newLine->GetPointIds();
-          newLineIds->Initialize();
-
-          newLines.push_back(newLine);
-          rawLinePointIds.push_back(newLineIds);
+          const double* point1 = &coordinates[3 * originalLinePointIds[point1Id]];
+          const vtkTypeInt64* gridCell = &pointGridCells[3 * point1Id];
+          closePointIndices.clear();
+          for (int offsetK = -1; offsetK <= 1; ++offsetK)
+          {
+            for (int offsetJ = -1; offsetJ <= 1; ++offsetJ)
+            {
+              for (int offsetI = -1; offsetI <= 1; ++offsetI)
+              {
+                vtkTypeUInt64 key = gridCellKey(gridCell[0] + offsetI, gridCell[1] + offsetJ, gridCell[2] + offsetK);
+                auto cellRange = std::equal_range(sortedGridCellKeys.begin(), sortedGridCellKeys.end(), std::make_pair(key, vtkIdType(0)),
+                  [](const std::pair<vtkTypeUInt64, vtkIdType>& a, const std::pair<vtkTypeUInt64, vtkIdType>& b) { return a.first < b.first; });
+                for (auto cellIt = cellRange.first; cellIt != cellRange.second; ++cellIt)
+                {
+                  int point2Id = static_cast<int>(cellIt->second);
+
+                  // Make sure the points are not too close together on the line index-wise
+                  int pointsOfSeperation = std::min(point2Id - point1Id, numberOfPointsInLine - 1 - point2Id + point1Id);
+                  if (pointsOfSeperation > minimumSeperation
+                    && vtkMath::Distance2BetweenPoints(point1, &coordinates[3 * originalLinePointIds[point2Id]]) <= epsilonSquared)
+                  {
+                    closePointIndices.push_back(point2Id);
+                  }
+                }
+              }
+            }
+          }
+          // Hash collisions of neighboring cells may report the same point more than once
+          std::sort(closePointIndices.begin(), closePointIndices.end());
+          closePointIndices.erase(std::unique(closePointIndices.begin(), closePointIndices.end()), closePointIndices.end());
+          for (int point2Id : closePointIndices)
+          {
+            keyHoleExists = true;
+            flags[point1Id] = point2Id;
+            flags[point2Id] = point1Id;
+          }
         }
 
-        int currentPointId = originalLine->GetPointId(currentPointIndex);
-
-        // If the current point is not part of a keyhole, add it to the current line
-        if (flags[currentPointIndex] == -1)
+        std::vector<std::vector<vtkIdType> > newLines;
+        if (!keyHoleExists)
         {
-          rawLinePointIds[currentLayer]->InsertNextId(currentPointId);
-          pointInChannel = false;
+          newLines.emplace_back(originalLinePointIds, originalLinePointIds + numberOfPointsInLine);
         }
         else
         {
-          // If the current point is the start of a keyhole add the point to the line,
-          // increment the layer, and start the channel.
-          if (flags[currentPointIndex] > currentPointIndex && !pointInChannel)
+          // Split the line at the keyholes
+          size_t currentLayer = 0;
+          bool pointInChannel = false;
+          std::vector<size_t> rawLineIndices;
+          std::vector<size_t> finishedLineIndices;
+          for (int currentPointIndex = 0; currentPointIndex < numberOfPointsInLine; ++currentPointIndex)
           {
-            rawLinePointIds[currentLayer]->InsertNextId(currentPointId);
-            ++currentLayer;
-            pointInChannel = true;
+            // Add a new line if necessary
+            if (currentLayer == rawLineIndices.size())
+            {
+              rawLineIndices.push_back(newLines.size());
+              newLines.emplace_back();
+            }
+
+            vtkIdType currentPointId = originalLinePointIds[currentPointIndex];
+            if (flags[currentPointIndex] == -1)
+            {
+              newLines[rawLineIndices[currentLayer]].push_back(currentPointId);
+              pointInChannel = false;
+            }
+            else if (flags[currentPointIndex] > currentPointIndex && !pointInChannel)
+            {
+              newLines[rawLineIndices[currentLayer]].push_back(currentPointId);
+              ++currentLayer;
+              pointInChannel = true;
+            }
+            else if (flags[currentPointIndex] < currentPointIndex && !pointInChannel)
+            {
+              newLines[rawLineIndices[currentLayer]].push_back(currentPointId);
+              finishedLineIndices.push_back(rawLineIndices[currentLayer]);
+              rawLineIndices.pop_back();
+              if (currentLayer > 0)
+              {
+                --currentLayer;
+              }
+              pointInChannel = true;
+            }
           }
-          // If the current point is the end of a volume in the keyhole, add the point
-          // to the line, remove the current line from the working list, deincrement
-          // the layer, add the current line to the finished lines and start the,
-          // channel.
-          else if (flags[currentPointIndex] < currentPointIndex && !pointInChannel)
+          finishedLineIndices.insert(finishedLineIndices.end(), rawLineIndices.begin(), rawLineIndices.end());
+
+          // Make sure that the completed lines are closed
+          for (size_t finishedLineIndex : finishedLineIndices)
           {
-            rawLinePointIds[currentLayer]->InsertNextId(currentPointId);
-            finishedLinePointIds.push_back(rawLinePointIds[currentLayer]);
-            rawLinePointIds.pop_back();
-            if (currentLayer > 0)
+            std::vector<vtkIdType>& finishedLine = newLines[finishedLineIndex];
+            if (!finishedLine.empty() && finishedLine.front() != finishedLine.back())
             {
-              --currentLayer;
+              finishedLine.push_back(finishedLine.front());
             }
-            pointInChannel = true;
           }
         }
-      }
-
-      // Add the remaining line to the finished list.
-      for (size_t remainingLineId = 0; remainingLineId < rawLinePointIds.size(); ++remainingLineId)
-      {
-        finishedLinePointIds.push_back(rawLinePointIds[remainingLineId]);
-      }
 
-      // Loop through the completed lines and make sure that they are closed
-      for (size_t finishedLineId = 0; finishedLineId < finishedLinePointIds.size(); ++finishedLineId)
-      {
-        if (finishedLinePointIds[finishedLineId]->GetNumberOfIds() > 0
-          && finishedLinePointIds[finishedLineId]->GetId(0) != finishedLinePointIds[finishedLineId]->GetId(finishedLinePointIds[finishedLineId]->GetNumberOfIds() - 1))
+        // Keep the lines with more than one point and orient them counter-clockwise
+        std::vector<std::vector<vtkIdType> >& outputLines = outputLinesOfInputLines[lineIndex];
+        for (std::vector<vtkIdType>& newLine : newLines)
         {
-          finishedLinePointIds[finishedLineId]->InsertNextId(finishedLinePointIds[finishedLineId]->GetId(0));
+          if (newLine.size() < 2)
+          {
+            continue;
+          }
+
+          // Twice the signed area of the line, positive if the line is clockwise
+          double areaSum = 0.0;
+          for (size_t pointIndex = 0; pointIndex + 1 < newLine.size(); ++pointIndex)
+          {
+            const double* point1 = &coordinates[3 * newLine[pointIndex]];
+            const double* point2 = &coordinates[3 * newLine[pointIndex + 1]];
+            areaSum += (point2[0] - point1[0]) * (point2[1] + point1[1]);
+          }
+          if (areaSum > 0)
+          {
+            std::reverse(newLine.begin(), newLine.end());
+          }
+          outputLines.push_back(std::move(newLine));
         }
       }
+    });
 
-    }
-  }
-
+  // Replace the lines in the input data with the modified lines.
   vtkSmartPointer<vtkCellArray> outputLines = vtkSmartPointer<vtkCellArray>::New();
   outputLines->Initialize();
-  inputROIPoints->DeleteCells();
-  for (size_t currentLineIndex = 0; currentLineIndex < newLines.size(); ++currentLineIndex)
-  {
-    // Only add the lines if they have more than 2 points
-    if (newLines[currentLineIndex]->GetNumberOfPoints() > 1)
-    {
-      outputLines->InsertNextCell(newLines[currentLineIndex]);
-    }
-  }
-  inputROIPoints->SetLines(outputLines);
-  inputROIPoints->BuildCells();
-}
-
-//----------------------------------------------------------------------------
-void vtkPlanarContourToClosedSurfaceConversionRule::SetLinesCounterClockwise(vtkPolyData* inputROIPoints)
-{
-  if (!inputROIPoints)
+  for (const std::vector<std::vector<vtkIdType> >& outputLinesOfInputLine : outputLinesOfInputLines)
   {
-    vtkErrorMacro("inputROIPoints: Invalid vtkPolyData!");
-    return;
-  }
-
-  int numberOfLines = inputROIPoints->GetNumberOfLines();
-
-  std::vector<vtkSmartPointer<vtkLine> > newLines;
-
-  for (int currentLineId = 0; currentLineId < numberOfLines; ++currentLineId)
-  {
-    vtkSmartPointer<vtkLine> currentLine = vtkSmartPointer<vtkLine>::New();
-    currentLine->DeepCopy(inputROIPoints->GetCell(currentLineId));
-
-    vtkSmartPointer<vtkPoints> currentPoints = currentLine->GetPoints();
-
-    if (IsLineClockwise(inputROIPoints, currentLine))
+    for (const std::vector<vtkIdType>& outputLine : outputLinesOfInputLine)
     {
-      vtkSmartPointer<vtkLine> newLine = vtkSmartPointer<vtkLine>::New();
-      vtkSmartPointer<vtkIdList> newLineIds = newLine->GetPointIds();
-      newLineIds->Initialize();
-
-      this->ReverseLine(currentLine, newLine);
-      newLines.push_back(newLine);
-
-    }
-    else
-    {
-      newLines.push_back(currentLine);
+      outputLines->InsertNextCell(static_cast<vtkIdType>(outputLine.size()), outputLine.data());
     }
   }
-
-  // Replace the lines in the input data with the modified lines.
-  vtkSmartPointer<vtkCellArray> outputLines = vtkSmartPointer<vtkCellArray>::New();
-  outputLines->Initialize();
   inputROIPoints->DeleteCells();
-  for (size_t currentLineIndex = 0; currentLineIndex < newLines.size(); ++currentLineIndex)
-  {
-    outputLines->InsertNextCell(newLines[currentLineIndex]);
-  }
   inputROIPoints->SetLines(outputLines);
   inputROIPoints->BuildCells();
-
 }
 
 //----------------------------------------------------------------------------
@@ -907,63 +1128,6 @@ void vtkPlanarContourToClosedSurfaceConversionRule::ReverseLine(vtkLine* origina
   }
 }
 
-//----------------------------------------------------------------------------
-int vtkPlanarContourToClosedSurfaceConversionRule::GetNumberOfLinesOnPlane(vtkPolyData* inputROIPoints, vtkIdType originalLineIndex, double spacing)
-{
-  if (!inputROIPoints)
-  {
-    vtkErrorMacro("GetNumberOfLinesOnPlane: Invalid vtkPolyData!");
-    return 0;
-  }
-
-  int numberOfLines = inputROIPoints->GetNumberOfLines();
-
-  double contourPlaneThreshold = 0.1*spacing;
-  double lineZ = (inputROIPoints->GetCell(originalLineIndex)->GetBounds()[4] + inputROIPoints->GetCell(originalLineIndex)->GetBounds()[5]) / 2.0; // z-value
-  vtkIdType currentLineId = originalLineIndex + 1;
-
-  while (currentLineId < numberOfLines)
-  {
-    double currentLineZDifference = std::abs(0.5*(inputROIPoints->GetCell(currentLineId)->GetBounds()[4] + inputROIPoints->GetCell(currentLineId)->GetBounds()[5]) - lineZ);
-    if (currentLineZDifference < contourPlaneThreshold)
-    {
-      currentLineId++;
-    }
-    else
-    {
-      break;
-    }
-  }
-  return currentLineId - originalLineIndex;
-}
-
-//----------------------------------------------------------------------------
-bool vtkPlanarContourToClosedSurfaceConversionRule::DoLinesOverlap(vtkLine* line1, vtkLine* line2)
-{
-  if (!line1)
-  {
-    vtkErrorMacro("DoLinesOverlap: Invalid vtkLine!");
-    return false;
-  }
-
-  if (!line2)
-  {
-    vtkErrorMacro("DoLinesOverlap: Invalid vtkLine!");
-    return false;
-  }
-
-  double bounds1[6];
-  line1->GetBounds(bounds1);
-
-  double bounds2[6];
-  line2->GetBounds(bounds2);
-
-  return bounds1[0] < bounds2[1] &&
-    bounds1[1] > bounds2[0] &&
-    bounds1[2] < bounds2[3] &&
-    bounds1[3] > bounds2[2];
-}
-
 // TODO: It may be possible to speed up this function by only calling the branch function once. -- need to look into this
 //----------------------------------------------------------------------------
 void vtkPlanarContourToClosedSurfaceConversionRule::Branch(vtkPolyData* inputROIPoints, vtkLine* branchingLine, vtkIdType currentLineId, std::vector< vtkIdType > overlappingLineIds, std::vector<vtkSmartPointer<vtkPointLocator> > pointLocators, std::vector<vtkSmartPointer<vtkIdList> > lineIdLists, vtkLine* outputLine)
@@ -1066,7 +1230,7 @@ int vtkPlanarContourToClosedSurfaceConversionRule::GetClosestBranch(vtkPolyData*
 }
 
 //----------------------------------------------------------------------------
-void vtkPlanarContourToClosedSurfaceConversionRule::EndCapping(vtkPolyData* inputROIPoints, vtkCellArray* outputPolygons, std::vector< bool > lineTriganulatedToAbove, std::vector< bool > lineTriganulatedToBelow)
+void vtkPlanarContourToClosedSurfaceConversionRule::EndCapping(vtkPolyData* inputROIPoints, vtkCellArray* outputPolygons, std::vector< bool > lineTriganulatedToAbove, std::vector< bool > lineTriganulatedToBelow, double lineSpacing)
 {
   if (!inputROIPoints)
   {
@@ -1081,7 +1245,6 @@ void vtkPlanarContourToClosedSurfaceConversionRule::EndCapping(vtkPolyData* inpu
   }
 
   int numberOfLines = inputROIPoints->GetNumberOfLines();
-  double lineSpacing = this->GetSpacingBetweenLines(inputROIPoints);
 
   // Loop through all of the lines in the polydata
   for (int currentLineIndex = 0; currentLineIndex < numberOfLines; ++currentLineIndex)
@@ -1181,38 +1344,18 @@ double vtkPlanarContourToClosedSurfaceConversionRule::GetSpacingBetweenLines(vtk
   }
 
   // Vector containing the distance between lines on adjacent contour slices.
+  // The contour spacing values are cached on the poly data, so repeated calls on the same contours are cheap.
   std::vector<double> distances;
   double distanceSum = 0.0;
-
-  // Loop through all of the lines
-  vtkIdType lineId = 0;
-  while (lineId < inputROIPoints->GetNumberOfLines() - 1)
+  vtkPlanarContourPlaneGeometry* planeGeometry = vtkPlanarContourPlaneGeometry::GetContourPlaneGeometry(inputROIPoints);
+  for (double distance : planeGeometry->GetContourSpacingValues())
   {
-
-    // First line
-    vtkSmartPointer<vtkLine> line1 = vtkSmartPointer<vtkLine>::New();
-    line1->DeepCopy(inputROIPoints->GetCell(lineId));
-
-    double line1Bounds[6] = { 0, 0, 0, 0, 0, 0 };
-    line1->GetBounds(line1Bounds);
-
-    // Second line
-    vtkSmartPointer<vtkLine> line2 = vtkSmartPointer<vtkLine>::New();
-    line2->DeepCopy(inputROIPoints->GetCell(lineId + 1));
-
-    double line2Bounds[6] = { 0, 0, 0, 0, 0, 0 };
-    line2->GetBounds(line2Bounds);
-
-    // Calculate the distance as the difference between the z value in the middle of the bounding boxes of the two lines.
-    double distance = std::abs((line1Bounds[4] + line1Bounds[5]) / 2 - (line2Bounds[4] + line2Bounds[5]) / 2);
-
     // If the distance between the lines is not zero, add it to the list
     if (distance > 0.01)
     {
       distances.push_back(distance);
       distanceSum += distance;
     }
-    ++lineId;
   }
 
   if (distances.size() == 0)
@@ -1838,48 +1981,11 @@ void vtkPlanarContourToClosedSurfaceConversionRule::CalculateContourTransform(vt
 //----------------------------------------------------------------------------
 void vtkPlanarContourToClosedSurfaceConversionRule::CalculateContourNormal(vtkPolyData* inputPolyData, double outputNormal[3], int minimumContourSize)
 {
-  vtkSmartPointer<vtkIdList> currentContour = vtkSmartPointer<vtkIdList>::New();
-
-  double meshNormalSum[3] = { 0, 0, 0 };
-
-  int numberOfSmallContours = 0;
-  int currentContourIndex = 0;
-  inputPolyData->GetLines()->InitTraversal();
-  while (inputPolyData->GetLines()->GetNextCell(currentContour))
-  {
-    double contourNormal[3] = { 0, 0, 0 };
-
-    vtkNew<vtkExtractCells> extract;
-    extract->SetInputData(inputPolyData);
-    extract->AddCellRange(currentContourIndex, currentContourIndex);
-    extract->Update();
-
-    if (extract->GetOutput()->GetNumberOfPoints() > minimumContourSize)
-    {
-      vtkNew<vtkTextureMapToPlane> textureMapToPlane;
-      textureMapToPlane->SetInputConnection(extract->GetOutputPort());
-      textureMapToPlane->Update();
-      textureMapToPlane->GetNormal(contourNormal);
-      vtkMath::Add(contourNormal, meshNormalSum, meshNormalSum);
-    }
-    else
-    {
-      ++numberOfSmallContours;
-    }
-    ++currentContourIndex;
-  }
-
-  // All contours had less than the minimum number of points.
-  // Return before divide by 0 error
-  if (numberOfSmallContours >= inputPolyData->GetNumberOfLines() || vtkMath::Norm(meshNormalSum) == 0.0)
+  // Contour normals are computed in one pass and cached on the poly data.
+  // If all contours have at most the minimum number of points then the output is left unchanged.
+  vtkPlanarContourPlaneGeometry* planeGeometry = vtkPlanarContourPlaneGeometry::GetContourPlaneGeometry(inputPolyData);
+  if (planeGeometry)
   {
-    return;
+    planeGeometry->GetAverageContourNormal(minimumContourSize, outputNormal);
   }
-
-  for (int i = 0; i < 3; ++i)
-  {
-    outputNormal[i] = meshNormalSum[i] / (inputPolyData->GetNumberOfLines() - numberOfSmallContours);
-  }
-  vtkMath::Normalize(outputNormal);
-
 }
@@ -32,6 +32,11 @@
 
 // VTK includes
 #include "vtkPointLocator.h"
+#include "vtkStaticPointLocator.h"
+#include "vtkWeakPointer.h"
+
+// STD includes
+#include <map>
 
 class vtkPolyData;
 class vtkIdList;
@@ -57,6 +62,9 @@ public:
   vtkSegmentationConverterRule* CreateRuleInstance() override;
 
   static const std::string GetDefaultSliceThicknessParameterName() { return "Default slice thickness"; };
+  /// If enabled, triangulations of adjacent contour plane pairs are cached between conversions
+  /// of the same planar contour representation, and only plane pairs with modified contours are re-triangulated
+  static const std::string GetIncrementalConversionParameterName() { return "Incremental conversion"; };
 
   /// Constructs representation object from representation name for the supported representation classes
   /// (typically source and target representation VTK classes, subclasses of vtkDataObject)
@@ -92,12 +100,109 @@ protected:
   ~vtkPlanarContourToClosedSurfaceConversionRule() override;
 
   /// Construct a surface triangulation between two lines using a dynamic programming algorithm.
+  /// Gathers the point coordinates and calls \sa TriangulateBetweenContourCoordinates. Used for end capping,
+  /// where the lines are created on the fly in the poly data
   /// \param inputROIPoints Polydata containing all of the points and contours
   /// \param pointsInLine1 List of points that are contained in the line to be triangulated
   /// \param pointsInLine2 List of points that are contained in the line to be triangulated
   /// \param Cell array that polygons are added to by the triangulation algorithm
   void TriangulateBetweenContours(vtkPolyData* inputROIPoints, vtkIdList* pointsInLine1, vtkIdList* pointsInLine2, vtkCellArray* outputPolygons);
 
+  /// Geometry of a contour line cached once per conversion, so that triangulation of the
+  /// plane pairs does not need to copy cells or query the poly data
+  struct ContourLineGeometry
+  {
+    /// Point ids of the line, the first id is repeated at the end for closed lines
+    std::vector<vtkIdType> PointIds;
+    /// Bounds of the line points
+    double Bounds[6];
+    /// Position of the contour plane (average Z, contours are aligned with the Z-axis)
+    double PlanePosition;
+    /// Whether the first point is repeated as the last point
+    bool Closed;
+    /// Thread-safe locator of the line points, indexed by position within the line
+    vtkSmartPointer<vtkStaticPointLocator> Locator;
+  };
+
+  /// Scratch buffers of the triangulation kernel. One instance is reused for all contour pairs
+  /// processed by a thread so that the dynamic programming tables are not reallocated per pair.
+  struct TriangulationScratch
+  {
+    std::vector<double> Line1Coordinates;
+    std::vector<double> Line2Coordinates;
+    std::vector<vtkIdType> ClosestPointFromLine1ToLine2;
+    std::vector<vtkIdType> ClosestPointFromLine2ToLine1;
+    std::vector<double> FirstColumnScores;
+    std::vector<double> PreviousRowScores;
+    std::vector<double> CurrentRowScores;
+    std::vector<char> BacktrackTable;
+  };
+
+  /// Construct a surface triangulation between two lines using a dynamic programming algorithm.
+  /// Operates on contiguous coordinate arrays.
+  /// Thread-safe, as long as each thread uses its own scratch buffers and output.
+  /// \param pointIdsInLine1 Point ids of the first line
+  /// \param line1Coordinates Coordinates of the points of the first line (x,y,z for each point, in line order)
+  /// \param numberOfPointsInLine1 Number of points in the first line
+  /// \param pointIdsInLine2 Point ids of the second line
+  /// \param line2Coordinates Coordinates of the points of the second line
+  /// \param numberOfPointsInLine2 Number of points in the second line
+  /// \param scratch Reusable scratch buffers
+  /// \param outputTriangles Point ids of the created triangles are appended to this vector (3 ids per triangle)
+  void TriangulateBetweenContourCoordinates(const vtkIdType* pointIdsInLine1, const double* line1Coordinates, vtkIdType numberOfPointsInLine1,
+    const vtkIdType* pointIdsInLine2, const double* line2Coordinates, vtkIdType numberOfPointsInLine2,
+    TriangulationScratch& scratch, std::vector<vtkIdType>& outputTriangles);
+
+  /// Compute cached geometry of a contour line.
+  /// \param coordinates Contiguous coordinates of all points in the contours
+  /// \param linePointIds Point ids of the line
+  /// \param lineGeometry Output geometry
+  void ComputeContourLineGeometry(const double* coordinates, vtkIdList* linePointIds, ContourLineGeometry& lineGeometry);
+
+  /// Create a branching pattern for overlapping contours using cached line geometry.
+  /// Same algorithm as \sa Branch. Thread-safe.
+  /// \param coordinates Contiguous coordinates of all points in the contours
+  /// \param lineGeometries Cached geometry of all lines
+  /// \param branchingLineIndex Index of the line that is being divided
+  /// \param currentLineIndex Index of the line that is being compared
+  /// \param overlappingLineIndices Indices of lines that overlap with the branching line
+  /// \param outputPointIds Point ids of the output branched line
+  void BranchContourLine(const double* coordinates, const std::vector<ContourLineGeometry>& lineGeometries, vtkIdType branchingLineIndex,
+    vtkIdType currentLineIndex, const std::vector<vtkIdType>& overlappingLineIndices, std::vector<vtkIdType>& outputPointIds);
+
+  /// Triangulation of a pair of adjacent contour planes, stored for incremental conversion.
+  /// Triangle vertices are stored as positions in the concatenated point ids of the lines of the pair,
+  /// so that the triangulation stays valid when point ids change elsewhere in the contours.
+  struct PlanePairTriangulation
+  {
+    /// Vertex positions of the triangles (3 per triangle)
+    std::vector<vtkIdType> TrianglePointPositions;
+    /// For each line in the pair: whether it was triangulated (to above for lines in the first plane,
+    /// to below for lines in the second plane)
+    std::vector<char> LinesTriangulated;
+  };
+
+  /// Cached plane pair triangulations of one planar contour representation, keyed by content hash
+  struct IncrementalConversionCache
+  {
+    vtkWeakPointer<vtkPolyData> SourceRepresentation;
+    std::map<vtkTypeUInt64, PlanePairTriangulation> PlanePairTriangulations;
+  };
+
+  /// Compute the content hash of a range of lines forming a pair of adjacent contour planes.
+  /// The hash covers the point coordinates, the line lengths, the plane split and which points are shared between lines.
+  /// \param coordinates Contiguous coordinates of all points in the contours
+  /// \param lineGeometries Cached geometry of all lines
+  /// \param firstLineIndex Index of the first line on the first plane
+  /// \param firstLineOnPlane2Index Index of the first line on the second plane
+  /// \param endLineIndex Index after the last line on the second plane
+  /// \param pairPointIds Output concatenated point ids of the lines
+  /// \param pointIdToPosition Output position of the first occurrence of each point id in pairPointIds
+  /// \return Content hash of the plane pair
+  vtkTypeUInt64 ComputePlanePairSignature(const double* coordinates, const std::vector<ContourLineGeometry>& lineGeometries,
+    vtkIdType firstLineIndex, vtkIdType firstLineOnPlane2Index, vtkIdType endLineIndex,
+    std::vector<vtkIdType>& pairPointIds, std::map<vtkIdType, vtkIdType>& pointIdToPosition);
+
   /// Find the index of the last point in a contour.
   /// \param startLoopIndex The index of the first point in the contour
   /// \param numberOfPoints The number of points in the contour
@@ -105,26 +210,17 @@ protected:
   /// \return The index of the last point in the contour
   vtkIdType GetEndLoop(vtkIdType startLoopIndex, int numberOfPoints, bool loopClosed);
 
-  /// Find the point on the given line that is closest to the given point.
-  /// \param inputROIPoints Polydata containing all of the points and contours
-  /// \param originalPoint The point that is being compared to the line
-  /// \param linePointIds The line that is being compared to the point
-  /// \return The index of the point in the line that is closet to the specified point
-  vtkIdType GetClosestPoint(vtkPolyData* inputROIPoints, double* originalPoint, vtkIdList* linePointIds);
-
   /// Sort the contours based on Z value.
   /// \param inputROIPoints Polydata containing all of the points and contours
   void SortContours(vtkPolyData* inputROIPoints);
 
-  /// Remove the keyholes from the contours.
+  /// Remove the keyholes from the contours and set all of the lines to be oriented counter-clockwise.
+  /// Done in a single traversal per contour, in parallel over the contours. Close points are found using
+  /// a uniform grid hash of the contour points.
   /// \param inputROIPoints Polydata containing all of the points and contours
   /// \param The minimum distance between two points in mm before points are considered to be part of a keyhole
   /// \param The minimum number of seperation of indices between points before they can be part of a keyhole
-  void FixKeyholes(vtkPolyData* inputROIPoints, double epsilon, int minimumSeperation);
-
-  /// Set all of the lines to be oriented in the clockwise direction.
-  /// \param inputROIPoints Polydata containing all of the points and contours
-  void SetLinesCounterClockwise(vtkPolyData* inputROIPoints);
+  void FixKeyholesAndSetLinesCounterClockwise(vtkPolyData* inputROIPoints, double epsilon, int minimumSeperation);
 
   /// Determine if a line runs in a clockwise orientation.
   /// \param inputROIPoints Polydata containing all of the points and contours
@@ -136,18 +232,6 @@ protected:
   /// \param newLine The output reversed line
   void ReverseLine(vtkLine* originalLine, vtkLine* newLine);
 
-  /// Determine the number of contours that share the same Z-coordinates.
-  /// WARNING: This function requires that the normal vector of all contours is aligned with the Z-axis.
-  /// \param inputROIPoints Polydata containing all of the points and contours
-  /// \param originalLineIndex The index of the line that is part of the plane being checked
-  /// \param spacing The spacing between lines
-  int GetNumberOfLinesOnPlane(vtkPolyData* inputROIPoints, vtkIdType originalLineIndex, double spacing);
-
-  /// Determine if two contours overlap in the XY axis.
-  /// \param The first line
-  /// \param The second line
-  bool DoLinesOverlap(vtkLine* line1, vtkLine* line2);
-
   /// Create a branching pattern for overlapping contours.
   /// \param inputROIPoints Polydata containing all of the points and contours
   /// \param branchingLine The orignal line that is being divided
@@ -172,10 +256,12 @@ protected:
   /// \param outputPolygons
   /// \param lineTriganulatedToAbove
   /// \param lineTriganulatedToBelow
-  void EndCapping(vtkPolyData* inputROIPoints, vtkCellArray* outputPolygons, std::vector< bool > lineTriganulatedToAbove, std::vector< bool > lineTriganulatedToBelow);
+  /// \param lineSpacing Spacing between the contours \sa GetSpacingBetweenLines
+  void EndCapping(vtkPolyData* inputROIPoints, vtkCellArray* outputPolygons, std::vector< bool > lineTriganulatedToAbove, std::vector< bool > lineTriganulatedToBelow, double lineSpacing);
 
-  /// Calculate the spacing between the lines in the polydata
-  /// WARNING: This function requires that the normal vector of all contours is aligned with the Z-axis.
+  /// Calculate the spacing between the lines in the polydata.
+  /// The distances are measured along the contour normal between adjacent lines
+  /// (\sa vtkPlanarContourPlaneGeometry::GetContourSpacingValues).
   /// \param inputROIPoints Polydata containing all of the points and contours
   /// \return The size of the spacing between the contours
   double GetSpacingBetweenLines(vtkPolyData* inputROIPoints);
@@ -264,6 +350,9 @@ protected:
   // Image padding size that is used in the end-capping process
   int ImagePadding[3];
 
+  // Plane pair triangulations of previously converted planar contour representations (for incremental conversion)
+  std::map<vtkPolyData*, IncrementalConversionCache> IncrementalConversionCaches;
+
 private:
   vtkPlanarContourToClosedSurfaceConversionRule(const vtkPlanarContourToClosedSurfaceConversionRule&) = delete;
   void operator=(const vtkPlanarContourToClosedSurfaceConversionRule&) = delete;
@@ -20,18 +20,27 @@
 
 // Segmentations includes
 #include "vtkPlanarContourToRibbonModelConversionRule.h"
+#include "vtkPlanarContourPlaneGeometry.h"
 
 // VTK includes
 #include <vtkObjectFactory.h>
-#include <vtkVector.h>
 #include <vtkPolyData.h>
-#include <vtkCell.h>
 #include <vtkIdList.h>
 #include <vtkPlane.h>
 #include <vtkCleanPolyData.h>
 #include <vtkPolyDataNormals.h>
 #include <vtkRibbonFilter.h>
 #include <vtkMath.h>
+#include <vtkCellArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+#include <vtkVariant.h>
+
+// STD includes
+#include <algorithm>
 
 #if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
 // SegmentationCore includes
@@ -42,20 +51,6 @@
 // Utility functions
 namespace
 {
-  vtkVector3d operator -(const vtkVector3d& a, const vtkVector3d& b)
-  {
-    vtkVector3d result;
-    result.SetX(a.GetX() - b.GetX());
-    result.SetY(a.GetY() - b.GetY());
-    result.SetZ(a.GetZ() - b.GetZ());
-    return result;
-  }
-
-  bool AreEqualWithTolerance(double a, double b)
-  {
-    return fabs(a - b) < EPSILON;
-  }
-
   double MajorityValue(const std::vector<double>& spacingValues, std::string &outputMessage)
   {
     std::map<double, int> spacingValueFrequencies;
@@ -83,6 +78,82 @@ namespace
     outputMessage = outputStringStream.str();
     return majorityValue;
   }
+
+  //----------------------------------------------------------------------------
+  /// Extrudes contour lines into triangle strips. Each contour has its own preallocated range in the outputs
+  class RibbonBuilderFunctor
+  {
+  public:
+    vtkPoints* ContourPoints;
+    /// Point IDs of the contours (duplicate consecutive points already removed)
+    const std::vector<vtkIdType>* ContourPointIds;
+    /// Start of each contour in ContourPointIds. Contains number of contours + 1 elements.
+    /// Contour i has ribbon points from 2*ContourOffsets[i], and its strip cell starts at ContourOffsets[i]*2+i
+    const std::vector<vtkIdType>* ContourOffsets;
+    double Normal[3];
+    double HalfWidth;
+    double* RibbonPoints;
+    float* RibbonNormals;
+    vtkIdType* Strips;
+
+    void operator()(vtkIdType beginContour, vtkIdType endContour) const
+    {
+      const std::vector<vtkIdType>& pointIds = *this->ContourPointIds;
+      for (vtkIdType contour = beginContour; contour < endContour; ++contour)
+      {
+        vtkIdType firstIndex = (*this->ContourOffsets)[contour];
+        vtkIdType numberOfPoints = (*this->ContourOffsets)[contour+1] - firstIndex;
+
+        double firstPoint[3] = {0.0, 0.0, 0.0};
+        double lastPoint[3] = {0.0, 0.0, 0.0};
+        this->ContourPoints->GetPoint(pointIds[firstIndex], firstPoint);
+        this->ContourPoints->GetPoint(pointIds[firstIndex + numberOfPoints - 1], lastPoint);
+        bool closed = (numberOfPoints > 2 && vtkMath::Distance2BetweenPoints(firstPoint, lastPoint) == 0.0);
+
+        vtkIdType* strip = this->Strips + firstIndex * 2 + contour;
+        strip[0] = 2 * numberOfPoints;
+        for (vtkIdType index = 0; index < numberOfPoints; ++index)
+        {
+          // Tangent from the neighboring points (wrapping around the closing point of closed contours)
+          vtkIdType previousIndex = index - 1;
+          vtkIdType nextIndex = index + 1;
+          if (index == 0)
+          {
+            previousIndex = (closed ? numberOfPoints - 2 : 0);
+          }
+          if (index == numberOfPoints - 1)
+          {
+            nextIndex = (closed ? 1 : numberOfPoints - 1);
+          }
+          double point[3] = {0.0, 0.0, 0.0};
+          double previousPoint[3] = {0.0, 0.0, 0.0};
+          double nextPoint[3] = {0.0, 0.0, 0.0};
+          this->ContourPoints->GetPoint(pointIds[firstIndex + index], point);
+          this->ContourPoints->GetPoint(pointIds[firstIndex + previousIndex], previousPoint);
+          this->ContourPoints->GetPoint(pointIds[firstIndex + nextIndex], nextPoint);
+          double tangent[3] = { nextPoint[0] - previousPoint[0], nextPoint[1] - previousPoint[1], nextPoint[2] - previousPoint[2] };
+          double pointNormal[3] = {0.0, 0.0, 0.0};
+          vtkMath::Cross(tangent, this->Normal, pointNormal);
+          vtkMath::Normalize(pointNormal);
+
+          // Strip order is such that the triangle normals agree with the point normals
+          vtkIdType ribbonPointIndex = 2 * (firstIndex + index);
+          for (int side = 0; side < 2; ++side)
+          {
+            double offset = (side == 0 ? this->HalfWidth : -this->HalfWidth);
+            double* ribbonPoint = this->RibbonPoints + 3 * (ribbonPointIndex + side);
+            float* ribbonNormal = this->RibbonNormals + 3 * (ribbonPointIndex + side);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+              ribbonPoint[axis] = point[axis] + offset * this->Normal[axis];
+              ribbonNormal[axis] = static_cast<float>(pointNormal[axis]);
+            }
+            strip[1 + 2 * index + side] = ribbonPointIndex + side;
+          }
+        }
+      }
+    }
+  };
 }
 
 //----------------------------------------------------------------------------
@@ -92,6 +163,8 @@ vtkSegmentationConverterRuleNewMacro(vtkPlanarContourToRibbonModelConversionRule
 vtkPlanarContourToRibbonModelConversionRule::vtkPlanarContourToRibbonModelConversionRule()
 {
   //this->ConversionParameters[GetXYParameterName()] = std::make_pair("value", "description");
+  this->ConversionParameters[this->GetDirectRibbonBuilderParameterName()] = std::make_pair("1",
+    "Build the ribbon directly by extruding the contours along the contour plane normal (1), or use vtkRibbonFilter (0).");
 }
 
 //----------------------------------------------------------------------------
@@ -173,6 +246,12 @@ bool vtkPlanarContourToRibbonModelConversionRule::Convert(vtkDataObject* sourceR
   vtkSmartPointer<vtkPlane> contoursPlane = vtkSmartPointer<vtkPlane>::New();
   double sliceThickness = this->ComputeContourPlaneSpacing(planarContourPolyData, contoursPlane);
 
+  if (vtkVariant(this->ConversionParameters[this->GetDirectRibbonBuilderParameterName()].first).ToInt() != 0)
+  {
+    this->BuildRibbonModel(planarContourPolyData, contoursPlane->GetNormal(), sliceThickness, ribbonModelPolyData);
+    return true;
+  }
+
   // Remove coincident points (if there are multiple contour points at the same position then the ribbon filter fails)
   vtkSmartPointer<vtkCleanPolyData> cleaner = vtkSmartPointer<vtkCleanPolyData>::New();
   cleaner->SetInputData(planarContourPolyData);
@@ -196,91 +275,6 @@ bool vtkPlanarContourToRibbonModelConversionRule::Convert(vtkDataObject* sourceR
   return true;
 }
 
-//----------------------------------------------------------------------------
-bool vtkPlanarContourToRibbonModelConversionRule::ComputePlaneForContour(vtkPoints* contourPoints, vtkCell* contourCell, vtkPlane* contourPlane)
-{
-  if (!contourPoints || !contourCell || !contourPlane)
-  {
-    vtkErrorMacro("ComputePlaneForContour: Invalid arguments!");
-    return false;
-  }
-
-  // Get point indices
-  vtkIdList* currentContourPointIds = contourCell->GetPointIds();
-  int numberOfPoints = currentContourPointIds->GetNumberOfIds();
-  if (numberOfPoints < 3)
-  {
-    vtkWarningMacro("ComputePlaneForContour: Contour does not contain enough points to extract a planar equation.");
-    return false;
-  }
-
-  // Compute equation of the current plane from the first point, and two other points about equal number of points away from the first one.
-  // This heuristic method attempts to get an as accurate plane normal vector as possible by maximizing expected distance between plane points.
-  int firstPointIndex = currentContourPointIds->GetId(0);
-  int secondPointIndex = currentContourPointIds->GetId(numberOfPoints / 3);
-  int thirdPointIndex = currentContourPointIds->GetId(2 * numberOfPoints / 3);
-  // Sanity check of indices
-  if (secondPointIndex == firstPointIndex || secondPointIndex == thirdPointIndex)
-  {
-    vtkErrorMacro("ComputePlaneForContour: Invalid contour point indices for computing plane equation. This is probably a bug, please report!");
-    return false;
-  }
-
-  // Get plane points
-  double firstPointArray[3] = {0.0,0.0,0.0};
-  contourPoints->GetPoint(firstPointIndex, firstPointArray);
-  double secondPointArray[3] = {0.0,0.0,0.0};
-  contourPoints->GetPoint(secondPointIndex, secondPointArray);
-  double thirdPointArray[3] = {0.0,0.0,0.0};
-  contourPoints->GetPoint(thirdPointIndex, thirdPointArray);
-  vtkVector3d firstPlanePoint(firstPointArray[0], firstPointArray[1], firstPointArray[2]);
-  vtkVector3d secondPlanePoint(secondPointArray[0], secondPointArray[1], secondPointArray[2]);
-  vtkVector3d thirdPlanePoint(thirdPointArray[0], thirdPointArray[1], thirdPointArray[2]);
-  // Compute plane vectors: two vectors on the plane, and the normal
-  vtkVector3d currentPlaneIVector(secondPlanePoint - firstPlanePoint);
-  vtkVector3d currentPlaneJVector(thirdPlanePoint - firstPlanePoint);
-  vtkVector3d currentPlaneKVector(currentPlaneIVector.Cross(currentPlaneJVector));
-
-  // Attempt to compute plane equation with brute force
-  // if the heuristic choice of plane points produces collinear vectors
-  if (currentPlaneKVector.GetX() == 0 && currentPlaneKVector.GetY() == 0 && currentPlaneKVector.GetZ() == 0)
-  {
-    for (int pointIndex=0; pointIndex<numberOfPoints-2; ++pointIndex)
-    {
-      contourPoints->GetPoint(pointIndex, firstPointArray);
-      contourPoints->GetPoint(pointIndex+1, secondPointArray);
-      contourPoints->GetPoint(pointIndex+2, thirdPointArray);
-      firstPlanePoint = vtkVector3d(firstPointArray[0], firstPointArray[1], firstPointArray[2]);
-      secondPlanePoint = vtkVector3d(secondPointArray[0], secondPointArray[1], secondPointArray[2]);
-      thirdPlanePoint = vtkVector3d(thirdPointArray[0], thirdPointArray[1], thirdPointArray[2]);
-      currentPlaneIVector = secondPlanePoint - firstPlanePoint;
-      currentPlaneJVector = thirdPlanePoint - firstPlanePoint;
-      currentPlaneKVector = currentPlaneIVector.Cross(currentPlaneJVector);
-
-      if (!(currentPlaneKVector.GetX() == 0 && currentPlaneKVector.GetY() == 0 && currentPlaneKVector.GetZ() == 0))
-      {
-        break;
-      }
-    }
-
-    // Check for valid plane vector and report failure if all attempts failed to produce a valid one
-    if (currentPlaneKVector.GetX() == 0 && currentPlaneKVector.GetY() == 0 && currentPlaneKVector.GetZ() == 0)
-    {
-      vtkErrorMacro("ComputePlaneForContour: All points in contour plane produce co-linear vectors. Unable to determine equation of the plane.");
-      return false;
-    }
-  }
-
-  // Normalize normal vector
-  currentPlaneKVector.Normalize();
-
-  // Setup output computed plane
-  contourPlane->SetNormal(currentPlaneKVector.GetX(), currentPlaneKVector.GetY(), currentPlaneKVector.GetZ());
-  contourPlane->SetOrigin(firstPlanePoint.GetX(), firstPlanePoint.GetY(), firstPlanePoint.GetZ());
-
-  return true;
-}
-
 //----------------------------------------------------------------------------
 double vtkPlanarContourToRibbonModelConversionRule::ComputeContourPlaneSpacing(vtkPolyData* planarContourPolyData, vtkPlane* contoursPlane)
 {
@@ -297,113 +291,120 @@ double vtkPlanarContourToRibbonModelConversionRule::ComputeContourPlaneSpacing(v
     return 1.0;
   }
 
-  // Get all contour points
-  vtkPoints* points = planarContourPolyData->GetPoints();
-
-  // Computed output variables
-  std::vector<double> planeSpacingValues;
-  bool consistentPlaneSpacing = true;
-  double distanceBetweenContourPlanes = -1.0; // The found distance between planes if consistent
-
-  // All contour planes, with their distances from the first plane
-  std::map< vtkSmartPointer<vtkPlane>, double > contourPlanes;
-  double firstNormal[3] = {0.0,0.0,0.0};
-  double firstOrigin[3] = {0.0,0.0,0.0};
-
-  // Iterate over each contour in the set, computing planar spacing values for every contour
-  for (int contourIndex = 0; contourIndex < planarContourPolyData->GetNumberOfCells(); ++contourIndex)
+  // Plane geometry is computed once per contour poly data and shared with the other conversion rules
+  vtkPlanarContourPlaneGeometry* planeGeometry = vtkPlanarContourPlaneGeometry::GetContourPlaneGeometry(planarContourPolyData);
+  for (int contourIndex = 0; contourIndex < planeGeometry->GetNumberOfContours(); ++contourIndex)
   {
-    // Get contour cell
-    vtkCell* currentContour = planarContourPolyData->GetCell(contourIndex);
-
-    // Compute contour plane
-    vtkSmartPointer<vtkPlane> currentContourPlane = vtkSmartPointer<vtkPlane>::New();
-    bool validPlane = this->ComputePlaneForContour(points, currentContour, currentContourPlane);
-    if (!validPlane)
+    if (!planeGeometry->IsContourPlaneValid(contourIndex))
     {
       vtkWarningMacro("ComputeContourPlaneSpacing: Unable to calculate plane for contour " << contourIndex << ". Skipping contour.");
-      continue;
     }
+  }
 
-    // Store first plane parameters to compute distances
-    if (contourPlanes.empty())
-    {
-      currentContourPlane->GetNormal(firstNormal);
-      currentContourPlane->GetOrigin(firstOrigin);
-      contourPlanes[currentContourPlane] = 0.0;
+  // Set first valid plane as output contours plane
+  if (contoursPlane)
+  {
+    contoursPlane->SetOrigin(planeGeometry->GetReferenceOrigin());
+    contoursPlane->SetNormal(planeGeometry->GetReferenceNormal());
+  }
 
-      // Set first valid plane as output contours plane
-      if (contoursPlane)
-      {
-        contoursPlane->SetOrigin(currentContourPlane->GetOrigin());
-        contoursPlane->SetNormal(currentContourPlane->GetNormal());
-      }
-    }
-    // Compute distance from first plane (also check if they are parallel)
-    else
-    {
-      double normal[3] = {0.0,0.0,0.0};
-      currentContourPlane->GetNormal(normal);
-      // We accept normal vectors with the exact opposite direction, so we accept if their dot product is 1 or -1 (normal vectors have magnitude of 1)
-      double dotProduct = (normal[0]*firstNormal[0]) + (normal[1]*firstNormal[1]) + (normal[2]*firstNormal[2]);
-      if (!AreEqualWithTolerance(fabs(dotProduct), 1.0))
-      {
-        vtkErrorMacro("ComputeContourPlaneSpacing: Contour planes in structures set are not parallel!");
-      }
+  if (!planeGeometry->GetContourPlanesParallel())
+  {
+    vtkErrorMacro("ComputeContourPlaneSpacing: Contour planes in structures set are not parallel!");
+  }
 
-      // Store distance of current plane from first plane
-      double distanceFromFirstPlane = vtkPlane::DistanceToPlane(firstOrigin, normal, currentContourPlane->GetOrigin());
-      contourPlanes[currentContourPlane] = distanceFromFirstPlane;
-    }
-  } // For all contour planes
+  double distanceBetweenContourPlanes = planeGeometry->GetPlaneSpacingMode();
+
+  // Report the frequencies of the spacing values if inconsistent spacing was found
+  if (!planeGeometry->GetConsistentPlaneSpacing())
+  {
+    std::string message("");
+    distanceBetweenContourPlanes = MajorityValue(planeGeometry->GetPlaneSpacingValues(), message);
+    vtkWarningMacro("ComputeContourPlaneSpacing: Inconsistent plane spacing. Details:\n" << message << "Used contour spacing: " << distanceBetweenContourPlanes);
+  }
+
+  return distanceBetweenContourPlanes;
+}
 
-  // Order computed contour planes
-  std::map< double, vtkSmartPointer<vtkPlane> > orderedContourPlanes;
-  std::map< vtkSmartPointer<vtkPlane>, double >::iterator planesIt;
-  for (planesIt=contourPlanes.begin(); planesIt != contourPlanes.end(); ++planesIt)
+//----------------------------------------------------------------------------
+void vtkPlanarContourToRibbonModelConversionRule::BuildRibbonModel(
+  vtkPolyData* planarContourPolyData, double normal[3], double width, vtkPolyData* ribbonModelPolyData)
+{
+  ribbonModelPolyData->Initialize();
+  vtkPoints* contourPoints = planarContourPolyData->GetPoints();
+  vtkCellArray* lines = planarContourPolyData->GetLines();
+  if (!contourPoints || !lines)
   {
-    // Swap map to have the ordering by distance from first plane
-    orderedContourPlanes[planesIt->second] = planesIt->first;
+    return;
   }
 
-  // Compute distances between adjacent planes
-  std::map< double, vtkSmartPointer<vtkPlane> >::iterator orderedPlanesIt;
-  double previousDistance = 0.0;
-  for (orderedPlanesIt=orderedContourPlanes.begin(); orderedPlanesIt != orderedContourPlanes.end(); ++orderedPlanesIt)
+  // Collect contour point IDs without coincident consecutive points (the strip would be degenerate there)
+  std::vector<vtkIdType> contourPointIds;
+  contourPointIds.reserve(lines->GetNumberOfConnectivityEntries());
+  std::vector<vtkIdType> contourOffsets(1, 0);
+  vtkSmartPointer<vtkIdList> linePointIds = vtkSmartPointer<vtkIdList>::New();
+  lines->InitTraversal();
+  while (lines->GetNextCell(linePointIds))
   {
-    if (orderedPlanesIt != orderedContourPlanes.begin()) // We skip the first one, just save its distance as previous
+    vtkIdType contourStart = static_cast<vtkIdType>(contourPointIds.size());
+    double previousPoint[3] = {0.0, 0.0, 0.0};
+    for (vtkIdType index = 0; index < linePointIds->GetNumberOfIds(); ++index)
     {
-      double currentDistance = fabs(orderedPlanesIt->first - previousDistance);
-      if (!AreEqualWithTolerance(currentDistance, 0.0))
+      double point[3] = {0.0, 0.0, 0.0};
+      contourPoints->GetPoint(linePointIds->GetId(index), point);
+      if (index > 0 && vtkMath::Distance2BetweenPoints(point, previousPoint) == 0.0)
       {
-        // Only add spacing value if it's not 0 - multiple contours may be drawn on the same plane and it's not considered for slice thickness computation
-        planeSpacingValues.push_back(currentDistance);
-
-        // Store current spacing as found spacing if has not been set
-        if (distanceBetweenContourPlanes == -1.0)
-        {
-          distanceBetweenContourPlanes = currentDistance;
-        }
-
-        // Check for inconsistency
-        if ( !AreEqualWithTolerance(currentDistance, distanceBetweenContourPlanes)
-          && consistentPlaneSpacing ) // Only prompt the warning once
-        {
-          vtkWarningMacro("ComputeContourPlaneSpacing: Contour does not have consistent plane spacing (" << currentDistance << " != " << distanceBetweenContourPlanes << "). Using majority spacing value.");
-          consistentPlaneSpacing = false;
-        }
-      } // If non-zero
+        continue;
+      }
+      contourPointIds.push_back(linePointIds->GetId(index));
+      previousPoint[0] = point[0];
+      previousPoint[1] = point[1];
+      previousPoint[2] = point[2];
     }
-    previousDistance = orderedPlanesIt->first;
+    if (static_cast<vtkIdType>(contourPointIds.size()) - contourStart < 2)
+    {
+      contourPointIds.resize(contourStart); // No ribbon from a single point
+      continue;
+    }
+    contourOffsets.push_back(static_cast<vtkIdType>(contourPointIds.size()));
   }
-
-  // Calculate the majority value for the plane spacing from plane spacing values if inconsistent spacing was found
-  if (!consistentPlaneSpacing)
+  vtkIdType numberOfContours = static_cast<vtkIdType>(contourOffsets.size()) - 1;
+  vtkIdType numberOfContourPoints = static_cast<vtkIdType>(contourPointIds.size());
+  if (numberOfContours == 0)
   {
-    std::string message("");
-    distanceBetweenContourPlanes = MajorityValue(planeSpacingValues, message);
-    vtkWarningMacro("ComputeContourPlaneSpacing: Inconsistent plane spacing. Details:\n" << message << "Used contour spacing: " << distanceBetweenContourPlanes);
+    return;
   }
 
-  return distanceBetweenContourPlanes;
+  // Preallocate outputs
+  vtkSmartPointer<vtkDoubleArray> ribbonPointArray = vtkSmartPointer<vtkDoubleArray>::New();
+  ribbonPointArray->SetNumberOfComponents(3);
+  ribbonPointArray->SetNumberOfTuples(2 * numberOfContourPoints);
+  vtkSmartPointer<vtkFloatArray> ribbonNormalArray = vtkSmartPointer<vtkFloatArray>::New();
+  ribbonNormalArray->SetName("Normals");
+  ribbonNormalArray->SetNumberOfComponents(3);
+  ribbonNormalArray->SetNumberOfTuples(2 * numberOfContourPoints);
+  vtkSmartPointer<vtkIdTypeArray> stripArray = vtkSmartPointer<vtkIdTypeArray>::New();
+  stripArray->SetNumberOfValues(2 * numberOfContourPoints + numberOfContours);
+
+  RibbonBuilderFunctor functor;
+  functor.ContourPoints = contourPoints;
+  functor.ContourPointIds = &contourPointIds;
+  functor.ContourOffsets = &contourOffsets;
+  functor.Normal[0] = normal[0];
+  functor.Normal[1] = normal[1];
+  functor.Normal[2] = normal[2];
+  vtkMath::Normalize(functor.Normal);
+  functor.HalfWidth = width / 2.0;
+  functor.RibbonPoints = ribbonPointArray->GetPointer(0);
+  functor.RibbonNormals = ribbonNormalArray->GetPointer(0);
+  functor.Strips = stripArray->GetPointer(0);
+  vtkSMPTools::For(0, numberOfContours, functor);
+
+  vtkSmartPointer<vtkPoints> ribbonPoints = vtkSmartPointer<vtkPoints>::New();
+  ribbonPoints->SetData(ribbonPointArray);
+  vtkSmartPointer<vtkCellArray> strips = vtkSmartPointer<vtkCellArray>::New();
+  strips->SetCells(numberOfContours, stripArray);
+  ribbonModelPolyData->SetPoints(ribbonPoints);
+  ribbonModelPolyData->SetStrips(strips);
+  ribbonModelPolyData->GetPointData()->SetNormals(ribbonNormalArray);
 }
@@ -35,7 +35,6 @@
 
 class vtkPolyData;
 class vtkPoints;
-class vtkCell;
 class vtkPlane;
 
 /// \ingroup DicomRtImportImportExportConversionRules
@@ -50,6 +49,8 @@ public:
   vtkTypeMacro(vtkPlanarContourToRibbonModelConversionRule, vtkSegmentationConverterRule);
   vtkSegmentationConverterRule* CreateRuleInstance() override;
 
+  static const std::string GetDirectRibbonBuilderParameterName() { return "Direct ribbon builder"; };
+
   /// Constructs representation object from representation name for the supported representation classes
   /// (typically source and target representation VTK classes, subclasses of vtkDataObject)
   /// Note: Need to take ownership of the created object! For example using vtkSmartPointer<vtkDataObject>::Take
@@ -80,18 +81,21 @@ public:
   const char* GetTargetRepresentationName() override { return vtkSlicerRtCommon::SEGMENTATION_RIBBON_MODEL_REPRESENTATION_NAME; };
 
 protected:
-  /// Compute plane for a given contour
-  /// \param contourPoints Point list containing all the points (from which \sa contourCell selects a subset)
-  /// \param contourCell Input contour cell, indices of the points in \sa contourPoints belonging to the contour
-  /// \param contourPlane Computed contour plane (output argument)
-  bool ComputePlaneForContour(vtkPoints* contourPoints, vtkCell* contourCell, vtkPlane* contourPlane);
-
-  /// Determine the distance between contour planes based on the actual planar contour data
+  /// Determine the distance between contour planes based on the actual planar contour data.
+  /// Uses the plane geometry cached on the poly data (\sa vtkPlanarContourPlaneGeometry)
   /// \param planarContourPolyData Input poly data containing the planar contours
   /// \param contoursPlane Output argument for plane of the contours
   /// \return Computed plane spacing. 1mm in case of critical errors (so that the ribbon can be visualized in all cases)
   double ComputeContourPlaneSpacing(vtkPolyData* planarContourPolyData, vtkPlane* contoursPlane);
 
+  /// Create ribbon model by extruding each contour line along the contour plane normal into a triangle strip.
+  /// The points, normals and strips are preallocated, and the contours are processed in parallel
+  /// \param planarContourPolyData Input poly data containing the planar contours as lines
+  /// \param normal Unit normal vector of the contour planes
+  /// \param width Width of the ribbon along the normal
+  /// \param ribbonModelPolyData Output ribbon model
+  void BuildRibbonModel(vtkPolyData* planarContourPolyData, double normal[3], double width, vtkPolyData* ribbonModelPolyData);
+
 protected:
   vtkPlanarContourToRibbonModelConversionRule();
   ~vtkPlanarContourToRibbonModelConversionRule();
@@ -47,6 +47,7 @@
 
 // SlicerRT includes
 #include "vtkSlicerRtCommon.h"
+#include "vtkPolyDataMultiPlaneCutter.h"
 #include "PlmCommon.h"
 #include "vtkMRMLIsodoseNode.h"
 #include "vtkMRMLPlanarImageNode.h"
@@ -99,23 +100,24 @@
 #include <vtkMRMLMarkupsDisplayNode.h>
 
 // VTK includes
-#include <vtkCutter.h>
 #include <vtkGeneralTransform.h>
 #include <vtkImageCast.h>
+#include <vtkImageConstantPad.h>
 #include <vtkImageData.h>
 #include <vtkLookupTable.h>
 #include <vtkObjectFactory.h>
-#include <vtkPlane.h>
 #include <vtkPolyData.h>
+#include <vtkSMPTools.h>
 #include <vtkSmartPointer.h>
 #include <vtkStringArray.h>
-#include <vtkStripper.h>
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkTable.h>
 #include <vtkDoubleArray.h>
 
 // ITK includes
 #include <itkImage.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
 
 // GDCM includes
 #include <gdcmIPPSorter.h>
@@ -124,6 +126,9 @@
 #include "vtkSlicerDICOMLoadable.h"
 #include "vtkSlicerDICOMExportable.h"
 
+// STD includes
+#include <algorithm>
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerDicomRtImportExportModuleLogic);
 vtkCxxSetObjectMacro(vtkSlicerDicomRtImportExportModuleLogic, IsodoseLogic, vtkSlicerIsodoseModuleLogic);
@@ -192,6 +197,23 @@ public:
   /// \param roiReferencedSeriesUid Uid of the input series for which slice spacing is to be calculated.
   double CalculateSliceSpacing(vtkSlicerDicomRtReader* rtReader, const char* roiReferencedSeriesUid);
 
+  /// Copy the region of the labelmap that contains non-zero voxels
+  /// \return Cropped copy of the labelmap, nullptr if the labelmap is empty
+  static vtkSmartPointer<vtkOrientedImageData> CopyLabelmapEffectiveExtent(vtkOrientedImageData* labelmap);
+
+  /// Resample structure labelmap to the geometry of the anatomical image, and convert it to an ITK image cropped to the
+  /// non-zero voxels within the extent of the anatomical image. Does not access MRML, so it can be called from any thread
+  /// \param structureLabelmap Structure labelmap, nullptr if the structure is empty
+  /// \param croppedStructureImage Output image, nullptr if the structure is empty
+  /// \return Success flag
+  static bool ConvertStructureLabelmapToCroppedImage(vtkOrientedImageData* structureLabelmap,
+    vtkOrientedImageData* anatomicalImage, UCharImageType::Pointer& croppedStructureImage);
+
+  /// Create structure image of the full anatomical image extent (as expected by the writer) from a cropped structure image
+  /// \param anatomicalGeometryImage Image that has the geometry of the anatomical image (its region is not used)
+  static UCharImageType::Pointer CreateFullExtentStructureImage(UCharImageType::Pointer croppedStructureImage,
+    UCharImageType::Pointer anatomicalGeometryImage, int anatomicalImageExtent[6]);
+
 public:
   vtkSlicerDicomRtImportExportModuleLogic* External;
 };
@@ -784,6 +806,9 @@ bool vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::LoadExternalBeamPlan(
 
     beamNode->SetSAD(rtReader->GetBeamSourceAxisDistance(dicomBeamNumber));
 
+    // Geometry of all control points (e.g. arc)
+    beamNode->SetControlPointStore(rtReader->GetBeamControlPointStore(dicomBeamNumber));
+
     // Set isocenter to parent plan
     double* isocenter = rtReader->GetBeamIsocenterPositionRas(dicomBeamNumber);
     planNode->SetIsocenterSpecification(vtkMRMLRTPlanNode::ArbitraryPoint);
@@ -1661,6 +1686,124 @@ double vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::CalculateSliceSpaci
 }
 
 
+//---------------------------------------------------------------------------
+vtkSmartPointer<vtkOrientedImageData> vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::CopyLabelmapEffectiveExtent(vtkOrientedImageData* labelmap)
+{
+  int effectiveExtent[6] = {0,-1,0,-1,0,-1};
+  if (!labelmap || !vtkOrientedImageDataResample::CalculateEffectiveExtent(labelmap, effectiveExtent))
+  {
+    return nullptr;
+  }
+
+  vtkSmartPointer<vtkImageConstantPad> padder = vtkSmartPointer<vtkImageConstantPad>::New();
+  padder->SetInputData(labelmap);
+  padder->SetOutputWholeExtent(effectiveExtent);
+  padder->Update();
+  vtkSmartPointer<vtkOrientedImageData> croppedLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  croppedLabelmap->vtkImageData::ShallowCopy(padder->GetOutput());
+  croppedLabelmap->CopyDirections(labelmap);
+  return croppedLabelmap;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::ConvertStructureLabelmapToCroppedImage(
+  vtkOrientedImageData* structureLabelmap, vtkOrientedImageData* anatomicalImage, UCharImageType::Pointer& croppedStructureImage)
+{
+  croppedStructureImage = nullptr;
+  if (!anatomicalImage)
+  {
+    return false;
+  }
+  if (!structureLabelmap)
+  {
+    return true; // Empty structure
+  }
+
+  // Resample to the anatomical image geometry. The extent of the result only covers the input labelmap
+  vtkSmartPointer<vtkOrientedImageData> resampledLabelmap = structureLabelmap;
+  if (!vtkOrientedImageDataResample::DoGeometriesMatch(anatomicalImage, structureLabelmap))
+  {
+    vtkSmartPointer<vtkMatrix4x4> anatomicalImageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    anatomicalImage->GetImageToWorldMatrix(anatomicalImageToWorldMatrix);
+    resampledLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    if (!vtkOrientedImageDataResample::ResampleOrientedImageToReferenceGeometry(structureLabelmap, anatomicalImageToWorldMatrix, resampledLabelmap))
+    {
+      return false;
+    }
+  }
+
+  // Crop to the non-zero voxels within the anatomical image
+  int croppedExtent[6] = {0,-1,0,-1,0,-1};
+  if (!vtkOrientedImageDataResample::CalculateEffectiveExtent(resampledLabelmap, croppedExtent))
+  {
+    return true; // Empty structure
+  }
+  int anatomicalImageExtent[6] = {0,-1,0,-1,0,-1};
+  anatomicalImage->GetExtent(anatomicalImageExtent);
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    croppedExtent[2*axis] = std::max(croppedExtent[2*axis], anatomicalImageExtent[2*axis]);
+    croppedExtent[2*axis+1] = std::min(croppedExtent[2*axis+1], anatomicalImageExtent[2*axis+1]);
+    if (croppedExtent[2*axis] > croppedExtent[2*axis+1])
+    {
+      return true; // Structure is outside the anatomical image
+    }
+  }
+
+  vtkSmartPointer<vtkImageConstantPad> padder = vtkSmartPointer<vtkImageConstantPad>::New();
+  padder->SetInputData(resampledLabelmap);
+  padder->SetOutputWholeExtent(croppedExtent);
+  vtkSmartPointer<vtkImageCast> caster = vtkSmartPointer<vtkImageCast>::New();
+  caster->SetInputConnection(padder->GetOutputPort());
+  caster->SetOutputScalarTypeToUnsignedChar();
+  caster->ClampOverflowOn();
+  caster->Update();
+  vtkSmartPointer<vtkOrientedImageData> croppedLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  croppedLabelmap->vtkImageData::ShallowCopy(caster->GetOutput());
+  croppedLabelmap->CopyDirections(resampledLabelmap);
+
+  croppedStructureImage = UCharImageType::New();
+  return vtkSlicerRtCommon::ConvertVtkOrientedImageDataToItkImage<unsigned char>(croppedLabelmap, croppedStructureImage, true);
+}
+
+//---------------------------------------------------------------------------
+UCharImageType::Pointer vtkSlicerDicomRtImportExportModuleLogic::vtkInternal::CreateFullExtentStructureImage(
+  UCharImageType::Pointer croppedStructureImage, UCharImageType::Pointer anatomicalGeometryImage, int anatomicalImageExtent[6])
+{
+  UCharImageType::SizeType size;
+  UCharImageType::IndexType start;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    size[axis] = anatomicalImageExtent[2*axis+1] - anatomicalImageExtent[2*axis] + 1;
+    start[axis] = anatomicalImageExtent[2*axis];
+  }
+  UCharImageType::RegionType region;
+  region.SetSize(size);
+  region.SetIndex(start);
+
+  UCharImageType::Pointer fullStructureImage = UCharImageType::New();
+  fullStructureImage->SetSpacing(anatomicalGeometryImage->GetSpacing());
+  fullStructureImage->SetOrigin(anatomicalGeometryImage->GetOrigin());
+  fullStructureImage->SetDirection(anatomicalGeometryImage->GetDirection());
+  fullStructureImage->SetRegions(region);
+  fullStructureImage->Allocate();
+  fullStructureImage->FillBuffer(0);
+
+  // Cropped image has the same geometry, and its region is within the full extent
+  if (croppedStructureImage.IsNotNull())
+  {
+    UCharImageType::RegionType croppedRegion = croppedStructureImage->GetLargestPossibleRegion();
+    itk::ImageRegionConstIterator<UCharImageType> croppedIt(croppedStructureImage, croppedRegion);
+    itk::ImageRegionIterator<UCharImageType> fullIt(fullStructureImage, croppedRegion);
+    for (croppedIt.GoToBegin(), fullIt.GoToBegin(); !croppedIt.IsAtEnd(); ++croppedIt, ++fullIt)
+    {
+      fullIt.Set(croppedIt.Get());
+    }
+  }
+
+  return fullStructureImage;
+}
+
 //----------------------------------------------------------------------------
 // vtkSlicerDicomRtImportExportModuleLogic methods
 
@@ -1674,6 +1817,8 @@ vtkSlicerDicomRtImportExportModuleLogic::vtkSlicerDicomRtImportExportModuleLogic
   this->BeamsLogic = nullptr;
 
   this->BeamModelsInSeparateBranch = true;
+  this->ParallelLabelmapStructureExport = true;
+  this->ContourSimplificationTolerance = 0.0;
 }
 
 //----------------------------------------------------------------------------
@@ -1833,6 +1978,7 @@ bool vtkSlicerDicomRtImportExportModuleLogic::LoadDicomRT(vtkSlicerDICOMLoadable
 
   vtkSmartPointer<vtkSlicerDicomRtReader> rtReader = vtkSmartPointer<vtkSlicerDicomRtReader>::New();
   rtReader->SetFileName(firstFileName);
+  rtReader->SetContourSimplificationTolerance(this->ContourSimplificationTolerance);
   rtReader->Update();
 
   // One series can contain composite information, e.g, an RTPLAN series can contain structure sets and plans as well
@@ -1841,6 +1987,11 @@ bool vtkSlicerDicomRtImportExportModuleLogic::LoadDicomRT(vtkSlicerDICOMLoadable
   // RTSTRUCT
   if (rtReader->GetLoadRTStructureSetSuccessful())
   {
+    if (rtReader->GetNumberOfContourPointsRemoved() > 0)
+    {
+      vtkDebugMacro("LoadDicomRT: Contour simplification removed " << rtReader->GetNumberOfContourPointsRemoved()
+        << " of " << rtReader->GetNumberOfContourPointsRead() << " contour points");
+    }
     loadSuccessful = this->Internal->LoadRtStructureSet(rtReader, loadable);
   }
 
@@ -2122,6 +2273,10 @@ std::string vtkSlicerDicomRtImportExportModuleLogic::ExportDicomRTStudy(vtkColle
         return error;
       }
 
+      // Segments and their labelmaps to export in parallel
+      std::vector<vtkSegment*> structureSegments;
+      std::vector< vtkSmartPointer<vtkOrientedImageData> > structureLabelmaps;
+
       // Export each segment in segmentation
       std::vector< std::string > segmentIDs;
       segmentationNode->GetSegmentation()->GetSegmentIDs(segmentIDs);
@@ -2144,6 +2299,26 @@ std::string vtkSlicerDicomRtImportExportModuleLogic::ExportDicomRTStudy(vtkColle
           vtkErrorMacro("ExportDicomRTStudy: " + error);
           return error;
         }
+        if (this->ParallelLabelmapStructureExport)
+        {
+          // Only keep a copy of the non-empty region of the labelmap until the parallel conversion,
+          // so that at most one full size labelmap exists at a time
+          vtkSmartPointer<vtkOrientedImageData> croppedLabelmap = vtkInternal::CopyLabelmapEffectiveExtent(binaryLabelmap);
+          if (croppedLabelmap && segmentationNode->GetParentTransformNode())
+          {
+            if (!vtkSlicerSegmentationsModuleLogic::ApplyParentTransformToOrientedImageData(segmentationNode, croppedLabelmap))
+            {
+              std::string errorMessage("Failed to apply parent transformation to exported segment");
+              vtkErrorMacro("ExportDicomRTStudy: " << errorMessage);
+              return errorMessage;
+            }
+          }
+          // Resampling and conversion is done after collecting all segments
+          structureSegments.push_back(segment);
+          structureLabelmaps.push_back(croppedLabelmap);
+          continue;
+        }
+
         // Temporarily copy labelmap image data as it will be probably resampled
         vtkSmartPointer<vtkOrientedImageData> binaryLabelmapCopy = vtkSmartPointer<vtkOrientedImageData>::New();
         binaryLabelmapCopy->DeepCopy(binaryLabelmap);
@@ -2185,6 +2360,54 @@ std::string vtkSlicerDicomRtImportExportModuleLogic::ExportDicomRTStudy(vtkColle
 
         rtWriter->AddStructure(plmStructure->itk_uchar(), segmentName.c_str(), segmentColor);
       } // For each segment
+
+      if (!structureSegments.empty())
+      {
+        // Resample and convert the structures concurrently into images cropped to the structure extent.
+        // Labelmaps are released as soon as they are converted to limit peak memory usage
+        std::vector<UCharImageType::Pointer> croppedStructureImages(structureLabelmaps.size());
+        std::vector<char> structureConversionSuccess(structureLabelmaps.size(), 0);
+        vtkSMPTools::For(0, static_cast<vtkIdType>(structureLabelmaps.size()), 1,
+          [&](vtkIdType beginStructure, vtkIdType endStructure)
+          {
+            for (vtkIdType structureIndex = beginStructure; structureIndex < endStructure; ++structureIndex)
+            {
+              structureConversionSuccess[structureIndex] = vtkInternal::ConvertStructureLabelmapToCroppedImage(
+                structureLabelmaps[structureIndex], imageOrientedImageData, croppedStructureImages[structureIndex] );
+              structureLabelmaps[structureIndex] = nullptr;
+            }
+          });
+
+        // Geometry of the anatomical image in ITK
+        int imageExtent[6] = {0,-1,0,-1,0,-1};
+        imageOrientedImageData->GetExtent(imageExtent);
+        vtkSmartPointer<vtkOrientedImageData> anatomicalGeometryVoxel = vtkSmartPointer<vtkOrientedImageData>::New();
+        anatomicalGeometryVoxel->CopyDirections(imageOrientedImageData);
+        anatomicalGeometryVoxel->SetOrigin(imageOrientedImageData->GetOrigin());
+        anatomicalGeometryVoxel->SetSpacing(imageOrientedImageData->GetSpacing());
+        anatomicalGeometryVoxel->SetExtent(imageExtent[0], imageExtent[0], imageExtent[2], imageExtent[2], imageExtent[4], imageExtent[4]);
+        anatomicalGeometryVoxel->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+        UCharImageType::Pointer anatomicalGeometryImage = UCharImageType::New();
+        vtkSlicerRtCommon::ConvertVtkOrientedImageDataToItkImage<unsigned char>(anatomicalGeometryVoxel, anatomicalGeometryImage, true);
+
+        // Add structures to the writer one by one, so that only one full extent structure image exists at a time
+        for (size_t structureIndex = 0; structureIndex < structureSegments.size(); ++structureIndex)
+        {
+          vtkSegment* segment = structureSegments[structureIndex];
+          std::string segmentName = segment->GetName();
+          if (!structureConversionSuccess[structureIndex])
+          {
+            error = "Failed to resample and convert segment " + segmentName + " to match anatomical image geometry";
+            vtkErrorMacro("ExportDicomRTStudy: " + error);
+            return error;
+          }
+
+          UCharImageType::Pointer structureImage = vtkInternal::CreateFullExtentStructureImage(
+            croppedStructureImages[structureIndex], anatomicalGeometryImage, imageExtent );
+          croppedStructureImages[structureIndex] = nullptr;
+          rtWriter->AddStructure(structureImage, segmentName.c_str(), segment->GetColor());
+        }
+      }
     }
     // If master representation is poly data type, then export from closed surface
     else if (segmentation->IsMasterRepresentationPolyData())
@@ -2205,20 +2428,21 @@ std::string vtkSlicerDicomRtImportExportModuleLogic::ExportDicomRTStudy(vtkColle
       {
         segmentationNode->GetParentTransformNode()->GetTransformToWorld(nodeToWorldTransform);
       }
-      // Initialize poly data transformer
-      vtkSmartPointer<vtkTransformPolyDataFilter> transformPolyData = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
-      transformPolyData->SetTransform(nodeToWorldTransform);
 
-      // Initialize cutting plane with normal of the Z axis of the anatomical image
+      // Cutting planes are the anatomical image slices: origin and normal are defined by the image geometry
       vtkSmartPointer<vtkMatrix4x4> imageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
       imageOrientedImageData->GetImageToWorldMatrix(imageToWorldMatrix);
       double normal[3] = { imageToWorldMatrix->GetElement(0,2), imageToWorldMatrix->GetElement(1,2), imageToWorldMatrix->GetElement(2,2) };
-      vtkSmartPointer<vtkPlane> slicePlane = vtkSmartPointer<vtkPlane>::New();
-      slicePlane->SetNormal(normal);
+      int imageExtent[6] = {0,-1,0,-1,0,-1};
+      imageOrientedImageData->GetExtent(imageExtent);
+      double firstSliceOrigin[3] = { imageToWorldMatrix->GetElement(0,3) + imageExtent[4]*normal[0],
+                                     imageToWorldMatrix->GetElement(1,3) + imageExtent[4]*normal[1],
+                                     imageToWorldMatrix->GetElement(2,3) + imageExtent[4]*normal[2] };
 
-      // Export each segment in segmentation
+      // Get closed surfaces of all segments transformed to world
       std::vector< std::string > segmentIDs;
       segmentationNode->GetSegmentation()->GetSegmentIDs(segmentIDs);
+      std::vector< vtkSmartPointer<vtkPolyDataMultiPlaneCutter> > segmentCutters;
       for (std::vector< std::string >::const_iterator segmentIdIt = segmentIDs.begin(); segmentIdIt != segmentIDs.end(); ++segmentIdIt)
       {
         std::string segmentID = *segmentIdIt;
@@ -2234,43 +2458,50 @@ std::string vtkSlicerDicomRtImportExportModuleLogic::ExportDicomRTStudy(vtkColle
           return error;
         }
 
-        // Initialize cutter pipeline for segment
+        vtkSmartPointer<vtkTransformPolyDataFilter> transformPolyData = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
+        transformPolyData->SetTransform(nodeToWorldTransform);
         transformPolyData->SetInputData(closedSurfacePolyData);
-        vtkSmartPointer<vtkCutter> cutter = vtkSmartPointer<vtkCutter>::New();
-        cutter->SetInputConnection(transformPolyData->GetOutputPort());
-        cutter->SetGenerateCutScalars(0);
-        vtkSmartPointer<vtkStripper> stripper = vtkSmartPointer<vtkStripper>::New();
-        stripper->SetInputConnection(cutter->GetOutputPort());
-
-        // Get segment bounding box
-        double bounds[6] = {0.0,0.0,0.0,0.0,0.0,0.0};
         transformPolyData->Update();
-        transformPolyData->GetOutput()->GetBounds(bounds);
+
+        vtkSmartPointer<vtkPolyDataMultiPlaneCutter> cutter = vtkSmartPointer<vtkPolyDataMultiPlaneCutter>::New();
+        cutter->SetInputPolyData(transformPolyData->GetOutput());
+        cutter->SetOrigin(firstSliceOrigin);
+        cutter->SetPlaneStep(normal);
+        cutter->SetNumberOfPlanes(imageExtent[5] - imageExtent[4]);
+        segmentCutters.push_back(cutter);
+      }
+
+      // Create planar contours from the closed surfaces for each of the anatomical image slices.
+      // Each cutter sweeps through all slices of one segment, and the segments are processed in parallel
+      vtkSMPTools::For(0, static_cast<vtkIdType>(segmentCutters.size()), 1,
+        [&segmentCutters](vtkIdType beginSegment, vtkIdType endSegment)
+        {
+          for (vtkIdType segmentIndex = beginSegment; segmentIndex < endSegment; ++segmentIndex)
+          {
+            segmentCutters[segmentIndex]->Update();
+          }
+        });
+
+      // Export each segment in segmentation
+      for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+      {
+        vtkSegment* segment = segmentationNode->GetSegmentation()->GetSegment(segmentIDs[segmentIndex]);
+        vtkPolyDataMultiPlaneCutter* cutter = segmentCutters[segmentIndex];
 
         // Containers to be passed to the writer
         std::vector<int> sliceNumbers;
         std::vector<std::string> sliceUIDs;
         std::vector<vtkPolyData*> sliceContours;
 
-        // Create planar contours from closed surface based on each of the anatomical image slices
-        int imageExtent[6] = {0,-1,0,-1,0,-1};
-        imageOrientedImageData->GetExtent(imageExtent);
         for (int slice=imageExtent[4]; slice<imageExtent[5]; ++slice)
         {
-          // Calculate slice origin
-          double origin[3] = { imageToWorldMatrix->GetElement(0,3) + slice*normal[0],
-                               imageToWorldMatrix->GetElement(1,3) + slice*normal[1],
-                               imageToWorldMatrix->GetElement(2,3) + slice*normal[2] };
-          slicePlane->SetOrigin(origin);
-          if (origin[2] < bounds[4] || origin[2] > bounds[5])
+          vtkPolyData* cutterOutput = cutter->GetOutput(slice - imageExtent[4]);
+          if (!cutterOutput || cutterOutput->GetNumberOfLines() == 0)
           {
-            // No contours outside surface bounds
+            // No contours outside surface
             continue;
           }
 
-          // Cut closed surface at slice
-          cutter->SetCutFunction(slicePlane);
-
           // Get instance UID of corresponding slice
           int sliceNumber = slice-imageExtent[0];
           sliceNumbers.push_back(sliceNumber);
@@ -2278,10 +2509,9 @@ std::string vtkSlicerDicomRtImportExportModuleLogic::ExportDicomRTStudy(vtkColle
           sliceUIDs.push_back(sliceInstanceUID);
 
           // Save slice contour
-          stripper->Update();
           vtkPolyData* sliceContour = vtkPolyData::New();
-          sliceContour->SetPoints(stripper->GetOutput()->GetPoints());
-          sliceContour->SetPolys(stripper->GetOutput()->GetLines());
+          sliceContour->SetPoints(cutterOutput->GetPoints());
+          sliceContour->SetPolys(cutterOutput->GetLines());
           sliceContours.push_back(sliceContour);
         } // For each anatomical image slice
 
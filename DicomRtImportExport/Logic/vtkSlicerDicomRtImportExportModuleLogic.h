@@ -90,6 +90,13 @@ public:
   vtkGetMacro(BeamModelsInSeparateBranch, bool);
   vtkBooleanMacro(BeamModelsInSeparateBranch, bool);
 
+  vtkSetMacro(ParallelLabelmapStructureExport, bool);
+  vtkGetMacro(ParallelLabelmapStructureExport, bool);
+  vtkBooleanMacro(ParallelLabelmapStructureExport, bool);
+
+  vtkSetMacro(ContourSimplificationTolerance, double);
+  vtkGetMacro(ContourSimplificationTolerance, double);
+
 protected:
   void SetMRMLSceneInternal(vtkMRMLScene* newScene) override;
   void OnMRMLSceneEndClose() override;
@@ -121,6 +128,14 @@ private:
   /// Flag determining whether the generated beam models are arranged in a separate subject hierarchy
   /// branch, or each beam model is added under its corresponding isocenter fiducial
   bool BeamModelsInSeparateBranch;
+
+  /// Flag determining whether segments of labelmap segmentations are resampled and converted in parallel when exporting
+  /// RT structure set, into images cropped to their extent. Otherwise a full size copy is kept for each structure.
+  bool ParallelLabelmapStructureExport;
+
+  /// Maximum deviation (in mm) allowed when simplifying planar contours of loaded RT structure sets.
+  /// 0 (default) loads the contours at full resolution.
+  double ContourSimplificationTolerance;
 };
 
 #endif
@@ -27,15 +27,21 @@
 // SlicerRt includes
 #include "vtkSlicerRtCommon.h"
 
+// Beams includes
+#include "vtkRTBeamControlPointStore.h"
+
 // VTK includes
 #include <vtkCellArray.h>
+#include <vtkLine.h>
 #include <vtkMath.h>
 #include <vtkObjectFactory.h>
 #include <vtkPoints.h>
 #include <vtkPolyData.h>
+#include <vtkSMPTools.h>
 #include <vtkSmartPointer.h>
 
 // STD includes
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <map>
@@ -171,6 +177,32 @@ public:
     //   not for only one control point. LoadRTPlan must load all
     //   control points not only one.
     std::vector<double> LeafJawPositionsMLC[2];
+
+    /// Geometry of all control points, only if there are more than one
+    vtkSmartPointer<vtkRTBeamControlPointStore> ControlPointStore;
+  };
+
+  /// Geometry of a beam in one control point
+  class ControlPointGeometry
+  {
+  public:
+    ControlPointGeometry()
+    {
+      GantryAngle = 0.0;
+      PatientSupportAngle = 0.0;
+      BeamLimitingDeviceAngle = 0.0;
+      LeafJawPositions[0][0] = 0.0;
+      LeafJawPositions[0][1] = 0.0;
+      LeafJawPositions[1][0] = 0.0;
+      LeafJawPositions[1][1] = 0.0;
+    }
+    double GantryAngle;
+    double PatientSupportAngle;
+    double BeamLimitingDeviceAngle;
+    /// Jaw positions (same as \sa BeamEntry::LeafJawPositions)
+    double LeafJawPositions[2][2];
+    /// MLC positions (same as \sa BeamEntry::LeafJawPositionsMLC)
+    std::vector<double> LeafJawPositionsMLC[2];
   };
 
   /// List of loaded beams from external beam plan
@@ -211,6 +243,13 @@ public:
   void LoadContoursFromRoiSequence(DRTStructureSetROISequence* roiSequence);
   /// Load individual contour from RT Structure Set
   vtkSlicerDicomRtReader::vtkInternal::RoiEntry* LoadContour(DRTROIContourSequence::Item &roiObject, DRTStructureSetIOD* rtStructureSet);
+  /// Simplify the contours of all loaded ROIs in parallel, \sa ContourSimplificationTolerance
+  void SimplifyRoiContours();
+  /// Simplify closed planar contours using the Douglas-Peucker algorithm
+  /// \param polyData Contours to simplify. Points that are not used by the simplified contours are removed
+  /// \param tolerance Maximum allowed distance of the removed points from the simplified contour (in mm)
+  /// \return Number of removed points
+  static vtkIdType SimplifyContours(vtkPolyData* polyData, double tolerance);
 
   /// Load RT Image
   void LoadRTImage(DcmDataset* dataset);
@@ -219,6 +258,10 @@ public:
   /// Find and return a beam entry according to its beam number
   BeamEntry* FindBeamByNumber(unsigned int beamNumber);
 
+  /// Create control point store from the geometry of all control points of a beam
+  vtkSmartPointer<vtkRTBeamControlPointStore> CreateControlPointStore(
+    const BeamEntry& beamEntry, const std::vector<ControlPointGeometry>& controlPoints);
+
   /// Find and return a ROI entry according to its ROI number
   RoiEntry* FindRoiByNumber(unsigned int roiNumber);
 
@@ -344,6 +387,46 @@ vtkSlicerDicomRtReader::vtkInternal::BeamEntry* vtkSlicerDicomRtReader::vtkInter
   return nullptr;
 }
 
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkRTBeamControlPointStore> vtkSlicerDicomRtReader::vtkInternal::CreateControlPointStore(
+  const BeamEntry& beamEntry, const std::vector<ControlPointGeometry>& controlPoints)
+{
+  // Use the MLC that has positions in all control points
+  int mlcIndex = -1;
+  unsigned int numberOfLeafPairs = 0;
+  for (int index = 0; index < 2 && mlcIndex < 0; ++index)
+  {
+    const BeamLimitingDeviceEntry& mlc = beamEntry.MultiLeafCollimator[index];
+    bool valid = ( mlc.NumberOfLeafJawPairs > 0 && mlc.LeafPositionBoundary.size() == mlc.NumberOfLeafJawPairs + 1 );
+    for (const ControlPointGeometry& controlPoint : controlPoints)
+    {
+      valid = valid && (controlPoint.LeafJawPositionsMLC[index].size() == 2 * mlc.NumberOfLeafJawPairs);
+    }
+    if (valid)
+    {
+      mlcIndex = index;
+      numberOfLeafPairs = mlc.NumberOfLeafJawPairs;
+    }
+  }
+
+  vtkSmartPointer<vtkRTBeamControlPointStore> controlPointStore = vtkSmartPointer<vtkRTBeamControlPointStore>::New();
+  controlPointStore->Allocate(static_cast<int>(controlPoints.size()), numberOfLeafPairs);
+  if (mlcIndex >= 0)
+  {
+    controlPointStore->SetMLCType(mlcIndex == 0 ? vtkRTBeamControlPointStore::MLCX : vtkRTBeamControlPointStore::MLCY);
+    controlPointStore->SetLeafBoundaries(beamEntry.MultiLeafCollimator[mlcIndex].LeafPositionBoundary.data());
+  }
+  for (size_t index = 0; index < controlPoints.size(); ++index)
+  {
+    const ControlPointGeometry& controlPoint = controlPoints[index];
+    double jaws[4] = { controlPoint.LeafJawPositions[0][0], controlPoint.LeafJawPositions[0][1],
+      controlPoint.LeafJawPositions[1][0], controlPoint.LeafJawPositions[1][1] };
+    controlPointStore->SetControlPoint(static_cast<int>(index), controlPoint.GantryAngle, controlPoint.BeamLimitingDeviceAngle,
+      controlPoint.PatientSupportAngle, jaws, (mlcIndex >= 0 ? controlPoint.LeafJawPositionsMLC[mlcIndex].data() : nullptr));
+  }
+  return controlPointStore;
+}
+
 //----------------------------------------------------------------------------
 vtkSlicerDicomRtReader::vtkInternal::RoiEntry* vtkSlicerDicomRtReader::vtkInternal::FindRoiByNumber(unsigned int roiNumber)
 {
@@ -673,34 +756,54 @@ void vtkSlicerDicomRtReader::vtkInternal::LoadRTPlan(DcmDataset* dataset)
         continue;
       }
 
-      //do //TODO: comment out for now since only first control point is loaded (as isocenter)
-      //{
+      // Read all control points. Parameters that do not change are only present in the first control point,
+      // so each control point starts from the geometry of the previous one
+      std::vector<ControlPointGeometry> controlPoints;
+      ControlPointGeometry currentGeometry;
+      bool firstControlPointValid = true;
+      do
+      {
         DRTControlPointSequence::Item &controlPointItem = rtControlPointSequence.getCurrentItem();
         if (!controlPointItem.isValid())
         {
           vtkWarningWithObjectMacro(this->External, "LoadRTPlan: Found an invalid RT control point in dataset");
+          if (controlPoints.empty())
+          {
+            firstControlPointValid = false;
+            break;
+          }
           continue;
         }
 
-        OFVector<vtkTypeFloat64> isocenterPositionDataLps;
-        controlPointItem.getIsocenterPosition(isocenterPositionDataLps);
+        // Isocenter is taken from the first control point
+        if (controlPoints.empty())
+        {
+          OFVector<vtkTypeFloat64> isocenterPositionDataLps;
+          controlPointItem.getIsocenterPosition(isocenterPositionDataLps);
 
-        // Convert from DICOM LPS -> Slicer RAS
-        beamEntry.IsocenterPositionRas[0] = -isocenterPositionDataLps[0];
-        beamEntry.IsocenterPositionRas[1] = -isocenterPositionDataLps[1];
-        beamEntry.IsocenterPositionRas[2] = isocenterPositionDataLps[2];
+          // Convert from DICOM LPS -> Slicer RAS
+          beamEntry.IsocenterPositionRas[0] = -isocenterPositionDataLps[0];
+          beamEntry.IsocenterPositionRas[1] = -isocenterPositionDataLps[1];
+          beamEntry.IsocenterPositionRas[2] = isocenterPositionDataLps[2];
+        }
 
         vtkTypeFloat64 gantryAngle = 0.0;
-        controlPointItem.getGantryAngle(gantryAngle);
-        beamEntry.GantryAngle = gantryAngle;
+        if (controlPointItem.getGantryAngle(gantryAngle).good())
+        {
+          currentGeometry.GantryAngle = gantryAngle;
+        }
 
         vtkTypeFloat64 patientSupportAngle = 0.0;
-        controlPointItem.getPatientSupportAngle(patientSupportAngle);
-        beamEntry.PatientSupportAngle = patientSupportAngle;
+        if (controlPointItem.getPatientSupportAngle(patientSupportAngle).good())
+        {
+          currentGeometry.PatientSupportAngle = patientSupportAngle;
+        }
 
         vtkTypeFloat64 beamLimitingDeviceAngle = 0.0;
-        controlPointItem.getBeamLimitingDeviceAngle(beamLimitingDeviceAngle);
-        beamEntry.BeamLimitingDeviceAngle = beamLimitingDeviceAngle;
+        if (controlPointItem.getBeamLimitingDeviceAngle(beamLimitingDeviceAngle).good())
+        {
+          currentGeometry.BeamLimitingDeviceAngle = beamLimitingDeviceAngle;
+        }
 
         DRTBeamLimitingDevicePositionSequence &currentCollimatorPositionSequence =
           controlPointItem.getBeamLimitingDevicePositionSequence();
@@ -722,8 +825,8 @@ void vtkSlicerDicomRtReader::vtkInternal::LoadRTPlan(DcmDataset* dataset)
               {
                 if (getJawPositionsCondition.good())
                 {
-                  beamEntry.LeafJawPositions[0][0] = leafJawPositions[0];
-                  beamEntry.LeafJawPositions[0][1] = leafJawPositions[1];
+                  currentGeometry.LeafJawPositions[0][0] = leafJawPositions[0];
+                  currentGeometry.LeafJawPositions[0][1] = leafJawPositions[1];
                 }
                 else
                 {
@@ -734,8 +837,8 @@ void vtkSlicerDicomRtReader::vtkInternal::LoadRTPlan(DcmDataset* dataset)
               {
                 if (getJawPositionsCondition.good())
                 {
-                  beamEntry.LeafJawPositions[1][0] = leafJawPositions[0];
-                  beamEntry.LeafJawPositions[1][1] = leafJawPositions[1];
+                  currentGeometry.LeafJawPositions[1][0] = leafJawPositions[0];
+                  currentGeometry.LeafJawPositions[1][1] = leafJawPositions[1];
                 }
                 else
                 {
@@ -747,8 +850,8 @@ void vtkSlicerDicomRtReader::vtkInternal::LoadRTPlan(DcmDataset* dataset)
                 // Get MLC leaves positions
                 if (getJawPositionsCondition.good())
                 {
-                  std::vector<double>& positionsX = beamEntry.LeafJawPositionsMLC[0];
-                  std::vector<double>& positionsY = beamEntry.LeafJawPositionsMLC[1];
+                  std::vector<double>& positionsX = currentGeometry.LeafJawPositionsMLC[0];
+                  std::vector<double>& positionsY = currentGeometry.LeafJawPositionsMLC[1];
                   if (!rtBeamLimitingDeviceType.compare("MLCX"))
                   {
                     positionsX.resize(leafJawPositions.size());
@@ -771,8 +874,29 @@ void vtkSlicerDicomRtReader::vtkInternal::LoadRTPlan(DcmDataset* dataset)
           }
           while (currentCollimatorPositionSequence.gotoNextItem().good());
         } // endif controlPointItem.isValid()
-      //}
-      //while (rtControlPointSequence.gotoNextItem().good());
+
+        controlPoints.push_back(currentGeometry);
+      }
+      while (rtControlPointSequence.gotoNextItem().good());
+      if (!firstControlPointValid)
+      {
+        continue;
+      }
+
+      // Beam parameters are the ones of the first control point
+      const ControlPointGeometry& firstGeometry = controlPoints.front();
+      beamEntry.GantryAngle = firstGeometry.GantryAngle;
+      beamEntry.PatientSupportAngle = firstGeometry.PatientSupportAngle;
+      beamEntry.BeamLimitingDeviceAngle = firstGeometry.BeamLimitingDeviceAngle;
+      std::copy(&firstGeometry.LeafJawPositions[0][0], &firstGeometry.LeafJawPositions[0][0] + 4, &beamEntry.LeafJawPositions[0][0]);
+      beamEntry.LeafJawPositionsMLC[0] = firstGeometry.LeafJawPositionsMLC[0];
+      beamEntry.LeafJawPositionsMLC[1] = firstGeometry.LeafJawPositionsMLC[1];
+
+      // Store geometry of all control points (e.g. arc) in a compact form
+      if (controlPoints.size() > 1)
+      {
+        beamEntry.ControlPointStore = this->CreateControlPointStore(beamEntry, controlPoints);
+      }
 
       this->BeamSequenceVector.push_back(beamEntry);
     }
@@ -939,6 +1063,8 @@ void vtkSlicerDicomRtReader::vtkInternal::LoadRTPlan(DcmDataset* dataset)
 void vtkSlicerDicomRtReader::vtkInternal::LoadRTStructureSet(DcmDataset* dataset)
 {
   this->External->LoadRTStructureSetSuccessful = false;
+  this->External->NumberOfContourPointsRead = 0;
+  this->External->NumberOfContourPointsRemoved = 0;
 
   DRTStructureSetIOD* rtStructureSet = new DRTStructureSetIOD();
   if (rtStructureSet->read(*dataset).bad())
@@ -980,6 +1106,12 @@ void vtkSlicerDicomRtReader::vtkInternal::LoadRTStructureSet(DcmDataset* dataset
   }
   while (rtROIContourSequence.gotoNextItem().good());
 
+  // Simplify contours if requested
+  if (this->External->ContourSimplificationTolerance > 0.0)
+  {
+    this->SimplifyRoiContours();
+  }
+
   // Get SOP instance UID
   OFString sopInstanceUid("");
   if (rtStructureSet->getSOPInstanceUID(sopInstanceUid).bad())
@@ -1114,6 +1246,7 @@ vtkSlicerDicomRtReader::vtkInternal::RoiEntry* vtkSlicerDicomRtReader::vtkIntern
 
     // Close the contour
     currentRoiContourCells->InsertCellPoint(pointId-numberOfPoints);
+    this->External->NumberOfContourPointsRead += numberOfPoints;
 
     // Add map to the referenced slice instance UID
     // This is not a mandatory field so no error logged if not found. The reason why
@@ -1215,6 +1348,152 @@ vtkSlicerDicomRtReader::vtkInternal::RoiEntry* vtkSlicerDicomRtReader::vtkIntern
   return roiEntry;
 }
 
+//----------------------------------------------------------------------------
+void vtkSlicerDicomRtReader::vtkInternal::SimplifyRoiContours()
+{
+  double tolerance = this->External->ContourSimplificationTolerance;
+  std::vector<vtkIdType> numberOfRemovedPoints(this->RoiSequenceVector.size(), 0);
+  vtkSMPTools::For(0, static_cast<vtkIdType>(this->RoiSequenceVector.size()),
+    [&](vtkIdType beginRoi, vtkIdType endRoi)
+    {
+      for (vtkIdType roiIndex = beginRoi; roiIndex < endRoi; ++roiIndex)
+      {
+        vtkPolyData* roiPolyData = this->RoiSequenceVector[roiIndex].PolyData;
+        if (roiPolyData && roiPolyData->GetNumberOfLines() > 0)
+        {
+          numberOfRemovedPoints[roiIndex] = SimplifyContours(roiPolyData, tolerance);
+        }
+      }
+    });
+
+  for (size_t roiIndex = 0; roiIndex < this->RoiSequenceVector.size(); ++roiIndex)
+  {
+    if (numberOfRemovedPoints[roiIndex] > 0)
+    {
+      vtkDebugWithObjectMacro(this->External, "SimplifyRoiContours: Removed " << numberOfRemovedPoints[roiIndex]
+        << " points from ROI " << this->RoiSequenceVector[roiIndex].Name);
+    }
+    this->External->NumberOfContourPointsRemoved += numberOfRemovedPoints[roiIndex];
+  }
+  vtkDebugWithObjectMacro(this->External, "SimplifyRoiContours: Removed " << this->External->NumberOfContourPointsRemoved
+    << " of " << this->External->NumberOfContourPointsRead << " contour points with tolerance " << tolerance << " mm");
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkSlicerDicomRtReader::vtkInternal::SimplifyContours(vtkPolyData* polyData, double tolerance)
+{
+  vtkPoints* points = polyData->GetPoints();
+  vtkCellArray* lines = polyData->GetLines();
+  if (!points || !lines)
+  {
+    return 0;
+  }
+
+  double toleranceSquared = tolerance * tolerance;
+  vtkSmartPointer<vtkPoints> simplifiedPoints = vtkSmartPointer<vtkPoints>::New();
+  simplifiedPoints->SetDataType(points->GetDataType());
+  vtkSmartPointer<vtkCellArray> simplifiedLines = vtkSmartPointer<vtkCellArray>::New();
+
+  std::vector<double> contourCoordinates;
+  std::vector<char> keepPoint;
+  std::vector<std::pair<vtkIdType, vtkIdType> > segmentStack;
+  vtkSmartPointer<vtkIdList> contourPointIds = vtkSmartPointer<vtkIdList>::New();
+  lines->InitTraversal();
+  while (lines->GetNextCell(contourPointIds))
+  {
+    // Contours are stored closed, with the first point repeated at the end
+    vtkIdType numberOfPoints = contourPointIds->GetNumberOfIds();
+    bool closed = (numberOfPoints > 1 && contourPointIds->GetId(0) == contourPointIds->GetId(numberOfPoints - 1));
+    vtkIdType numberOfUniquePoints = (closed ? numberOfPoints - 1 : numberOfPoints);
+
+    contourCoordinates.resize(3 * numberOfUniquePoints);
+    for (vtkIdType pointIndex = 0; pointIndex < numberOfUniquePoints; ++pointIndex)
+    {
+      points->GetPoint(contourPointIds->GetId(pointIndex), &contourCoordinates[3 * pointIndex]);
+    }
+
+    keepPoint.assign(numberOfUniquePoints, 1);
+    if (closed && numberOfUniquePoints > 3)
+    {
+      // Split the loop at the first point and the point farthest from it, and simplify both halves
+      vtkIdType farthestPointIndex = 1;
+      double farthestDistanceSquared = -1.0;
+      for (vtkIdType pointIndex = 1; pointIndex < numberOfUniquePoints; ++pointIndex)
+      {
+        double distanceSquared = vtkMath::Distance2BetweenPoints(&contourCoordinates[0], &contourCoordinates[3 * pointIndex]);
+        if (distanceSquared > farthestDistanceSquared)
+        {
+          farthestDistanceSquared = distanceSquared;
+          farthestPointIndex = pointIndex;
+        }
+      }
+
+      keepPoint.assign(numberOfUniquePoints, 0);
+      keepPoint[0] = 1;
+      keepPoint[farthestPointIndex] = 1;
+      segmentStack.clear();
+      segmentStack.push_back(std::make_pair(vtkIdType(0), farthestPointIndex));
+      segmentStack.push_back(std::make_pair(farthestPointIndex, numberOfUniquePoints)); // Index numberOfUniquePoints is the first point
+      while (!segmentStack.empty())
+      {
+        vtkIdType startIndex = segmentStack.back().first;
+        vtkIdType endIndex = segmentStack.back().second;
+        segmentStack.pop_back();
+
+        const double* startPoint = &contourCoordinates[3 * startIndex];
+        const double* endPoint = &contourCoordinates[3 * (endIndex % numberOfUniquePoints)];
+        double maximumDistanceSquared = 0.0;
+        vtkIdType maximumDistancePointIndex = -1;
+        for (vtkIdType pointIndex = startIndex + 1; pointIndex < endIndex; ++pointIndex)
+        {
+          double closestPoint[3] = { 0.0, 0.0, 0.0 };
+          double parametricCoordinate = 0.0;
+          double distanceSquared = vtkLine::DistanceToLine(&contourCoordinates[3 * pointIndex],
+            const_cast<double*>(startPoint), const_cast<double*>(endPoint), parametricCoordinate, closestPoint);
+          if (distanceSquared > maximumDistanceSquared)
+          {
+            maximumDistanceSquared = distanceSquared;
+            maximumDistancePointIndex = pointIndex;
+          }
+        }
+        if (maximumDistancePointIndex >= 0 && maximumDistanceSquared > toleranceSquared)
+        {
+          keepPoint[maximumDistancePointIndex] = 1;
+          segmentStack.push_back(std::make_pair(startIndex, maximumDistancePointIndex));
+          segmentStack.push_back(std::make_pair(maximumDistancePointIndex, endIndex));
+        }
+      }
+
+      // Keep the original contour if it would degenerate
+      if (std::count(keepPoint.begin(), keepPoint.end(), 1) < 3)
+      {
+        keepPoint.assign(numberOfUniquePoints, 1);
+      }
+    }
+
+    // Add the kept points to the simplified contour
+    vtkIdType firstSimplifiedPointId = simplifiedPoints->GetNumberOfPoints();
+    vtkIdType numberOfKeptPoints = static_cast<vtkIdType>(std::count(keepPoint.begin(), keepPoint.end(), 1));
+    simplifiedLines->InsertNextCell(closed ? numberOfKeptPoints + 1 : numberOfKeptPoints);
+    for (vtkIdType pointIndex = 0; pointIndex < numberOfUniquePoints; ++pointIndex)
+    {
+      if (keepPoint[pointIndex])
+      {
+        simplifiedLines->InsertCellPoint(simplifiedPoints->InsertNextPoint(&contourCoordinates[3 * pointIndex]));
+      }
+    }
+    if (closed)
+    {
+      simplifiedLines->InsertCellPoint(firstSimplifiedPointId);
+    }
+  }
+
+  vtkIdType numberOfRemovedPoints = points->GetNumberOfPoints() - simplifiedPoints->GetNumberOfPoints();
+  polyData->SetPoints(simplifiedPoints);
+  polyData->SetLines(simplifiedLines);
+  return numberOfRemovedPoints;
+}
+
 //----------------------------------------------------------------------------
 void vtkSlicerDicomRtReader::vtkInternal::LoadRTImage(DcmDataset* dataset)
 {
@@ -1488,6 +1767,10 @@ vtkSlicerDicomRtReader::vtkSlicerDicomRtReader()
   this->LoadRTDoseSuccessful = false;
   this->LoadRTPlanSuccessful = false;
   this->LoadRTImageSuccessful = false;
+
+  this->ContourSimplificationTolerance = 0.0;
+  this->NumberOfContourPointsRead = 0;
+  this->NumberOfContourPointsRemoved = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -1821,6 +2104,18 @@ const char* vtkSlicerDicomRtReader::GetBeamMultiLeafCollimatorPositions( unsigne
   return nullptr;
 }
 
+//----------------------------------------------------------------------------
+vtkRTBeamControlPointStore* vtkSlicerDicomRtReader::GetBeamControlPointStore(unsigned int beamNumber)
+{
+  vtkInternal::BeamEntry* beam = this->Internal->FindBeamByNumber(beamNumber);
+  if (beam == nullptr)
+  {
+    vtkErrorMacro("GetBeamControlPointStore: Unable to find beam of number" << beamNumber);
+    return nullptr;
+  }
+  return beam->ControlPointStore;
+}
+
 //----------------------------------------------------------------------------
 int vtkSlicerDicomRtReader::GetNumberOfChannels()
 {
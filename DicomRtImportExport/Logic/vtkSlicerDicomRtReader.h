@@ -39,6 +39,7 @@
 #include <vector>
 
 class vtkPolyData;
+class vtkRTBeamControlPointStore;
 
 /// \ingroup SlicerRt_QtModules_DicomRtImport
 class VTK_SLICER_DICOMRTIMPORTEXPORT_LOGIC_EXPORT vtkSlicerDicomRtReader : public vtkSlicerDicomReaderBase
@@ -124,6 +125,10 @@ public:
   const char* GetBeamMultiLeafCollimatorPositions( unsigned int beamNumber, 
     std::vector<double>& pairBoundaries, std::vector<double>& leafPositions);
 
+  /// Get geometry of all control points for a given beam
+  /// \return Control point store if the beam has more than one control point (e.g. arc), nullptr otherwise
+  vtkRTBeamControlPointStore* GetBeamControlPointStore(unsigned int beamNumber);
+
   /// Get number of channels
   int GetNumberOfChannels();
 
@@ -237,6 +242,17 @@ public:
   /// Get load image successful flag
   vtkGetMacro(LoadRTImageSuccessful, bool);
 
+  /// Get maximum deviation (in mm) allowed when simplifying the structure set contours at load time
+  vtkGetMacro(ContourSimplificationTolerance, double);
+  /// Set maximum deviation (in mm) allowed when simplifying the structure set contours at load time.
+  /// Contours are simplified using the Douglas-Peucker algorithm. 0 (default) disables simplification.
+  vtkSetMacro(ContourSimplificationTolerance, double);
+
+  /// Get number of contour points read from the structure set
+  vtkGetMacro(NumberOfContourPointsRead, vtkIdType);
+  /// Get number of contour points removed by load time simplification
+  vtkGetMacro(NumberOfContourPointsRemoved, vtkIdType);
+
 protected:
   /// Set pixel spacing for dose volume
   vtkSetVector2Macro(PixelSpacing, double);
@@ -315,6 +331,15 @@ protected:
   /// Flag indicating if RT Image has been successfully read from the input dataset
   bool LoadRTImageSuccessful;
 
+  /// Maximum deviation (in mm) allowed when simplifying the structure set contours at load time. 0 disables simplification
+  double ContourSimplificationTolerance;
+
+  /// Number of contour points read from the structure set
+  vtkIdType NumberOfContourPointsRead;
+
+  /// Number of contour points removed by load time simplification
+  vtkIdType NumberOfContourPointsRemoved;
+
 protected:
   vtkSlicerDicomRtReader();
   ~vtkSlicerDicomRtReader() override;
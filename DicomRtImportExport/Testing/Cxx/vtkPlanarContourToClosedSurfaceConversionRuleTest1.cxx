@@ -0,0 +1,152 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// DicomRtImportExport includes
+#include "vtkPlanarContourToClosedSurfaceConversionRule.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  /// Conversion rule giving access to the contour processing steps of the closed surface conversion
+  class vtkPlanarContourToClosedSurfaceTestConversionRule : public vtkPlanarContourToClosedSurfaceConversionRule
+  {
+  public:
+    static vtkPlanarContourToClosedSurfaceTestConversionRule* New();
+    vtkTypeMacro(vtkPlanarContourToClosedSurfaceTestConversionRule, vtkPlanarContourToClosedSurfaceConversionRule);
+    using vtkPlanarContourToClosedSurfaceConversionRule::FixKeyholesAndSetLinesCounterClockwise;
+    using vtkPlanarContourToClosedSurfaceConversionRule::TriangulateBetweenContours;
+  };
+  vtkStandardNewMacro(vtkPlanarContourToClosedSurfaceTestConversionRule);
+
+  //----------------------------------------------------------------------------
+  /// Compare the point IDs of the cells with the expected ones, cell by cell
+  bool AreCellsEqualTo(vtkCellArray* cells, const std::vector<std::vector<vtkIdType> >& expectedCells)
+  {
+    if (cells->GetNumberOfCells() != static_cast<vtkIdType>(expectedCells.size()))
+    {
+      std::cerr << "Number of cells " << cells->GetNumberOfCells() << " does not match expected value " << expectedCells.size() << std::endl;
+      return false;
+    }
+    vtkNew<vtkIdList> cellPointIds;
+    cells->InitTraversal();
+    for (size_t cellIndex = 0; cells->GetNextCell(cellPointIds); ++cellIndex)
+    {
+      const std::vector<vtkIdType>& expectedCell = expectedCells[cellIndex];
+      bool equal = (cellPointIds->GetNumberOfIds() == static_cast<vtkIdType>(expectedCell.size()));
+      for (vtkIdType pointIndex = 0; equal && pointIndex < cellPointIds->GetNumberOfIds(); ++pointIndex)
+      {
+        equal = (cellPointIds->GetId(pointIndex) == expectedCell[pointIndex]);
+      }
+      if (!equal)
+      {
+        std::cerr << "Point IDs of cell " << cellIndex << " (";
+        for (vtkIdType pointIndex = 0; pointIndex < cellPointIds->GetNumberOfIds(); ++pointIndex)
+        {
+          std::cerr << (pointIndex > 0 ? ", " : "") << cellPointIds->GetId(pointIndex);
+        }
+        std::cerr << ") do not match expected IDs (";
+        for (size_t pointIndex = 0; pointIndex < expectedCell.size(); ++pointIndex)
+        {
+          std::cerr << (pointIndex > 0 ? ", " : "") << expectedCell[pointIndex];
+        }
+        std::cerr << ")" << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkPlanarContourToClosedSurfaceConversionRuleTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // Square contour with a square hole on the first plane, connected to the outside by a 0.0005 mm wide keyhole channel
+  // along the line y=5, and a clockwise square contour on the second plane
+  const double contourPoints[16][3] = {
+    { 0.0, 0.0, 0.0 }, { 10.0, 0.0, 0.0 }, { 10.0, 10.0, 0.0 }, { 0.0, 10.0, 0.0 }, { 0.0, 5.0, 0.0 },
+    { 3.0, 5.0, 0.0 }, { 3.0, 3.0, 0.0 }, { 7.0, 3.0, 0.0 }, { 7.0, 7.0, 0.0 }, { 3.0, 7.0, 0.0 },
+    { 3.0, 5.0005, 0.0 }, { 0.0, 5.0005, 0.0 },
+    { 1.0, 1.0, 1.0 }, { 1.0, 9.0, 1.0 }, { 9.0, 9.0, 1.0 }, { 9.0, 1.0, 1.0 } };
+  vtkNew<vtkPoints> points;
+  for (int pointIndex = 0; pointIndex < 16; ++pointIndex)
+  {
+    points->InsertNextPoint(contourPoints[pointIndex]);
+  }
+  vtkNew<vtkCellArray> lines;
+  const vtkIdType keyholeLine[13] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0 };
+  lines->InsertNextCell(13, keyholeLine);
+  const vtkIdType clockwiseLine[5] = { 12, 13, 14, 15, 12 };
+  lines->InsertNextCell(5, clockwiseLine);
+  vtkNew<vtkPolyData> contours;
+  contours->SetPoints(points);
+  contours->SetLines(lines);
+
+  // Expected lines and triangles are the output of the separate FixKeyholes and SetLinesCounterClockwise passes
+  // and of the table-based triangulation that the fused and the dynamic programming implementations replaced
+  vtkSmartPointer<vtkPlanarContourToClosedSurfaceTestConversionRule> rule = vtkSmartPointer<vtkPlanarContourToClosedSurfaceTestConversionRule>::New();
+  rule->FixKeyholesAndSetLinesCounterClockwise(contours, 0.001, 3);
+  std::vector<std::vector<vtkIdType> > expectedLines = {
+    { 0, 1, 2, 3, 4, 0 },         // Outer contour, the part of the channel on the outer side is removed
+    { 6, 7, 8, 9, 10, 6 },        // Hole, closed
+    { 12, 15, 14, 13, 12 } };     // Reversed to be counter-clockwise
+  if (!AreCellsEqualTo(contours->GetLines(), expectedLines))
+  {
+    std::cerr << __LINE__ << ": Lines after keyhole removal do not match baseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkNew<vtkIdList> outerLinePointIds;
+  vtkNew<vtkIdList> secondPlaneLinePointIds;
+  contours->GetCellPoints(0, outerLinePointIds);
+  contours->GetCellPoints(2, secondPlaneLinePointIds);
+  vtkNew<vtkCellArray> triangles;
+  rule->TriangulateBetweenContours(contours, outerLinePointIds, secondPlaneLinePointIds, triangles);
+  std::vector<std::vector<vtkIdType> > expectedTriangles = {
+    { 0, 12, 4 }, { 4, 12, 13 }, { 4, 13, 3 }, { 3, 13, 14 }, { 3, 14, 2 },
+    { 2, 14, 15 }, { 2, 15, 1 }, { 1, 15, 12 }, { 1, 12, 0 } };
+  if (!AreCellsEqualTo(triangles, expectedTriangles))
+  {
+    std::cerr << __LINE__ << ": Triangulation between the outer contour and the second plane does not match baseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Same contours in the opposite order: the second plane contour starts the triangulation
+  vtkNew<vtkCellArray> reversedTriangles;
+  rule->TriangulateBetweenContours(contours, secondPlaneLinePointIds, outerLinePointIds, reversedTriangles);
+  std::vector<std::vector<vtkIdType> > expectedReversedTriangles = {
+    { 12, 0, 4 }, { 12, 4, 13 }, { 13, 4, 3 }, { 13, 3, 2 }, { 13, 2, 14 },
+    { 14, 2, 1 }, { 14, 1, 15 }, { 15, 1, 0 }, { 15, 0, 12 } };
+  if (!AreCellsEqualTo(reversedTriangles, expectedReversedTriangles))
+  {
+    std::cerr << __LINE__ << ": Triangulation between the second plane and the outer contour does not match baseline" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Planar contour keyhole removal and triangulation test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -57,15 +57,18 @@
 #include <vtkDoubleArray.h>
 #include <vtkFieldData.h>
 #include <vtkImageAccumulate.h>
+#include <vtkImageClip.h>
 #include <vtkImageConstantPad.h>
 #include <vtkImageDilateErode3D.h>
 #include <vtkImageMathematics.h>
 #include <vtkImageStencilData.h>
 #include <vtkImageToImageStencil.h>
 #include <vtkMath.h>
+#include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkPiecewiseFunction.h>
+#include <vtkSMPTools.h>
 #include <vtkStringArray.h>
 #include <vtkTable.h>
 #include <vtkTimerLog.h>
@@ -75,7 +78,9 @@
 #include <vtksys/SystemTools.hxx>
 
 // STD includes
+#include <algorithm>
 #include <set>
+#include <vector>
 
 // Slicer includes
 #include <vtkSlicerVersionConfigure.h>
@@ -103,6 +108,196 @@ const std::string vtkSlicerDoseVolumeHistogramModuleLogic::DVH_TABLE_NODE_NAME_P
 const std::string vtkSlicerDoseVolumeHistogramModuleLogic::DVH_CSV_HEADER_VOLUME_FIELD_MIDDLE = " Value (% of ";
 const std::string vtkSlicerDoseVolumeHistogramModuleLogic::DVH_CSV_HEADER_VOLUME_FIELD_END = " cc)";
 
+//----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Build run-length encoded stencil extents from the voxels of a labelmap that are at least the threshold.
+  /// Only the given extent of the labelmap is scanned, once, and the extent of the stencil is cropped to the bounding
+  /// box of the foreground voxels, so that the stencil data is proportional to the size of the structure.
+  /// \param scanExtent Extent of the labelmap containing all foreground voxels, typically its effective extent
+  /// \return Number of foreground voxels. Stencil is not modified if zero
+  template<class T>
+  vtkIdType BuildRunLengthEncodedStencil(vtkImageData* labelmap, T* vtkNotUsed(scalarTypePtr), const int scanExtent[6],
+    double threshold, vtkImageStencilData* stencil)
+  {
+    int extent[6] = {0,-1,0,-1,0,-1};
+    labelmap->GetExtent(extent);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      extent[2*axis] = std::max(extent[2*axis], scanExtent[2*axis]);
+      extent[2*axis+1] = std::min(extent[2*axis+1], scanExtent[2*axis+1]);
+    }
+    if (extent[0] > extent[1] || extent[2] > extent[3] || extent[4] > extent[5])
+    {
+      return 0;
+    }
+    vtkIdType increments[3] = {0,0,0};
+    labelmap->GetIncrements(increments);
+    T* labelmapPtr = static_cast<T*>(labelmap->GetScalarPointerForExtent(extent));
+
+    // Runs are stored as (start, end, y, z) quadruplets
+    std::vector<int> runs;
+    int foregroundExtent[6] = {VTK_INT_MAX, VTK_INT_MIN, VTK_INT_MAX, VTK_INT_MIN, VTK_INT_MAX, VTK_INT_MIN};
+    vtkIdType numberOfForegroundVoxels = 0;
+    for (int z = extent[4]; z <= extent[5]; ++z)
+    {
+      for (int y = extent[2]; y <= extent[3]; ++y)
+      {
+        T* rowPtr = labelmapPtr + (z-extent[4])*increments[2] + (y-extent[2])*increments[1];
+        int x = extent[0];
+        while (x <= extent[1])
+        {
+          // Skip background
+          while (x <= extent[1] && static_cast<double>(rowPtr[(x-extent[0])*increments[0]]) < threshold)
+          {
+            ++x;
+          }
+          if (x > extent[1])
+          {
+            break;
+          }
+          int runStart = x;
+          while (x <= extent[1] && static_cast<double>(rowPtr[(x-extent[0])*increments[0]]) >= threshold)
+          {
+            ++x;
+          }
+          runs.push_back(runStart);
+          runs.push_back(x-1);
+          runs.push_back(y);
+          runs.push_back(z);
+          numberOfForegroundVoxels += x - runStart;
+
+          foregroundExtent[0] = std::min(foregroundExtent[0], runStart);
+          foregroundExtent[1] = std::max(foregroundExtent[1], x-1);
+          foregroundExtent[2] = std::min(foregroundExtent[2], y);
+          foregroundExtent[3] = std::max(foregroundExtent[3], y);
+          foregroundExtent[4] = std::min(foregroundExtent[4], z);
+          foregroundExtent[5] = std::max(foregroundExtent[5], z);
+        }
+      }
+    }
+    if (numberOfForegroundVoxels == 0)
+    {
+      return 0;
+    }
+
+    stencil->SetSpacing(labelmap->GetSpacing());
+    stencil->SetOrigin(labelmap->GetOrigin());
+    stencil->SetExtent(foregroundExtent);
+    stencil->AllocateExtents();
+    for (size_t runIndex = 0; runIndex < runs.size(); runIndex += 4)
+    {
+      stencil->InsertNextExtent(runs[runIndex], runs[runIndex+1], runs[runIndex+2], runs[runIndex+3]);
+    }
+
+    return numberOfForegroundVoxels;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Functor resampling a dose volume onto the lattice of an output image, processing output slices in parallel.
+  /// Samples outside the input volume are set to zero, similarly to vtkImageReslice with default background.
+  template<class T>
+  class ResampleDoseFunctor
+  {
+  public:
+    T* InputPtr;
+    int InputExtent[6];
+    vtkIdType InputIncrements[3];
+    double* OutputPtr;
+    int OutputExtent[6];
+    double OutputIjkToInputIjk[4][4];
+    bool Linear;
+
+    void operator()(vtkIdType beginSlice, vtkIdType endSlice) const
+    {
+      const double tolerance = 1e-3;
+      vtkIdType outputRowLength = this->OutputExtent[1] - this->OutputExtent[0] + 1;
+      vtkIdType outputSliceSize = outputRowLength * (this->OutputExtent[3] - this->OutputExtent[2] + 1);
+      for (vtkIdType k = beginSlice; k < endSlice; ++k)
+      {
+        double* outPtr = this->OutputPtr + (k - this->OutputExtent[4]) * outputSliceSize;
+        for (int j = this->OutputExtent[2]; j <= this->OutputExtent[3]; ++j)
+        {
+          for (int i = this->OutputExtent[0]; i <= this->OutputExtent[1]; ++i, ++outPtr)
+          {
+            double inputIjk[3] = {0.0, 0.0, 0.0};
+            bool inside = true;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+              inputIjk[axis] = this->OutputIjkToInputIjk[axis][0] * i + this->OutputIjkToInputIjk[axis][1] * j
+                + this->OutputIjkToInputIjk[axis][2] * k + this->OutputIjkToInputIjk[axis][3];
+              if ( inputIjk[axis] < this->InputExtent[2*axis] - tolerance
+                || inputIjk[axis] > this->InputExtent[2*axis+1] + tolerance )
+              {
+                inside = false;
+              }
+            }
+            if (!inside)
+            {
+              *outPtr = 0.0;
+              continue;
+            }
+            if (!this->Linear)
+            {
+              T* inPtr = this->InputPtr;
+              for (int axis = 0; axis < 3; ++axis)
+              {
+                int index = std::min(std::max(vtkMath::Floor(inputIjk[axis] + 0.5), this->InputExtent[2*axis]), this->InputExtent[2*axis+1]);
+                inPtr += (index - this->InputExtent[2*axis]) * this->InputIncrements[axis];
+              }
+              *outPtr = static_cast<double>(*inPtr);
+              continue;
+            }
+
+            // Trilinear interpolation from the eight surrounding voxels
+            int baseIndex[3] = {0,0,0};
+            double weight[3] = {0.0, 0.0, 0.0};
+            vtkIdType step[3] = {0,0,0};
+            for (int axis = 0; axis < 3; ++axis)
+            {
+              int index = std::min(std::max(vtkMath::Floor(inputIjk[axis]), this->InputExtent[2*axis]), this->InputExtent[2*axis+1]);
+              weight[axis] = std::min(std::max(inputIjk[axis] - index, 0.0), 1.0);
+              step[axis] = (index < this->InputExtent[2*axis+1] ? this->InputIncrements[axis] : 0);
+              baseIndex[axis] = index - this->InputExtent[2*axis];
+            }
+            T* inPtr = this->InputPtr + baseIndex[0] * this->InputIncrements[0]
+              + baseIndex[1] * this->InputIncrements[1] + baseIndex[2] * this->InputIncrements[2];
+            double c00 = inPtr[0] * (1.0 - weight[0]) + inPtr[step[0]] * weight[0];
+            double c10 = inPtr[step[1]] * (1.0 - weight[0]) + inPtr[step[1] + step[0]] * weight[0];
+            double c01 = inPtr[step[2]] * (1.0 - weight[0]) + inPtr[step[2] + step[0]] * weight[0];
+            double c11 = inPtr[step[2] + step[1]] * (1.0 - weight[0]) + inPtr[step[2] + step[1] + step[0]] * weight[0];
+            double c0 = c00 * (1.0 - weight[1]) + c10 * weight[1];
+            double c1 = c01 * (1.0 - weight[1]) + c11 * weight[1];
+            *outPtr = c0 * (1.0 - weight[2]) + c1 * weight[2];
+          }
+        }
+      }
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  template<class T>
+  void ResampleDoseVolume(vtkOrientedImageData* doseVolume, T* vtkNotUsed(scalarTypePtr), vtkOrientedImageData* outputVolume, vtkMatrix4x4* outputIjkToInputIjk, bool linear)
+  {
+    ResampleDoseFunctor<T> functor;
+    doseVolume->GetExtent(functor.InputExtent);
+    doseVolume->GetIncrements(functor.InputIncrements);
+    functor.InputPtr = static_cast<T*>(doseVolume->GetScalarPointerForExtent(functor.InputExtent));
+    outputVolume->GetExtent(functor.OutputExtent);
+    functor.OutputPtr = static_cast<double*>(outputVolume->GetScalarPointerForExtent(functor.OutputExtent));
+    for (int row = 0; row < 4; ++row)
+    {
+      for (int column = 0; column < 4; ++column)
+      {
+        functor.OutputIjkToInputIjk[row][column] = outputIjkToInputIjk->GetElement(row, column);
+      }
+    }
+    functor.Linear = linear;
+    vtkSMPTools::For(functor.OutputExtent[4], functor.OutputExtent[5] + 1, functor);
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerDoseVolumeHistogramModuleLogic);
 
@@ -127,6 +322,8 @@ vtkSlicerDoseVolumeHistogramModuleLogic::vtkSlicerDoseVolumeHistogramModuleLogic
   this->NumberOfSamplesForNonDoseVolumes = 100;
   this->DefaultDoseVolumeOversamplingFactor = 2.0;
   this->UseLinearInterpolationForDoseVolume = true;
+  this->UseRunLengthEncodedStencil = true;
+  this->CropOversampledDoseToSegmentExtent = true;
 
   this->LogSpeedMeasurements = false;
 }
@@ -407,7 +604,44 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
     else
     {
       oversampledDoseVolume = vtkSmartPointer<vtkOrientedImageData>::New();
-      if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
+      int segmentEffectiveExtent[6] = {0,-1,0,-1,0,-1};
+      if ( this->CropOversampledDoseToSegmentExtent
+        && vtkOrientedImageDataResample::CalculateEffectiveExtent(segmentLabelmap, segmentEffectiveExtent, minimumValue) )
+      {
+        // Oversample dose only within the bounding box of the segment. Pad by one voxel so that
+        // the surface of the structure can still be extracted when computing dose surface histogram.
+        // The segment labelmap is cropped to the same extent by the padder below.
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          segmentEffectiveExtent[2*axis] -= 1;
+          segmentEffectiveExtent[2*axis+1] += 1;
+        }
+        oversampledDoseVolume->SetExtent(segmentEffectiveExtent);
+        oversampledDoseVolume->SetSpacing(segmentLabelmap->GetSpacing());
+        oversampledDoseVolume->SetOrigin(segmentLabelmap->GetOrigin());
+        oversampledDoseVolume->CopyDirections(segmentLabelmap);
+        oversampledDoseVolume->AllocateScalars(VTK_DOUBLE, 1);
+
+        vtkNew<vtkMatrix4x4> oversampledIjkToWorld;
+        oversampledDoseVolume->GetImageToWorldMatrix(oversampledIjkToWorld);
+        vtkNew<vtkMatrix4x4> worldToDoseIjk;
+        doseImageData->GetWorldToImageMatrix(worldToDoseIjk);
+        vtkNew<vtkMatrix4x4> oversampledIjkToDoseIjk;
+        vtkMatrix4x4::Multiply4x4(worldToDoseIjk, oversampledIjkToWorld, oversampledIjkToDoseIjk);
+
+        switch (doseImageData->GetScalarType())
+        {
+          vtkTemplateMacro( ResampleDoseVolume( doseImageData, static_cast<VTK_TT*>(nullptr),
+            oversampledDoseVolume, oversampledIjkToDoseIjk, this->UseLinearInterpolationForDoseVolume ) );
+          default:
+            {
+            std::string errorMessage("Unsupported dose volume scalar type");
+            vtkErrorMacro("ComputeDvh: " << errorMessage);
+            return errorMessage;
+            }
+        }
+      }
+      else if ( !vtkOrientedImageDataResample::ResampleOrientedImageToReferenceOrientedImage(
         doseImageData, segmentLabelmap, oversampledDoseVolume, this->UseLinearInterpolationForDoseVolume ) )
       {
         std::string errorMessage("Failed to resample dose volume");
@@ -531,9 +765,6 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
     segmentLabelmap->vtkImageData::DeepCopy(imageMathematics->GetOutput());
   }
 
-  // Create stencil for structure
-  vtkNew<vtkImageToImageStencil> stencil;
-  stencil->SetInputData(segmentLabelmap);
   // Foreground voxels are all those with an intensity > 0.
   // Unfortunately vtkImageToImageStencil only have options for < and >= comparison.
   // So, we have to choose >=epsilon (epsilon is a very small positive number).
@@ -541,7 +772,6 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
   // which is a rare scenario, but may still happen.
   double minimumValue = 0.0;
   double maximumValue = 1.0;
-  segmentLabelmap->GetFieldData();
   vtkDoubleArray* scalarRange = vtkDoubleArray::SafeDownCast(
     segmentLabelmap->GetFieldData()->GetAbstractArray( vtkSegmentationConverter::GetScalarRangeFieldName() )
     );
@@ -551,27 +781,71 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
     maximumValue = scalarRange->GetValue(1);
   }
 
+  // Create stencil for structure
   bool useFractionalLabelmap = parameterNode->GetUseFractionalLabelmap();
-  if (useFractionalLabelmap)
+  bool useRunLengthEncodedStencil = (this->UseRunLengthEncodedStencil && !useFractionalLabelmap);
+  vtkSmartPointer<vtkImageStencilData> structureStencil = vtkSmartPointer<vtkImageStencilData>::New();
+  int stencilExtent[6] = {0,-1,0,-1,0,-1};
+  if (useRunLengthEncodedStencil)
   {
-    stencil->ThresholdByUpper(minimumValue + 1e-10);
+    // Same check as for the stencil created by vtkImageToImageStencil, which has the extent of the labelmap
+    int labelmapExtent[6] = {0,-1,0,-1,0,-1};
+    segmentLabelmap->GetExtent(labelmapExtent);
+    if (labelmapExtent[1]-labelmapExtent[0] <= 0 || labelmapExtent[3]-labelmapExtent[2] <= 0 || labelmapExtent[5]-labelmapExtent[4] <= 0)
+    {
+      std::string errorMessage("Invalid stenciled dose volume");
+      vtkErrorMacro("ComputeDvh: " << errorMessage);
+      return errorMessage;
+    }
+
+    // Build the stencil extents directly from the labelmap in one scan of its effective extent, cropped to the structure
+    vtkIdType numberOfStructureVoxels = 0;
+    int effectiveExtent[6] = {0,-1,0,-1,0,-1};
+    if (vtkOrientedImageDataResample::CalculateEffectiveExtent(segmentLabelmap, effectiveExtent))
+    {
+      switch (segmentLabelmap->GetScalarType())
+      {
+        vtkTemplateMacro( numberOfStructureVoxels = BuildRunLengthEncodedStencil(
+          segmentLabelmap, static_cast<VTK_TT*>(nullptr), effectiveExtent, 1e-10, structureStencil ) );
+        default:
+          {
+          std::string errorMessage("Unsupported segment labelmap scalar type");
+          vtkErrorMacro("ComputeDvh: " << errorMessage);
+          return errorMessage;
+          }
+      }
+    }
+    if (numberOfStructureVoxels < 1)
+    {
+      std::string errorMessage("Dose volume and the structure do not overlap"); // User-friendly error to help troubleshooting
+      vtkErrorMacro("ComputeDvh: " << errorMessage);
+      return errorMessage;
+    }
+    structureStencil->GetExtent(stencilExtent);
   }
   else
   {
-    stencil->ThresholdByUpper(1e-10);
-  }
-  stencil->Update();
+    vtkNew<vtkImageToImageStencil> stencil;
+    stencil->SetInputData(segmentLabelmap);
+    if (useFractionalLabelmap)
+    {
+      stencil->ThresholdByUpper(minimumValue + 1e-10);
+    }
+    else
+    {
+      stencil->ThresholdByUpper(1e-10);
+    }
+    stencil->Update();
 
-  vtkSmartPointer<vtkImageStencilData> structureStencil = vtkSmartPointer<vtkImageStencilData>::New();
-  structureStencil->DeepCopy(stencil->GetOutput());
+    structureStencil->DeepCopy(stencil->GetOutput());
 
-  int stencilExtent[6] = {0,-1,0,-1,0,-1};
-  structureStencil->GetExtent(stencilExtent);
-  if (stencilExtent[1]-stencilExtent[0] <= 0 || stencilExtent[3]-stencilExtent[2] <= 0 || stencilExtent[5]-stencilExtent[4] <= 0)
-  {
-    std::string errorMessage("Invalid stenciled dose volume");
-    vtkErrorMacro("ComputeDvh: " << errorMessage);
-    return errorMessage;
+    structureStencil->GetExtent(stencilExtent);
+    if (stencilExtent[1]-stencilExtent[0] <= 0 || stencilExtent[3]-stencilExtent[2] <= 0 || stencilExtent[5]-stencilExtent[4] <= 0)
+    {
+      std::string errorMessage("Invalid stenciled dose volume");
+      vtkErrorMacro("ComputeDvh: " << errorMessage);
+      return errorMessage;
+    }
   }
 
   // Compute statistics
@@ -588,7 +862,20 @@ std::string vtkSlicerDoseVolumeHistogramModuleLogic::ComputeDvh(vtkMRMLDoseVolum
   {
     structureStat = vtkSmartPointer<vtkImageAccumulate>::New();
   }
-  structureStat->SetInputData(oversampledDoseVolume);
+  // Restrict accumulation to the extent of the run-length encoded stencil so that small structures
+  // do not cost as much as the whole dose grid. The dose data is not copied, only the extent is changed.
+  vtkNew<vtkImageClip> doseClipper;
+  if (useRunLengthEncodedStencil)
+  {
+    doseClipper->SetInputData(oversampledDoseVolume);
+    doseClipper->SetOutputWholeExtent(stencilExtent);
+    doseClipper->ClipDataOff();
+    structureStat->SetInputConnection(doseClipper->GetOutputPort());
+  }
+  else
+  {
+    structureStat->SetInputData(oversampledDoseVolume);
+  }
   structureStat->SetStencilData(structureStencil);
   structureStat->Update();
 
@@ -138,6 +138,14 @@ public:
   vtkSetMacro(UseLinearInterpolationForDoseVolume, bool);
   vtkBooleanMacro(UseLinearInterpolationForDoseVolume, bool);
 
+  vtkGetMacro(UseRunLengthEncodedStencil, bool);
+  vtkSetMacro(UseRunLengthEncodedStencil, bool);
+  vtkBooleanMacro(UseRunLengthEncodedStencil, bool);
+
+  vtkGetMacro(CropOversampledDoseToSegmentExtent, bool);
+  vtkSetMacro(CropOversampledDoseToSegmentExtent, bool);
+  vtkBooleanMacro(CropOversampledDoseToSegmentExtent, bool);
+
   vtkGetMacro(LogSpeedMeasurements, bool);
   vtkSetMacro(LogSpeedMeasurements, bool);
   vtkBooleanMacro(LogSpeedMeasurements, bool);
@@ -211,6 +219,18 @@ protected:
   /// does not reach the end of the dose voxel. False by default
   bool UseLinearInterpolationForDoseVolume;
 
+  /// Flag determining whether the structure stencil is built directly from the binary labelmap as run-length
+  /// encoded extents cropped to the structure, instead of using vtkImageToImageStencil on the whole dose grid.
+  /// Dose accumulation is then also restricted to the extent of the structure. Not used for fractional labelmaps.
+  /// True by default
+  bool UseRunLengthEncodedStencil;
+
+  /// Flag determining whether the dose volume is oversampled only within the effective extent of each segment
+  /// (padded by one voxel) when automatic oversampling is used. The resampling is multithreaded. This allows using
+  /// high oversampling factors for small structures without resampling the dose for the whole labelmap extent.
+  /// True by default
+  bool CropOversampledDoseToSegmentExtent;
+
   /// Flag telling whether the speed measurements are logged on standard output
   bool LogSpeedMeasurements;
 };
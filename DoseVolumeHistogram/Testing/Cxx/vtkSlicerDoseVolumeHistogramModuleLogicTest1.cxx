@@ -338,6 +338,17 @@ int vtkSlicerDoseVolumeHistogramModuleLogicTest1( int argc, char * argv[] )
     std::cerr << "Invalid arguments" << std::endl;
     return EXIT_FAILURE;
   }
+  // UseRunLengthEncodedStencil (optional, the logic default is used if not specified)
+  int useRunLengthEncodedStencil = -1;
+  if (argc > argIndex + 1)
+  {
+    if (STRCASECMP(argv[argIndex], "-UseRunLengthEncodedStencil") == 0)
+    {
+      useRunLengthEncodedStencil = (vtkVariant(argv[argIndex + 1]).ToInt() > 0 ? 1 : 0);
+      std::cout << "Use run-length encoded stencil: " << (useRunLengthEncodedStencil ? "true" : "false") << std::endl;
+      argIndex += 2;
+    }
+  }
 
   // Constraint the criteria to be greater than zero
   if (volumeDifferenceCriterion == 0.0)
@@ -419,6 +430,10 @@ int vtkSlicerDoseVolumeHistogramModuleLogicTest1( int argc, char * argv[] )
   // Create and set up logic
   vtkSmartPointer<vtkSlicerDoseVolumeHistogramModuleLogic> dvhLogic = vtkSmartPointer<vtkSlicerDoseVolumeHistogramModuleLogic>::New();
   dvhLogic->SetMRMLScene(mrmlScene);
+  if (useRunLengthEncodedStencil >= 0)
+  {
+    dvhLogic->SetUseRunLengthEncodedStencil(useRunLengthEncodedStencil > 0);
+  }
 
   // Create and set up parameter set MRML node
   vtkSmartPointer<vtkMRMLDoseVolumeHistogramNode> paramNode = vtkSmartPointer<vtkMRMLDoseVolumeHistogramNode>::New();
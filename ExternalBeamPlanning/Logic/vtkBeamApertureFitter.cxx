@@ -0,0 +1,665 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#include "vtkBeamApertureFitter.h"
+
+// Beams includes
+#include "vtkMRMLRTBeamNode.h"
+
+// MRML includes
+#include <vtkMRMLTransformNode.h>
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkIdList.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  /// Points closer to the source plane than this are considered to be behind the source (mm)
+  const double MINIMUM_SOURCE_DISTANCE = 1.0;
+
+  //----------------------------------------------------------------------------
+  /// Divergent projection of a point given in beam coordinates to the isocenter plane
+  /// \return Scaling factor of the projection, 0 if the point is behind the source
+  inline double ProjectToIsocenterPlane(const double beamPoint[3], double sourceAxisDistance, double projected[2])
+  {
+    double sourceDistance = sourceAxisDistance - beamPoint[2];
+    if (sourceDistance < MINIMUM_SOURCE_DISTANCE)
+    {
+      projected[0] = projected[1] = std::numeric_limits<double>::quiet_NaN();
+      return 0.0;
+    }
+    double scale = sourceAxisDistance / sourceDistance;
+    projected[0] = beamPoint[0] * scale;
+    projected[1] = beamPoint[1] * scale;
+    return scale;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Projects the points of a surface given in RAS
+  class SurfaceProjectionFunctor
+  {
+  public:
+    vtkPoints* Points;
+    double RASToBeam[4][4];
+    double SourceAxisDistance;
+    double* ProjectedPoints;
+
+    void operator()(vtkIdType beginPoint, vtkIdType endPoint) const
+    {
+      double ras[3] = { 0.0, 0.0, 0.0 };
+      double beam[3] = { 0.0, 0.0, 0.0 };
+      for (vtkIdType pointId = beginPoint; pointId < endPoint; ++pointId)
+      {
+        this->Points->GetPoint(pointId, ras);
+        for (int row = 0; row < 3; ++row)
+        {
+          beam[row] = this->RASToBeam[row][0] * ras[0] + this->RASToBeam[row][1] * ras[1]
+            + this->RASToBeam[row][2] * ras[2] + this->RASToBeam[row][3];
+        }
+        ProjectToIsocenterPlane(beam, this->SourceAxisDistance, this->ProjectedPoints + 2 * pointId);
+      }
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  /// Finds the boundary voxels of a labelmap slice by slice and projects their centers
+  class LabelmapProjectionFunctor
+  {
+  public:
+    vtkDataArray* Scalars;
+    int Extent[6];
+    double IJKToBeam[4][4];
+    double SourceAxisDistance;
+    /// Half of the voxel diagonal (mm)
+    double VoxelRadius;
+
+    /// Projected centers and footprint radii of the voxels found by each thread
+    vtkSMPThreadLocal< std::vector<double> > ThreadProjectedPoints;
+    vtkSMPThreadLocal< std::vector<double> > ThreadFootprintRadii;
+
+    bool IsInside(int i, int j, int k) const
+    {
+      if ( i < this->Extent[0] || i > this->Extent[1] || j < this->Extent[2] || j > this->Extent[3]
+        || k < this->Extent[4] || k > this->Extent[5] )
+      {
+        return false;
+      }
+      vtkIdType dimX = this->Extent[1] - this->Extent[0] + 1;
+      vtkIdType dimY = this->Extent[3] - this->Extent[2] + 1;
+      vtkIdType voxel = (i - this->Extent[0]) + dimX * ((j - this->Extent[2]) + dimY * (k - this->Extent[4]));
+      return this->Scalars->GetComponent(voxel, 0) != 0.0;
+    }
+
+    void operator()(vtkIdType beginSlice, vtkIdType endSlice)
+    {
+      std::vector<double>& projectedPoints = this->ThreadProjectedPoints.Local();
+      std::vector<double>& footprintRadii = this->ThreadFootprintRadii.Local();
+      double beam[3] = { 0.0, 0.0, 0.0 };
+      double projected[2] = { 0.0, 0.0 };
+      for (vtkIdType k = beginSlice; k < endSlice; ++k)
+      {
+        for (int j = this->Extent[2]; j <= this->Extent[3]; ++j)
+        {
+          for (int i = this->Extent[0]; i <= this->Extent[1]; ++i)
+          {
+            int slice = static_cast<int>(k);
+            if (!this->IsInside(i, j, slice))
+            {
+              continue;
+            }
+            // Interior voxels are hidden by the boundary ones in the projection
+            if ( this->IsInside(i - 1, j, slice) && this->IsInside(i + 1, j, slice)
+              && this->IsInside(i, j - 1, slice) && this->IsInside(i, j + 1, slice)
+              && this->IsInside(i, j, slice - 1) && this->IsInside(i, j, slice + 1) )
+            {
+              continue;
+            }
+            for (int row = 0; row < 3; ++row)
+            {
+              beam[row] = this->IJKToBeam[row][0] * i + this->IJKToBeam[row][1] * j
+                + this->IJKToBeam[row][2] * slice + this->IJKToBeam[row][3];
+            }
+            double scale = ProjectToIsocenterPlane(beam, this->SourceAxisDistance, projected);
+            if (scale <= 0.0)
+            {
+              continue;
+            }
+            projectedPoints.push_back(projected[0]);
+            projectedPoints.push_back(projected[1]);
+            footprintRadii.push_back(this->VoxelRadius * scale);
+          }
+        }
+      }
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  /// Geometry of the BEV mask
+  struct MaskGeometry
+  {
+    double Origin[2];
+    double Spacing;
+    int Dimensions[2];
+
+    /// Index range of the pixels with center in the [minimum, maximum] interval along an axis
+    /// \return False if there are no such pixels
+    bool GetPixelRange(int axis, double minimum, double maximum, int& beginIndex, int& endIndex) const
+    {
+      beginIndex = std::max(0, static_cast<int>(std::ceil((minimum - this->Origin[axis]) / this->Spacing)));
+      endIndex = std::min(this->Dimensions[axis] - 1, static_cast<int>(std::floor((maximum - this->Origin[axis]) / this->Spacing)));
+      return beginIndex <= endIndex;
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  /// Rasterizes projected primitives into thread local masks, then merges them into the (zero initialized) output
+  class RasterizeFunctor
+  {
+  public:
+    MaskGeometry Geometry;
+    const double* ProjectedPoints;
+    /// Triangle point IDs for surface input
+    const vtkIdType* Triangles;
+    /// Footprint radii for labelmap input (one square footprint for each projected point)
+    const double* FootprintRadii;
+    unsigned char* Mask;
+
+    vtkSMPThreadLocal< std::vector<unsigned char> > ThreadMask;
+
+    void Initialize()
+    {
+      this->ThreadMask.Local().assign(static_cast<size_t>(this->Geometry.Dimensions[0]) * this->Geometry.Dimensions[1], 0);
+    }
+
+    void RasterizeTriangle(vtkIdType triangle, std::vector<unsigned char>& mask) const
+    {
+      const double* p[3] = { nullptr, nullptr, nullptr };
+      double minimum[2] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MAX };
+      double maximum[2] = { VTK_DOUBLE_MIN, VTK_DOUBLE_MIN };
+      for (int vertex = 0; vertex < 3; ++vertex)
+      {
+        p[vertex] = this->ProjectedPoints + 2 * this->Triangles[3 * triangle + vertex];
+        if (std::isnan(p[vertex][0]))
+        {
+          return;
+        }
+        for (int axis = 0; axis < 2; ++axis)
+        {
+          minimum[axis] = std::min(minimum[axis], p[vertex][axis]);
+          maximum[axis] = std::max(maximum[axis], p[vertex][axis]);
+        }
+      }
+      double area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+      if (std::abs(area) < 1e-12)
+      {
+        // Triangle is seen edge-on, the neighboring triangles cover its projection
+        return;
+      }
+      int beginIndex[2] = { 0, 0 };
+      int endIndex[2] = { 0, 0 };
+      if ( !this->Geometry.GetPixelRange(0, minimum[0], maximum[0], beginIndex[0], endIndex[0])
+        || !this->Geometry.GetPixelRange(1, minimum[1], maximum[1], beginIndex[1], endIndex[1]) )
+      {
+        return;
+      }
+      // Pixel centers on the edges are included, with a tolerance relative to the triangle area
+      double tolerance = -1e-9 * std::abs(area);
+      double sign = (area > 0.0 ? 1.0 : -1.0);
+      for (int j = beginIndex[1]; j <= endIndex[1]; ++j)
+      {
+        double y = this->Geometry.Origin[1] + j * this->Geometry.Spacing;
+        for (int i = beginIndex[0]; i <= endIndex[0]; ++i)
+        {
+          double x = this->Geometry.Origin[0] + i * this->Geometry.Spacing;
+          bool inside = true;
+          for (int edge = 0; edge < 3 && inside; ++edge)
+          {
+            const double* a = p[edge];
+            const double* b = p[(edge + 1) % 3];
+            double edgeFunction = sign * ((b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]));
+            inside = (edgeFunction >= tolerance);
+          }
+          if (inside)
+          {
+            mask[i + static_cast<size_t>(j) * this->Geometry.Dimensions[0]] = 1;
+          }
+        }
+      }
+    }
+
+    void RasterizeFootprint(vtkIdType pointIndex, std::vector<unsigned char>& mask) const
+    {
+      const double* center = this->ProjectedPoints + 2 * pointIndex;
+      double radius = this->FootprintRadii[pointIndex];
+      int beginIndex[2] = { 0, 0 };
+      int endIndex[2] = { 0, 0 };
+      if ( !this->Geometry.GetPixelRange(0, center[0] - radius, center[0] + radius, beginIndex[0], endIndex[0])
+        || !this->Geometry.GetPixelRange(1, center[1] - radius, center[1] + radius, beginIndex[1], endIndex[1]) )
+      {
+        // Footprint smaller than a pixel, mark the pixel containing the center
+        int i = static_cast<int>(std::floor((center[0] - this->Geometry.Origin[0]) / this->Geometry.Spacing + 0.5));
+        int j = static_cast<int>(std::floor((center[1] - this->Geometry.Origin[1]) / this->Geometry.Spacing + 0.5));
+        if (i >= 0 && i < this->Geometry.Dimensions[0] && j >= 0 && j < this->Geometry.Dimensions[1])
+        {
+          mask[i + static_cast<size_t>(j) * this->Geometry.Dimensions[0]] = 1;
+        }
+        return;
+      }
+      for (int j = beginIndex[1]; j <= endIndex[1]; ++j)
+      {
+        std::fill(mask.begin() + beginIndex[0] + static_cast<size_t>(j) * this->Geometry.Dimensions[0],
+          mask.begin() + endIndex[0] + 1 + static_cast<size_t>(j) * this->Geometry.Dimensions[0], 1);
+      }
+    }
+
+    void operator()(vtkIdType begin, vtkIdType end)
+    {
+      std::vector<unsigned char>& mask = this->ThreadMask.Local();
+      for (vtkIdType index = begin; index < end; ++index)
+      {
+        if (this->Triangles)
+        {
+          this->RasterizeTriangle(index, mask);
+        }
+        else
+        {
+          this->RasterizeFootprint(index, mask);
+        }
+      }
+    }
+
+    void Reduce()
+    {
+      size_t numberOfPixels = static_cast<size_t>(this->Geometry.Dimensions[0]) * this->Geometry.Dimensions[1];
+      for (vtkSMPThreadLocal< std::vector<unsigned char> >::iterator maskIt = this->ThreadMask.begin();
+        maskIt != this->ThreadMask.end(); ++maskIt)
+      {
+        const std::vector<unsigned char>& threadMask = *maskIt;
+        for (size_t pixel = 0; pixel < numberOfPixels; ++pixel)
+        {
+          this->Mask[pixel] |= threadMask[pixel];
+        }
+      }
+    }
+  };
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkBeamApertureFitter);
+
+//----------------------------------------------------------------------------
+vtkBeamApertureFitter::vtkBeamApertureFitter()
+{
+  this->InputSurface = nullptr;
+  this->InputLabelmap = nullptr;
+  this->BeamToRASMatrix = nullptr;
+  this->SourceAxisDistance = 1000.0;
+  this->Margin = 5.0;
+  this->MaskSpacing = 1.0;
+  this->MLCBoundaries = nullptr;
+  this->LeavesMoveAlongX = true;
+
+  this->OutputMask = vtkImageData::New();
+  this->JawPositions[0] = this->JawPositions[1] = this->JawPositions[2] = this->JawPositions[3] = 0.0;
+  this->LeafPositions = vtkDoubleArray::New();
+  this->LeafPositions->SetNumberOfComponents(2);
+  this->LeafPositions->SetName("LeafPositions");
+}
+
+//----------------------------------------------------------------------------
+vtkBeamApertureFitter::~vtkBeamApertureFitter()
+{
+  this->SetInputSurface(nullptr);
+  this->SetInputLabelmap(nullptr);
+  this->SetBeamToRASMatrix(nullptr);
+  this->SetMLCBoundaries(nullptr);
+  this->OutputMask->Delete();
+  this->OutputMask = nullptr;
+  this->LeafPositions->Delete();
+  this->LeafPositions = nullptr;
+}
+
+//----------------------------------------------------------------------------
+void vtkBeamApertureFitter::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "InputSurface: " << this->InputSurface << "\n";
+  os << indent << "InputLabelmap: " << this->InputLabelmap << "\n";
+  os << indent << "BeamToRASMatrix: " << this->BeamToRASMatrix << "\n";
+  os << indent << "SourceAxisDistance: " << this->SourceAxisDistance << "\n";
+  os << indent << "Margin: " << this->Margin << "\n";
+  os << indent << "MaskSpacing: " << this->MaskSpacing << "\n";
+  os << indent << "MLCBoundaries: " << this->MLCBoundaries << "\n";
+  os << indent << "LeavesMoveAlongX: " << (this->LeavesMoveAlongX ? "true" : "false") << "\n";
+  os << indent << "JawPositions: (" << this->JawPositions[0] << ", " << this->JawPositions[1] << ", "
+    << this->JawPositions[2] << ", " << this->JawPositions[3] << ")\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkBeamApertureFitter::SetBeamGeometry(vtkMRMLRTBeamNode* beamNode)
+{
+  if (!beamNode)
+  {
+    vtkErrorMacro("SetBeamGeometry: Invalid beam node");
+    return false;
+  }
+  vtkMRMLTransformNode* beamTransformNode = beamNode->GetParentTransformNode();
+  if (!beamTransformNode)
+  {
+    vtkErrorMacro("SetBeamGeometry: Failed to access transform node of beam " << beamNode->GetName());
+    return false;
+  }
+
+  vtkSmartPointer<vtkMatrix4x4> beamToRASMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  if (!beamTransformNode->GetMatrixTransformToWorld(beamToRASMatrix))
+  {
+    vtkErrorMacro("SetBeamGeometry: Transform of beam " << beamNode->GetName() << " is not linear");
+    return false;
+  }
+  this->SetBeamToRASMatrix(beamToRASMatrix);
+  this->SetSourceAxisDistance(beamNode->GetSAD());
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkBeamApertureFitter::ProjectInput(std::vector<double>& projectedPoints, std::vector<double>& footprintRadii)
+{
+  projectedPoints.clear();
+  footprintRadii.clear();
+
+  vtkSmartPointer<vtkMatrix4x4> rasToBeamMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Invert(this->BeamToRASMatrix, rasToBeamMatrix);
+
+  if (this->InputSurface)
+  {
+    vtkPoints* points = this->InputSurface->GetPoints();
+    if (!points)
+    {
+      return;
+    }
+    projectedPoints.resize(2 * points->GetNumberOfPoints());
+
+    SurfaceProjectionFunctor functor;
+    functor.Points = points;
+    for (int row = 0; row < 4; ++row)
+    {
+      for (int column = 0; column < 4; ++column)
+      {
+        functor.RASToBeam[row][column] = rasToBeamMatrix->GetElement(row, column);
+      }
+    }
+    functor.SourceAxisDistance = this->SourceAxisDistance;
+    functor.ProjectedPoints = projectedPoints.data();
+    vtkSMPTools::For(0, points->GetNumberOfPoints(), functor);
+    return;
+  }
+
+  vtkDataArray* scalars = this->InputLabelmap->GetPointData()->GetScalars();
+  if (!scalars)
+  {
+    return;
+  }
+  vtkSmartPointer<vtkMatrix4x4> ijkToRASMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  this->InputLabelmap->GetImageToWorldMatrix(ijkToRASMatrix);
+  vtkSmartPointer<vtkMatrix4x4> ijkToBeamMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Multiply4x4(rasToBeamMatrix, ijkToRASMatrix, ijkToBeamMatrix);
+
+  LabelmapProjectionFunctor functor;
+  functor.Scalars = scalars;
+  this->InputLabelmap->GetExtent(functor.Extent);
+  double voxelDiagonalSquared = 0.0;
+  for (int row = 0; row < 4; ++row)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      functor.IJKToBeam[row][column] = ijkToBeamMatrix->GetElement(row, column);
+    }
+    if (row < 3)
+    {
+      double* ijkToRAS = ijkToRASMatrix->Element[row];
+      voxelDiagonalSquared += ijkToRAS[0] * ijkToRAS[0] + ijkToRAS[1] * ijkToRAS[1] + ijkToRAS[2] * ijkToRAS[2];
+    }
+  }
+  functor.VoxelRadius = 0.5 * std::sqrt(voxelDiagonalSquared);
+  functor.SourceAxisDistance = this->SourceAxisDistance;
+  if (functor.Extent[0] > functor.Extent[1] || functor.Extent[2] > functor.Extent[3] || functor.Extent[4] > functor.Extent[5])
+  {
+    return;
+  }
+  vtkSMPTools::For(functor.Extent[4], functor.Extent[5] + 1, functor);
+
+  for (vtkSMPThreadLocal< std::vector<double> >::iterator pointsIt = functor.ThreadProjectedPoints.begin();
+    pointsIt != functor.ThreadProjectedPoints.end(); ++pointsIt)
+  {
+    projectedPoints.insert(projectedPoints.end(), pointsIt->begin(), pointsIt->end());
+  }
+  for (vtkSMPThreadLocal< std::vector<double> >::iterator radiiIt = functor.ThreadFootprintRadii.begin();
+    radiiIt != functor.ThreadFootprintRadii.end(); ++radiiIt)
+  {
+    footprintRadii.insert(footprintRadii.end(), radiiIt->begin(), radiiIt->end());
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkBeamApertureFitter::Update()
+{
+  this->LeafPositions->SetNumberOfTuples(0);
+  if (!this->InputSurface && !this->InputLabelmap)
+  {
+    vtkErrorMacro("Update: No input target");
+    return false;
+  }
+  if (!this->BeamToRASMatrix)
+  {
+    vtkErrorMacro("Update: Invalid beam to RAS matrix");
+    return false;
+  }
+  if (this->SourceAxisDistance <= 0.0 || this->MaskSpacing <= 0.0)
+  {
+    vtkErrorMacro("Update: Invalid source-axis distance or mask spacing");
+    return false;
+  }
+
+  // Project target to the isocenter plane
+  std::vector<double> projectedPoints;
+  std::vector<double> footprintRadii;
+  this->ProjectInput(projectedPoints, footprintRadii);
+
+  // Triangles of the surface
+  std::vector<vtkIdType> triangles;
+  if (this->InputSurface && this->InputSurface->GetPolys())
+  {
+    vtkCellArray* polys = this->InputSurface->GetPolys();
+    vtkSmartPointer<vtkIdList> pointIds = vtkSmartPointer<vtkIdList>::New();
+    polys->InitTraversal();
+    while (polys->GetNextCell(pointIds))
+    {
+      for (vtkIdType vertex = 2; vertex < pointIds->GetNumberOfIds(); ++vertex)
+      {
+        triangles.push_back(pointIds->GetId(0));
+        triangles.push_back(pointIds->GetId(vertex - 1));
+        triangles.push_back(pointIds->GetId(vertex));
+      }
+    }
+  }
+
+  // Mask covers the projected target and the margin
+  double bounds[4] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN };
+  vtkIdType numberOfProjectedPoints = static_cast<vtkIdType>(projectedPoints.size() / 2);
+  for (vtkIdType pointIndex = 0; pointIndex < numberOfProjectedPoints; ++pointIndex)
+  {
+    const double* point = &projectedPoints[2 * pointIndex];
+    if (std::isnan(point[0]))
+    {
+      continue;
+    }
+    double radius = (footprintRadii.empty() ? 0.0 : footprintRadii[pointIndex]);
+    bounds[0] = std::min(bounds[0], point[0] - radius);
+    bounds[1] = std::max(bounds[1], point[0] + radius);
+    bounds[2] = std::min(bounds[2], point[1] - radius);
+    bounds[3] = std::max(bounds[3], point[1] + radius);
+  }
+  if (bounds[0] > bounds[1])
+  {
+    vtkErrorMacro("Update: Target is not in front of the beam source");
+    return false;
+  }
+
+  MaskGeometry geometry;
+  geometry.Spacing = this->MaskSpacing;
+  for (int axis = 0; axis < 2; ++axis)
+  {
+    int beginIndex = static_cast<int>(std::floor(bounds[2 * axis] / this->MaskSpacing)) - 1;
+    int endIndex = static_cast<int>(std::ceil(bounds[2 * axis + 1] / this->MaskSpacing)) + 1;
+    geometry.Origin[axis] = beginIndex * this->MaskSpacing;
+    geometry.Dimensions[axis] = endIndex - beginIndex + 1;
+  }
+  if (static_cast<double>(geometry.Dimensions[0]) * geometry.Dimensions[1] > 1.0e8)
+  {
+    vtkErrorMacro("Update: Projected target is too large for mask spacing " << this->MaskSpacing);
+    return false;
+  }
+
+  this->OutputMask->SetOrigin(geometry.Origin[0], geometry.Origin[1], 0.0);
+  this->OutputMask->SetSpacing(geometry.Spacing, geometry.Spacing, 1.0);
+  this->OutputMask->SetExtent(0, geometry.Dimensions[0] - 1, 0, geometry.Dimensions[1] - 1, 0, 0);
+  this->OutputMask->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  unsigned char* maskPointer = static_cast<unsigned char*>(this->OutputMask->GetScalarPointer());
+  std::fill(maskPointer, maskPointer + static_cast<size_t>(geometry.Dimensions[0]) * geometry.Dimensions[1], 0);
+
+  // Rasterize projected triangles or voxel footprints
+  RasterizeFunctor functor;
+  functor.Geometry = geometry;
+  functor.ProjectedPoints = projectedPoints.data();
+  functor.Triangles = (this->InputSurface ? triangles.data() : nullptr);
+  functor.FootprintRadii = footprintRadii.data();
+  functor.Mask = maskPointer;
+  vtkIdType numberOfPrimitives = (this->InputSurface ? static_cast<vtkIdType>(triangles.size() / 3) : numberOfProjectedPoints);
+  vtkSMPTools::For(0, numberOfPrimitives, functor);
+  this->OutputMask->Modified();
+
+  this->FitAperture();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkBeamApertureFitter::FitAperture()
+{
+  int dimensions[3] = { 0, 0, 0 };
+  this->OutputMask->GetDimensions(dimensions);
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  this->OutputMask->GetOrigin(origin);
+  const unsigned char* mask = static_cast<unsigned char*>(this->OutputMask->GetScalarPointer());
+  double halfPixel = 0.5 * this->MaskSpacing;
+
+  // Extent of the target along the leaf direction in each line of the mask perpendicular to the boundaries
+  int leafAxis = (this->LeavesMoveAlongX ? 0 : 1);
+  int boundaryAxis = 1 - leafAxis;
+  std::vector<int> lineMinimum(dimensions[boundaryAxis], dimensions[leafAxis]);
+  std::vector<int> lineMaximum(dimensions[boundaryAxis], -1);
+  int minimumIndex[2] = { dimensions[0], dimensions[1] };
+  int maximumIndex[2] = { -1, -1 };
+  for (int j = 0; j < dimensions[1]; ++j)
+  {
+    for (int i = 0; i < dimensions[0]; ++i)
+    {
+      if (!mask[i + static_cast<size_t>(j) * dimensions[0]])
+      {
+        continue;
+      }
+      int index[2] = { i, j };
+      for (int axis = 0; axis < 2; ++axis)
+      {
+        minimumIndex[axis] = std::min(minimumIndex[axis], index[axis]);
+        maximumIndex[axis] = std::max(maximumIndex[axis], index[axis]);
+      }
+      lineMinimum[index[boundaryAxis]] = std::min(lineMinimum[index[boundaryAxis]], index[leafAxis]);
+      lineMaximum[index[boundaryAxis]] = std::max(lineMaximum[index[boundaryAxis]], index[leafAxis]);
+    }
+  }
+  if (maximumIndex[0] < 0)
+  {
+    vtkWarningMacro("FitAperture: Target projection is empty");
+    this->JawPositions[0] = this->JawPositions[1] = this->JawPositions[2] = this->JawPositions[3] = 0.0;
+    return;
+  }
+
+  // Jaws
+  for (int axis = 0; axis < 2; ++axis)
+  {
+    this->JawPositions[2 * axis] = origin[axis] + minimumIndex[axis] * this->MaskSpacing - halfPixel - this->Margin;
+    this->JawPositions[2 * axis + 1] = origin[axis] + maximumIndex[axis] * this->MaskSpacing + halfPixel + this->Margin;
+  }
+
+  // Leaves
+  if (!this->MLCBoundaries || this->MLCBoundaries->GetNumberOfTuples() < 2)
+  {
+    return;
+  }
+  vtkIdType numberOfLeafPairs = this->MLCBoundaries->GetNumberOfTuples() - 1;
+  this->LeafPositions->SetNumberOfTuples(numberOfLeafPairs);
+  double closedPosition = 0.5 * (this->JawPositions[2 * leafAxis] + this->JawPositions[2 * leafAxis + 1]);
+  for (vtkIdType leafPair = 0; leafPair < numberOfLeafPairs; ++leafPair)
+  {
+    double boundaryBegin = this->MLCBoundaries->GetValue(leafPair);
+    double boundaryEnd = this->MLCBoundaries->GetValue(leafPair + 1);
+    if (boundaryBegin > boundaryEnd)
+    {
+      std::swap(boundaryBegin, boundaryEnd);
+    }
+
+    // Lines having pixels that overlap with the leaf pair expanded by the margin
+    int beginLine = std::max(0, static_cast<int>(std::floor(
+      (boundaryBegin - this->Margin - halfPixel - origin[boundaryAxis]) / this->MaskSpacing)) + 1);
+    int endLine = std::min(dimensions[boundaryAxis] - 1, static_cast<int>(std::ceil(
+      (boundaryEnd + this->Margin + halfPixel - origin[boundaryAxis]) / this->MaskSpacing)) - 1);
+    int minimumLeafIndex = dimensions[leafAxis];
+    int maximumLeafIndex = -1;
+    for (int line = beginLine; line <= endLine; ++line)
+    {
+      minimumLeafIndex = std::min(minimumLeafIndex, lineMinimum[line]);
+      maximumLeafIndex = std::max(maximumLeafIndex, lineMaximum[line]);
+    }
+
+    if (maximumLeafIndex < 0)
+    {
+      this->LeafPositions->SetTuple2(leafPair, closedPosition, closedPosition);
+      continue;
+    }
+    this->LeafPositions->SetTuple2(leafPair,
+      origin[leafAxis] + minimumLeafIndex * this->MaskSpacing - halfPixel - this->Margin,
+      origin[leafAxis] + maximumLeafIndex * this->MaskSpacing + halfPixel + this->Margin );
+  }
+  this->LeafPositions->Modified();
+}
@@ -0,0 +1,146 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// .NAME vtkBeamApertureFitter - Fits jaws and MLC leaves to the beam's eye view projection of a target
+// .SECTION Description
+
+#ifndef __vtkBeamApertureFitter_h
+#define __vtkBeamApertureFitter_h
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObject.h>
+#include <vtkPolyData.h>
+
+// SegmentationCore includes
+#include <vtkOrientedImageData.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerExternalBeamPlanningModuleLogicExport.h"
+
+class vtkMRMLRTBeamNode;
+
+/// \ingroup SlicerRt_QtModules_ExternalBeamPlanning
+/// \brief Projects a target structure into beam's eye view (BEV) and fits the jaws and MLC leaves to it.
+///
+/// The target is given either as a closed surface or as a binary labelmap. The surface points (or the
+/// boundary voxels of the labelmap) are projected divergently from the beam source onto the isocenter
+/// plane in parallel, then the projected triangles (or voxel footprints) are rasterized into a BEV mask
+/// in parallel as well. The jaws are set to the bounding box of the mask, and each MLC leaf pair is
+/// opened to the extent of the mask rows it covers. All positions are expanded by the margin.
+///
+/// The mask and the fitted positions are in the beam coordinate system on the isocenter plane
+/// (X and Y axes of the collimator, isocenter at the origin), the same as the jaw and MLC positions.
+class VTK_SLICER_EXTERNALBEAMPLANNING_MODULE_LOGIC_EXPORT vtkBeamApertureFitter : public vtkObject
+{
+public:
+  static vtkBeamApertureFitter *New();
+  vtkTypeMacro(vtkBeamApertureFitter, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Project the target and fit the aperture
+  /// \return Success flag. Fails if there is no input or if no part of the target is in front of the source
+  virtual bool Update();
+
+  /// Set beam geometry from a beam node: source-axis distance, and the beam to RAS transform
+  /// \return Success flag
+  bool SetBeamGeometry(vtkMRMLRTBeamNode* beamNode);
+
+  /// Target closed surface in RAS. Used instead of \sa InputLabelmap if both are set
+  vtkSetObjectMacro(InputSurface, vtkPolyData);
+  vtkGetObjectMacro(InputSurface, vtkPolyData);
+
+  /// Target binary labelmap. Voxels with non-zero value are inside the target
+  vtkSetObjectMacro(InputLabelmap, vtkOrientedImageData);
+  vtkGetObjectMacro(InputLabelmap, vtkOrientedImageData);
+
+  /// Beam to RAS matrix. Beam source is on the Z axis of the beam coordinate system, the isocenter is the origin
+  vtkSetObjectMacro(BeamToRASMatrix, vtkMatrix4x4);
+  vtkGetObjectMacro(BeamToRASMatrix, vtkMatrix4x4);
+
+  /// Source-axis distance (mm)
+  vtkSetMacro(SourceAxisDistance, double);
+  vtkGetMacro(SourceAxisDistance, double);
+
+  /// Margin added around the projected target on the isocenter plane (mm)
+  vtkSetMacro(Margin, double);
+  vtkGetMacro(Margin, double);
+
+  /// Pixel spacing of the BEV mask on the isocenter plane (mm)
+  vtkSetMacro(MaskSpacing, double);
+  vtkGetMacro(MaskSpacing, double);
+
+  /// MLC leaf pair boundaries (number of leaf pairs + 1 values). If not set, only the jaws are fitted
+  vtkSetObjectMacro(MLCBoundaries, vtkDoubleArray);
+  vtkGetObjectMacro(MLCBoundaries, vtkDoubleArray);
+
+  /// Leaves move along the X axis (MLCX) if true, along the Y axis (MLCY) otherwise
+  vtkSetMacro(LeavesMoveAlongX, bool);
+  vtkGetMacro(LeavesMoveAlongX, bool);
+  vtkBooleanMacro(LeavesMoveAlongX, bool);
+
+  /// Get BEV mask of the target. Unsigned char image on the isocenter plane, in beam coordinate system
+  vtkGetObjectMacro(OutputMask, vtkImageData);
+
+  /// Get fitted jaw positions in X1, X2, Y1, Y2 order
+  vtkGetVector4Macro(JawPositions, double);
+
+  /// Get fitted leaf positions. Two component array (positions of side "1" and "2") with one tuple for each
+  /// leaf pair in \sa MLCBoundaries. Leaf pairs not covering the target are closed in the middle of the field
+  vtkGetObjectMacro(LeafPositions, vtkDoubleArray);
+
+protected:
+  /// Project the surface points, or the boundary voxel centers of the labelmap to the isocenter plane.
+  /// Points behind the source are set to NaN.
+  /// \param projectedPoints Projected point coordinates (X and Y in the beam coordinate system)
+  /// \param footprintRadii Half size of the projected voxels for labelmap input, empty for surface input
+  void ProjectInput(std::vector<double>& projectedPoints, std::vector<double>& footprintRadii);
+
+  /// Fit jaws and leaves to the output mask
+  void FitAperture();
+
+protected:
+  vtkPolyData* InputSurface;
+  vtkOrientedImageData* InputLabelmap;
+  vtkMatrix4x4* BeamToRASMatrix;
+  double SourceAxisDistance;
+  double Margin;
+  double MaskSpacing;
+  vtkDoubleArray* MLCBoundaries;
+  bool LeavesMoveAlongX;
+
+  vtkImageData* OutputMask;
+  double JawPositions[4];
+  vtkDoubleArray* LeafPositions;
+
+protected:
+  vtkBeamApertureFitter();
+  ~vtkBeamApertureFitter() override;
+
+private:
+  vtkBeamApertureFitter(const vtkBeamApertureFitter&) = delete;
+  void operator=(const vtkBeamApertureFitter&) = delete;
+};
+
+#endif
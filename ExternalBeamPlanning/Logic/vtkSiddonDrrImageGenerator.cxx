@@ -0,0 +1,392 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#include "vtkSiddonDrrImageGenerator.h"
+
+// Beams includes
+#include "vtkMRMLRTBeamNode.h"
+
+// MRML includes
+#include <vtkMRMLTransformNode.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Converts Hounsfield units to linear attenuation coefficients
+  class AttenuationFunctor
+  {
+  public:
+    vtkDataArray* Scalars;
+    double WaterAttenuationCoefficient;
+    double HounsfieldUnitThreshold;
+    float* Attenuations;
+
+    void operator()(vtkIdType beginVoxel, vtkIdType endVoxel) const
+    {
+      for (vtkIdType voxel = beginVoxel; voxel < endVoxel; ++voxel)
+      {
+        double hounsfieldUnit = this->Scalars->GetComponent(voxel, 0);
+        double attenuation = 0.0;
+        if (hounsfieldUnit >= this->HounsfieldUnitThreshold)
+        {
+          attenuation = std::max(0.0, this->WaterAttenuationCoefficient * (1.0 + hounsfieldUnit / 1000.0));
+        }
+        this->Attenuations[voxel] = static_cast<float>(attenuation);
+      }
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  /// Casts the rays of a range of DRR image rows
+  class DrrRowFunctor
+  {
+  public:
+    const float* Attenuations;
+    int Extent[6];
+    vtkIdType Increments[3];
+    /// Beam source position in RAS and in continuous IJK coordinates
+    double SourceRAS[3];
+    double SourceIJK[3];
+    /// Beam to RAS and RAS to IJK matrices
+    vtkMatrix4x4* BeamToRASMatrix;
+    vtkMatrix4x4* RASToIJKMatrix;
+    int ImageDimensions[2];
+    double ImageOrigin[2];
+    double ImageSpacing[2];
+    /// Rays are extended by this factor beyond the isocenter plane so that they pass through the whole volume
+    double RayExtensionFactor;
+    float* OutputPixels;
+
+    void operator()(vtkIdType beginRow, vtkIdType endRow) const
+    {
+      for (vtkIdType row = beginRow; row < endRow; ++row)
+      {
+        for (int column = 0; column < this->ImageDimensions[0]; ++column)
+        {
+          double pixel_Beam[4] = {
+            this->ImageOrigin[0] + column * this->ImageSpacing[0],
+            this->ImageOrigin[1] + row * this->ImageSpacing[1],
+            0.0, 1.0 };
+          double pixelRAS[4] = { 0.0, 0.0, 0.0, 1.0 };
+          this->BeamToRASMatrix->MultiplyPoint(pixel_Beam, pixelRAS);
+
+          // Extend ray from the source through the pixel
+          double rayEndRAS[4] = { 0.0, 0.0, 0.0, 1.0 };
+          for (int axis = 0; axis < 3; ++axis)
+          {
+            rayEndRAS[axis] = this->SourceRAS[axis] + this->RayExtensionFactor * (pixelRAS[axis] - this->SourceRAS[axis]);
+          }
+          double rayEndIJK[4] = { 0.0, 0.0, 0.0, 1.0 };
+          this->RASToIJKMatrix->MultiplyPoint(rayEndRAS, rayEndIJK);
+
+          // The parametric positions are the same in IJK and RAS, so the physical length is applied after integration
+          double rayLength = std::sqrt(vtkMath::Distance2BetweenPoints(this->SourceRAS, rayEndRAS));
+          double integral = vtkSiddonDrrImageGenerator::IntegrateAlongSegment(this->SourceIJK, rayEndIJK, this->Extent, this->Increments, this->Attenuations);
+          this->OutputPixels[row * this->ImageDimensions[0] + column] = static_cast<float>(integral * rayLength);
+        }
+      }
+    }
+  };
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSiddonDrrImageGenerator);
+
+//----------------------------------------------------------------------------
+vtkSiddonDrrImageGenerator::vtkSiddonDrrImageGenerator()
+{
+  this->InputImage = nullptr;
+  this->IJKToRASMatrix = nullptr;
+  this->BeamToRASMatrix = nullptr;
+  this->SourceAxisDistance = 1000.0;
+  this->ImageDimensions[0] = 256;
+  this->ImageDimensions[1] = 256;
+  this->ImageSpacing[0] = 1.0;
+  this->ImageSpacing[1] = 1.0;
+  this->WaterAttenuationCoefficient = 0.02;
+  this->HounsfieldUnitThreshold = -1000.0;
+  this->Output = vtkImageData::New();
+
+  this->AttenuationVolumeInput = nullptr;
+  this->AttenuationVolumeWaterCoefficient = 0.0;
+  this->AttenuationVolumeThreshold = 0.0;
+}
+
+//----------------------------------------------------------------------------
+vtkSiddonDrrImageGenerator::~vtkSiddonDrrImageGenerator()
+{
+  this->SetInputImage(nullptr);
+  this->SetIJKToRASMatrix(nullptr);
+  this->SetBeamToRASMatrix(nullptr);
+  this->Output->Delete();
+  this->Output = nullptr;
+}
+
+//----------------------------------------------------------------------------
+void vtkSiddonDrrImageGenerator::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "InputImage: " << this->InputImage << "\n";
+  os << indent << "IJKToRASMatrix: " << this->IJKToRASMatrix << "\n";
+  os << indent << "BeamToRASMatrix: " << this->BeamToRASMatrix << "\n";
+  os << indent << "SourceAxisDistance: " << this->SourceAxisDistance << "\n";
+  os << indent << "ImageDimensions: (" << this->ImageDimensions[0] << ", " << this->ImageDimensions[1] << ")\n";
+  os << indent << "ImageSpacing: (" << this->ImageSpacing[0] << ", " << this->ImageSpacing[1] << ")\n";
+  os << indent << "WaterAttenuationCoefficient: " << this->WaterAttenuationCoefficient << "\n";
+  os << indent << "HounsfieldUnitThreshold: " << this->HounsfieldUnitThreshold << "\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkSiddonDrrImageGenerator::SetBeamGeometry(vtkMRMLRTBeamNode* beamNode)
+{
+  if (!beamNode)
+  {
+    vtkErrorMacro("SetBeamGeometry: Invalid beam node");
+    return false;
+  }
+  vtkMRMLTransformNode* beamTransformNode = beamNode->GetParentTransformNode();
+  if (!beamTransformNode)
+  {
+    vtkErrorMacro("SetBeamGeometry: Failed to access transform node of beam " << beamNode->GetName());
+    return false;
+  }
+
+  vtkSmartPointer<vtkMatrix4x4> beamToRASMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  if (!beamTransformNode->GetMatrixTransformToWorld(beamToRASMatrix))
+  {
+    vtkErrorMacro("SetBeamGeometry: Transform of beam " << beamNode->GetName() << " is not linear");
+    return false;
+  }
+  this->SetBeamToRASMatrix(beamToRASMatrix);
+  this->SetSourceAxisDistance(beamNode->GetSAD());
+  return true;
+}
+
+//----------------------------------------------------------------------------
+double vtkSiddonDrrImageGenerator::IntegrateAlongSegment(const double start[3], const double end[3], const int extent[6], const vtkIdType increments[3], const float* voxelValues)
+{
+  // Parametric range of the segment inside the volume (voxel boundaries are halfway between the voxel centers)
+  double direction[3] = { 0.0, 0.0, 0.0 };
+  double alphaMin = 0.0;
+  double alphaMax = 1.0;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    direction[axis] = end[axis] - start[axis];
+    double lowerBoundary = extent[2 * axis] - 0.5;
+    double upperBoundary = extent[2 * axis + 1] + 0.5;
+    if (std::abs(direction[axis]) < 1e-12)
+    {
+      if (start[axis] <= lowerBoundary || start[axis] >= upperBoundary)
+      {
+        return 0.0;
+      }
+      direction[axis] = 0.0;
+      continue;
+    }
+    double alphaLower = (lowerBoundary - start[axis]) / direction[axis];
+    double alphaUpper = (upperBoundary - start[axis]) / direction[axis];
+    alphaMin = std::max(alphaMin, std::min(alphaLower, alphaUpper));
+    alphaMax = std::min(alphaMax, std::max(alphaLower, alphaUpper));
+  }
+  if (alphaMin >= alphaMax)
+  {
+    return 0.0;
+  }
+
+  // Entry voxel, and parametric position of the next voxel boundary crossing along each axis
+  int voxel[3] = { 0, 0, 0 };
+  int voxelStep[3] = { 0, 0, 0 };
+  double alphaNext[3] = { 0.0, 0.0, 0.0 };
+  double alphaIncrement[3] = { 0.0, 0.0, 0.0 };
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    double entry = start[axis] + alphaMin * direction[axis];
+    if (direction[axis] > 0.0)
+    {
+      voxel[axis] = static_cast<int>(std::floor(entry + 0.5));
+    }
+    else if (direction[axis] < 0.0)
+    {
+      voxel[axis] = static_cast<int>(std::ceil(entry + 0.5)) - 1;
+    }
+    else
+    {
+      voxel[axis] = static_cast<int>(std::floor(entry + 0.5));
+    }
+    voxel[axis] = std::max(extent[2 * axis], std::min(voxel[axis], extent[2 * axis + 1]));
+
+    if (direction[axis] > 0.0)
+    {
+      voxelStep[axis] = 1;
+      alphaNext[axis] = (voxel[axis] + 0.5 - start[axis]) / direction[axis];
+      alphaIncrement[axis] = 1.0 / direction[axis];
+    }
+    else if (direction[axis] < 0.0)
+    {
+      voxelStep[axis] = -1;
+      alphaNext[axis] = (voxel[axis] - 0.5 - start[axis]) / direction[axis];
+      alphaIncrement[axis] = -1.0 / direction[axis];
+    }
+    else
+    {
+      alphaNext[axis] = std::numeric_limits<double>::max();
+    }
+  }
+
+  double integral = 0.0;
+  double alpha = alphaMin;
+  while (alpha < alphaMax)
+  {
+    int axis = (alphaNext[0] < alphaNext[1] ? (alphaNext[0] < alphaNext[2] ? 0 : 2) : (alphaNext[1] < alphaNext[2] ? 1 : 2));
+    double alphaExit = std::min(alphaNext[axis], alphaMax);
+    if (alphaExit > alpha)
+    {
+      vtkIdType voxelIndex = (voxel[0] - extent[0]) * increments[0] + (voxel[1] - extent[2]) * increments[1] + (voxel[2] - extent[4]) * increments[2];
+      integral += (alphaExit - alpha) * voxelValues[voxelIndex];
+      alpha = alphaExit;
+    }
+    voxel[axis] += voxelStep[axis];
+    if (voxel[axis] < extent[2 * axis] || voxel[axis] > extent[2 * axis + 1])
+    {
+      break;
+    }
+    alphaNext[axis] += alphaIncrement[axis];
+  }
+
+  return integral;
+}
+
+//----------------------------------------------------------------------------
+void vtkSiddonDrrImageGenerator::UpdateAttenuationVolume()
+{
+  vtkDataArray* scalars = this->InputImage->GetPointData()->GetScalars();
+  vtkIdType numberOfVoxels = this->InputImage->GetNumberOfPoints();
+  if ( this->AttenuationVolumeInput == this->InputImage
+    && this->AttenuationVolumeTime > this->InputImage->GetMTime()
+    && this->AttenuationVolumeTime > scalars->GetMTime()
+    && this->AttenuationVolumeWaterCoefficient == this->WaterAttenuationCoefficient
+    && this->AttenuationVolumeThreshold == this->HounsfieldUnitThreshold
+    && static_cast<vtkIdType>(this->AttenuationVolume.size()) == numberOfVoxels )
+  {
+    return;
+  }
+
+  this->AttenuationVolume.resize(numberOfVoxels);
+  AttenuationFunctor functor;
+  functor.Scalars = scalars;
+  functor.WaterAttenuationCoefficient = this->WaterAttenuationCoefficient;
+  functor.HounsfieldUnitThreshold = this->HounsfieldUnitThreshold;
+  functor.Attenuations = this->AttenuationVolume.data();
+  vtkSMPTools::For(0, numberOfVoxels, functor);
+
+  this->AttenuationVolumeInput = this->InputImage;
+  this->AttenuationVolumeWaterCoefficient = this->WaterAttenuationCoefficient;
+  this->AttenuationVolumeThreshold = this->HounsfieldUnitThreshold;
+  this->AttenuationVolumeTime.Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkSiddonDrrImageGenerator::Update()
+{
+  this->Output->Initialize();
+  if (!this->InputImage || !this->InputImage->GetPointData()->GetScalars() || !this->IJKToRASMatrix || !this->BeamToRASMatrix)
+  {
+    vtkErrorMacro("Update: Input image, IJK to RAS matrix and beam to RAS matrix are required");
+    return;
+  }
+  if (this->ImageDimensions[0] < 1 || this->ImageDimensions[1] < 1 || this->SourceAxisDistance <= 0.0)
+  {
+    vtkErrorMacro("Update: Invalid DRR image dimensions or source-axis distance");
+    return;
+  }
+
+  this->UpdateAttenuationVolume();
+
+  // Output image is on the isocenter plane, centered on the beam axis
+  double imageOrigin[2] = {
+    -0.5 * (this->ImageDimensions[0] - 1) * this->ImageSpacing[0],
+    -0.5 * (this->ImageDimensions[1] - 1) * this->ImageSpacing[1] };
+  this->Output->SetDimensions(this->ImageDimensions[0], this->ImageDimensions[1], 1);
+  this->Output->SetOrigin(imageOrigin[0], imageOrigin[1], 0.0);
+  this->Output->SetSpacing(this->ImageSpacing[0], this->ImageSpacing[1], 1.0);
+  this->Output->AllocateScalars(VTK_FLOAT, 1);
+
+  DrrRowFunctor functor;
+  functor.Attenuations = this->AttenuationVolume.data();
+  this->InputImage->GetExtent(functor.Extent);
+  functor.Increments[0] = 1;
+  functor.Increments[1] = functor.Extent[1] - functor.Extent[0] + 1;
+  functor.Increments[2] = functor.Increments[1] * (functor.Extent[3] - functor.Extent[2] + 1);
+  vtkSmartPointer<vtkMatrix4x4> rasToIJKMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Invert(this->IJKToRASMatrix, rasToIJKMatrix);
+  functor.BeamToRASMatrix = this->BeamToRASMatrix;
+  functor.RASToIJKMatrix = rasToIJKMatrix;
+
+  double source_Beam[4] = { 0.0, 0.0, this->SourceAxisDistance, 1.0 };
+  double sourceRAS[4] = { 0.0, 0.0, 0.0, 1.0 };
+  this->BeamToRASMatrix->MultiplyPoint(source_Beam, sourceRAS);
+  double sourceIJK[4] = { 0.0, 0.0, 0.0, 1.0 };
+  rasToIJKMatrix->MultiplyPoint(sourceRAS, sourceIJK);
+  std::copy(sourceRAS, sourceRAS + 3, functor.SourceRAS);
+  std::copy(sourceIJK, sourceIJK + 3, functor.SourceIJK);
+
+  // Rays pass the isocenter plane at least SAD away from the source, so extending them by the largest
+  // distance of the volume corners from the isocenter makes sure that they traverse the whole volume.
+  // The corners are on the outer voxel boundaries, half a voxel beyond the outermost voxel centers
+  double isocenterRAS[4] = { 0.0, 0.0, 0.0, 1.0 };
+  double origin_Beam[4] = { 0.0, 0.0, 0.0, 1.0 };
+  this->BeamToRASMatrix->MultiplyPoint(origin_Beam, isocenterRAS);
+  double maximumCornerDistance = 0.0;
+  for (int corner = 0; corner < 8; ++corner)
+  {
+    double cornerIJK[4] = {
+      (corner & 1) ? functor.Extent[1] + 0.5 : functor.Extent[0] - 0.5,
+      (corner & 2) ? functor.Extent[3] + 0.5 : functor.Extent[2] - 0.5,
+      (corner & 4) ? functor.Extent[5] + 0.5 : functor.Extent[4] - 0.5, 1.0 };
+    double cornerRAS[4] = { 0.0, 0.0, 0.0, 1.0 };
+    this->IJKToRASMatrix->MultiplyPoint(cornerIJK, cornerRAS);
+    maximumCornerDistance = std::max(maximumCornerDistance, std::sqrt(vtkMath::Distance2BetweenPoints(cornerRAS, isocenterRAS)));
+  }
+  functor.RayExtensionFactor = (this->SourceAxisDistance + maximumCornerDistance + 1.0) / this->SourceAxisDistance;
+
+  functor.ImageDimensions[0] = this->ImageDimensions[0];
+  functor.ImageDimensions[1] = this->ImageDimensions[1];
+  functor.ImageOrigin[0] = imageOrigin[0];
+  functor.ImageOrigin[1] = imageOrigin[1];
+  functor.ImageSpacing[0] = this->ImageSpacing[0];
+  functor.ImageSpacing[1] = this->ImageSpacing[1];
+  functor.OutputPixels = static_cast<float*>(this->Output->GetScalarPointer());
+  vtkSMPTools::For(0, static_cast<vtkIdType>(this->ImageDimensions[1]), functor);
+
+  this->Output->Modified();
+}
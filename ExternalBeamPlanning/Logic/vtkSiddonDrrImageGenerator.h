@@ -0,0 +1,142 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// .NAME vtkSiddonDrrImageGenerator - Computes digitally reconstructed radiographs by software ray casting
+// .SECTION Description
+
+#ifndef __vtkSiddonDrrImageGenerator_h
+#define __vtkSiddonDrrImageGenerator_h
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimeStamp.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerExternalBeamPlanningModuleLogicExport.h"
+
+class vtkMRMLRTBeamNode;
+
+/// \ingroup SlicerRt_QtModules_ExternalBeamPlanning
+/// \brief Computes a digitally reconstructed radiograph (DRR) of a CT volume for a divergent beam.
+///
+/// For each pixel of the imager a ray is cast from the beam source, and the linear attenuation
+/// coefficients derived from the Hounsfield units of the CT are integrated along it. The voxels
+/// crossed by the ray are traversed with the incremental Siddon-Jacobs algorithm on the original
+/// CT values, and the imager rows are processed in parallel. No rendering context is needed.
+///
+/// The imager is placed on the isocenter plane of the beam, i.e. the output image is in the beam
+/// coordinate system (X and Y axes of the collimator, isocenter at the origin). The output pixel
+/// values are the line integrals of the attenuation coefficient (dimensionless).
+class VTK_SLICER_EXTERNALBEAMPLANNING_MODULE_LOGIC_EXPORT vtkSiddonDrrImageGenerator : public vtkObject
+{
+public:
+  static vtkSiddonDrrImageGenerator *New();
+  vtkTypeMacro(vtkSiddonDrrImageGenerator, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Compute the DRR image
+  virtual void Update();
+
+  /// Get computed DRR image. Single component float image with origin and spacing in the beam coordinate system
+  vtkGetObjectMacro(Output, vtkImageData);
+
+  /// Set beam geometry from a beam node: source-axis distance, and the beam to RAS transform
+  /// (that contains the gantry, collimator and couch rotations, and the isocenter position)
+  /// \return Success flag
+  bool SetBeamGeometry(vtkMRMLRTBeamNode* beamNode);
+
+  /// CT volume in Hounsfield units
+  vtkSetObjectMacro(InputImage, vtkImageData);
+  vtkGetObjectMacro(InputImage, vtkImageData);
+
+  /// IJK to RAS matrix of the CT volume
+  vtkSetObjectMacro(IJKToRASMatrix, vtkMatrix4x4);
+  vtkGetObjectMacro(IJKToRASMatrix, vtkMatrix4x4);
+
+  /// Beam to RAS matrix. Beam source is on the Z axis of the beam coordinate system, the isocenter is the origin
+  vtkSetObjectMacro(BeamToRASMatrix, vtkMatrix4x4);
+  vtkGetObjectMacro(BeamToRASMatrix, vtkMatrix4x4);
+
+  /// Source-axis distance (mm)
+  vtkSetMacro(SourceAxisDistance, double);
+  vtkGetMacro(SourceAxisDistance, double);
+
+  /// Number of columns and rows of the DRR image
+  vtkSetVector2Macro(ImageDimensions, int);
+  vtkGetVector2Macro(ImageDimensions, int);
+
+  /// Pixel spacing of the DRR image on the isocenter plane (mm)
+  vtkSetVector2Macro(ImageSpacing, double);
+  vtkGetVector2Macro(ImageSpacing, double);
+
+  /// Linear attenuation coefficient of water (1/mm). Voxel attenuation is (1 + HU/1000) times this value
+  vtkSetMacro(WaterAttenuationCoefficient, double);
+  vtkGetMacro(WaterAttenuationCoefficient, double);
+
+  /// Voxels with lower Hounsfield unit than this threshold do not attenuate
+  vtkSetMacro(HounsfieldUnitThreshold, double);
+  vtkGetMacro(HounsfieldUnitThreshold, double);
+
+  /// Integrate voxel values along the segment between two points given in continuous IJK coordinates.
+  /// Voxels are traversed in order using the incremental Siddon-Jacobs algorithm.
+  /// \param extent Extent of the volume, the voxel boundaries are halfway between the voxel centers
+  /// \param increments Offsets between adjacent voxels along the three axes in \sa voxelValues
+  /// \return Sum of voxel values weighted by the parametric length of the intersection with the voxel.
+  ///   The segment is parameterized from 0 to 1, so the caller needs to multiply by the length of the segment
+  static double IntegrateAlongSegment(const double start[3], const double end[3], const int extent[6], const vtkIdType increments[3], const float* voxelValues);
+
+protected:
+  /// Convert the input CT to attenuation coefficients if the input or the conversion parameters changed since last time
+  void UpdateAttenuationVolume();
+
+protected:
+  vtkImageData* InputImage;
+  vtkMatrix4x4* IJKToRASMatrix;
+  vtkMatrix4x4* BeamToRASMatrix;
+  double SourceAxisDistance;
+  int ImageDimensions[2];
+  double ImageSpacing[2];
+  double WaterAttenuationCoefficient;
+  double HounsfieldUnitThreshold;
+  vtkImageData* Output;
+
+  /// Attenuation coefficient of each input voxel, in the order of the input scalars
+  std::vector<float> AttenuationVolume;
+  /// Input, time and parameters of the last attenuation volume computation
+  vtkImageData* AttenuationVolumeInput;
+  vtkTimeStamp AttenuationVolumeTime;
+  double AttenuationVolumeWaterCoefficient;
+  double AttenuationVolumeThreshold;
+
+protected:
+  vtkSiddonDrrImageGenerator();
+  ~vtkSiddonDrrImageGenerator() override;
+
+private:
+  vtkSiddonDrrImageGenerator(const vtkSiddonDrrImageGenerator&) = delete;
+  void operator=(const vtkSiddonDrrImageGenerator&) = delete;
+};
+
+#endif
@@ -20,6 +20,9 @@
 ==============================================================================*/
 
 #include "vtkSlicerExternalBeamPlanningModuleLogic.h"
+#include "vtkBeamApertureFitter.h"
+#include "vtkSiddonDrrImageGenerator.h"
+#include "vtkWaterEquivalentDepthVolumeGenerator.h"
 
 // Beams includes
 #include "vtkMRMLRTPlanNode.h"
@@ -32,11 +35,22 @@
 //#include <vtkMRMLLinearTransformNode.h>
 #include <vtkMRMLScalarVolumeNode.h>
 //#include <vtkMRMLScalarVolumeDisplayNode.h>
-//#include <vtkMRMLDoubleArrayNode.h>
+#include <vtkMRMLDoubleArrayNode.h>
 //#include <vtkMRMLSliceLogic.h>
 //#include <vtkMRMLSliceNode.h>
 //#include <vtkMRMLSliceCompositeNode.h>
+#include <vtkMRMLSegmentationNode.h>
 #include <vtkMRMLSubjectHierarchyNode.h>
+#include <vtkMRMLTableNode.h>
+#include <vtkMRMLTransformNode.h>
+
+// SegmentationCore includes
+#include <vtkSegment.h>
+#include <vtkSegmentation.h>
+#include <vtkSegmentationConverter.h>
+
+// SlicerRT includes
+#include "vtkSlicerRtCommon.h"
 
 // Slicer includes
 #include <vtkSlicerCLIModuleLogic.h>
@@ -58,6 +72,8 @@
 //#include <vtkImageData.h>
 //#include <vtkImageCast.h>
 //#include <vtkPiecewiseFunction.h>
+#include <vtkPolyData.h>
+#include <vtkTable.h>
 //#include <vtkProperty.h>
 //#include <vtkActor.h>
 //#include <vtkVolumeProperty.h>
@@ -69,10 +85,17 @@
 //#include <vtkImageShiftScale.h>
 //#include <vtkImageExtractComponents.h>
 //#include <vtkTransform.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPiecewiseFunction.h>
 //#include <vtkPolyDataMapper.h>
 //#include <vtkImageGradientMagnitude.h>
 //#include <vtkImageMathematics.h>
 
+// STD includes
+#include <algorithm>
+#include <map>
+
 //----------------------------------------------------------------------------
 vtkCxxSetObjectMacro(vtkSlicerExternalBeamPlanningModuleLogic, BeamsLogic, vtkSlicerBeamsModuleLogic);
 
@@ -84,12 +107,73 @@ public:
 
   //TODO: Add Matlab dose engine plugin infrastructure
   vtkSlicerCLIModuleLogic* MatlabDoseCalculationModuleLogic;
+
+  /// Computed WED volume of a beam, and the inputs it was computed from
+  struct WedCacheEntry
+  {
+    std::string ReferenceVolumeNodeID;
+    vtkMTimeType ReferenceImageMTime;
+    double ReferenceIJKToRAS[16];
+    double SourcePosition[3];
+    double GantryAngle;
+    double CouchAngle;
+    vtkMTimeType StoppingPowerTableMTime;
+    vtkSmartPointer<vtkOrientedImageData> WedVolume;
+    /// Image data of the WED volume node of the beam, sharing the voxels of WedVolume
+    vtkSmartPointer<vtkImageData> WedImageData;
+  };
+  /// Cached WED volumes by beam node ID
+  std::map<std::string, WedCacheEntry> WedCache;
+
+  /// Set cached WED volume to the WED volume node of the beam so that dose engines can read it.
+  /// The node is created if the beam does not have one, and only updated if it does not contain the cached volume.
+  void PublishWED(vtkMRMLRTBeamNode* beamNode, vtkMRMLScalarVolumeNode* referenceVolumeNode, WedCacheEntry& cacheEntry);
+
+  vtkSmartPointer<vtkWaterEquivalentDepthVolumeGenerator> WedGenerator;
 };
 
 //----------------------------------------------------------------------------
 vtkSlicerExternalBeamPlanningModuleLogic::vtkInternal::vtkInternal()
 {
   this->MatlabDoseCalculationModuleLogic = nullptr;
+  this->WedGenerator = vtkSmartPointer<vtkWaterEquivalentDepthVolumeGenerator>::New();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerExternalBeamPlanningModuleLogic::vtkInternal::PublishWED(
+  vtkMRMLRTBeamNode* beamNode, vtkMRMLScalarVolumeNode* referenceVolumeNode, WedCacheEntry& cacheEntry)
+{
+  vtkMRMLScene* scene = beamNode->GetScene();
+  vtkMRMLScalarVolumeNode* wedVolumeNode = beamNode->GetWEDVolumeNode();
+  if (!wedVolumeNode)
+  {
+    vtkSmartPointer<vtkMRMLScalarVolumeNode> newWedVolumeNode = vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
+    std::string wedVolumeNodeName = scene->GenerateUniqueName(std::string(beamNode->GetName()) + std::string("_WED"));
+    newWedVolumeNode->SetName(wedVolumeNodeName.c_str());
+    scene->AddNode(newWedVolumeNode);
+    beamNode->SetAndObserveWEDVolumeNode(newWedVolumeNode);
+    wedVolumeNode = newWedVolumeNode;
+  }
+
+  if (!cacheEntry.WedImageData)
+  {
+    // Geometry of the image is stored in the volume node
+    cacheEntry.WedImageData = vtkSmartPointer<vtkImageData>::New();
+    cacheEntry.WedImageData->ShallowCopy(cacheEntry.WedVolume);
+    cacheEntry.WedImageData->SetOrigin(0.0, 0.0, 0.0);
+    cacheEntry.WedImageData->SetSpacing(1.0, 1.0, 1.0);
+  }
+  if (wedVolumeNode->GetImageData() != cacheEntry.WedImageData.GetPointer())
+  {
+    int wasModifying = wedVolumeNode->StartModify();
+    vtkNew<vtkMatrix4x4> referenceIjkToRasMatrix;
+    referenceVolumeNode->GetIJKToRASMatrix(referenceIjkToRasMatrix.GetPointer());
+    wedVolumeNode->SetIJKToRASMatrix(referenceIjkToRasMatrix.GetPointer());
+    wedVolumeNode->SetAndObserveImageData(cacheEntry.WedImageData);
+    wedVolumeNode->EndModify(wasModifying);
+  }
+  // The WED volume is in the geometry of the reference volume, so it follows its transform
+  wedVolumeNode->SetAndObserveTransformNodeID(referenceVolumeNode->GetTransformNodeID());
 }
 
 //----------------------------------------------------------------------------
@@ -235,6 +319,11 @@ void vtkSlicerExternalBeamPlanningModuleLogic::OnMRMLSceneNodeRemoved(vtkMRMLNod
     return;
   }
 
+  if (node->IsA("vtkMRMLRTBeamNode") && node->GetID())
+  {
+    this->Internal->WedCache.erase(node->GetID());
+  }
+
   if (node->IsA("vtkMRMLScalarVolumeNode") || node->IsA("vtkMRMLRTPlanNode"))
   {
     this->Modified();
@@ -244,6 +333,8 @@ void vtkSlicerExternalBeamPlanningModuleLogic::OnMRMLSceneNodeRemoved(vtkMRMLNod
 //---------------------------------------------------------------------------
 void vtkSlicerExternalBeamPlanningModuleLogic::OnMRMLSceneEndClose()
 {
+  this->Internal->WedCache.clear();
+
   this->Modified();
 }
 
@@ -336,6 +427,189 @@ vtkMRMLRTBeamNode* vtkSlicerExternalBeamPlanningModuleLogic::CloneBeamInPlan(vtk
 }
 
 
+//---------------------------------------------------------------------------
+vtkOrientedImageData* vtkSlicerExternalBeamPlanningModuleLogic::ComputeWED(vtkMRMLRTBeamNode* beamNode)
+{
+  if (!this->GetMRMLScene() || !beamNode || !beamNode->GetID())
+  {
+    vtkErrorMacro("ComputeWED: Invalid MRML scene or beam node");
+    return nullptr;
+  }
+  vtkMRMLRTPlanNode* planNode = beamNode->GetParentPlanNode();
+  vtkMRMLScalarVolumeNode* referenceVolumeNode = (planNode ? planNode->GetReferenceVolumeNode() : nullptr);
+  if (!referenceVolumeNode || !referenceVolumeNode->GetImageData())
+  {
+    vtkErrorMacro("ComputeWED: Failed to access reference volume of beam " << beamNode->GetName());
+    return nullptr;
+  }
+
+  // Make sure the beam transform reflects the current beam parameters and isocenter
+  if (this->BeamsLogic)
+  {
+    this->BeamsLogic->UpdateTransformForBeam(beamNode);
+  }
+  double sourcePosition[3] = { 0.0, 0.0, 0.0 };
+  if (!beamNode->GetSourcePosition(sourcePosition))
+  {
+    vtkErrorMacro("ComputeWED: Failed to get source position of beam " << beamNode->GetName());
+    return nullptr;
+  }
+  vtkNew<vtkMatrix4x4> referenceIjkToRasMatrix;
+  referenceVolumeNode->GetIJKToRASMatrix(referenceIjkToRasMatrix.GetPointer());
+  vtkPiecewiseFunction* stoppingPowerTable = this->Internal->WedGenerator->GetHounsfieldToStoppingPowerTable();
+
+  // Reuse the cached WED volume if none of its inputs changed
+  vtkInternal::WedCacheEntry& cacheEntry = this->Internal->WedCache[beamNode->GetID()];
+  bool cacheValid = ( cacheEntry.WedVolume.GetPointer() != nullptr
+    && cacheEntry.ReferenceVolumeNodeID == referenceVolumeNode->GetID()
+    && cacheEntry.ReferenceImageMTime == referenceVolumeNode->GetImageData()->GetMTime()
+    && cacheEntry.StoppingPowerTableMTime == stoppingPowerTable->GetMTime()
+    && vtkSlicerRtCommon::AreEqualWithTolerance(cacheEntry.GantryAngle, beamNode->GetGantryAngle())
+    && vtkSlicerRtCommon::AreEqualWithTolerance(cacheEntry.CouchAngle, beamNode->GetCouchAngle()) );
+  for (int index = 0; index < 3 && cacheValid; ++index)
+  {
+    cacheValid = vtkSlicerRtCommon::AreEqualWithTolerance(cacheEntry.SourcePosition[index], sourcePosition[index]);
+  }
+  for (int index = 0; index < 16 && cacheValid; ++index)
+  {
+    cacheValid = vtkSlicerRtCommon::AreEqualWithTolerance(cacheEntry.ReferenceIJKToRAS[index], referenceIjkToRasMatrix->GetElement(index / 4, index % 4));
+  }
+  if (cacheValid)
+  {
+    this->Internal->PublishWED(beamNode, referenceVolumeNode, cacheEntry);
+    return cacheEntry.WedVolume;
+  }
+
+  // Trace the rays from the source to all voxels
+  vtkWaterEquivalentDepthVolumeGenerator* wedGenerator = this->Internal->WedGenerator;
+  wedGenerator->SetInputImage(referenceVolumeNode->GetImageData());
+  wedGenerator->SetIJKToRASMatrix(referenceIjkToRasMatrix.GetPointer());
+  wedGenerator->SetSourcePosition(sourcePosition);
+  wedGenerator->Update();
+  wedGenerator->SetInputImage(nullptr);
+
+  vtkSmartPointer<vtkOrientedImageData> wedVolume = vtkSmartPointer<vtkOrientedImageData>::New();
+  wedVolume->ShallowCopy(wedGenerator->GetOutput());
+  wedVolume->SetImageToWorldMatrix(referenceIjkToRasMatrix.GetPointer());
+
+  cacheEntry.ReferenceVolumeNodeID = referenceVolumeNode->GetID();
+  cacheEntry.ReferenceImageMTime = referenceVolumeNode->GetImageData()->GetMTime();
+  for (int index = 0; index < 16; ++index)
+  {
+    cacheEntry.ReferenceIJKToRAS[index] = referenceIjkToRasMatrix->GetElement(index / 4, index % 4);
+  }
+  std::copy(sourcePosition, sourcePosition + 3, cacheEntry.SourcePosition);
+  cacheEntry.GantryAngle = beamNode->GetGantryAngle();
+  cacheEntry.CouchAngle = beamNode->GetCouchAngle();
+  cacheEntry.StoppingPowerTableMTime = stoppingPowerTable->GetMTime();
+  cacheEntry.WedVolume = wedVolume;
+  cacheEntry.WedImageData = nullptr;
+  this->Internal->PublishWED(beamNode, referenceVolumeNode, cacheEntry);
+
+  return wedVolume;
+}
+
+//---------------------------------------------------------------------------
+vtkPiecewiseFunction* vtkSlicerExternalBeamPlanningModuleLogic::GetHounsfieldToStoppingPowerTable()
+{
+  return this->Internal->WedGenerator->GetHounsfieldToStoppingPowerTable();
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerExternalBeamPlanningModuleLogic::FitBeamApertureToTarget(vtkMRMLRTBeamNode* beamNode, double margin)
+{
+  if (!this->GetMRMLScene() || !beamNode)
+  {
+    vtkErrorMacro("FitBeamApertureToTarget: Invalid MRML scene or beam node");
+    return false;
+  }
+  vtkMRMLRTPlanNode* planNode = beamNode->GetParentPlanNode();
+  vtkMRMLSegmentationNode* segmentationNode = (planNode ? planNode->GetSegmentationNode() : nullptr);
+  if (!segmentationNode || !segmentationNode->GetSegmentation() || !planNode->GetTargetSegmentID())
+  {
+    vtkErrorMacro("FitBeamApertureToTarget: Failed to access target segment of beam " << beamNode->GetName());
+    return false;
+  }
+
+  // Make sure the beam transform reflects the current beam parameters and isocenter
+  if (this->BeamsLogic)
+  {
+    this->BeamsLogic->UpdateTransformForBeam(beamNode);
+  }
+  vtkNew<vtkBeamApertureFitter> apertureFitter;
+  if (!apertureFitter->SetBeamGeometry(beamNode))
+  {
+    vtkErrorMacro("FitBeamApertureToTarget: Failed to get geometry of beam " << beamNode->GetName());
+    return false;
+  }
+  apertureFitter->SetMargin(margin);
+
+  // Use the closed surface of the target if it is readily available in RAS, otherwise the labelmap
+  vtkSegment* targetSegment = segmentationNode->GetSegmentation()->GetSegment(planNode->GetTargetSegmentID());
+  vtkPolyData* targetSurface = (targetSegment ? vtkPolyData::SafeDownCast( targetSegment->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName() ) ) : nullptr);
+  vtkSmartPointer<vtkOrientedImageData> targetLabelmap;
+  if (targetSurface && targetSurface->GetNumberOfPolys() > 0 && !segmentationNode->GetParentTransformNode())
+  {
+    apertureFitter->SetInputSurface(targetSurface);
+  }
+  else
+  {
+    targetLabelmap = planNode->GetTargetOrientedImageData();
+    if (!targetLabelmap.GetPointer())
+    {
+      vtkErrorMacro("FitBeamApertureToTarget: Failed to get target labelmap of beam " << beamNode->GetName());
+      return false;
+    }
+    apertureFitter->SetInputLabelmap(targetLabelmap);
+  }
+
+  // Fit leaves too if the beam has a valid MLC
+  vtkMRMLDoubleArrayNode* mlcBoundaryNode = beamNode->GetMLCBoundaryDoubleArrayNode();
+  vtkMRMLTableNode* mlcPositionNode = beamNode->GetMLCPositionTableNode();
+  vtkDoubleArray* mlcBoundaries = (mlcBoundaryNode ? mlcBoundaryNode->GetArray() : nullptr);
+  bool fitLeaves = ( mlcBoundaries && mlcPositionNode && mlcPositionNode->GetTable()
+    && mlcBoundaries->GetNumberOfTuples() > 1
+    && mlcPositionNode->GetNumberOfRows() == mlcBoundaries->GetNumberOfTuples() - 1
+    && mlcPositionNode->GetNumberOfColumns() >= 2 );
+  if (fitLeaves)
+  {
+    apertureFitter->SetMLCBoundaries(mlcBoundaries);
+    const char* mlcName = mlcPositionNode->GetName();
+    apertureFitter->SetLeavesMoveAlongX(!mlcName || strncmp("MLCY", mlcName, strlen("MLCY")));
+  }
+
+  if (!apertureFitter->Update())
+  {
+    vtkErrorMacro("FitBeamApertureToTarget: Failed to fit aperture of beam " << beamNode->GetName());
+    return false;
+  }
+
+  if (fitLeaves)
+  {
+    vtkTable* mlcTable = mlcPositionNode->GetTable();
+    vtkDoubleArray* leafPositions = apertureFitter->GetLeafPositions();
+    for (vtkIdType leafPair = 0; leafPair < leafPositions->GetNumberOfTuples(); ++leafPair)
+    {
+      mlcTable->SetValue(leafPair, 0, leafPositions->GetComponent(leafPair, 0));
+      mlcTable->SetValue(leafPair, 1, leafPositions->GetComponent(leafPair, 1));
+    }
+    mlcTable->Modified();
+    mlcPositionNode->Modified();
+  }
+
+  // Set all jaws with one geometry modified event
+  double* jawPositions = apertureFitter->GetJawPositions();
+  int wasModifying = beamNode->StartModify();
+  beamNode->SetX1Jaw(jawPositions[0]);
+  beamNode->SetX2Jaw(jawPositions[1]);
+  beamNode->SetY1Jaw(jawPositions[2]);
+  beamNode->SetY2Jaw(jawPositions[3]);
+  beamNode->EndModify(wasModifying);
+
+  return true;
+}
+
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 //
@@ -344,13 +618,6 @@ vtkMRMLRTBeamNode* vtkSlicerExternalBeamPlanningModuleLogic::CloneBeamInPlan(vtk
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 
-//---------------------------------------------------------------------------
-void vtkSlicerExternalBeamPlanningModuleLogic::ComputeWED()
-{
-  //TODO: Needs implementation
-  vtkErrorMacro("ComputeWED: Not implemented");
-}
-
 //----------------------------------------------------------------------------
 void vtkSlicerExternalBeamPlanningModuleLogic::SetMatlabDoseCalculationModuleLogic(vtkSlicerCLIModuleLogic* logic)
 {
@@ -406,185 +673,83 @@ std::string vtkSlicerExternalBeamPlanningModuleLogic::ComputeDoseByMatlab(vtkMRM
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerExternalBeamPlanningModuleLogic::UpdateDRR(vtkMRMLRTPlanNode* planNode, char* beamName)
+bool vtkSlicerExternalBeamPlanningModuleLogic::UpdateDRR(vtkMRMLRTPlanNode* planNode, char* beamName)
 {
   if ( !this->GetMRMLScene() || !planNode )
   {
-    vtkErrorMacro("RemoveBeam: Invalid MRML scene or RT plan node");
-    return;
+    vtkErrorMacro("UpdateDRR: Invalid MRML scene or RT plan node");
+    return false;
   }
 
-  (void)(beamName); // unused
-#if defined (commentout)
   vtkMRMLScalarVolumeNode* referenceVolumeNode = planNode->GetReferenceVolumeNode();
-  if (!referenceVolumeNode)
+  if (!referenceVolumeNode || !referenceVolumeNode->GetImageData())
   {
     vtkErrorMacro("UpdateDRR: Failed to access reference volume node");
-    return;
+    return false;
   }
 
   // Get beam node by name
-  vtkMRMLRTBeamNode* beamNode = planNode->GetBeamByName(beamName);
+  vtkMRMLRTBeamNode* beamNode = planNode->GetBeamByName(beamName ? beamName : "");
   if (!beamNode)
   {
     vtkErrorMacro("UpdateDRR: Unable to access beam node with name " << (beamName?beamName:"nullptr"));
-    return;
+    return false;
   }
 
-  vtkMRMLMarkupsFiducialNode* isocenterMarkupsNode = beamNode->GetIsocenterFiducialNode();
-  // vtkMRMLDoubleArrayNode* MLCPositionDoubleArrayNode = beamNode->GetMLCPositionDoubleArrayNode();
-  if (!isocenterMarkupsNode) // || !MLCPositionDoubleArrayNode)
+  // Make sure the beam transform reflects the current gantry, collimator and couch angles and isocenter
+  if (this->BeamsLogic)
   {
-    vtkErrorMacro("UpdateDRR: Inputs are not initialized");
-    return;
+    this->BeamsLogic->UpdateTransformForBeam(beamNode);
   }
 
-  // Cast image data to uchar for faster rendering (this is for CT data only now)
-  vtkSmartPointer<vtkImageShiftScale> cast = vtkSmartPointer<vtkImageShiftScale>::New();
-  cast->SetInputData(referenceVolumeNode->GetImageData());
-  cast->SetOutputScalarTypeToUnsignedChar();
-  cast->SetShift(1000);
-  cast->SetScale(255./2000.);
-  cast->SetClampOverflow(1);
-  cast->Update();
-
-  // Create the renderer, render window 
-  vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
-  vtkSmartPointer<vtkRenderWindow> renWin = vtkSmartPointer<vtkRenderWindow>::New();
-  renWin->SetOffScreenRendering(1);
-  renWin->AddRenderer(renderer);
-
-  // Create our volume and mapper
-  // Currently use cpu ray casting as gpu ray casting and texturemapping 3d are not working on my computer
-  vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
-  vtkSmartPointer<vtkVolumeRayCastMapper> mapper = vtkSmartPointer<vtkVolumeRayCastMapper>::New();
-  vtkSmartPointer<vtkVolumeRayCastCompositeFunction> compositeFunction = vtkSmartPointer<vtkVolumeRayCastCompositeFunction>::New();
-  mapper->SetVolumeRayCastFunction(compositeFunction);
-  //vtkSmartPointer<vtkVolumeTextureMapper3D> mapper = vtkSmartPointer<vtkVolumeTextureMapper3D>::New();
-  //vtkSmartPointer<vtkVolumeTextureMapper2D> mapper = vtkSmartPointer<vtkVolumeTextureMapper2D>::New();
-  //vtkSmartPointer<vtkGPUVolumeRayCastMapper> mapper = vtkSmartPointer<vtkGPUVolumeRayCastMapper>::New();
-  mapper->SetInputData( cast->GetOutput() );
-  mapper->SetBlendModeToComposite();
-  volume->SetMapper( mapper );
-
-  // Create our transfer function
-  vtkSmartPointer<vtkColorTransferFunction> colorFun = vtkSmartPointer<vtkColorTransferFunction>::New();
-  vtkSmartPointer<vtkPiecewiseFunction> opacityFun = vtkSmartPointer<vtkPiecewiseFunction>::New();
-
-  // Create the property and attach the transfer functions
-  vtkSmartPointer<vtkVolumeProperty> volumeProperty = vtkSmartPointer<vtkVolumeProperty>::New();
-  volumeProperty->SetColor( colorFun );
-  volumeProperty->SetScalarOpacity( opacityFun );
-  volumeProperty->SetInterpolationTypeToLinear();
-
-  colorFun->AddRGBPoint( 0, 0, 0, 0);
-  colorFun->AddRGBPoint( 128, 0, 0, 0);
-  colorFun->AddRGBPoint( 255, 1, 1, 1);
-
-  opacityFun->AddPoint(0, 0 );
-  opacityFun->AddPoint(128, 0 );
-  opacityFun->AddPoint(255, 0.2);
-
-  volumeProperty->ShadeOff();
-  volumeProperty->SetScalarOpacityUnitDistance(0.8919);
-
-  // connect up the volume to the property and the mapper
-  volume->SetProperty( volumeProperty );
-
-  vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
-  transform->Identity();
-  transform->RotateY(beamNode->GetGantryAngle());
-  transform->RotateX(90);
-
-  vtkSmartPointer<vtkTransform> transform2 = vtkSmartPointer<vtkTransform>::New();
-  transform2->Identity();
-  double isoCenterPosition[3] = {0.0,0.0,0.0};
-  isocenterMarkupsNode->GetNthFiducialPosition(0,isoCenterPosition);
-  transform2->Translate(-isoCenterPosition[0], -isoCenterPosition[1], -isoCenterPosition[2]);
-
-  vtkSmartPointer<vtkTransform> transform3 = vtkSmartPointer<vtkTransform>::New();
-  vtkSmartPointer<vtkMatrix4x4> IJK2RASMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  referenceVolumeNode->GetIJKToRASMatrix(IJK2RASMatrix);
-  transform3->SetMatrix(IJK2RASMatrix);
-
-  transform->PreMultiply();
-  transform->Concatenate(transform2);
-  transform->Concatenate(transform3);
-  volume->SetUserTransform( transform );
-
-  // The usual rendering stuff.
-  vtkSmartPointer<vtkCamera> camera = vtkSmartPointer<vtkCamera>::New();
-  // fixed camera parameters for now
-  camera->SetPosition(0, 0, 1000);
-  camera->SetFocalPoint(0, 0, 0);
-  camera->SetViewAngle(14.68);
-  camera->SetClippingRange(100, 2000);
-  camera->ParallelProjectionOff();
-
-  // Add the volume to the scene
-  renderer->AddVolume( volume );
-  renderer->SetActiveCamera(camera);
-
-  renWin->SetSize(this->DRRImageSize[0], this->DRRImageSize[1]);
-  renWin->Render();
-
-  // Capture and convert to 2D image
-  vtkSmartPointer<vtkWindowToImageFilter> windowToImage = vtkSmartPointer<vtkWindowToImageFilter>::New();
-  windowToImage->SetInput( renWin );
-
-  vtkSmartPointer<vtkImageExtractComponents> extract = vtkSmartPointer<vtkImageExtractComponents>::New();
-  extract->SetInputConnection( windowToImage->GetOutputPort() );
-  extract->SetComponents(0);
-  extract->Update();
-
-  // Add the drr image to mrml scene
-  vtkSmartPointer<vtkMRMLScalarVolumeNode> drrImageNode = beamNode->GetDRRVolumeNode();
-  if (!drrImageNode)
+  // Compute DRR by ray casting through the original CT values
+  vtkNew<vtkSiddonDrrImageGenerator> drrGenerator;
+  drrGenerator->SetInputImage(referenceVolumeNode->GetImageData());
+  vtkNew<vtkMatrix4x4> referenceIjkToRasMatrix;
+  referenceVolumeNode->GetIJKToRASMatrix(referenceIjkToRasMatrix.GetPointer());
+  drrGenerator->SetIJKToRASMatrix(referenceIjkToRasMatrix.GetPointer());
+  if (!drrGenerator->SetBeamGeometry(beamNode))
   {
-    drrImageNode = vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
-    drrImageNode = vtkMRMLScalarVolumeNode::SafeDownCast(this->GetMRMLScene()->AddNode(drrImageNode));
-    std::string DRRImageNodeName = std::string(beamName) + std::string("_DRRImage");
-    DRRImageNodeName = this->GetMRMLScene()->GenerateUniqueName(DRRImageNodeName);
-    drrImageNode->SetName(DRRImageNodeName.c_str());
-    beamNode->SetAndObserveDRRVolumeNode(drrImageNode);
+    vtkErrorMacro("UpdateDRR: Failed to get geometry of beam " << beamNode->GetName());
+    return false;
   }
-  drrImageNode->SetAndObserveImageData(extract->GetOutput());
-  drrImageNode->SetOrigin(-128,-128,0);
+  drrGenerator->SetImageDimensions(this->DRRImageSize);
+  drrGenerator->Update();
+
+  // Add the DRR image to the scene
+  vtkMRMLScalarVolumeNode* drrImageNode = beamNode->GetDRRVolumeNode();
+  if (!drrImageNode)
+  {
+    vtkSmartPointer<vtkMRMLScalarVolumeNode> newDrrImageNode = vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
+    std::string drrImageNodeName = std::string(beamNode->GetName()) + std::string("_DRRImage");
+    drrImageNodeName = this->GetMRMLScene()->GenerateUniqueName(drrImageNodeName);
+    newDrrImageNode->SetName(drrImageNodeName.c_str());
+    this->GetMRMLScene()->AddNode(newDrrImageNode);
+    beamNode->SetAndObserveDRRVolumeNode(newDrrImageNode);
+    drrImageNode = newDrrImageNode;
+  }
+
+  // Geometry of the image is stored in the volume node, so that the DRR is on the isocenter plane of the beam
+  vtkImageData* drrOutput = drrGenerator->GetOutput();
+  vtkSmartPointer<vtkImageData> drrImageData = vtkSmartPointer<vtkImageData>::New();
+  drrImageData->DeepCopy(drrOutput);
+  drrImageData->SetOrigin(0.0, 0.0, 0.0);
+  drrImageData->SetSpacing(1.0, 1.0, 1.0);
+  drrImageNode->SetOrigin(drrOutput->GetOrigin());
+  drrImageNode->SetSpacing(drrOutput->GetSpacing());
+  drrImageNode->SetAndObserveImageData(drrImageData);
+  drrImageNode->SetAndObserveTransformNodeID(beamNode->GetParentTransformNode()->GetID());
   drrImageNode->SetSelectable(1);
 
+  // The contour BEV image is not generated. The disabled offscreen rendering implementation is kept below for reference
+#if defined (commentout)
   vtkSmartPointer<vtkMRMLSliceLogic> sliceLogic = this->GetApplicationLogic()->GetSliceLogicByLayoutName("Slice4");
   if (!sliceLogic)
   {
     vtkErrorMacro("UpdateDRR: Invalid sliceLogic for DRR viewer");
-    return;
+    return false;
   }
 
-  // Transforms to place the DRR image aligned with the beam geometry
-  vtkSmartPointer<vtkTransform> transformDRR = vtkSmartPointer<vtkTransform>::New();
-  transformDRR->Identity();
-  transformDRR->RotateZ(beamNode->GetGantryAngle());
-  transformDRR->RotateX(-90);
-
-  vtkSmartPointer<vtkTransform> transformDRR2 = vtkSmartPointer<vtkTransform>::New();
-  transformDRR2->Identity();
-  transformDRR2->Translate(isoCenterPosition[0], isoCenterPosition[1], isoCenterPosition[2]);
-
-  transformDRR->PostMultiply();
-  transformDRR->Concatenate(transformDRR2->GetMatrix());
-
-  vtkSmartPointer<vtkMRMLLinearTransformNode> drrImageTransformNode = vtkMRMLLinearTransformNode::SafeDownCast(
-    this->GetMRMLScene()->GetNodeByID(drrImageNode->GetTransformNodeID()));
-  if (!drrImageTransformNode)
-  {
-    drrImageTransformNode = vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
-    drrImageTransformNode = vtkMRMLLinearTransformNode::SafeDownCast(this->GetMRMLScene()->AddNode(drrImageTransformNode));
-    std::string DRRImageTransformNodeName = std::string(beamName) + std::string("_DRRImage_Transform");
-    DRRImageTransformNodeName = this->GetMRMLScene()->GenerateUniqueName(DRRImageTransformNodeName);
-    drrImageTransformNode->SetName(DRRImageTransformNodeName.c_str());
-    drrImageNode->SetAndObserveTransformNodeID(drrImageTransformNode->GetID());
-  }
-  drrImageTransformNode->SetAndObserveMatrixTransformToParent(transformDRR->GetMatrix());
-
   // 
   vtkSmartPointer<vtkMRMLSliceNode> sliceNode = sliceLogic->GetSliceNode();
   vtkSmartPointer<vtkMRMLSliceCompositeNode> compositeSliceNode = sliceLogic->GetSliceCompositeNode();
@@ -708,7 +873,7 @@ void vtkSlicerExternalBeamPlanningModuleLogic::UpdateDRR(vtkMRMLRTPlanNode* plan
   contourBEVImageNode->SetOrigin(-128,-128,0);
   contourBEVImageNode->SetSelectable(1);
 
-  contourBEVImageNode->SetAndObserveTransformNodeID(drrImageTransformNode->GetID());
+  contourBEVImageNode->SetAndObserveTransformNodeID(beamNode->GetParentTransformNode()->GetID());
 
   compositeSliceNode->SetForegroundVolumeID(contourBEVImageNode->GetID());
   compositeSliceNode->SetForegroundOpacity(0.3);
@@ -726,4 +891,6 @@ void vtkSlicerExternalBeamPlanningModuleLogic::UpdateDRR(vtkMRMLRTPlanNode* plan
   sliceLogic->FitSliceToAll();
 
 #endif
+
+  return true;
 }
@@ -44,6 +44,7 @@ class vtkMRMLRTBeamNode;
 class vtkSlicerCLIModuleLogic;
 class vtkSlicerBeamsModuleLogic;
 class vtkSlicerDoseAccumulationModuleLogic;
+class vtkPiecewiseFunction;
 
 /// \ingroup SlicerRt_QtModules_ExternalBeamPlanning
 class VTK_SLICER_EXTERNALBEAMPLANNING_MODULE_LOGIC_EXPORT vtkSlicerExternalBeamPlanningModuleLogic :
@@ -66,14 +67,32 @@ public:
   /// \return The new beam node that has been copied and added to the plan
   vtkMRMLRTBeamNode* CloneBeamInPlan(vtkMRMLRTBeamNode* copiedBeamNode, vtkMRMLRTPlanNode* planNode=nullptr);
 
+  /// Compute water-equivalent depth (radiological depth) of the reference volume voxels of the parent plan
+  /// from the source of the given beam (\sa vtkWaterEquivalentDepthVolumeGenerator).
+  /// The result is cached for each beam, and reused as long as the reference volume, the source position,
+  /// the gantry and couch angles, and the stopping power lookup table are unchanged.
+  /// The result is also set to the WED volume node of the beam (\sa vtkMRMLRTBeamNode::GetWEDVolumeNode),
+  /// which is created if missing. Dose engines read the WED from that node.
+  /// \return WED volume in the geometry of the reference volume (mm), nullptr on failure
+  vtkOrientedImageData* ComputeWED(vtkMRMLRTBeamNode* beamNode);
+
+  /// Get lookup table from Hounsfield unit to stopping power relative to water, used for WED computation
+  vtkPiecewiseFunction* GetHounsfieldToStoppingPowerTable();
+
+  /// Fit the jaws and MLC leaves of a beam to the beam's eye view projection of the target segment of its
+  /// parent plan (\sa vtkBeamApertureFitter). The closed surface of the target is used if available,
+  /// otherwise its binary labelmap. Leaf positions are only set if the beam has MLC boundary and position nodes.
+  /// \param margin Margin around the projected target on the isocenter plane (mm)
+  /// \return Success flag
+  bool FitBeamApertureToTarget(vtkMRMLRTBeamNode* beamNode, double margin);
+
 //TODO: Obsolete functions
 public:
-  /// TODO Fix
+  /// Compute digitally reconstructed radiograph of the reference volume of the plan for the given beam,
+  /// and place it on the isocenter plane of the beam (\sa vtkSiddonDrrImageGenerator)
+  /// \return Success flag
   /// TODO Move to separate logic
-  void UpdateDRR(vtkMRMLRTPlanNode* planNode, char* beamName);
-
-  /// TODO
-  void ComputeWED();
+  bool UpdateDRR(vtkMRMLRTPlanNode* planNode, char* beamName);
 
   /// TODO
   void SetMatlabDoseCalculationModuleLogic(vtkSlicerCLIModuleLogic* logic);
@@ -101,7 +120,7 @@ protected:
   void ProcessMRMLNodesEvents(vtkObject* caller, unsigned long event, void* callData) override;
 
 protected:
-  /// TODO:
+  /// Number of columns and rows of the computed DRR images
   int DRRImageSize[2];
 
 private:
@@ -0,0 +1,195 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#include "vtkWaterEquivalentDepthVolumeGenerator.h"
+#include "vtkSiddonDrrImageGenerator.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  /// Hounsfield unit range of the sampled stopping power lookup table
+  const int LOOKUP_TABLE_MINIMUM_HU = -1024;
+  const int LOOKUP_TABLE_MAXIMUM_HU = 4095;
+
+  //----------------------------------------------------------------------------
+  /// Converts Hounsfield units to relative stopping power using the sampled lookup table
+  class StoppingPowerFunctor
+  {
+  public:
+    vtkDataArray* Scalars;
+    const std::vector<double>* LookupTable;
+    float* StoppingPowers;
+
+    void operator()(vtkIdType beginVoxel, vtkIdType endVoxel) const
+    {
+      const std::vector<double>& lookupTable = *this->LookupTable;
+      for (vtkIdType voxel = beginVoxel; voxel < endVoxel; ++voxel)
+      {
+        double position = this->Scalars->GetComponent(voxel, 0) - LOOKUP_TABLE_MINIMUM_HU;
+        position = std::max(0.0, std::min(position, static_cast<double>(lookupTable.size() - 1)));
+        int lowerIndex = std::min(static_cast<int>(position), static_cast<int>(lookupTable.size()) - 2);
+        double weight = position - lowerIndex;
+        this->StoppingPowers[voxel] = static_cast<float>((1.0 - weight) * lookupTable[lowerIndex] + weight * lookupTable[lowerIndex + 1]);
+      }
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  /// Traces the rays from the source to the voxel centers of a range of slices
+  class WaterEquivalentDepthFunctor
+  {
+  public:
+    const float* StoppingPowers;
+    int Extent[6];
+    vtkIdType Increments[3];
+    /// Beam source position in RAS and in continuous IJK coordinates
+    double SourceRAS[3];
+    double SourceIJK[3];
+    vtkMatrix4x4* IJKToRASMatrix;
+    float* OutputVoxels;
+
+    void operator()(vtkIdType beginSlice, vtkIdType endSlice) const
+    {
+      for (vtkIdType k = beginSlice; k < endSlice; ++k)
+      {
+        for (int j = this->Extent[2]; j <= this->Extent[3]; ++j)
+        {
+          for (int i = this->Extent[0]; i <= this->Extent[1]; ++i)
+          {
+            double voxelIJK[4] = { static_cast<double>(i), static_cast<double>(j), static_cast<double>(k), 1.0 };
+            double voxelRAS[4] = { 0.0, 0.0, 0.0, 1.0 };
+            this->IJKToRASMatrix->MultiplyPoint(voxelIJK, voxelRAS);
+            double rayLength = std::sqrt(vtkMath::Distance2BetweenPoints(this->SourceRAS, voxelRAS));
+            double integral = vtkSiddonDrrImageGenerator::IntegrateAlongSegment(
+              this->SourceIJK, voxelIJK, this->Extent, this->Increments, this->StoppingPowers);
+            vtkIdType voxelIndex = (i - this->Extent[0]) * this->Increments[0]
+              + (j - this->Extent[2]) * this->Increments[1] + (k - this->Extent[4]) * this->Increments[2];
+            this->OutputVoxels[voxelIndex] = static_cast<float>(integral * rayLength);
+          }
+        }
+      }
+    }
+  };
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkWaterEquivalentDepthVolumeGenerator);
+
+//----------------------------------------------------------------------------
+vtkWaterEquivalentDepthVolumeGenerator::vtkWaterEquivalentDepthVolumeGenerator()
+{
+  this->InputImage = nullptr;
+  this->IJKToRASMatrix = nullptr;
+  this->SourcePosition[0] = 0.0;
+  this->SourcePosition[1] = 0.0;
+  this->SourcePosition[2] = 0.0;
+  this->Output = vtkImageData::New();
+
+  // Generic calibration curve (air, lung, water, soft tissue, bone)
+  this->HounsfieldToStoppingPowerTable = vtkPiecewiseFunction::New();
+  this->HounsfieldToStoppingPowerTable->AddPoint(-1000.0, 0.001);
+  this->HounsfieldToStoppingPowerTable->AddPoint(-700.0, 0.3);
+  this->HounsfieldToStoppingPowerTable->AddPoint(0.0, 1.0);
+  this->HounsfieldToStoppingPowerTable->AddPoint(100.0, 1.08);
+  this->HounsfieldToStoppingPowerTable->AddPoint(1500.0, 1.9);
+  this->HounsfieldToStoppingPowerTable->AddPoint(3000.0, 2.6);
+}
+
+//----------------------------------------------------------------------------
+vtkWaterEquivalentDepthVolumeGenerator::~vtkWaterEquivalentDepthVolumeGenerator()
+{
+  this->SetInputImage(nullptr);
+  this->SetIJKToRASMatrix(nullptr);
+  this->HounsfieldToStoppingPowerTable->Delete();
+  this->HounsfieldToStoppingPowerTable = nullptr;
+  this->Output->Delete();
+  this->Output = nullptr;
+}
+
+//----------------------------------------------------------------------------
+void vtkWaterEquivalentDepthVolumeGenerator::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "InputImage: " << this->InputImage << "\n";
+  os << indent << "IJKToRASMatrix: " << this->IJKToRASMatrix << "\n";
+  os << indent << "SourcePosition: (" << this->SourcePosition[0] << ", " << this->SourcePosition[1] << ", " << this->SourcePosition[2] << ")\n";
+  os << indent << "HounsfieldToStoppingPowerTable: " << this->HounsfieldToStoppingPowerTable << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkWaterEquivalentDepthVolumeGenerator::Update()
+{
+  this->Output->Initialize();
+  if (!this->InputImage || !this->InputImage->GetPointData()->GetScalars() || !this->IJKToRASMatrix)
+  {
+    vtkErrorMacro("Update: Input image and IJK to RAS matrix are required");
+    return;
+  }
+
+  // Sample the stopping power curve at every integer Hounsfield unit so that voxels can be converted in parallel
+  std::vector<double> lookupTable(LOOKUP_TABLE_MAXIMUM_HU - LOOKUP_TABLE_MINIMUM_HU + 1);
+  this->HounsfieldToStoppingPowerTable->GetTable(LOOKUP_TABLE_MINIMUM_HU, LOOKUP_TABLE_MAXIMUM_HU,
+    static_cast<int>(lookupTable.size()), lookupTable.data());
+
+  vtkIdType numberOfVoxels = this->InputImage->GetNumberOfPoints();
+  std::vector<float> stoppingPowers(numberOfVoxels);
+  StoppingPowerFunctor stoppingPowerFunctor;
+  stoppingPowerFunctor.Scalars = this->InputImage->GetPointData()->GetScalars();
+  stoppingPowerFunctor.LookupTable = &lookupTable;
+  stoppingPowerFunctor.StoppingPowers = stoppingPowers.data();
+  vtkSMPTools::For(0, numberOfVoxels, stoppingPowerFunctor);
+
+  this->Output->SetExtent(this->InputImage->GetExtent());
+  this->Output->AllocateScalars(VTK_FLOAT, 1);
+
+  WaterEquivalentDepthFunctor functor;
+  functor.StoppingPowers = stoppingPowers.data();
+  this->InputImage->GetExtent(functor.Extent);
+  functor.Increments[0] = 1;
+  functor.Increments[1] = functor.Extent[1] - functor.Extent[0] + 1;
+  functor.Increments[2] = functor.Increments[1] * (functor.Extent[3] - functor.Extent[2] + 1);
+  functor.IJKToRASMatrix = this->IJKToRASMatrix;
+
+  vtkSmartPointer<vtkMatrix4x4> rasToIJKMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Invert(this->IJKToRASMatrix, rasToIJKMatrix);
+  double sourceRAS[4] = { this->SourcePosition[0], this->SourcePosition[1], this->SourcePosition[2], 1.0 };
+  double sourceIJK[4] = { 0.0, 0.0, 0.0, 1.0 };
+  rasToIJKMatrix->MultiplyPoint(sourceRAS, sourceIJK);
+  std::copy(sourceRAS, sourceRAS + 3, functor.SourceRAS);
+  std::copy(sourceIJK, sourceIJK + 3, functor.SourceIJK);
+
+  functor.OutputVoxels = static_cast<float*>(this->Output->GetScalarPointer());
+  vtkSMPTools::For(functor.Extent[4], functor.Extent[5] + 1, functor);
+
+  this->Output->Modified();
+}
@@ -0,0 +1,87 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// .NAME vtkWaterEquivalentDepthVolumeGenerator - Computes radiological depth of each voxel from a beam source
+// .SECTION Description
+
+#ifndef __vtkWaterEquivalentDepthVolumeGenerator_h
+#define __vtkWaterEquivalentDepthVolumeGenerator_h
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObject.h>
+#include <vtkPiecewiseFunction.h>
+
+#include "vtkSlicerExternalBeamPlanningModuleLogicExport.h"
+
+/// \ingroup SlicerRt_QtModules_ExternalBeamPlanning
+/// \brief Computes the water-equivalent depth (WED, also called radiological depth) volume of a CT for a beam source.
+///
+/// The Hounsfield units are converted to relative stopping power using a lookup table, and for each voxel
+/// the stopping power is integrated along the ray from the source to the voxel center with Siddon-Jacobs
+/// traversal (\sa vtkSiddonDrrImageGenerator::IntegrateAlongSegment). Slices are processed in parallel.
+/// The output has the same extent as the input, and its geometry is given by the input IJK to RAS matrix.
+class VTK_SLICER_EXTERNALBEAMPLANNING_MODULE_LOGIC_EXPORT vtkWaterEquivalentDepthVolumeGenerator : public vtkObject
+{
+public:
+  static vtkWaterEquivalentDepthVolumeGenerator *New();
+  vtkTypeMacro(vtkWaterEquivalentDepthVolumeGenerator, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Compute the WED volume
+  virtual void Update();
+
+  /// Get computed WED volume. Single component float image (mm)
+  vtkGetObjectMacro(Output, vtkImageData);
+
+  /// CT volume in Hounsfield units
+  vtkSetObjectMacro(InputImage, vtkImageData);
+  vtkGetObjectMacro(InputImage, vtkImageData);
+
+  /// IJK to RAS matrix of the CT volume
+  vtkSetObjectMacro(IJKToRASMatrix, vtkMatrix4x4);
+  vtkGetObjectMacro(IJKToRASMatrix, vtkMatrix4x4);
+
+  /// Position of the beam source in RAS
+  vtkSetVector3Macro(SourcePosition, double);
+  vtkGetVector3Macro(SourcePosition, double);
+
+  /// Lookup table from Hounsfield unit to stopping power relative to water.
+  /// By default it contains a generic piecewise linear calibration curve.
+  vtkGetObjectMacro(HounsfieldToStoppingPowerTable, vtkPiecewiseFunction);
+
+protected:
+  vtkImageData* InputImage;
+  vtkMatrix4x4* IJKToRASMatrix;
+  double SourcePosition[3];
+  vtkPiecewiseFunction* HounsfieldToStoppingPowerTable;
+  vtkImageData* Output;
+
+protected:
+  vtkWaterEquivalentDepthVolumeGenerator();
+  ~vtkWaterEquivalentDepthVolumeGenerator() override;
+
+private:
+  vtkWaterEquivalentDepthVolumeGenerator(const vtkWaterEquivalentDepthVolumeGenerator&) = delete;
+  void operator=(const vtkWaterEquivalentDepthVolumeGenerator&) = delete;
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// ExternalBeamPlanning includes
+#include "qSlicerMockDoseEngine.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+// Qt includes
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// STD includes
+#include <memory>
+#include <vector>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  const unsigned long long MEGABYTE = 1024 * 1024;
+
+  /// Mock engine giving access to the intermediate result cache functions
+  class qSlicerCacheTestDoseEngine : public qSlicerMockDoseEngine
+  {
+  public:
+    using qSlicerMockDoseEngine::cachedIntermediateResult;
+    using qSlicerMockDoseEngine::cacheIntermediateResult;
+  };
+}
+
+//----------------------------------------------------------------------------
+int qSlicerAbstractDoseEngineTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  qSlicerCacheTestDoseEngine engine;
+  engine.setIntermediateResultCacheSizeMB(3.0);
+
+  vtkNew<vtkImageData> input;
+  QString key = qSlicerAbstractDoseEngine::intermediateResultCacheKey(QList<vtkObject*>() << input.GetPointer(), QStringList() << "1.0");
+
+  // Stored result is returned with the same name, key and type
+  std::shared_ptr<std::vector<double> > result = std::make_shared<std::vector<double> >(10, 1.0);
+  engine.cacheIntermediateResult("Result1", key, result, MEGABYTE);
+  if (engine.cachedIntermediateResult<std::vector<double> >("Result1", key) != result)
+  {
+    std::cerr << __LINE__ << ": Cached result is not returned" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (engine.intermediateResultCacheUsedMB() != 1.0)
+  {
+    std::cerr << __LINE__ << ": Used cache size " << engine.intermediateResultCacheUsedMB() << " MB does not match expected value 1 MB" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Result is not returned as a different type, and is released
+  if (engine.cachedIntermediateResult<std::vector<int> >("Result1", key))
+  {
+    std::cerr << __LINE__ << ": Cached result is returned as a different type" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (engine.cachedIntermediateResult<std::vector<double> >("Result1", key) || engine.intermediateResultCacheUsedMB() != 0.0)
+  {
+    std::cerr << __LINE__ << ": Result requested with mismatching type is not removed from the cache" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Key changes when the input is modified, and the outdated result is not returned
+  engine.cacheIntermediateResult("Result1", key, result, MEGABYTE);
+  input->Modified();
+  QString modifiedKey = qSlicerAbstractDoseEngine::intermediateResultCacheKey(QList<vtkObject*>() << input.GetPointer(), QStringList() << "1.0");
+  if (modifiedKey == key)
+  {
+    std::cerr << __LINE__ << ": Cache key does not change when the input is modified" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (engine.cachedIntermediateResult<std::vector<double> >("Result1", modifiedKey) || engine.intermediateResultCacheUsedMB() != 0.0)
+  {
+    std::cerr << __LINE__ << ": Outdated result is returned or kept in the cache" << std::endl;
+    return EXIT_FAILURE;
+  }
+  key = modifiedKey;
+
+  // Least recently used result is evicted when the budget is exceeded
+  engine.cacheIntermediateResult("Result1", key, result, MEGABYTE);
+  engine.cacheIntermediateResult("Result2", key, std::make_shared<std::vector<double> >(), MEGABYTE);
+  engine.cacheIntermediateResult("Result3", key, std::make_shared<std::vector<double> >(), MEGABYTE);
+  engine.cachedIntermediateResult<std::vector<double> >("Result1", key); // Result2 becomes the least recently used
+  engine.cacheIntermediateResult("Result4", key, std::make_shared<std::vector<double> >(), MEGABYTE);
+  if ( !engine.cachedIntermediateResult<std::vector<double> >("Result1", key)
+    || engine.cachedIntermediateResult<std::vector<double> >("Result2", key)
+    || !engine.cachedIntermediateResult<std::vector<double> >("Result3", key)
+    || !engine.cachedIntermediateResult<std::vector<double> >("Result4", key) )
+  {
+    std::cerr << __LINE__ << ": Least recently used result is not the one evicted" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (engine.intermediateResultCacheUsedMB() != 3.0)
+  {
+    std::cerr << __LINE__ << ": Used cache size " << engine.intermediateResultCacheUsedMB() << " MB does not match expected value 3 MB" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Result larger than the budget is not cached, and replaces the previous result with the same name
+  engine.cacheIntermediateResult("Result1", key, result, 4 * MEGABYTE);
+  if (engine.cachedIntermediateResult<std::vector<double> >("Result1", key) || engine.intermediateResultCacheUsedMB() != 2.0)
+  {
+    std::cerr << __LINE__ << ": Result larger than the cache budget is cached" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Decreasing the budget evicts results
+  engine.setIntermediateResultCacheSizeMB(1.0);
+  if (engine.intermediateResultCacheUsedMB() != 1.0 || engine.cachedIntermediateResult<std::vector<double> >("Result3", key))
+  {
+    std::cerr << __LINE__ << ": Least recently used result is not evicted when decreasing the cache budget" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Clear releases all results
+  engine.clearIntermediateResultCache();
+  if (engine.intermediateResultCacheUsedMB() != 0.0 || engine.cachedIntermediateResult<std::vector<double> >("Result4", key))
+  {
+    std::cerr << __LINE__ << ": Cache is not empty after clearing" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Zero budget disables caching
+  engine.setIntermediateResultCacheSizeMB(0.0);
+  engine.cacheIntermediateResult("Result1", key, result, 1);
+  if (engine.cachedIntermediateResult<std::vector<double> >("Result1", key))
+  {
+    std::cerr << __LINE__ << ": Result is cached with zero cache budget" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Dose engine intermediate result cache test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// ExternalBeamPlanning includes
+#include "vtkSiddonDrrImageGenerator.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  const double SOURCE_AXIS_DISTANCE = 100.0;
+  /// Half size of the phantom in the lateral directions and along the beam axis (mm)
+  const double HALF_WIDTH = 10.0;
+  const double HALF_THICKNESS = 20.0;
+  const double WATER_ATTENUATION_COEFFICIENT = 0.02;
+  /// Line integral of the attenuation along the beam axis: bone slab (1000 HU, twice the attenuation
+  /// of water) on the source side, water slab behind it
+  const double AXIS_INTEGRAL = HALF_THICKNESS * WATER_ATTENUATION_COEFFICIENT * 2.0 + HALF_THICKNESS * WATER_ATTENUATION_COEFFICIENT;
+
+  //----------------------------------------------------------------------------
+  bool IsPixelEqualTo(vtkImageData* drrImageData, int column, double expectedValue)
+  {
+    double value = drrImageData->GetScalarComponentAsDouble(column, 0, 0, 0);
+    if (std::fabs(value - expectedValue) > 1e-4)
+    {
+      std::cerr << "DRR value of column " << column << " is " << value << ", expected " << expectedValue << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkSiddonDrrImageGeneratorTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // Phantom of 10x10x2 voxels centered on the isocenter. The slices are 20 mm thick, so the outer voxel
+  // boundaries are much farther from the isocenter than the outermost voxel centers along the beam axis
+  vtkNew<vtkImageData> ctImageData;
+  ctImageData->SetExtent(0, 9, 0, 9, 0, 1);
+  ctImageData->AllocateScalars(VTK_SHORT, 1);
+  short* ctVoxels = static_cast<short*>(ctImageData->GetScalarPointer());
+  for (int k = 0; k <= 1; ++k)
+  {
+    for (int index = 0; index < 100; ++index)
+    {
+      ctVoxels[k * 100 + index] = (k == 0 ? 0 : 1000);
+    }
+  }
+  vtkNew<vtkMatrix4x4> ijkToRasMatrix;
+  ijkToRasMatrix->SetElement(0, 0, 2.0);
+  ijkToRasMatrix->SetElement(1, 1, 2.0);
+  ijkToRasMatrix->SetElement(2, 2, HALF_THICKNESS);
+  ijkToRasMatrix->SetElement(0, 3, 1.0 - HALF_WIDTH);
+  ijkToRasMatrix->SetElement(1, 3, 1.0 - HALF_WIDTH);
+  ijkToRasMatrix->SetElement(2, 3, -0.5 * HALF_THICKNESS);
+
+  // Beam coordinate system is RAS, so the source is above the phantom on the S axis.
+  // Imager is a single row of pixels along the R axis, from -16 mm to 16 mm
+  vtkNew<vtkMatrix4x4> beamToRasMatrix;
+  vtkSmartPointer<vtkSiddonDrrImageGenerator> drrGenerator = vtkSmartPointer<vtkSiddonDrrImageGenerator>::New();
+  drrGenerator->SetInputImage(ctImageData);
+  drrGenerator->SetIJKToRASMatrix(ijkToRasMatrix);
+  drrGenerator->SetBeamToRASMatrix(beamToRasMatrix);
+  drrGenerator->SetSourceAxisDistance(SOURCE_AXIS_DISTANCE);
+  drrGenerator->SetImageDimensions(9, 1);
+  drrGenerator->SetImageSpacing(4.0, 4.0);
+  drrGenerator->SetWaterAttenuationCoefficient(WATER_ATTENUATION_COEFFICIENT);
+  drrGenerator->Update();
+
+  vtkImageData* drrImageData = drrGenerator->GetOutput();
+  int drrDimensions[3] = { 0, 0, 0 };
+  drrImageData->GetDimensions(drrDimensions);
+  double drrOrigin[3] = { 0.0, 0.0, 0.0 };
+  drrImageData->GetOrigin(drrOrigin);
+  if ( drrImageData->GetScalarType() != VTK_FLOAT || drrDimensions[0] != 9 || drrDimensions[1] != 1 || drrDimensions[2] != 1
+    || drrOrigin[0] != -16.0 || drrOrigin[1] != 0.0 || drrOrigin[2] != 0.0 )
+  {
+    std::cerr << __LINE__ << ": DRR image is not a float image of 9x1 pixels centered on the isocenter" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Central ray traverses the whole thickness of the phantom, up to the outer voxel boundary
+  if (!IsPixelEqualTo(drrImageData, 4, AXIS_INTEGRAL))
+  {
+    std::cerr << __LINE__ << ": DRR on the beam axis does not match the slab phantom" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Divergent rays 8 mm off axis on the isocenter plane stay inside the phantom, but are longer than the axis
+  double offAxisFactor = std::sqrt(1.0 + (8.0 / SOURCE_AXIS_DISTANCE) * (8.0 / SOURCE_AXIS_DISTANCE));
+  if (!IsPixelEqualTo(drrImageData, 2, AXIS_INTEGRAL * offAxisFactor) || !IsPixelEqualTo(drrImageData, 6, AXIS_INTEGRAL * offAxisFactor))
+  {
+    std::cerr << __LINE__ << ": DRR of divergent rays does not match the slab phantom" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Rays 16 mm off axis on the isocenter plane miss the phantom
+  if (!IsPixelEqualTo(drrImageData, 0, 0.0) || !IsPixelEqualTo(drrImageData, 8, 0.0))
+  {
+    std::cerr << __LINE__ << ": DRR of rays outside the phantom is not zero" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Changed attenuation coefficient is applied to the cached attenuation volume
+  drrGenerator->SetWaterAttenuationCoefficient(0.5 * WATER_ATTENUATION_COEFFICIENT);
+  drrGenerator->Update();
+  if (!IsPixelEqualTo(drrGenerator->GetOutput(), 4, 0.5 * AXIS_INTEGRAL))
+  {
+    std::cerr << __LINE__ << ": DRR is not updated after changing the attenuation coefficient" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Voxels below the threshold do not attenuate, so only the bone slab remains
+  drrGenerator->SetWaterAttenuationCoefficient(WATER_ATTENUATION_COEFFICIENT);
+  drrGenerator->SetHounsfieldUnitThreshold(500.0);
+  drrGenerator->Update();
+  if (!IsPixelEqualTo(drrGenerator->GetOutput(), 4, HALF_THICKNESS * WATER_ATTENUATION_COEFFICIENT * 2.0))
+  {
+    std::cerr << __LINE__ << ": DRR does not exclude voxels below the Hounsfield unit threshold" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Siddon DRR image generator test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// ExternalBeamPlanning includes
+#include "vtkSlicerExternalBeamPlanningModuleLogic.h"
+
+// Beams includes
+#include "vtkMRMLRTBeamNode.h"
+#include "vtkMRMLRTPlanNode.h"
+#include "vtkSlicerBeamsModuleLogic.h"
+
+// MRML includes
+#include <vtkMRMLDoubleArrayNode.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLSegmentationNode.h>
+#include <vtkMRMLTableNode.h>
+
+// SegmentationCore includes
+#include <vtkSegment.h>
+#include <vtkSegmentation.h>
+#include <vtkSegmentationConverter.h>
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTable.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  const double SOURCE_AXIS_DISTANCE = 1000.0;
+  const double TARGET_RADIUS = 20.0;
+  const int NUMBER_OF_LEAF_PAIRS = 8;
+  const double LEAF_WIDTH = 10.0;
+  /// Fitted positions are on the boundaries of the 1 mm pixels of the beam's eye view mask, and the
+  /// tessellated sphere is slightly smaller than the ideal one
+  const double FIT_TOLERANCE = 0.6;
+
+  //----------------------------------------------------------------------------
+  bool IsPositionEqualTo(const char* name, double position, double expectedPosition, double tolerance)
+  {
+    if (std::fabs(position - expectedPosition) > tolerance)
+    {
+      std::cerr << name << " position is " << position << " mm, expected " << expectedPosition << " mm" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /// Check jaws against the projected sphere: the divergent projection of a sphere centered on the isocenter
+  /// is a circle on the isocenter plane, that is expanded by the margin
+  bool AreJawsFittedToTarget(vtkMRMLRTBeamNode* beamNode, double projectedRadius, double margin)
+  {
+    double extent = projectedRadius + margin;
+    return IsPositionEqualTo("X1 jaw", beamNode->GetX1Jaw(), -extent, FIT_TOLERANCE)
+      && IsPositionEqualTo("X2 jaw", beamNode->GetX2Jaw(), extent, FIT_TOLERANCE)
+      && IsPositionEqualTo("Y1 jaw", beamNode->GetY1Jaw(), -extent, FIT_TOLERANCE)
+      && IsPositionEqualTo("Y2 jaw", beamNode->GetY2Jaw(), extent, FIT_TOLERANCE);
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerExternalBeamPlanningModuleLogicTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkMRMLScene> mrmlScene;
+  vtkSmartPointer<vtkSlicerBeamsModuleLogic> beamsLogic = vtkSmartPointer<vtkSlicerBeamsModuleLogic>::New();
+  beamsLogic->SetMRMLScene(mrmlScene);
+  vtkSmartPointer<vtkSlicerExternalBeamPlanningModuleLogic> logic = vtkSmartPointer<vtkSlicerExternalBeamPlanningModuleLogic>::New();
+  logic->SetMRMLScene(mrmlScene);
+  logic->SetBeamsLogic(beamsLogic);
+
+  // Spherical target given as closed surface, centered on the isocenter
+  double isocenter[3] = { 10.0, 20.0, 30.0 };
+  vtkNew<vtkSphereSource> sphereSource;
+  sphereSource->SetCenter(isocenter);
+  sphereSource->SetRadius(TARGET_RADIUS);
+  sphereSource->SetThetaResolution(64);
+  sphereSource->SetPhiResolution(64);
+  sphereSource->Update();
+
+  vtkSmartPointer<vtkMRMLSegmentationNode> segmentationNode = vtkSmartPointer<vtkMRMLSegmentationNode>::New();
+  mrmlScene->AddNode(segmentationNode);
+  segmentationNode->GetSegmentation()->SetMasterRepresentationName(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName());
+  vtkSmartPointer<vtkSegment> targetSegment = vtkSmartPointer<vtkSegment>::New();
+  targetSegment->SetName("Target");
+  targetSegment->AddRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName(), sphereSource->GetOutput());
+  segmentationNode->GetSegmentation()->AddSegment(targetSegment, "Target");
+
+  vtkSmartPointer<vtkMRMLRTPlanNode> planNode = vtkSmartPointer<vtkMRMLRTPlanNode>::New();
+  mrmlScene->AddNode(planNode);
+  planNode->SetAndObserveSegmentationNode(segmentationNode);
+  planNode->SetTargetSegmentID("Target");
+  planNode->SetIsocenterSpecification(vtkMRMLRTPlanNode::ArbitraryPoint);
+  if (!planNode->SetIsocenterPosition(isocenter))
+  {
+    std::cerr << __LINE__ << ": Failed to set isocenter position" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Beam with an MLCX of 10 mm wide leaf pairs, from -40 to 40 mm
+  vtkSmartPointer<vtkMRMLRTBeamNode> beamNode = vtkSmartPointer<vtkMRMLRTBeamNode>::New();
+  beamNode->SetName("Beam");
+  mrmlScene->AddNode(beamNode);
+  beamNode->SetSAD(SOURCE_AXIS_DISTANCE);
+  planNode->AddBeam(beamNode);
+
+  vtkSmartPointer<vtkMRMLDoubleArrayNode> mlcBoundaryNode = vtkSmartPointer<vtkMRMLDoubleArrayNode>::New();
+  mrmlScene->AddNode(mlcBoundaryNode);
+  vtkNew<vtkDoubleArray> mlcBoundaries;
+  mlcBoundaries->SetNumberOfComponents(1);
+  mlcBoundaries->SetNumberOfTuples(NUMBER_OF_LEAF_PAIRS + 1);
+  for (int boundary = 0; boundary <= NUMBER_OF_LEAF_PAIRS; ++boundary)
+  {
+    mlcBoundaries->SetValue(boundary, (boundary - 0.5 * NUMBER_OF_LEAF_PAIRS) * LEAF_WIDTH);
+  }
+  mlcBoundaryNode->SetArray(mlcBoundaries);
+
+  vtkSmartPointer<vtkMRMLTableNode> mlcPositionNode = vtkSmartPointer<vtkMRMLTableNode>::New();
+  mlcPositionNode->SetName("MLCX_Position");
+  mrmlScene->AddNode(mlcPositionNode);
+  vtkNew<vtkDoubleArray> leafPositions1;
+  leafPositions1->SetName("1");
+  mlcPositionNode->GetTable()->AddColumn(leafPositions1);
+  vtkNew<vtkDoubleArray> leafPositions2;
+  leafPositions2->SetName("2");
+  mlcPositionNode->GetTable()->AddColumn(leafPositions2);
+  mlcPositionNode->GetTable()->SetNumberOfRows(NUMBER_OF_LEAF_PAIRS);
+  for (int leafPair = 0; leafPair < NUMBER_OF_LEAF_PAIRS; ++leafPair)
+  {
+    mlcPositionNode->GetTable()->SetValue(leafPair, 0, -50.0);
+    mlcPositionNode->GetTable()->SetValue(leafPair, 1, 50.0);
+  }
+
+  beamNode->SetAndObserveMLCBoundaryDoubleArrayNode(mlcBoundaryNode);
+  beamNode->SetAndObserveMLCPositionTableNode(mlcPositionNode);
+
+  // Fit with 5 mm margin
+  const double margin = 5.0;
+  if (!logic->FitBeamApertureToTarget(beamNode, margin))
+  {
+    std::cerr << __LINE__ << ": Failed to fit beam aperture to the target" << std::endl;
+    return EXIT_FAILURE;
+  }
+  double projectedRadius = TARGET_RADIUS * SOURCE_AXIS_DISTANCE
+    / std::sqrt(SOURCE_AXIS_DISTANCE * SOURCE_AXIS_DISTANCE - TARGET_RADIUS * TARGET_RADIUS);
+  if (!AreJawsFittedToTarget(beamNode, projectedRadius, margin))
+  {
+    std::cerr << __LINE__ << ": Jaw positions do not match the projected target expanded by the margin" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Each leaf pair is opened to the widest part of the projected target in its range expanded by the margin.
+  // Leaf pairs beyond the target are closed in the middle of the field
+  vtkTable* mlcTable = mlcPositionNode->GetTable();
+  for (int leafPair = 0; leafPair < NUMBER_OF_LEAF_PAIRS; ++leafPair)
+  {
+    double leafPosition1 = mlcTable->GetValue(leafPair, 0).ToDouble();
+    double leafPosition2 = mlcTable->GetValue(leafPair, 1).ToDouble();
+    // No leaf pair crosses the beam axis, so the widest part of the target is at the boundary closest to the axis
+    double nearestOffset = std::max(0.0, std::min(
+      std::fabs(mlcBoundaries->GetValue(leafPair)), std::fabs(mlcBoundaries->GetValue(leafPair + 1))) - margin);
+    if (nearestOffset > projectedRadius)
+    {
+      if (leafPosition1 != leafPosition2 || !IsPositionEqualTo("Closed leaf", leafPosition1, 0.0, FIT_TOLERANCE))
+      {
+        std::cerr << __LINE__ << ": Leaf pair " << leafPair << " outside the target is not closed in the middle of the field" << std::endl;
+        return EXIT_FAILURE;
+      }
+      continue;
+    }
+    double expectedOpening = std::sqrt(projectedRadius * projectedRadius - nearestOffset * nearestOffset) + margin;
+    if ( !IsPositionEqualTo("Leaf 1", leafPosition1, -expectedOpening, FIT_TOLERANCE)
+      || !IsPositionEqualTo("Leaf 2", leafPosition2, expectedOpening, FIT_TOLERANCE) )
+    {
+      std::cerr << __LINE__ << ": Positions of leaf pair " << leafPair << " do not match the projected target expanded by the margin" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Increasing the margin moves the jaws by the same distance
+  double previousJaws[4] = { beamNode->GetX1Jaw(), beamNode->GetX2Jaw(), beamNode->GetY1Jaw(), beamNode->GetY2Jaw() };
+  if (!logic->FitBeamApertureToTarget(beamNode, 2.0 * margin))
+  {
+    std::cerr << __LINE__ << ": Failed to fit beam aperture to the target with increased margin" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ( !IsPositionEqualTo("X1 jaw", beamNode->GetX1Jaw(), previousJaws[0] - margin, 1e-6)
+    || !IsPositionEqualTo("X2 jaw", beamNode->GetX2Jaw(), previousJaws[1] + margin, 1e-6)
+    || !IsPositionEqualTo("Y1 jaw", beamNode->GetY1Jaw(), previousJaws[2] - margin, 1e-6)
+    || !IsPositionEqualTo("Y2 jaw", beamNode->GetY2Jaw(), previousJaws[3] + margin, 1e-6) )
+  {
+    std::cerr << __LINE__ << ": Jaws do not follow the change of the margin" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Beam aperture fitting test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
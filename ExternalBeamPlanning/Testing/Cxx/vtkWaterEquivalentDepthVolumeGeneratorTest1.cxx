@@ -0,0 +1,116 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// ExternalBeamPlanning includes
+#include "vtkWaterEquivalentDepthVolumeGenerator.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  /// Number of water slices in the phantom. Slices below are water, slices above are bone
+  const int NUMBER_OF_WATER_SLICES = 5;
+  const double SPACING = 2.0;
+  /// Stopping powers of the phantom materials in the default calibration curve
+  const double WATER_STOPPING_POWER = 1.0;
+  const double BONE_STOPPING_POWER = 1.9;
+
+  //----------------------------------------------------------------------------
+  bool IsWedEqualTo(vtkImageData* wedImageData, int i, int j, int k, double expectedWed)
+  {
+    double wed = wedImageData->GetScalarComponentAsDouble(i, j, k, 0);
+    if (std::fabs(wed - expectedWed) > 1e-3)
+    {
+      std::cerr << "WED of voxel (" << i << ", " << j << ", " << k << ") is " << wed << " mm, expected " << expectedWed << " mm" << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkWaterEquivalentDepthVolumeGeneratorTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // Slab phantom of 5x5x10 voxels with 2 mm spacing: water on the source side, bone behind it
+  vtkNew<vtkImageData> ctImageData;
+  ctImageData->SetExtent(0, 4, 0, 4, 0, 9);
+  ctImageData->AllocateScalars(VTK_SHORT, 1);
+  short* ctVoxels = static_cast<short*>(ctImageData->GetScalarPointer());
+  for (int k = 0; k <= 9; ++k)
+  {
+    for (int index = 0; index < 25; ++index)
+    {
+      ctVoxels[k * 25 + index] = (k < NUMBER_OF_WATER_SLICES ? 0 : 1500);
+    }
+  }
+  vtkNew<vtkMatrix4x4> ijkToRasMatrix;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    ijkToRasMatrix->SetElement(axis, axis, SPACING);
+  }
+
+  // Source on the axis of the central voxel column, 100 mm in front of the phantom
+  vtkSmartPointer<vtkWaterEquivalentDepthVolumeGenerator> wedGenerator = vtkSmartPointer<vtkWaterEquivalentDepthVolumeGenerator>::New();
+  wedGenerator->SetInputImage(ctImageData);
+  wedGenerator->SetIJKToRASMatrix(ijkToRasMatrix);
+  wedGenerator->SetSourcePosition(2.0 * SPACING, 2.0 * SPACING, -100.0);
+  wedGenerator->Update();
+
+  vtkImageData* wedImageData = wedGenerator->GetOutput();
+  int wedExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  wedImageData->GetExtent(wedExtent);
+  if ( wedImageData->GetScalarType() != VTK_FLOAT || wedExtent[0] != 0 || wedExtent[1] != 4
+    || wedExtent[2] != 0 || wedExtent[3] != 4 || wedExtent[4] != 0 || wedExtent[5] != 9 )
+  {
+    std::cerr << __LINE__ << ": WED volume is not a float image with the extent of the input" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Central column: the ray crosses full voxels up to the voxel, then half of the voxel to its center
+  double waterDepth = 0.0;
+  for (int k = 0; k <= 9; ++k)
+  {
+    double stoppingPower = (k < NUMBER_OF_WATER_SLICES ? WATER_STOPPING_POWER : BONE_STOPPING_POWER);
+    if (!IsWedEqualTo(wedImageData, 2, 2, k, waterDepth + 0.5 * SPACING * stoppingPower))
+    {
+      std::cerr << __LINE__ << ": WED in the central column does not match the slab phantom" << std::endl;
+      return EXIT_FAILURE;
+    }
+    waterDepth += SPACING * stoppingPower;
+  }
+
+  // Oblique ray in water: WED is the geometric length of the ray inside the phantom
+  const int obliqueSlice = 3;
+  double sourceDistanceIjk = obliqueSlice + 100.0 / SPACING;
+  double rayLength = SPACING * std::sqrt(4.0 + sourceDistanceIjk * sourceDistanceIjk);
+  double expectedObliqueWed = rayLength * (obliqueSlice + 0.5) / sourceDistanceIjk;
+  if (!IsWedEqualTo(wedImageData, 0, 2, obliqueSlice, expectedObliqueWed))
+  {
+    std::cerr << __LINE__ << ": WED along oblique ray does not match the slab phantom" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Water-equivalent depth volume generator test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -37,6 +37,7 @@ Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
 #include <vtkMRMLSubjectHierarchyNode.h>
 #include <vtkMRMLSubjectHierarchyConstants.h>
 #include <vtkMRMLColorTableNode.h>
+#include <vtkMRMLTransformNode.h>
 
 // VTK includes
 #include <vtkSmartPointer.h>
@@ -56,12 +57,16 @@ Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
 #include <QCheckBox>
 #include <QComboBox>
 
+// STD includes
+#include <list>
+
 //----------------------------------------------------------------------------
 double qSlicerAbstractDoseEngine::DEFAULT_DOSE_VOLUME_WINDOW_LEVEL_MAXIMUM = 16.0;
 
 //----------------------------------------------------------------------------
 static const char* INTERMEDIATE_RESULT_REFERENCE_ROLE = "IntermediateResultRef";
 static const char* RESULT_DOSE_REFERENCE_ROLE = "ResultDoseRef";
+static const unsigned long long DEFAULT_INTERMEDIATE_RESULT_CACHE_SIZE_MB = 1024;
 
 //-----------------------------------------------------------------------------
 /// \ingroup SlicerRt_QtModules_ExternalBeamPlanning
@@ -76,6 +81,31 @@ public:
   /// Engine-specific parameters defined in \sa defineBeamParameters.
   /// Key is the parameter name (without engine name prefix), value is the default
   QMap<QString,QVariant> BeamParameters;
+
+  /// Cached intermediate result
+  struct IntermediateResultCacheEntry
+  {
+    QString Name;
+    QString Key;
+    std::shared_ptr<void> Data;
+    const std::type_info* Type;
+    unsigned long long SizeInBytes;
+  };
+  typedef std::list<IntermediateResultCacheEntry> IntermediateResultCacheType;
+
+  /// Find cached intermediate result by name
+  IntermediateResultCacheType::iterator findIntermediateResult(const QString& name);
+  /// Remove cached intermediate result
+  void removeIntermediateResultFromCache(IntermediateResultCacheType::iterator entryIt);
+  /// Remove least recently used intermediate results until the used memory fits in the budget
+  void evictIntermediateResults();
+
+  /// Cached intermediate results, the most recently used one first
+  IntermediateResultCacheType IntermediateResultCache;
+  /// Total size of the cached intermediate results
+  unsigned long long IntermediateResultCacheUsedBytes;
+  /// Memory budget of the intermediate result cache
+  unsigned long long IntermediateResultCacheBudgetBytes;
 };
 
 //-----------------------------------------------------------------------------
@@ -84,7 +114,39 @@ public:
 //-----------------------------------------------------------------------------
 qSlicerAbstractDoseEnginePrivate::qSlicerAbstractDoseEnginePrivate(qSlicerAbstractDoseEngine& object)
   : q_ptr(&object)
+  , IntermediateResultCacheUsedBytes(0)
+  , IntermediateResultCacheBudgetBytes(DEFAULT_INTERMEDIATE_RESULT_CACHE_SIZE_MB * 1024 * 1024)
+{
+}
+
+//-----------------------------------------------------------------------------
+qSlicerAbstractDoseEnginePrivate::IntermediateResultCacheType::iterator qSlicerAbstractDoseEnginePrivate::findIntermediateResult(const QString& name)
+{
+  IntermediateResultCacheType::iterator entryIt;
+  for (entryIt = this->IntermediateResultCache.begin(); entryIt != this->IntermediateResultCache.end(); ++entryIt)
+  {
+    if (entryIt->Name == name)
+    {
+      break;
+    }
+  }
+  return entryIt;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerAbstractDoseEnginePrivate::removeIntermediateResultFromCache(IntermediateResultCacheType::iterator entryIt)
 {
+  this->IntermediateResultCacheUsedBytes -= entryIt->SizeInBytes;
+  this->IntermediateResultCache.erase(entryIt);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerAbstractDoseEnginePrivate::evictIntermediateResults()
+{
+  while (!this->IntermediateResultCache.empty() && this->IntermediateResultCacheUsedBytes > this->IntermediateResultCacheBudgetBytes)
+  {
+    this->removeIntermediateResultFromCache(--this->IntermediateResultCache.end());
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -118,6 +180,13 @@ void qSlicerAbstractDoseEngine::setName(QString name)
   qCritical() << Q_FUNC_INFO << ": Cannot set dose engine name by method, only in constructor";
 }
 
+//-----------------------------------------------------------------------------
+bool qSlicerAbstractDoseEngine::isWaterEquivalentDepthRequired(vtkMRMLRTBeamNode* beamNode)
+{
+  Q_UNUSED(beamNode);
+  return false;
+}
+
 //----------------------------------------------------------------------------
 QString qSlicerAbstractDoseEngine::calculateDose(vtkMRMLRTBeamNode* beamNode)
 {
@@ -358,6 +427,114 @@ void qSlicerAbstractDoseEngine::removeIntermediateResults(vtkMRMLRTBeamNode* bea
   }
 }
 
+//---------------------------------------------------------------------------
+// Intermediate result cache functions
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+void qSlicerAbstractDoseEngine::setIntermediateResultCacheSizeMB(double sizeMB)
+{
+  Q_D(qSlicerAbstractDoseEngine);
+  d->IntermediateResultCacheBudgetBytes = (sizeMB > 0.0 ? static_cast<unsigned long long>(sizeMB * 1024.0 * 1024.0) : 0);
+  d->evictIntermediateResults();
+}
+
+//-----------------------------------------------------------------------------
+double qSlicerAbstractDoseEngine::intermediateResultCacheSizeMB()const
+{
+  Q_D(const qSlicerAbstractDoseEngine);
+  return d->IntermediateResultCacheBudgetBytes / (1024.0 * 1024.0);
+}
+
+//-----------------------------------------------------------------------------
+double qSlicerAbstractDoseEngine::intermediateResultCacheUsedMB()const
+{
+  Q_D(const qSlicerAbstractDoseEngine);
+  return d->IntermediateResultCacheUsedBytes / (1024.0 * 1024.0);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerAbstractDoseEngine::clearIntermediateResultCache()
+{
+  Q_D(qSlicerAbstractDoseEngine);
+  d->IntermediateResultCache.clear();
+  d->IntermediateResultCacheUsedBytes = 0;
+}
+
+//-----------------------------------------------------------------------------
+QString qSlicerAbstractDoseEngine::intermediateResultCacheKey(const QList<vtkObject*>& inputs, const QStringList& parameters/*=QStringList()*/)
+{
+  QStringList keyItems;
+  foreach (vtkObject* input, inputs)
+  {
+    if (!input)
+    {
+      keyItems << QString("null");
+      continue;
+    }
+    // Address distinguishes objects, modified time covers changes in the object
+    QString inputItem = QString("%1:%2:%3").arg(input->GetClassName())
+      .arg(reinterpret_cast<quintptr>(input), 0, 16).arg(input->GetMTime());
+
+    // Transformable nodes are typically used in world coordinates, so changes in the transforms also need to be considered
+    vtkMRMLTransformableNode* transformableNode = vtkMRMLTransformableNode::SafeDownCast(input);
+    if (transformableNode && transformableNode->GetParentTransformNode())
+    {
+      inputItem += QString(":%1").arg(transformableNode->GetParentTransformNode()->GetTransformToWorldMTime());
+    }
+    keyItems << inputItem;
+  }
+  keyItems << parameters;
+  return keyItems.join("|");
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<void> qSlicerAbstractDoseEngine::cachedIntermediateResultData(const QString& name, const QString& key, const std::type_info& type)
+{
+  Q_D(qSlicerAbstractDoseEngine);
+  qSlicerAbstractDoseEnginePrivate::IntermediateResultCacheType::iterator entryIt = d->findIntermediateResult(name);
+  if (entryIt == d->IntermediateResultCache.end())
+  {
+    return std::shared_ptr<void>();
+  }
+  if (entryIt->Key != key || *entryIt->Type != type)
+  {
+    // Inputs changed since the result was cached. Release the outdated result right away
+    d->removeIntermediateResultFromCache(entryIt);
+    return std::shared_ptr<void>();
+  }
+
+  // Move to the front to mark it as the most recently used
+  d->IntermediateResultCache.splice(d->IntermediateResultCache.begin(), d->IntermediateResultCache, entryIt);
+  return entryIt->Data;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerAbstractDoseEngine::cacheIntermediateResultData(const QString& name, const QString& key,
+  std::shared_ptr<void> result, const std::type_info& type, unsigned long long sizeInBytes)
+{
+  Q_D(qSlicerAbstractDoseEngine);
+  qSlicerAbstractDoseEnginePrivate::IntermediateResultCacheType::iterator entryIt = d->findIntermediateResult(name);
+  if (entryIt != d->IntermediateResultCache.end())
+  {
+    d->removeIntermediateResultFromCache(entryIt);
+  }
+  if (!result || sizeInBytes > d->IntermediateResultCacheBudgetBytes)
+  {
+    return;
+  }
+
+  qSlicerAbstractDoseEnginePrivate::IntermediateResultCacheEntry entry;
+  entry.Name = name;
+  entry.Key = key;
+  entry.Data = result;
+  entry.Type = &type;
+  entry.SizeInBytes = sizeInBytes;
+  d->IntermediateResultCache.push_front(entry);
+  d->IntermediateResultCacheUsedBytes += sizeInBytes;
+  d->evictIntermediateResults();
+}
+
 //---------------------------------------------------------------------------
 // Beam parameter definition functions.
 // Need to be called from the implemented \sa defineBeamParameters method.
@@ -532,17 +709,34 @@ void qSlicerAbstractDoseEngine::addBeamParameterAttributesToBeamNode(vtkMRMLRTBe
     return;
   }
 
-  // Add each beam parameter if missing
+  // Add each beam parameter if missing (with a single modified event)
+  int wasModifying = beamNode->StartModify();
   foreach (QString parameterName, d->BeamParameters.keys())
   {
-    if ( !beamNode->GetAttribute(
-      this->assembleEngineParameterName(parameterName).toLatin1().constData()) )
+    std::string engineParameterName = this->assembleEngineParameterName(parameterName).toStdString();
+    if (beamNode->HasDoseEngineParameter(engineParameterName))
+    {
+      continue;
+    }
+
+    const QVariant& defaultValue = d->BeamParameters[parameterName];
+    switch (defaultValue.type())
     {
-      beamNode->SetAttribute(
-        this->assembleEngineParameterName(parameterName).toLatin1().constData(),
-        d->BeamParameters[parameterName].toString().toLatin1().constData() );
+      case QVariant::Double:
+        beamNode->SetDoseEngineDoubleParameter(engineParameterName, defaultValue.toDouble());
+        break;
+      case QVariant::Int:
+        beamNode->SetDoseEngineIntegerParameter(engineParameterName, defaultValue.toInt());
+        break;
+      case QVariant::Bool:
+        beamNode->SetDoseEngineBooleanParameter(engineParameterName, defaultValue.toBool());
+        break;
+      default:
+        beamNode->SetDoseEngineStringParameter(engineParameterName, defaultValue.toString().toStdString());
+        break;
     }
   }
+  beamNode->EndModify(wasModifying);
 }
 
 //---------------------------------------------------------------------------
@@ -577,12 +771,10 @@ int qSlicerAbstractDoseEngine::integerParameter(vtkMRMLRTBeamNode* beamNode, QSt
     return 0;
   }
 
-  QString parameterStr = this->parameter(beamNode, parameterName);
-  bool ok = false;
-  int parameterInt = parameterStr.toInt(&ok);
-  if (!ok)
+  int parameterInt = 0;
+  if (!beamNode->GetDoseEngineIntegerParameter(this->assembleEngineParameterName(parameterName).toStdString(), parameterInt))
   {
-    qCritical() << Q_FUNC_INFO << ": Parameter named " << parameterName << " cannot be converted to integer";
+    qCritical() << Q_FUNC_INFO << ": Parameter named " << parameterName << " cannot be found or converted to integer for beam " << beamNode->GetName();
     return 0;
   }
 
@@ -597,12 +789,10 @@ double qSlicerAbstractDoseEngine::doubleParameter(vtkMRMLRTBeamNode* beamNode, Q
     return 0.0;
   }
 
-  QString parameterStr = this->parameter(beamNode, parameterName);
-  bool ok = false;
-  double parameterDouble = parameterStr.toDouble(&ok);
-  if (!ok)
+  double parameterDouble = 0.0;
+  if (!beamNode->GetDoseEngineDoubleParameter(this->assembleEngineParameterName(parameterName).toStdString(), parameterDouble))
   {
-    qCritical() << Q_FUNC_INFO << ": Parameter named " << parameterName << " cannot be converted to floating point number";
+    qCritical() << Q_FUNC_INFO << ": Parameter named " << parameterName << " cannot be found or converted to floating point number for beam " << beamNode->GetName();
     return 0.0;
   }
 
@@ -617,18 +807,14 @@ bool qSlicerAbstractDoseEngine::booleanParameter(vtkMRMLRTBeamNode* beamNode, QS
     return false;
   }
 
-  QString parameterStr = this->parameter(beamNode, parameterName);
-  if (parameterStr == QVariant(true).toString())
-  {
-    return true;
-  }
-  else if (parameterStr == QVariant(false).toString())
+  bool parameterBool = false;
+  if (!beamNode->GetDoseEngineBooleanParameter(this->assembleEngineParameterName(parameterName).toStdString(), parameterBool))
   {
+    qCritical() << Q_FUNC_INFO << ": Parameter named " << parameterName << " cannot be found or contains invalid boolean value for beam " << beamNode->GetName();
     return false;
   }
 
-  qCritical() << Q_FUNC_INFO << ": Parameter named " << parameterName << " contains invalid boolean value '" << parameterStr << "'";
-  return false;
+  return parameterBool;
 }
 
 //-----------------------------------------------------------------------------
@@ -640,53 +826,48 @@ void qSlicerAbstractDoseEngine::setParameter(vtkMRMLRTBeamNode* beamNode, QStrin
     return;
   }
 
-  QString attributeName = this->assembleEngineParameterName(parameterName);
-  const char* oldValue = beamNode->GetAttribute(attributeName.toLatin1().constData());
-  if (oldValue == nullptr && parameterValue.isEmpty())
-    {
-    // no change
-    return;
-    }
-  if (parameterValue == QString(oldValue))
-    {
+  std::string engineParameterName = this->assembleEngineParameterName(parameterName).toStdString();
+  if (!beamNode->HasDoseEngineParameter(engineParameterName) && parameterValue.isEmpty())
+  {
     // no change
     return;
-    }
-
-  //TODO: Decide whether modified events are needed and handle custom modified events if necessary
-  //      (e.g. could create setGeometryParameter or add bool arguments to specify special parameter type)
-  // Disable full modified events in all cases (observe EffectParameterModified instead if necessary)
-  //int disableState = beamNode->GetDisableModifiedEvent();
-  //beamNode->SetDisableModifiedEvent(1);
-
-  // Set parameter as attribute
-  beamNode->SetAttribute(attributeName.toLatin1().constData(), parameterValue.toLatin1().constData());
-
-  // Re-enable full modified events for parameter node
-  //beamNode->SetDisableModifiedEvent(disableState);
+  }
 
-  // Emit parameter modified event if requested
-  // Don't pass parameter name as char pointer, as custom modified events may be compressed and invoked after EndModify()
-  // and by that time the pointer may not be valid anymore.
-  //beamNode->InvokeCustomModifiedEvent(vtkMRMLSegmentEditorNode::EffectParameterModified);
+  // Beam node invokes DoseEngineParameterModified if the value changes
+  beamNode->SetDoseEngineStringParameter(engineParameterName, parameterValue.toStdString());
 }
 
 //-----------------------------------------------------------------------------
 void qSlicerAbstractDoseEngine::setParameter(vtkMRMLRTBeamNode* beamNode, QString parameterName, int parameterValue)
 {
-  this->setParameter(beamNode, parameterName, QString::number(parameterValue));
+  if (!beamNode)
+  {
+    qCritical() << Q_FUNC_INFO << ": Invalid beam node";
+    return;
+  }
+  beamNode->SetDoseEngineIntegerParameter(this->assembleEngineParameterName(parameterName).toStdString(), parameterValue);
 }
 
 //-----------------------------------------------------------------------------
 void qSlicerAbstractDoseEngine::setParameter(vtkMRMLRTBeamNode* beamNode, QString parameterName, double parameterValue)
 {
-  this->setParameter(beamNode, parameterName, QString::number(parameterValue));
+  if (!beamNode)
+  {
+    qCritical() << Q_FUNC_INFO << ": Invalid beam node";
+    return;
+  }
+  beamNode->SetDoseEngineDoubleParameter(this->assembleEngineParameterName(parameterName).toStdString(), parameterValue);
 }
 
 //-----------------------------------------------------------------------------
 void qSlicerAbstractDoseEngine::setParameter(vtkMRMLRTBeamNode* beamNode, QString parameterName, bool parameterValue)
 {
-  this->setParameter(beamNode, parameterName, QVariant(parameterValue).toString());
+  if (!beamNode)
+  {
+    qCritical() << Q_FUNC_INFO << ": Invalid beam node";
+    return;
+  }
+  beamNode->SetDoseEngineBooleanParameter(this->assembleEngineParameterName(parameterName).toStdString(), parameterValue);
 }
 
 //-----------------------------------------------------------------------------
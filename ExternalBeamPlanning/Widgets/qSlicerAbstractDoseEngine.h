@@ -27,7 +27,12 @@
 #include <QObject>
 #include <QStringList>
 
+// STD includes
+#include <memory>
+#include <typeinfo>
+
 class qSlicerAbstractDoseEnginePrivate;
+class vtkObject;
 class vtkMRMLScalarVolumeNode;
 class vtkMRMLRTBeamNode;
 class vtkMRMLNode;
@@ -92,6 +97,12 @@ protected:
   /// This is the method that needs to be implemented in each engine.
   virtual void defineBeamParameters() = 0;
 
+public:
+  /// Determine whether the engine uses the water-equivalent depth volume of the beam in the dose calculation.
+  /// If it does, the WED volume node of the beam (\sa vtkMRMLRTBeamNode::GetWEDVolumeNode) is updated
+  /// by the dose engine logic before \sa calculateDoseUsingEngine is called. False by default
+  virtual bool isWaterEquivalentDepthRequired(vtkMRMLRTBeamNode* beamNode);
+
 // Dose calculation related functions (functions to call from the subclass).
 // Public so that they can be called from python.
 public:
@@ -106,6 +117,55 @@ public:
   /// \param replace Remove referenced dose volume if already exists. True by default
   Q_INVOKABLE void addResultDose(vtkMRMLScalarVolumeNode* resultDose, vtkMRMLRTBeamNode* beamNode, bool replace=true);
 
+// Intermediate result cache functions.
+// Engines can store expensive intermediate artifacts (converted images, etc.) that are reused in the
+// next calculation if the inputs and parameters they were computed from have not changed.
+public:
+  /// Set memory budget of the intermediate result cache in megabytes. Least recently used entries
+  /// are evicted when the budget is exceeded. Zero disables caching. Default is 1024 MB
+  Q_INVOKABLE void setIntermediateResultCacheSizeMB(double sizeMB);
+  /// Get memory budget of the intermediate result cache in megabytes
+  Q_INVOKABLE double intermediateResultCacheSizeMB()const;
+  /// Get memory currently used by the cached intermediate results in megabytes
+  Q_INVOKABLE double intermediateResultCacheUsedMB()const;
+  /// Remove all cached intermediate results
+  Q_INVOKABLE void clearIntermediateResultCache();
+
+  /// Assemble intermediate result cache key from the input objects and the parameters the result depends on.
+  /// The key contains the identity and modified time of each input, and for transformable MRML nodes
+  /// the modified time of the transform to world, so it changes whenever any of the inputs change.
+  /// \param inputs Objects (MRML nodes, data objects) the intermediate result is computed from. May contain nullptr
+  /// \param parameters Values of the parameters the intermediate result depends on
+  static QString intermediateResultCacheKey(const QList<vtkObject*>& inputs, const QStringList& parameters=QStringList());
+
+protected:
+  /// Get cached intermediate result
+  /// \param name Name of the intermediate result. Results with the same name replace each other in the cache,
+  ///   so it needs to contain the beam or plan ID if the result is specific to it
+  /// \param key Key assembled from the inputs, see \sa intermediateResultCacheKey
+  /// \return Cached result if it exists with the given name, key and type, nullptr otherwise
+  template<class T> std::shared_ptr<T> cachedIntermediateResult(const QString& name, const QString& key)
+  {
+    return std::static_pointer_cast<T>(this->cachedIntermediateResultData(name, key, typeid(T)));
+  }
+
+  /// Store intermediate result in the cache, replacing the previous result with the same name
+  /// \param name Name of the intermediate result, see \sa cachedIntermediateResult
+  /// \param key Key assembled from the inputs, see \sa intermediateResultCacheKey
+  /// \param result Result to store
+  /// \param sizeInBytes Approximate memory size of the result used for enforcing the cache memory budget
+  template<class T> void cacheIntermediateResult(const QString& name, const QString& key, std::shared_ptr<T> result, unsigned long long sizeInBytes)
+  {
+    this->cacheIntermediateResultData(name, key, std::static_pointer_cast<void>(result), typeid(T), sizeInBytes);
+  }
+
+private:
+  /// Type-erased implementation of \sa cachedIntermediateResult
+  std::shared_ptr<void> cachedIntermediateResultData(const QString& name, const QString& key, const std::type_info& type);
+  /// Type-erased implementation of \sa cacheIntermediateResult
+  void cacheIntermediateResultData(const QString& name, const QString& key,
+    std::shared_ptr<void> result, const std::type_info& type, unsigned long long sizeInBytes);
+
 // Beam parameter definition functions.
 // Need to be called from the implemented \sa defineBeamParameters method.
 // Public so that they can be called from python.
@@ -183,7 +243,8 @@ public:
   /// Get beam parameter from beam node
   Q_INVOKABLE QString parameter(vtkMRMLRTBeamNode* beamNode, QString parameterName);
 
-  /// Convenience function to get integer parameter
+  /// Convenience function to get integer parameter.
+  /// Typed parameter getters do not parse the attribute string except for the first access after scene load
   Q_INVOKABLE int integerParameter(vtkMRMLRTBeamNode* beamNode, QString parameterName);
 
   /// Convenience function to get double parameter
@@ -192,7 +253,9 @@ public:
   /// Convenience function to get boolean parameter
   Q_INVOKABLE bool booleanParameter(vtkMRMLRTBeamNode* beamNode, QString parameterName);
 
-  /// Set beam parameter in beam node. This function is called by both convenience functions.
+  /// Set beam parameter in beam node. The parameter is stored in typed form in the beam node, and as
+  /// attribute for serialization. Only \sa vtkMRMLRTBeamNode::DoseEngineParameterModified is invoked if the
+  /// value changes. Use StartModify/EndModify on the beam node to set multiple parameters with a single event.
   /// \param parameterName Parameter name string
   /// \param parameterValue Parameter value string
   Q_INVOKABLE void setParameter(vtkMRMLRTBeamNode* beamNode, QString parameterName, QString parameterValue);
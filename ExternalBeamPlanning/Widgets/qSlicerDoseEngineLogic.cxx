@@ -24,6 +24,9 @@
 #include "qSlicerDoseEnginePluginHandler.h"
 #include "qSlicerAbstractDoseEngine.h"
 
+// ExternalBeamPlanning includes
+#include "vtkSlicerExternalBeamPlanningModuleLogic.h"
+
 // Beams includes
 #include "vtkMRMLRTBeamNode.h"
 #include "vtkMRMLRTPlanNode.h"
@@ -49,6 +52,7 @@
 
 // VTK includes
 #include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
 
 // Qt includes
 #include <QDebug>
@@ -64,6 +68,9 @@ public:
   qSlicerDoseEngineLogicPrivate(qSlicerDoseEngineLogic& object);
   ~qSlicerDoseEngineLogicPrivate();
   void loadApplicationSettings();
+public:
+  /// External Beam Planning module logic computing and caching the WED volumes
+  vtkWeakPointer<vtkSlicerExternalBeamPlanningModuleLogic> ExternalBeamPlanningLogic;
 };
 
 //-----------------------------------------------------------------------------
@@ -91,6 +98,7 @@ void qSlicerDoseEngineLogicPrivate::loadApplicationSettings()
 //----------------------------------------------------------------------------
 qSlicerDoseEngineLogic::qSlicerDoseEngineLogic(QObject* parent)
   : QObject(parent)
+  , d_ptr( new qSlicerDoseEngineLogicPrivate(*this) )
 {
 }
 
@@ -106,6 +114,15 @@ void qSlicerDoseEngineLogic::setMRMLScene(vtkMRMLScene* scene)
   qvtkReconnect( scene, vtkMRMLScene::NodeAddedEvent, this, SLOT( onNodeAdded(vtkObject*,vtkObject*) ) );
   // Connect scene import ended event so that subject hierarchy nodes can be created for supported data nodes if missing (backwards compatibility)
   qvtkReconnect( scene, vtkMRMLScene::EndImportEvent, this, SLOT( onSceneImportEnded(vtkObject*) ) );
+  // Connect scene close ended event so that the dose engines release the results cached for the closed scene
+  qvtkReconnect( scene, vtkMRMLScene::EndCloseEvent, this, SLOT( onSceneClosed() ) );
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerDoseEngineLogic::setExternalBeamPlanningLogic(vtkSlicerExternalBeamPlanningModuleLogic* logic)
+{
+  Q_D(qSlicerDoseEngineLogic);
+  d->ExternalBeamPlanningLogic = logic;
 }
 
 //-----------------------------------------------------------------------------
@@ -146,6 +163,16 @@ void qSlicerDoseEngineLogic::onSceneImportEnded(vtkObject* sceneObject)
   }
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerDoseEngineLogic::onSceneClosed()
+{
+  // Dose engines are singletons that outlive the scene
+  foreach (qSlicerAbstractDoseEngine* engine, qSlicerDoseEnginePluginHandler::instance()->registeredDoseEngines())
+  {
+    engine->clearIntermediateResultCache();
+  }
+}
+
 //-----------------------------------------------------------------------------
 void qSlicerDoseEngineLogic::applyDoseEngineInPlan(vtkObject* nodeObject)
 {
@@ -186,6 +213,8 @@ void qSlicerDoseEngineLogic::applyDoseEngineInPlan(vtkObject* nodeObject)
 //---------------------------------------------------------------------------
 QString qSlicerDoseEngineLogic::calculateDose(vtkMRMLRTPlanNode* planNode)
 {
+  Q_D(qSlicerDoseEngineLogic);
+
   QString errorMessage("");
   if (!planNode || !planNode->GetScene())
   {
@@ -219,6 +248,17 @@ QString qSlicerDoseEngineLogic::calculateDose(vtkMRMLRTPlanNode* planNode)
       progress = (double)currentBeamIndex / (numberOfBeams+1);
       emit progressUpdated(progress);
 
+      // Update water-equivalent depth volume of the beam if the engine uses it (reused from the cache if unchanged)
+      if (selectedEngine->isWaterEquivalentDepthRequired(beamNode))
+      {
+        if (!d->ExternalBeamPlanningLogic || !d->ExternalBeamPlanningLogic->ComputeWED(beamNode))
+        {
+          errorMessage = QString("Failed to compute water-equivalent depth volume for beam %1").arg(beamNode->GetName());
+          qCritical() << Q_FUNC_INFO << ": " << errorMessage;
+          return errorMessage;
+        }
+      }
+
       // Calculate dose for current beam
       errorMessage = selectedEngine->calculateDose(beamNode);
       if (!errorMessage.isEmpty())
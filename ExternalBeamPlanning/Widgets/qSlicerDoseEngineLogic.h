@@ -36,6 +36,7 @@
 class vtkMRMLScene;
 class vtkMRMLRTPlanNode;
 class vtkMRMLRTBeamNode;
+class vtkSlicerExternalBeamPlanningModuleLogic;
 class qSlicerDoseEngineLogicPrivate;
 
 /// \ingroup SlicerRt_QtModules_ExternalBeamPlanning
@@ -58,6 +59,10 @@ public:
   /// Set the current MRML scene to the widget
   Q_INVOKABLE virtual void setMRMLScene(vtkMRMLScene* scene);
 
+  /// Set External Beam Planning module logic, used for computing the water-equivalent depth volumes
+  /// of the beams for the engines that require them (\sa qSlicerAbstractDoseEngine::isWaterEquivalentDepthRequired)
+  void setExternalBeamPlanningLogic(vtkSlicerExternalBeamPlanningModuleLogic* logic);
+
   /// Calculate dose for a plan
   Q_INVOKABLE QString calculateDose(vtkMRMLRTPlanNode* planNode);
 
@@ -90,8 +95,12 @@ protected slots:
   /// Called when scene import is finished
   void onSceneImportEnded(vtkObject* sceneObject);
 
+  /// Called when the scene is closed. Clears the intermediate result cache of all dose engines,
+  /// as the cached results belong to nodes of the closed scene
+  void onSceneClosed();
+
 protected:
-  QScopedPointer<qSlicerDoseEngineLogic> d_ptr;
+  QScopedPointer<qSlicerDoseEngineLogicPrivate> d_ptr;
 
 private:
   Q_DECLARE_PRIVATE(qSlicerDoseEngineLogic);
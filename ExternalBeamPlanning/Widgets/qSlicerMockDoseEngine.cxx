@@ -32,11 +32,16 @@
 
 // MRML includes
 #include "vtkMRMLScalarVolumeNode.h"
+#include "vtkMRMLTransformNode.h"
 
 // VTK includes
 #include <vtkSmartPointer.h>
 #include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
 #include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+#include <vtkTimerLog.h>
 
 // Slicer includes
 #include <vtkSlicerVersionConfigure.h>
@@ -44,6 +49,95 @@
 // Qt includes
 #include <QDebug>
 
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+
+/// Linear attenuation coefficient of the mock dose along the water-equivalent depth (1/mm)
+const float MOCK_DOSE_ATTENUATION_COEFFICIENT = 0.005f;
+
+/// Counter-based random number in [0,1). The same seed and counter always give the same number,
+/// so voxels can be filled in any order by any thread
+inline float CounterBasedUniformRandom(vtkTypeUInt64 seed, vtkTypeUInt64 counter)
+{
+  // SplitMix64 finalizer
+  vtkTypeUInt64 z = seed + (counter + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return static_cast<float>(z >> 40) * (1.0f / 16777216.0f);
+}
+
+/// Fills the dose voxels covered by the beam labelmap slice by slice
+class MockDoseFillFunctor
+{
+public:
+  /// \param wedVoxels Water-equivalent depth of the voxels in the dose geometry. Dose is attenuated along it if not nullptr
+  MockDoseFillFunctor(vtkImageData* beamImageData, vtkImageData* doseImageData, float rxDose, float noiseRange, vtkTypeUInt64 seed,
+    const float* wedVoxels=nullptr)
+    : RxDose(rxDose)
+    , NoiseAmplitude(rxDose * noiseRange / 100.0f)
+    , Seed(seed)
+    , WedVoxels(wedVoxels)
+  {
+    beamImageData->GetExtent(this->BeamExtent);
+    doseImageData->GetExtent(this->DoseExtent);
+    this->BeamScalars = static_cast<const unsigned char*>(beamImageData->GetScalarPointer());
+    this->DoseScalars = static_cast<float*>(doseImageData->GetScalarPointer());
+    beamImageData->GetIncrements(this->BeamIncrements);
+    doseImageData->GetIncrements(this->DoseIncrements);
+  }
+
+  void operator()(vtkIdType beginSlice, vtkIdType endSlice) const
+  {
+    int rowLength = this->BeamExtent[1] - this->BeamExtent[0] + 1;
+    for (vtkIdType k = beginSlice; k < endSlice; ++k)
+    {
+      for (int j = this->BeamExtent[2]; j <= this->BeamExtent[3]; ++j)
+      {
+        const unsigned char* beamRow = this->BeamScalars
+          + (k - this->BeamExtent[4]) * this->BeamIncrements[2] + (j - this->BeamExtent[2]) * this->BeamIncrements[1];
+        vtkIdType doseRowOffset = (k - this->DoseExtent[4]) * this->DoseIncrements[2]
+          + (j - this->DoseExtent[2]) * this->DoseIncrements[1] + (this->BeamExtent[0] - this->DoseExtent[0]);
+        float* doseRow = this->DoseScalars + doseRowOffset;
+
+        // Branch-free inner loop. The random number only depends on the voxel index in the dose volume
+        for (int i = 0; i < rowLength; ++i)
+        {
+          float noise = CounterBasedUniformRandom(this->Seed, static_cast<vtkTypeUInt64>(doseRowOffset + i)) - 0.5f;
+          doseRow[i] = (beamRow[i] > 0 ? 1.0f : 0.0f) * (this->RxDose + noise * this->NoiseAmplitude);
+        }
+        if (this->WedVoxels)
+        {
+          const float* wedRow = this->WedVoxels + doseRowOffset;
+          for (int i = 0; i < rowLength; ++i)
+          {
+            doseRow[i] *= std::exp(-MOCK_DOSE_ATTENUATION_COEFFICIENT * wedRow[i]);
+          }
+        }
+      }
+    }
+  }
+
+private:
+  float RxDose;
+  float NoiseAmplitude;
+  vtkTypeUInt64 Seed;
+  const float* WedVoxels;
+  int BeamExtent[6];
+  int DoseExtent[6];
+  const unsigned char* BeamScalars;
+  float* DoseScalars;
+  vtkIdType BeamIncrements[3];
+  vtkIdType DoseIncrements[3];
+};
+
+} // namespace
+
 //----------------------------------------------------------------------------
 qSlicerMockDoseEngine::qSlicerMockDoseEngine(QObject* parent)
   : qSlicerAbstractDoseEngine(parent)
@@ -61,6 +155,27 @@ void qSlicerMockDoseEngine::defineBeamParameters()
   this->addBeamParameterSpinBox(
     "Mock dose", "NoiseRange", "Noise range (% of Rx):", "Range of noise added to the prescription dose (+- half of the percentage of the Rx dose)",
     0.0, 99.99, 10.0, 1.0, 2 );
+
+  // High throughput mode parameters
+  QStringList dependentParameters;
+  dependentParameters << "RandomSeed" << "DepthAttenuation";
+  this->addBeamParameterCheckBox(
+    "Mock dose", "HighThroughput", "High throughput:",
+    "Rasterize the beam only within its bounding box and fill the dose in parallel with a reproducible random generator. Timings are logged",
+    false, dependentParameters );
+  this->addBeamParameterSpinBox(
+    "Mock dose", "RandomSeed", "Random seed:", "Seed of the random generator in high throughput mode",
+    0.0, 999999.0, 0.0, 1.0, 0 );
+  this->addBeamParameterCheckBox(
+    "Mock dose", "DepthAttenuation", "Attenuate with depth:",
+    "Attenuate the dose exponentially along the water-equivalent depth of the voxels from the beam source in high throughput mode",
+    false );
+}
+
+//---------------------------------------------------------------------------
+bool qSlicerMockDoseEngine::isWaterEquivalentDepthRequired(vtkMRMLRTBeamNode* beamNode)
+{
+  return (this->booleanParameter(beamNode, "HighThroughput") && this->booleanParameter(beamNode, "DepthAttenuation"));
 }
 
 //---------------------------------------------------------------------------
@@ -73,7 +188,7 @@ QString qSlicerMockDoseEngine::calculateDoseUsingEngine(vtkMRMLRTBeamNode* beamN
     return errorMessage;
   }
   vtkMRMLRTPlanNode* parentPlanNode = beamNode->GetParentPlanNode();
-  vtkMRMLScalarVolumeNode* referenceVolumeNode = parentPlanNode->GetReferenceVolumeNode();
+  vtkMRMLScalarVolumeNode* referenceVolumeNode = (parentPlanNode ? parentPlanNode->GetReferenceVolumeNode() : nullptr);
   if (!parentPlanNode || !referenceVolumeNode || !resultDoseVolumeNode)
   {
     QString errorMessage("Unable to access reference volume");
@@ -81,6 +196,11 @@ QString qSlicerMockDoseEngine::calculateDoseUsingEngine(vtkMRMLRTBeamNode* beamN
     return errorMessage;
   }
 
+  if (this->booleanParameter(beamNode, "HighThroughput"))
+  {
+    return this->calculateDoseHighThroughput(beamNode, resultDoseVolumeNode);
+  }
+
   vtkSmartPointer<vtkClosedSurfaceToBinaryLabelmapConversionRule> converter = 
     vtkSmartPointer<vtkClosedSurfaceToBinaryLabelmapConversionRule>::New();
   converter->SetUseOutputImageDataGeometry(true);
@@ -136,3 +256,167 @@ QString qSlicerMockDoseEngine::calculateDoseUsingEngine(vtkMRMLRTBeamNode* beamN
 
   return QString();
 }
+
+//---------------------------------------------------------------------------
+QString qSlicerMockDoseEngine::calculateDoseHighThroughput(vtkMRMLRTBeamNode* beamNode, vtkMRMLScalarVolumeNode* resultDoseVolumeNode)
+{
+  vtkMRMLRTPlanNode* parentPlanNode = beamNode->GetParentPlanNode();
+  vtkMRMLScalarVolumeNode* referenceVolumeNode = parentPlanNode->GetReferenceVolumeNode();
+  vtkImageData* referenceImageData = referenceVolumeNode->GetImageData();
+  if (!referenceImageData)
+  {
+    QString errorMessage("Invalid reference volume image data");
+    qCritical() << Q_FUNC_INFO << ": " << errorMessage;
+    return errorMessage;
+  }
+
+  vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
+  double checkpointStart = timer->GetUniversalTime();
+
+  // Get beam model in world coordinates
+  vtkSmartPointer<vtkSegment> beamSegment = vtkSmartPointer<vtkSegment>::Take(
+    vtkSlicerSegmentationsModuleLogic::CreateSegmentFromModelNode(beamNode) );
+  vtkPolyData* beamPolyData = (beamSegment.GetPointer() ? vtkPolyData::SafeDownCast(
+    beamSegment->GetRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName()) ) : nullptr);
+  if (!beamPolyData || beamPolyData->GetNumberOfPoints() == 0)
+  {
+    QString errorMessage("Failed to get beam model");
+    qCritical() << Q_FUNC_INFO << ": " << errorMessage;
+    return errorMessage;
+  }
+
+  // Reference volume IJK to world transform (without copying the reference image)
+  vtkNew<vtkMatrix4x4> ijkToWorldMatrix;
+  referenceVolumeNode->GetIJKToRASMatrix(ijkToWorldMatrix);
+  vtkMRMLTransformNode* referenceTransformNode = referenceVolumeNode->GetParentTransformNode();
+  if (referenceTransformNode)
+  {
+    if (!referenceTransformNode->IsTransformToWorldLinear())
+    {
+      QString errorMessage("Non-linearly transformed reference volume is not supported in high throughput mode");
+      qCritical() << Q_FUNC_INFO << ": " << errorMessage;
+      return errorMessage;
+    }
+    vtkNew<vtkMatrix4x4> referenceToWorldMatrix;
+    referenceTransformNode->GetMatrixTransformToWorld(referenceToWorldMatrix);
+    vtkMatrix4x4::Multiply4x4(referenceToWorldMatrix, ijkToWorldMatrix, ijkToWorldMatrix);
+  }
+  vtkNew<vtkMatrix4x4> worldToIjkMatrix;
+  vtkMatrix4x4::Invert(ijkToWorldMatrix, worldToIjkMatrix);
+
+  // Bounding extent of the beam in the reference volume
+  int referenceExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  referenceImageData->GetExtent(referenceExtent);
+  double beamBounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+  beamPolyData->GetBounds(beamBounds);
+  double beamIjkBounds[6] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN };
+  for (int corner = 0; corner < 8; ++corner)
+  {
+    double cornerWorld[4] = { beamBounds[corner & 1], beamBounds[2 + ((corner >> 1) & 1)], beamBounds[4 + ((corner >> 2) & 1)], 1.0 };
+    double cornerIjk[4] = { 0.0, 0.0, 0.0, 1.0 };
+    worldToIjkMatrix->MultiplyPoint(cornerWorld, cornerIjk);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      beamIjkBounds[2 * axis] = std::min(beamIjkBounds[2 * axis], cornerIjk[axis]);
+      beamIjkBounds[2 * axis + 1] = std::max(beamIjkBounds[2 * axis + 1], cornerIjk[axis]);
+    }
+  }
+  int beamExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  bool beamInVolume = true;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    beamExtent[2 * axis] = std::max(referenceExtent[2 * axis], static_cast<int>(std::floor(beamIjkBounds[2 * axis])));
+    beamExtent[2 * axis + 1] = std::min(referenceExtent[2 * axis + 1], static_cast<int>(std::ceil(beamIjkBounds[2 * axis + 1])));
+    beamInVolume = beamInVolume && (beamExtent[2 * axis] <= beamExtent[2 * axis + 1]);
+  }
+
+  // Rasterize beam within its bounding extent
+  vtkSmartPointer<vtkOrientedImageData> beamImageData;
+  if (beamInVolume)
+  {
+    beamImageData = vtkSmartPointer<vtkOrientedImageData>::New();
+    beamImageData->SetExtent(beamExtent);
+    beamImageData->SetImageToWorldMatrix(ijkToWorldMatrix);
+    beamImageData->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+
+    vtkSmartPointer<vtkClosedSurfaceToBinaryLabelmapConversionRule> converter =
+      vtkSmartPointer<vtkClosedSurfaceToBinaryLabelmapConversionRule>::New();
+    converter->SetUseOutputImageDataGeometry(true);
+#if Slicer_VERSION_MAJOR >= 5 || (Slicer_VERSION_MAJOR >= 4 && Slicer_VERSION_MINOR >= 11)
+    beamSegment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), beamImageData);
+    converter->Convert(beamSegment);
+    beamImageData = vtkOrientedImageData::SafeDownCast(
+      beamSegment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) );
+#else
+    converter->Convert(beamPolyData, beamImageData);
+#endif
+    if (beamImageData.GetPointer())
+    {
+      beamImageData->GetExtent(beamExtent);
+    }
+    if ( !beamImageData.GetPointer() || beamImageData->GetScalarType() != VTK_UNSIGNED_CHAR
+      || beamExtent[0] < referenceExtent[0] || beamExtent[1] > referenceExtent[1]
+      || beamExtent[2] < referenceExtent[2] || beamExtent[3] > referenceExtent[3]
+      || beamExtent[4] < referenceExtent[4] || beamExtent[5] > referenceExtent[5] )
+    {
+      QString errorMessage("Geometrical discrepancy between beam and dose");
+      qCritical() << Q_FUNC_INFO << ": " << errorMessage;
+      return errorMessage;
+    }
+  }
+  double checkpointFillStart = timer->GetUniversalTime();
+
+  // Create dose image. Voxels outside the beam bounding extent are zero
+  vtkSmartPointer<vtkImageData> doseImageData = vtkSmartPointer<vtkImageData>::New();
+  doseImageData->SetExtent(referenceExtent);
+  doseImageData->SetSpacing(referenceImageData->GetSpacing());
+  doseImageData->SetOrigin(referenceImageData->GetOrigin());
+  doseImageData->AllocateScalars(VTK_FLOAT, 1);
+  float* doseScalars = static_cast<float*>(doseImageData->GetScalarPointer());
+  std::fill(doseScalars, doseScalars + doseImageData->GetNumberOfPoints(), 0.0f);
+
+  // Water-equivalent depth volume of the beam, computed in the reference geometry by the dose engine logic
+  const float* wedVoxels = nullptr;
+  if (this->isWaterEquivalentDepthRequired(beamNode))
+  {
+    vtkMRMLScalarVolumeNode* wedVolumeNode = beamNode->GetWEDVolumeNode();
+    vtkImageData* wedImageData = (wedVolumeNode ? wedVolumeNode->GetImageData() : nullptr);
+    int wedExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    if (wedImageData)
+    {
+      wedImageData->GetExtent(wedExtent);
+    }
+    if ( !wedImageData || wedImageData->GetScalarType() != VTK_FLOAT || !std::equal(wedExtent, wedExtent + 6, referenceExtent) )
+    {
+      QString errorMessage("Water-equivalent depth volume of the beam is missing or does not match the reference volume");
+      qCritical() << Q_FUNC_INFO << ": " << errorMessage;
+      return errorMessage;
+    }
+    wedVoxels = static_cast<const float*>(wedImageData->GetScalarPointer());
+  }
+
+  // Paint voxels touched by beam prescription+noise in parallel
+  if (beamInVolume)
+  {
+    vtkTypeUInt64 seed = (static_cast<vtkTypeUInt64>(this->integerParameter(beamNode, "RandomSeed")) << 32)
+      + static_cast<vtkTypeUInt64>(beamNode->GetBeamNumber());
+    MockDoseFillFunctor functor(beamImageData, doseImageData, parentPlanNode->GetRxDose(),
+      this->doubleParameter(beamNode, "NoiseRange"), seed, wedVoxels);
+    vtkSMPTools::For(beamExtent[4], beamExtent[5] + 1, functor);
+  }
+  double checkpointOutputStart = timer->GetUniversalTime();
+
+  resultDoseVolumeNode->SetAndObserveImageData(doseImageData);
+  resultDoseVolumeNode->CopyOrientation(referenceVolumeNode);
+
+  std::string randomDoseNodeName = std::string(beamNode->GetName()) + "_MockDose";
+  resultDoseVolumeNode->SetName(randomDoseNodeName.c_str());
+
+  double checkpointEnd = timer->GetUniversalTime();
+  qDebug() << Q_FUNC_INFO << ": Total mock dose computation time:" << checkpointEnd-checkpointStart << "s\n"
+    << "\tRasterizing beam:" << checkpointFillStart-checkpointStart << "s\n"
+    << "\tFilling dose:" << checkpointOutputStart-checkpointFillStart << "s\n"
+    << "\tSetting output:" << checkpointEnd-checkpointOutputStart << "s";
+
+  return QString();
+}
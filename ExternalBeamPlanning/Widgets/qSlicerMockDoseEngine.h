@@ -30,6 +30,12 @@
 /// \class qSlicerMockDoseEngine
 /// \brief Mock dose calculation algorithm. Simply fills the beam apertures with prescription dose adding some noise.
 ///        Used for testing.
+///
+/// In high throughput mode the beam is only rasterized within its bounding extent, the dose voxels are filled in
+/// parallel using a counter-based random generator (so the result does not depend on the number of threads), and
+/// the time spent in each stage is logged. This makes it a reproducible baseline for measuring the overhead of
+/// the dose engine framework independently from the physics. Optionally the dose is attenuated along the
+/// water-equivalent depth volume of the beam, which exercises the WED computation in the framework.
 class Q_SLICER_MODULE_EXTERNALBEAMPLANNING_WIDGETS_EXPORT qSlicerMockDoseEngine : public qSlicerAbstractDoseEngine
 {
   Q_OBJECT
@@ -52,6 +58,13 @@ public:
   /// Define engine-specific beam parameters
   void defineBeamParameters();
 
+  /// The water-equivalent depth is used in high throughput mode if depth attenuation is enabled
+  bool isWaterEquivalentDepthRequired(vtkMRMLRTBeamNode* beamNode) override;
+
+protected:
+  /// Calculate mock dose in high throughput mode. Called by \sa calculateDoseUsingEngine
+  QString calculateDoseHighThroughput(vtkMRMLRTBeamNode* beamNode, vtkMRMLScalarVolumeNode* resultDoseVolumeNode);
+
 private:
   Q_DISABLE_COPY(qSlicerMockDoseEngine);
 };
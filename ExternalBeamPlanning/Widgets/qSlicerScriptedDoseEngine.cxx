@@ -56,6 +56,7 @@ public:
   enum {
     DefineBeamParametersMethod = 0,
     CalculateDoseUsingEngineMethod,
+    IsWaterEquivalentDepthRequiredMethod,
     };
 
   mutable qSlicerPythonCppAPI PythonCppAPI;
@@ -71,6 +72,7 @@ qSlicerScriptedDoseEnginePrivate::qSlicerScriptedDoseEnginePrivate()
 {
   this->PythonCppAPI.declareMethod(Self::DefineBeamParametersMethod, "defineBeamParameters");
   this->PythonCppAPI.declareMethod(Self::CalculateDoseUsingEngineMethod, "calculateDoseUsingEngine");
+  this->PythonCppAPI.declareMethod(Self::IsWaterEquivalentDepthRequiredMethod, "isWaterEquivalentDepthRequired");
 }
 
 //-----------------------------------------------------------------------------
@@ -223,3 +225,20 @@ void qSlicerScriptedDoseEngine::defineBeamParameters()
   Q_D(const qSlicerScriptedDoseEngine);
   d->PythonCppAPI.callMethod(d->DefineBeamParametersMethod);
 }
+
+//-----------------------------------------------------------------------------
+bool qSlicerScriptedDoseEngine::isWaterEquivalentDepthRequired(vtkMRMLRTBeamNode* beamNode)
+{
+  Q_D(const qSlicerScriptedDoseEngine);
+  PyObject* arguments = PyTuple_New(1);
+  PyTuple_SET_ITEM(arguments, 0, vtkPythonUtil::GetObjectFromPointer(beamNode));
+  PyObject* result = d->PythonCppAPI.callMethod(d->IsWaterEquivalentDepthRequiredMethod, arguments);
+  Py_DECREF(arguments);
+  if (!result)
+    {
+    // Method is optional
+    return this->Superclass::isWaterEquivalentDepthRequired(beamNode);
+    }
+
+  return (PyObject_IsTrue(result) == 1);
+}
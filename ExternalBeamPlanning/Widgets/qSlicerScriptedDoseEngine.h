@@ -83,6 +83,11 @@ protected:
   /// This is the method that needs to be implemented in each engine.
   void defineBeamParameters() override;
 
+public:
+  /// Determine whether the engine uses the water-equivalent depth volume of the beam.
+  /// Optional method, false if not implemented in python
+  bool isWaterEquivalentDepthRequired(vtkMRMLRTBeamNode* beamNode) override;
+
 protected:
   QScopedPointer<qSlicerScriptedDoseEnginePrivate> d_ptr;
 
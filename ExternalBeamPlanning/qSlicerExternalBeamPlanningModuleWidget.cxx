@@ -141,6 +141,7 @@ void qSlicerExternalBeamPlanningModuleWidget::setMRMLScene(vtkMRMLScene* scene)
 
   // Set scene to dose engine logic
   d->DoseEngineLogic->setMRMLScene(scene);
+  d->DoseEngineLogic->setExternalBeamPlanningLogic(d->logic());
 
   // Find a plan node and select it if there is one in the scene
   if (scene && d->MRMLNodeComboBox_RtPlan->currentNode())
@@ -254,6 +255,7 @@ void qSlicerExternalBeamPlanningModuleWidget::setup()
   // Calculation buttons
   connect( d->pushButton_CalculateDose, SIGNAL(clicked()), this, SLOT(calculateDoseClicked()) );
   connect( d->pushButton_CalculateWED, SIGNAL(clicked()), this, SLOT(calculateWEDClicked()) );
+  connect( d->pushButton_CalculateDRR, SIGNAL(clicked()), this, SLOT(calculateDRRClicked()) );
   connect( d->pushButton_ClearDose, SIGNAL(clicked()), this, SLOT(clearDoseClicked()) );
 
   // Connect to progress event
@@ -1081,18 +1083,47 @@ void qSlicerExternalBeamPlanningModuleWidget::calculateWEDClicked()
     return;
   }
 
-  /// GCS FIX TODO *** Implementation needs work ***
+  vtkMRMLRTPlanNode* planNode = vtkMRMLRTPlanNode::SafeDownCast(d->MRMLNodeComboBox_RtPlan->currentNode());
+  if (!planNode || !planNode->GetReferenceVolumeNode())
+  {
+    d->label_CalculateDoseStatus->setText("No reference image");
+    return;
+  }
+
+  QApplication::setOverrideCursor(QCursor(Qt::BusyCursor));
+
+  // Compute WED for each beam (unchanged beams reuse their cached WED volume)
+  std::vector<vtkMRMLRTBeamNode*> beams;
+  planNode->GetBeams(beams);
+  for (std::vector<vtkMRMLRTBeamNode*>::iterator beamIt = beams.begin(); beamIt != beams.end(); ++beamIt)
+  {
+    if (!d->logic()->ComputeWED(*beamIt))
+    {
+      d->label_CalculateDoseStatus->setText(QString("WED calculation failed for beam %1").arg((*beamIt)->GetName()));
+      QApplication::restoreOverrideCursor();
+      return;
+    }
+  }
+
+  d->label_CalculateDoseStatus->setText("WED calculation done.");
+  QApplication::restoreOverrideCursor();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerExternalBeamPlanningModuleWidget::calculateDRRClicked()
+{
+  Q_D(qSlicerExternalBeamPlanningModuleWidget);
 
-#if defined (commentout)
-  vtkMRMLExternalBeamPlanningNode* paramNode = d->logic()->GetExternalBeamPlanningNode();
-  if (!paramNode)
+  d->label_CalculateDoseStatus->setText("Starting DRR calculation...");
+
+  if (!this->mrmlScene())
   {
+    qCritical() << Q_FUNC_INFO << ": Invalid scene";
     return;
   }
 
-  // Make sure inputs were specified - only CT needed
-  vtkMRMLScalarVolumeNode* referenceVolume = planNode->GetReferenceVolumeNode();
-  if (!referenceVolume)
+  vtkMRMLRTPlanNode* planNode = vtkMRMLRTPlanNode::SafeDownCast(d->MRMLNodeComboBox_RtPlan->currentNode());
+  if (!planNode || !planNode->GetReferenceVolumeNode())
   {
     d->label_CalculateDoseStatus->setText("No reference image");
     return;
@@ -1100,17 +1131,21 @@ void qSlicerExternalBeamPlanningModuleWidget::calculateWEDClicked()
 
   QApplication::setOverrideCursor(QCursor(Qt::BusyCursor));
 
-  // Copy pertinent variable values from GUI to logic
-  // Is this the right place for this?
-  d->logic()->GetExternalBeamPlanningNode()->SetGantryAngle(d->SliderWidget_GantryAngle->value());
-
-  // OK, we're good to go (well, not really, but let's pretend). 
-  // Do the actual computation in the logic object
-  d->logic()->ComputeWED();
+  // Compute DRR for each beam, placed on the isocenter plane of the beam
+  std::vector<vtkMRMLRTBeamNode*> beams;
+  planNode->GetBeams(beams);
+  for (std::vector<vtkMRMLRTBeamNode*>::iterator beamIt = beams.begin(); beamIt != beams.end(); ++beamIt)
+  {
+    if (!d->logic()->UpdateDRR(planNode, (*beamIt)->GetName()))
+    {
+      d->label_CalculateDoseStatus->setText(QString("DRR calculation failed for beam %1").arg((*beamIt)->GetName()));
+      QApplication::restoreOverrideCursor();
+      return;
+    }
+  }
 
-  d->label_CalculateDoseStatus->setText("WED calculation done.");
+  d->label_CalculateDoseStatus->setText("DRR calculation done.");
   QApplication::restoreOverrideCursor();
-#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -90,6 +90,7 @@ protected slots:
   // Calculation buttons
   void calculateDoseClicked();
   void calculateWEDClicked();
+  void calculateDRRClicked();
   void clearDoseClicked();
 
   // Beams section
@@ -30,6 +30,7 @@
 
 // SlicerRT includes
 #include "vtkSlicerRtCommon.h"
+#include "vtkMultiLevelMarchingCubes.h"
 
 // MRML includes
 #include <vtkMRMLColorTableNode.h>
@@ -51,9 +52,12 @@
 #include <vtkImageData.h>
 #include <vtkImageMarchingCubes.h>
 #include <vtkImageReslice.h>
+#include <vtkImageShrink3D.h>
 #include <vtkLookupTable.h>
+#include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPolyData.h>
 #include <vtkPolyDataNormals.h>
 #include <vtkSmartPointer.h>
 #include <vtkTransformPolyDataFilter.h>
@@ -61,10 +65,19 @@
 #include <vtkWindowedSincPolyDataFilter.h>
 #include "vtksys/SystemTools.hxx"
 
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 //----------------------------------------------------------------------------
 const char* DEFAULT_ISODOSE_COLOR_TABLE_FILE_NAME = "Isodose_ColorTable.ctbl";
 const char* DEFAULT_ISODOSE_COLOR_TABLE_NODE_NAME = "Isodose_ColorTable_Default";
 const std::string vtkSlicerIsodoseModuleLogic::ISODOSE_MODEL_NODE_NAME_PREFIX = "IsodoseLevel_";
+const std::string vtkSlicerIsodoseModuleLogic::ISODOSE_LEVEL_ATTRIBUTE_NAME = "IsodoseLevel";
 const std::string vtkSlicerIsodoseModuleLogic::ISODOSE_PARAMETER_SET_BASE_NAME_PREFIX = "IsodoseParameterSet_";
 const std::string vtkSlicerIsodoseModuleLogic::ISODOSE_ROOT_HIERARCHY_NAME_POSTFIX = "_IsodoseSurfaces";
 const std::string vtkSlicerIsodoseModuleLogic::ISODOSE_COLOR_TABLE_NODE_NAME_POSTFIX = "_IsodoseColorTable";
@@ -73,15 +86,67 @@ const std::string vtkSlicerIsodoseModuleLogic::ISODOSE_COLOR_TABLE_NODE_NAME_POS
 vtkStandardNewMacro(vtkSlicerIsodoseModuleLogic);
 
 //----------------------------------------------------------------------------
-vtkSlicerIsodoseModuleLogic::vtkSlicerIsodoseModuleLogic() = default;
+class vtkSlicerIsodoseModuleLogic::vtkInternal
+{
+public:
+  vtkInternal();
+
+  /// State shared with the thread computing the full resolution isodose surfaces in progressive mode
+  struct RefinementJob
+  {
+    RefinementJob() : Finished(false), Cancelled(false) { }
+    /// Flag set by the refinement thread when it returns
+    bool Finished;
+    /// Flag requesting the refinement thread to stop
+    std::atomic<bool> Cancelled;
+    /// Multi-level marching cubes run by the thread, so that the extraction can be aborted on cancel
+    vtkSmartPointer<vtkMultiLevelMarchingCubes> MultiLevelMarchingCubes;
+    /// Refined surfaces, one for each level (nullptr if the level has no surface)
+    std::vector<vtkSmartPointer<vtkPolyData> > RefinedSurfaces;
+    /// Guards Finished and RefinedSurfaces
+    std::mutex Mutex;
+    std::condition_variable FinishedCondition;
+  };
+
+  /// Current refinement job. nullptr if there is no refinement to apply
+  std::shared_ptr<RefinementJob> Refinement;
+  /// Thread computing the refinement job. Joined when the result is applied or the job is cancelled
+  std::thread RefinementThread;
+  /// Flag determining whether model nodes of levels without refined surface are kept (when reusing nodes)
+  bool RefinementKeepEmptyModelNodes;
+  /// IDs of the isodose model nodes to update, one for each level (empty if no node was created for the level)
+  std::vector<std::string> RefinementModelNodeIDs;
+};
+
+//----------------------------------------------------------------------------
+vtkSlicerIsodoseModuleLogic::vtkInternal::vtkInternal()
+  : RefinementKeepEmptyModelNodes(false)
+{
+}
 
 //----------------------------------------------------------------------------
-vtkSlicerIsodoseModuleLogic::~vtkSlicerIsodoseModuleLogic() = default;
+vtkSlicerIsodoseModuleLogic::vtkSlicerIsodoseModuleLogic()
+{
+  this->UseMultiLevelMarchingCubes = true;
+  this->ProgressivePreviewShrinkFactor = 4;
+
+  this->Internal = new vtkInternal;
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerIsodoseModuleLogic::~vtkSlicerIsodoseModuleLogic()
+{
+  this->CancelIsodoseSurfaceRefinement();
+
+  delete this->Internal;
+}
 
 //----------------------------------------------------------------------------
 void vtkSlicerIsodoseModuleLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "UseMultiLevelMarchingCubes: " << (this->UseMultiLevelMarchingCubes ? "true" : "false") << "\n";
+  os << indent << "ProgressivePreviewShrinkFactor: " << this->ProgressivePreviewShrinkFactor << "\n";
 }
 
 //---------------------------------------------------------------------------
@@ -147,6 +212,8 @@ void vtkSlicerIsodoseModuleLogic::OnMRMLSceneEndClose()
     return;
   }
 
+  this->CancelIsodoseSurfaceRefinement();
+
   this->Modified();
 }
 
@@ -484,7 +551,7 @@ void vtkSlicerIsodoseModuleLogic::SetNumberOfIsodoseLevels(vtkMRMLIsodoseNode* p
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* parameterNode)
+void vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* parameterNode, bool progressive/*=false*/, bool reuseModelNodes/*=false*/)
 {
   vtkMRMLScene* scene = this->GetMRMLScene();
   if (!scene || !parameterNode)
@@ -506,7 +573,8 @@ void vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* para
     return;
   }
 
-  scene->StartState(vtkMRMLScene::BatchProcessState); 
+  // Result of a previous progressive run would be applied to the wrong nodes
+  this->CancelIsodoseSurfaceRefinement();
 
   // Get subject hierarchy item for the dose volume
   vtkIdType doseShItemID = shNode->GetItemByDataNode(doseVolumeNode);
@@ -516,27 +584,80 @@ void vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* para
     return;
   }
 
-  // Check existing isodose set and remove if exists
+  // Get color table
+  vtkMRMLColorTableNode* colorTableNode = parameterNode->GetColorTableNode();
+  if (!colorTableNode)
+  {
+    vtkErrorMacro("CreateIsodoseSurfaces: Failed to get isodose color table node for dose volume " << doseVolumeNode->GetName());
+    return;
+  }
+  int numberOfLevels = colorTableNode->GetNumberOfColors();
+
+  // Get dose unit name
+  std::string doseUnitName = shNode->GetAttributeFromItemAncestor(
+    doseShItemID, vtkSlicerRtCommon::DICOMRTIMPORT_DOSE_UNIT_NAME_ATTRIBUTE_NAME, vtkMRMLSubjectHierarchyConstants::GetDICOMLevelStudy());
+
+  // Collect existing isodose model nodes if they are to be reused, and match them to the levels by level value.
+  // Nodes created before the level attribute was introduced are matched by name
   vtkIdType isodoseFolderItemID = this->GetIsodoseFolderItemID(doseVolumeNode);
-  if (isodoseFolderItemID)
+  std::vector<vtkMRMLModelNode*> reusedIsodoseModelNodes(numberOfLevels, nullptr);
+  std::vector<vtkMRMLModelNode*> obsoleteIsodoseModelNodes;
+  if (isodoseFolderItemID && reuseModelNodes)
+  {
+    std::vector<vtkIdType> isodoseChildItemIDs;
+    shNode->GetItemChildren(isodoseFolderItemID, isodoseChildItemIDs, false);
+    for (std::vector<vtkIdType>::iterator childIt = isodoseChildItemIDs.begin(); childIt != isodoseChildItemIDs.end(); ++childIt)
+    {
+      vtkMRMLModelNode* isodoseModelNode = vtkMRMLModelNode::SafeDownCast(shNode->GetItemDataNode(*childIt));
+      if (vtkSlicerRtCommon::IsIsodoseModelNode(isodoseModelNode))
+      {
+        obsoleteIsodoseModelNodes.push_back(isodoseModelNode);
+      }
+    }
+    for (int levelIndex = 0; levelIndex < numberOfLevels; ++levelIndex)
+    {
+      std::string isoLevel = (colorTableNode->GetColorName(levelIndex) ? colorTableNode->GetColorName(levelIndex) : "");
+      std::string isodoseModelNodeName = vtkSlicerIsodoseModuleLogic::ISODOSE_MODEL_NODE_NAME_PREFIX + isoLevel + doseUnitName;
+      for (std::vector<vtkMRMLModelNode*>::iterator nodeIt = obsoleteIsodoseModelNodes.begin(); nodeIt != obsoleteIsodoseModelNodes.end(); ++nodeIt)
+      {
+        const char* nodeIsoLevel = (*nodeIt)->GetAttribute(vtkSlicerIsodoseModuleLogic::ISODOSE_LEVEL_ATTRIBUTE_NAME.c_str());
+        const char* nodeName = (*nodeIt)->GetName();
+        if ( (nodeIsoLevel && isoLevel == nodeIsoLevel)
+          || (!nodeIsoLevel && nodeName && isodoseModelNodeName == nodeName) )
+        {
+          reusedIsodoseModelNodes[levelIndex] = (*nodeIt);
+          obsoleteIsodoseModelNodes.erase(nodeIt);
+          break;
+        }
+      }
+    }
+  }
+
+  // Nodes are only added or removed if the set of levels changed when reusing nodes.
+  // Batch processing (which triggers a full update of the scene views) is not needed otherwise
+  bool batchProcessing = !obsoleteIsodoseModelNodes.empty()
+    || std::find(reusedIsodoseModelNodes.begin(), reusedIsodoseModelNodes.end(), nullptr) != reusedIsodoseModelNodes.end();
+  if (batchProcessing)
+  {
+    scene->StartState(vtkMRMLScene::BatchProcessState);
+  }
+
+  // Check existing isodose set and remove if exists (unless nodes are reused)
+  if (isodoseFolderItemID && !reuseModelNodes)
   {
     shNode->RemoveItem(isodoseFolderItemID, true, true);
+    isodoseFolderItemID = 0;
   }
 
   // Setup isodose subject hierarchy folder
-  std::string isodoseFolderName = std::string(doseVolumeNode->GetName()) + vtkSlicerIsodoseModuleLogic::ISODOSE_ROOT_HIERARCHY_NAME_POSTFIX;
-  isodoseFolderItemID = shNode->CreateFolderItem(doseShItemID, isodoseFolderName);
-
-  // Get color table
-  vtkMRMLColorTableNode* colorTableNode = parameterNode->GetColorTableNode();
-  if (!colorTableNode)
+  if (!isodoseFolderItemID)
   {
-    vtkErrorMacro("CreateIsodoseSurfaces: Failed to get isodose color table node for dose volume " << doseVolumeNode->GetName());
-    return;
+    std::string isodoseFolderName = std::string(doseVolumeNode->GetName()) + vtkSlicerIsodoseModuleLogic::ISODOSE_ROOT_HIERARCHY_NAME_POSTFIX;
+    isodoseFolderItemID = shNode->CreateFolderItem(doseShItemID, isodoseFolderName);
   }
 
   // Progress
-  int progressStepCount = colorTableNode->GetNumberOfColors() + 1 /* reslice step */;
+  int progressStepCount = numberOfLevels + 2 /* reslice and extraction steps */;
   int currentProgressStep = 0;
 
   // Reslice dose volume
@@ -577,92 +698,120 @@ void vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* para
   double progress = (double)(currentProgressStep) / (double)progressStepCount;
   this->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
 
+  std::vector<double> isoLevels;
+  for (int i = 0; i < colorTableNode->GetNumberOfColors(); i++)
+  {
+    isoLevels.push_back(vtkVariant(colorTableNode->GetColorName(i)).ToDouble());
+  }
+
+  // Extract raw isodose surfaces. In progressive mode a coarse preview is created from a downsampled
+  // dose volume, and the full resolution surfaces are computed in the background
+  std::vector<vtkSmartPointer<vtkPolyData> > rawIsodoseSurfaces;
+  if (progressive)
+  {
+    int shrinkFactors[3] = {1, 1, 1};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      if (this->ProgressivePreviewShrinkFactor > 1 && dimensions[axis] >= 2 * this->ProgressivePreviewShrinkFactor)
+      {
+        shrinkFactors[axis] = this->ProgressivePreviewShrinkFactor;
+      }
+    }
+    vtkNew<vtkImageShrink3D> shrink;
+    shrink->SetInputData(reslicedDoseVolumeImage);
+    shrink->SetShrinkFactors(shrinkFactors);
+    shrink->MeanOn();
+    shrink->Update();
+    vtkSlicerIsodoseModuleLogic::ExtractIsodoseSurfaces(shrink->GetOutput(), isoLevels, this->UseMultiLevelMarchingCubes, rawIsodoseSurfaces);
+  }
+  else
+  {
+    vtkSlicerIsodoseModuleLogic::ExtractIsodoseSurfaces(reslicedDoseVolumeImage, isoLevels, this->UseMultiLevelMarchingCubes, rawIsodoseSurfaces);
+  }
+
+  // Report progress
+  ++currentProgressStep;
+  progress = (double)(currentProgressStep) / (double)progressStepCount;
+  this->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
+
   // Create isodose surfaces
+  std::vector<std::string> isodoseModelNodeIDs(isoLevels.size());
   for (int i = 0; i < colorTableNode->GetNumberOfColors(); i++)
   {
     double val[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
     const char* strIsoLevel = colorTableNode->GetColorName(i);
-    double isoLevel = vtkVariant(strIsoLevel).ToDouble();
     colorTableNode->GetColor(i, val);
 
-    vtkSmartPointer<vtkImageMarchingCubes> marchingCubes = vtkSmartPointer<vtkImageMarchingCubes>::New();
-    marchingCubes->SetInputData(reslicedDoseVolumeImage);
-    marchingCubes->SetNumberOfContours(1); 
-    marchingCubes->SetValue(0, isoLevel);
-    marchingCubes->ComputeScalarsOff();
-    marchingCubes->ComputeGradientsOff();
-    marchingCubes->ComputeNormalsOff();
-    marchingCubes->Update();
-
-    vtkSmartPointer<vtkPolyData> isoPolyData= marchingCubes->GetOutput();
-    if (isoPolyData->GetNumberOfPoints() >= 1)
+    vtkPolyData* isoPolyData = rawIsodoseSurfaces[i];
+    bool emptyIsoSurface = (!isoPolyData || isoPolyData->GetNumberOfPoints() < 1);
+    // In progressive mode the node is created even if the preview is empty, because the refined surface may not be.
+    // When reusing nodes, there is a node for every level so that nodes only need to be added or removed if the
+    // set of levels changes
+    if (!emptyIsoSurface || progressive || reuseModelNodes)
     {
-      vtkSmartPointer<vtkTriangleFilter> triangleFilter = vtkSmartPointer<vtkTriangleFilter>::New();
-      triangleFilter->SetInputData(marchingCubes->GetOutput());
-      triangleFilter->Update();
-
-      vtkSmartPointer<vtkDecimatePro> decimate = vtkSmartPointer<vtkDecimatePro>::New();
-      decimate->SetInputData(triangleFilter->GetOutput());
-      decimate->SetTargetReduction(0.6);
-      decimate->SetFeatureAngle(60);
-      decimate->SplittingOff();
-      decimate->PreserveTopologyOn();
-      decimate->SetMaximumError(1);
-      decimate->Update();
-
-      vtkSmartPointer<vtkWindowedSincPolyDataFilter> smootherSinc = vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
-      smootherSinc->SetPassBand(0.1);
-      smootherSinc->SetInputData(decimate->GetOutput() );
-      smootherSinc->SetNumberOfIterations(2);
-      smootherSinc->FeatureEdgeSmoothingOff();
-      smootherSinc->BoundarySmoothingOff();
-      smootherSinc->Update();
-
-      vtkSmartPointer<vtkPolyDataNormals> normals = vtkSmartPointer<vtkPolyDataNormals>::New();
-      normals->SetInputData(smootherSinc->GetOutput());
-      normals->ComputePointNormalsOn();
-      normals->SetFeatureAngle(60);
-      normals->Update();
-
-      vtkSmartPointer<vtkTransform> inputIJKToRASTransform = vtkSmartPointer<vtkTransform>::New();
-      inputIJKToRASTransform->Identity();
-      inputIJKToRASTransform->SetMatrix(inputIJK2RASMatrix);
-
-      vtkSmartPointer<vtkTransformPolyDataFilter> transformPolyData = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
-      transformPolyData->SetInputData(normals->GetOutput());
-      transformPolyData->SetTransform(inputIJKToRASTransform);
-      transformPolyData->Update();
-  
-      vtkSmartPointer<vtkMRMLModelDisplayNode> displayNode = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
-      displayNode = vtkMRMLModelDisplayNode::SafeDownCast(scene->AddNode(displayNode));
-      displayNode->Visibility2DOn();  
-      displayNode->VisibilityOn(); 
-      displayNode->SetColor(val[0], val[1], val[2]);
-      displayNode->SetOpacity(val[3]);
-    
-      // Disable backface culling to make the back side of the model visible as well
-      displayNode->SetBackfaceCulling(0);
-
-      // Get dose unit name
-      std::string doseUnitName = shNode->GetAttributeFromItemAncestor(
-        doseShItemID, vtkSlicerRtCommon::DICOMRTIMPORT_DOSE_UNIT_NAME_ATTRIBUTE_NAME, vtkMRMLSubjectHierarchyConstants::GetDICOMLevelStudy());
+      vtkSmartPointer<vtkPolyData> isodoseSurface;
+      if (emptyIsoSurface)
+      {
+        isodoseSurface = vtkSmartPointer<vtkPolyData>::New();
+      }
+      else
+      {
+        isodoseSurface = vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfacePolyData(
+          isoPolyData, inputIJK2RASMatrix, !progressive );
+      }
 
-      vtkSmartPointer<vtkMRMLModelNode> isodoseModelNode = vtkSmartPointer<vtkMRMLModelNode>::New();
       std::string isodoseModelNodeName = vtkSlicerIsodoseModuleLogic::ISODOSE_MODEL_NODE_NAME_PREFIX + strIsoLevel + doseUnitName;
-      isodoseModelNode->SetName(isodoseModelNodeName.c_str());
-      isodoseModelNode->SetSelectable(1);
-      isodoseModelNode->SetAttribute(vtkSlicerRtCommon::DICOMRTIMPORT_ISODOSE_MODEL_IDENTIFIER_ATTRIBUTE_NAME.c_str(), "1"); // The attribute above distinguishes isodoses from regular models
-      scene->AddNode(isodoseModelNode);
-      isodoseModelNode->SetAndObserveDisplayNodeID(displayNode->GetID());
-      isodoseModelNode->SetAndObservePolyData(transformPolyData->GetOutput());
-      shNode->RequestOwnerPluginSearch(isodoseModelNode); //TODO: Why is this needed?
-
-      // Put the new node in the isodose folder
-      vtkIdType isodoseModelItemID = shNode->GetItemByDataNode(isodoseModelNode);
-      if (isodoseModelItemID) // There is no automatic SH creation in automatic tests 
+      vtkMRMLModelNode* isodoseModelNode = nullptr;
+      if (reusedIsodoseModelNodes[i])
+      {
+        // Only update properties and swap the surface of the existing node
+        isodoseModelNode = reusedIsodoseModelNodes[i];
+        int wasModifying = isodoseModelNode->StartModify();
+        isodoseModelNode->SetName(isodoseModelNodeName.c_str());
+        isodoseModelNode->SetAttribute(vtkSlicerIsodoseModuleLogic::ISODOSE_LEVEL_ATTRIBUTE_NAME.c_str(), strIsoLevel);
+        isodoseModelNode->SetAndObservePolyData(isodoseSurface);
+        isodoseModelNode->EndModify(wasModifying);
+
+        vtkMRMLModelDisplayNode* displayNode = vtkMRMLModelDisplayNode::SafeDownCast(isodoseModelNode->GetDisplayNode());
+        if (displayNode)
+        {
+          int wasModifyingDisplay = displayNode->StartModify();
+          displayNode->SetColor(val[0], val[1], val[2]);
+          displayNode->SetOpacity(val[3]);
+          displayNode->EndModify(wasModifyingDisplay);
+        }
+      }
+      else
       {
-        shNode->SetItemParent(isodoseModelItemID, isodoseFolderItemID);
+        vtkSmartPointer<vtkMRMLModelDisplayNode> displayNode = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
+        displayNode = vtkMRMLModelDisplayNode::SafeDownCast(scene->AddNode(displayNode));
+        displayNode->Visibility2DOn();  
+        displayNode->VisibilityOn(); 
+        displayNode->SetColor(val[0], val[1], val[2]);
+        displayNode->SetOpacity(val[3]);
+    
+        // Disable backface culling to make the back side of the model visible as well
+        displayNode->SetBackfaceCulling(0);
+
+        vtkSmartPointer<vtkMRMLModelNode> newIsodoseModelNode = vtkSmartPointer<vtkMRMLModelNode>::New();
+        newIsodoseModelNode->SetName(isodoseModelNodeName.c_str());
+        newIsodoseModelNode->SetSelectable(1);
+        newIsodoseModelNode->SetAttribute(vtkSlicerRtCommon::DICOMRTIMPORT_ISODOSE_MODEL_IDENTIFIER_ATTRIBUTE_NAME.c_str(), "1"); // The attribute above distinguishes isodoses from regular models
+        newIsodoseModelNode->SetAttribute(vtkSlicerIsodoseModuleLogic::ISODOSE_LEVEL_ATTRIBUTE_NAME.c_str(), strIsoLevel);
+        scene->AddNode(newIsodoseModelNode);
+        newIsodoseModelNode->SetAndObserveDisplayNodeID(displayNode->GetID());
+        newIsodoseModelNode->SetAndObservePolyData(isodoseSurface);
+        shNode->RequestOwnerPluginSearch(newIsodoseModelNode); //TODO: Why is this needed?
+        isodoseModelNode = newIsodoseModelNode;
+
+        // Put the new node in the isodose folder
+        vtkIdType isodoseModelItemID = shNode->GetItemByDataNode(isodoseModelNode);
+        if (isodoseModelItemID) // There is no automatic SH creation in automatic tests 
+        {
+          shNode->SetItemParent(isodoseModelItemID, isodoseFolderItemID);
+        }
       }
+      isodoseModelNodeIDs[i] = isodoseModelNode->GetID();
     }
 
     // Report progress
@@ -671,10 +820,264 @@ void vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfaces(vtkMRMLIsodoseNode* para
     this->InvokeEvent(vtkSlicerRtCommon::ProgressUpdated, (void*)&progress);
   } // For all isodose levels
 
+  // Remove existing nodes of levels that do not exist any more
+  for (std::vector<vtkMRMLModelNode*>::iterator nodeIt = obsoleteIsodoseModelNodes.begin(); nodeIt != obsoleteIsodoseModelNodes.end(); ++nodeIt)
+  {
+    vtkMRMLModelNode* isodoseModelNode = (*nodeIt);
+    if (isodoseModelNode->GetDisplayNode())
+    {
+      scene->RemoveNode(isodoseModelNode->GetDisplayNode());
+    }
+    scene->RemoveNode(isodoseModelNode);
+  }
+
   // Update dose color table based on isodose
   this->UpdateDoseColorTableFromIsodose(parameterNode);
 
+  if (batchProcessing)
+  {
+    scene->EndState(vtkMRMLScene::BatchProcessState);
+  }
+
+  // Start computing the full resolution surfaces in the background.
+  // Only VTK objects owned by the worker are accessed from the thread, the nodes are updated in ApplyIsodoseSurfaceRefinement
+  if (progressive)
+  {
+    vtkSmartPointer<vtkImageData> doseImage = vtkSmartPointer<vtkImageData>::New();
+    doseImage->ShallowCopy(reslicedDoseVolumeImage); // Detach from the reslice pipeline, scalars are only read
+    vtkSmartPointer<vtkMatrix4x4> ijkToRasMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    ijkToRasMatrix->DeepCopy(inputIJK2RASMatrix);
+    bool useMultiLevelMarchingCubes = this->UseMultiLevelMarchingCubes;
+    std::shared_ptr<vtkInternal::RefinementJob> job = std::make_shared<vtkInternal::RefinementJob>();
+    this->Internal->Refinement = job;
+    this->Internal->RefinementModelNodeIDs = isodoseModelNodeIDs;
+    this->Internal->RefinementKeepEmptyModelNodes = reuseModelNodes;
+    job->MultiLevelMarchingCubes = vtkSmartPointer<vtkMultiLevelMarchingCubes>::New();
+    this->Internal->RefinementThread = std::thread( [job, doseImage, isoLevels, ijkToRasMatrix, useMultiLevelMarchingCubes]()
+    {
+      std::vector<vtkSmartPointer<vtkPolyData> > refinedSurfaces(isoLevels.size());
+      if (useMultiLevelMarchingCubes)
+      {
+        // All levels are extracted in one pass, which is aborted through the marching cubes algorithm on cancel
+        std::vector<vtkSmartPointer<vtkPolyData> > rawSurfaces;
+        vtkSlicerIsodoseModuleLogic::ExtractIsodoseSurfaces(doseImage, isoLevels, true, rawSurfaces, job->MultiLevelMarchingCubes);
+        for (size_t levelIndex = 0; levelIndex < rawSurfaces.size() && !job->Cancelled; ++levelIndex)
+        {
+          if (rawSurfaces[levelIndex] && rawSurfaces[levelIndex]->GetNumberOfPoints() >= 1)
+          {
+            refinedSurfaces[levelIndex] = vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfacePolyData(rawSurfaces[levelIndex], ijkToRasMatrix, true);
+          }
+        }
+      }
+      else
+      {
+        // Extract and post-process level by level so that a cancelled job stops early
+        for (size_t levelIndex = 0; levelIndex < isoLevels.size() && !job->Cancelled; ++levelIndex)
+        {
+          std::vector<vtkSmartPointer<vtkPolyData> > rawSurfaces;
+          vtkSlicerIsodoseModuleLogic::ExtractIsodoseSurfaces(doseImage, std::vector<double>(1, isoLevels[levelIndex]), false, rawSurfaces);
+          if (rawSurfaces[0] && rawSurfaces[0]->GetNumberOfPoints() >= 1)
+          {
+            refinedSurfaces[levelIndex] = vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfacePolyData(rawSurfaces[0], ijkToRasMatrix, true);
+          }
+        }
+      }
+
+      std::lock_guard<std::mutex> lock(job->Mutex);
+      job->RefinedSurfaces.swap(refinedSurfaces);
+      job->Finished = true;
+      job->FinishedCondition.notify_all();
+    } );
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerIsodoseModuleLogic::ExtractIsodoseSurfaces(vtkImageData* doseImage, const std::vector<double>& isoLevels,
+  bool useMultiLevelMarchingCubes, std::vector<vtkSmartPointer<vtkPolyData> >& surfaces,
+  vtkMultiLevelMarchingCubes* multiLevelMarchingCubes/*=nullptr*/)
+{
+  surfaces.clear();
+  if (!doseImage)
+  {
+    return;
+  }
+
+  if (useMultiLevelMarchingCubes)
+  {
+    // Extract the surfaces of all levels in one pass
+    vtkSmartPointer<vtkMultiLevelMarchingCubes> marchingCubes = multiLevelMarchingCubes;
+    if (!marchingCubes)
+    {
+      marchingCubes = vtkSmartPointer<vtkMultiLevelMarchingCubes>::New();
+    }
+    marchingCubes->SetInputImage(doseImage);
+    for (size_t levelIndex = 0; levelIndex < isoLevels.size(); ++levelIndex)
+    {
+      marchingCubes->SetLevel(static_cast<int>(levelIndex), isoLevels[levelIndex]);
+    }
+    marchingCubes->Update();
+    for (size_t levelIndex = 0; levelIndex < isoLevels.size(); ++levelIndex)
+    {
+      surfaces.push_back(marchingCubes->GetOutput(static_cast<int>(levelIndex)));
+    }
+    return;
+  }
+
+  for (std::vector<double>::const_iterator levelIt = isoLevels.begin(); levelIt != isoLevels.end(); ++levelIt)
+  {
+    vtkSmartPointer<vtkImageMarchingCubes> marchingCubes = vtkSmartPointer<vtkImageMarchingCubes>::New();
+    marchingCubes->SetInputData(doseImage);
+    marchingCubes->SetNumberOfContours(1); 
+    marchingCubes->SetValue(0, (*levelIt));
+    marchingCubes->ComputeScalarsOff();
+    marchingCubes->ComputeGradientsOff();
+    marchingCubes->ComputeNormalsOff();
+    marchingCubes->Update();
+    surfaces.push_back(marchingCubes->GetOutput());
+  }
+}
+
+//---------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> vtkSlicerIsodoseModuleLogic::CreateIsodoseSurfacePolyData(
+  vtkPolyData* rawSurface, vtkMatrix4x4* ijkToRasMatrix, bool fullQuality)
+{
+  vtkSmartPointer<vtkTriangleFilter> triangleFilter = vtkSmartPointer<vtkTriangleFilter>::New();
+  triangleFilter->SetInputData(rawSurface);
+  triangleFilter->Update();
+  vtkSmartPointer<vtkPolyData> surface = triangleFilter->GetOutput();
+
+  // Decimation and smoothing are skipped for the quick preview
+  if (fullQuality)
+  {
+    vtkSmartPointer<vtkDecimatePro> decimate = vtkSmartPointer<vtkDecimatePro>::New();
+    decimate->SetInputData(surface);
+    decimate->SetTargetReduction(0.6);
+    decimate->SetFeatureAngle(60);
+    decimate->SplittingOff();
+    decimate->PreserveTopologyOn();
+    decimate->SetMaximumError(1);
+    decimate->Update();
+
+    vtkSmartPointer<vtkWindowedSincPolyDataFilter> smootherSinc = vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
+    smootherSinc->SetPassBand(0.1);
+    smootherSinc->SetInputData(decimate->GetOutput() );
+    smootherSinc->SetNumberOfIterations(2);
+    smootherSinc->FeatureEdgeSmoothingOff();
+    smootherSinc->BoundarySmoothingOff();
+    smootherSinc->Update();
+    surface = smootherSinc->GetOutput();
+  }
+
+  vtkSmartPointer<vtkPolyDataNormals> normals = vtkSmartPointer<vtkPolyDataNormals>::New();
+  normals->SetInputData(surface);
+  normals->ComputePointNormalsOn();
+  normals->SetFeatureAngle(60);
+  normals->Update();
+
+  vtkSmartPointer<vtkTransform> inputIJKToRASTransform = vtkSmartPointer<vtkTransform>::New();
+  inputIJKToRASTransform->Identity();
+  inputIJKToRASTransform->SetMatrix(ijkToRasMatrix);
+
+  vtkSmartPointer<vtkTransformPolyDataFilter> transformPolyData = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
+  transformPolyData->SetInputData(normals->GetOutput());
+  transformPolyData->SetTransform(inputIJKToRASTransform);
+  transformPolyData->Update();
+
+  return transformPolyData->GetOutput();
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerIsodoseModuleLogic::IsIsodoseSurfaceRefinementPending()
+{
+  return this->Internal->Refinement != nullptr;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerIsodoseModuleLogic::ApplyIsodoseSurfaceRefinement(bool wait/*=false*/)
+{
+  std::shared_ptr<vtkInternal::RefinementJob> job = this->Internal->Refinement;
+  if (!job)
+  {
+    return false;
+  }
+  std::vector<vtkSmartPointer<vtkPolyData> > refinedSurfaces;
+  {
+    std::unique_lock<std::mutex> lock(job->Mutex);
+    if (wait)
+    {
+      job->FinishedCondition.wait(lock, [&job]() { return job->Finished; });
+    }
+    else if (!job->Finished)
+    {
+      return false;
+    }
+    refinedSurfaces.swap(job->RefinedSurfaces);
+  }
+  // The thread returns right after setting the finished flag
+  if (this->Internal->RefinementThread.joinable())
+  {
+    this->Internal->RefinementThread.join();
+  }
+  this->Internal->Refinement = nullptr;
+
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+  {
+    vtkErrorMacro("ApplyIsodoseSurfaceRefinement: Invalid MRML scene");
+    return false;
+  }
+
+  scene->StartState(vtkMRMLScene::BatchProcessState);
+  std::vector<std::string>& modelNodeIDs = this->Internal->RefinementModelNodeIDs;
+  for (size_t levelIndex = 0; levelIndex < modelNodeIDs.size() && levelIndex < refinedSurfaces.size(); ++levelIndex)
+  {
+    vtkMRMLModelNode* isodoseModelNode = vtkMRMLModelNode::SafeDownCast(scene->GetNodeByID(modelNodeIDs[levelIndex]));
+    if (!isodoseModelNode)
+    {
+      continue; // Node has been removed since the preview was created
+    }
+    if (refinedSurfaces[levelIndex])
+    {
+      isodoseModelNode->SetAndObservePolyData(refinedSurfaces[levelIndex]);
+    }
+    else if (this->Internal->RefinementKeepEmptyModelNodes)
+    {
+      isodoseModelNode->SetAndObservePolyData(vtkSmartPointer<vtkPolyData>::New());
+    }
+    else
+    {
+      // Level is not present in the dose at full resolution
+      if (isodoseModelNode->GetDisplayNode())
+      {
+        scene->RemoveNode(isodoseModelNode->GetDisplayNode());
+      }
+      scene->RemoveNode(isodoseModelNode);
+    }
+  }
+  modelNodeIDs.clear();
   scene->EndState(vtkMRMLScene::BatchProcessState);
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerIsodoseModuleLogic::CancelIsodoseSurfaceRefinement()
+{
+  if (this->Internal->Refinement)
+  {
+    this->Internal->Refinement->Cancelled = true;
+    if (this->Internal->Refinement->MultiLevelMarchingCubes)
+    {
+      this->Internal->Refinement->MultiLevelMarchingCubes->SetAbortExecute(true);
+    }
+  }
+  // Make sure the thread does not outlive the logic or keep running after the scene is closed
+  if (this->Internal->RefinementThread.joinable())
+  {
+    this->Internal->RefinementThread.join();
+  }
+  this->Internal->Refinement = nullptr;
+  this->Internal->RefinementModelNodeIDs.clear();
 }
 
 //---------------------------------------------------------------------------
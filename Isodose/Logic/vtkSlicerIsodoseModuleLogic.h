@@ -33,6 +33,19 @@
 
 #include "vtkSlicerIsodoseModuleLogicExport.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkPolyData;
+
+// SlicerRt includes
+class vtkMultiLevelMarchingCubes;
+
 // MRML includes
 class vtkMRMLColorTableNode;
 class vtkMRMLIsodoseNode;
@@ -45,6 +58,7 @@ class VTK_SLICER_ISODOSE_LOGIC_EXPORT vtkSlicerIsodoseModuleLogic : public vtkSl
 public:
   // Isodose constants
   static const std::string ISODOSE_MODEL_NODE_NAME_PREFIX;
+  static const std::string ISODOSE_LEVEL_ATTRIBUTE_NAME;
   static const std::string ISODOSE_PARAMETER_SET_BASE_NAME_PREFIX;
   static const std::string ISODOSE_ROOT_HIERARCHY_NAME_POSTFIX;
   static const std::string ISODOSE_COLOR_TABLE_NODE_NAME_POSTFIX;
@@ -58,7 +72,27 @@ public:
   void SetNumberOfIsodoseLevels(vtkMRMLIsodoseNode* parameterNode, int newNumberOfColors);
 
   /// Accumulates dose volumes with the given IDs and corresponding weights
-  void CreateIsodoseSurfaces(vtkMRMLIsodoseNode* parameterNode);
+  /// \param progressive If true, coarse surfaces are created immediately from a downsampled dose volume, and the
+  ///   full resolution ones are computed in a background thread, to be applied by \sa ApplyIsodoseSurfaceRefinement.
+  ///   False by default
+  /// \param reuseModelNodes If true, the existing isodose model nodes of the dose volume are kept, and only their
+  ///   poly data and properties are updated. Nodes are matched to the levels by level value. There is a model node for
+  ///   every level in this mode (with empty surface if the level is not present), so that nodes are only added or
+  ///   removed when the set of levels changes. False by default
+  void CreateIsodoseSurfaces(vtkMRMLIsodoseNode* parameterNode, bool progressive=false, bool reuseModelNodes=false);
+
+  /// Replace the coarse isodose surfaces of the last progressive \sa CreateIsodoseSurfaces call with the
+  /// full resolution ones. Needs to be called from the main thread (e.g. periodically from a timer)
+  /// \param wait Wait for the background computation to finish if it is still running
+  /// \return True if the refined surfaces were applied, false if there is no finished refinement
+  bool ApplyIsodoseSurfaceRefinement(bool wait=false);
+
+  /// Determine whether there is a background refinement whose result has not been applied yet
+  bool IsIsodoseSurfaceRefinementPending();
+
+  /// Discard the result of the background refinement. A refinement that is still running is interrupted,
+  /// and the call returns when the background thread has finished
+  void CancelIsodoseSurfaceRefinement();
 
   /// Get isodose folder for a dose volume
   /// \param node Dose volume node or isodose parameter node referencing the dose volume
@@ -79,11 +113,32 @@ public:
   /// Gets and returns if already exists
   static vtkMRMLColorTableNode* CreateDefaultDoseColorTable(vtkMRMLScene *scene);
 
+public:
+  vtkGetMacro(UseMultiLevelMarchingCubes, bool);
+  vtkSetMacro(UseMultiLevelMarchingCubes, bool);
+  vtkBooleanMacro(UseMultiLevelMarchingCubes, bool);
+
+  vtkGetMacro(ProgressivePreviewShrinkFactor, int);
+  vtkSetMacro(ProgressivePreviewShrinkFactor, int);
+
 protected:
   /// Loads default isodose color table from the supplied color table file
   /// \return The loaded color table node if loading succeeded, nullptr otherwise
   vtkMRMLColorTableNode* LoadDefaultIsodoseColorTable();
 
+  /// Run marching cubes on the resliced dose image for each isodose level.
+  /// Does not access MRML, so it can be called from a background thread
+  /// \param multiLevelMarchingCubes Algorithm used if useMultiLevelMarchingCubes is on. Allows the caller to abort
+  ///   the extraction from another thread. A new one is created if nullptr
+  static void ExtractIsodoseSurfaces(vtkImageData* doseImage, const std::vector<double>& isoLevels,
+    bool useMultiLevelMarchingCubes, std::vector<vtkSmartPointer<vtkPolyData> >& surfaces,
+    vtkMultiLevelMarchingCubes* multiLevelMarchingCubes=nullptr);
+
+  /// Create displayable isodose surface in RAS from the raw marching cubes output.
+  /// Does not access MRML, so it can be called from a background thread
+  /// \param fullQuality Decimate and smooth the surface if true. Skipped for quick previews
+  static vtkSmartPointer<vtkPolyData> CreateIsodoseSurfacePolyData(vtkPolyData* rawSurface, vtkMatrix4x4* ijkToRasMatrix, bool fullQuality);
+
 protected:
   void SetMRMLSceneInternal(vtkMRMLScene* newScene) override;
 
@@ -101,6 +156,19 @@ protected:
 private:
   vtkSlicerIsodoseModuleLogic(const vtkSlicerIsodoseModuleLogic&) = delete;
   void operator=(const vtkSlicerIsodoseModuleLogic&) = delete;
+
+protected:
+  /// Flag determining whether the surfaces of all isodose levels are extracted in one multithreaded pass
+  /// over the dose volume (\sa vtkMultiLevelMarchingCubes) instead of running marching cubes for each level.
+  /// True by default
+  bool UseMultiLevelMarchingCubes;
+
+  /// Downsampling factor of the dose volume for the coarse preview in progressive mode. 4 by default
+  int ProgressivePreviewShrinkFactor;
+
+private:
+  class vtkInternal;
+  vtkInternal* Internal;
 };
 
 #endif
@@ -22,6 +22,7 @@
 // Qt includes
 #include <QCheckBox>
 #include <QDebug>
+#include <QTimer>
 
 // SlicerQt includes
 #include "qSlicerIsodoseModuleWidget.h"
@@ -84,6 +85,9 @@ public:
   vtkSlicerRTScalarBarActor* ScalarBarActor2DGreen;
 
   std::vector<vtkScalarBarWidget*> ScalarBarWidgets;
+
+  /// Timer polling the logic for the full resolution isodose surfaces computed in the background
+  QTimer RefinementTimer;
 };
 
 //-----------------------------------------------------------------------------
@@ -337,6 +341,9 @@ void qSlicerIsodoseModuleWidget::setup()
 
   connect( d->pushButton_Apply, SIGNAL(clicked()), this, SLOT(applyClicked()) );
 
+  d->RefinementTimer.setInterval(50);
+  connect( &d->RefinementTimer, SIGNAL(timeout()), this, SLOT(applyIsodoseSurfaceRefinement()) );
+
   d->pushButton_Apply->setMinimumSize(d->pushButton_Apply->sizeHint().width() + 8, d->pushButton_Apply->sizeHint().height() + 4);
 
   qSlicerApplication * app = qSlicerApplication::application();
@@ -732,12 +739,35 @@ void qSlicerIsodoseModuleWidget::applyClicked()
 
   QApplication::setOverrideCursor(QCursor(Qt::BusyCursor));
 
-  // Compute the isodose surface for the selected dose volume
-  d->logic()->CreateIsodoseSurfaces(paramNode);
+  // Compute the isodose surface for the selected dose volume.
+  // Show a coarse preview first, and swap in the full resolution surfaces when they are computed in the background.
+  // Existing isodose model nodes are reused so that the views do not need to be rebuilt when regenerating
+  d->RefinementTimer.stop();
+  d->logic()->CreateIsodoseSurfaces(paramNode, true, true);
+  if (d->logic()->IsIsodoseSurfaceRefinementPending())
+  {
+    d->RefinementTimer.start();
+  }
 
   QApplication::restoreOverrideCursor();
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerIsodoseModuleWidget::applyIsodoseSurfaceRefinement()
+{
+  Q_D(qSlicerIsodoseModuleWidget);
+
+  if (!d->logic()->IsIsodoseSurfaceRefinementPending())
+  {
+    d->RefinementTimer.stop();
+    return;
+  }
+  if (d->logic()->ApplyIsodoseSurfaceRefinement())
+  {
+    d->RefinementTimer.stop();
+  }
+}
+
 //-----------------------------------------------------------------------------
 void qSlicerIsodoseModuleWidget::updateButtonsState()
 {
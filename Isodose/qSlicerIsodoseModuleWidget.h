@@ -91,6 +91,9 @@ protected slots:
   /// Slot handling clicking the Apply button
   void applyClicked();
 
+  /// Slot replacing the isodose surface previews with the full resolution ones when they are ready
+  void applyIsodoseSurfaceRefinement();
+
   /// Slot called on change in logic
   void onLogicModified();
 
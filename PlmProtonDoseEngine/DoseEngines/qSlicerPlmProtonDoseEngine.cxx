@@ -211,9 +211,26 @@ QString qSlicerPlmProtonDoseEngine::calculateDoseUsingEngine(vtkMRMLRTBeamNode*
     return errorMessage;
   }
 
-  // Convert reference volume to Plastimatch image
-  //TODO: Cache it so that it does not need to be reconverted every time
-  Plm_image::Pointer referenceVolumePlm = PlmCommon::ConvertVolumeNodeToPlmImage(referenceVolumeNode);
+  // Convert reference volume to Plastimatch image. The converted image is cached so that it is not reconverted
+  // in subsequent calculations (e.g. when only the prescription or the beam weight changes)
+  QString referenceVolumeCacheKey = qSlicerAbstractDoseEngine::intermediateResultCacheKey(
+    QList<vtkObject*>() << referenceVolumeNode << referenceVolumeNode->GetImageData() );
+  std::shared_ptr<Plm_image::Pointer> cachedReferenceVolumePlm =
+    this->cachedIntermediateResult<Plm_image::Pointer>("ReferenceVolumePlm", referenceVolumeCacheKey);
+  if (!cachedReferenceVolumePlm)
+  {
+    Plm_image::Pointer convertedReferenceVolumePlm = PlmCommon::ConvertVolumeNodeToPlmImage(referenceVolumeNode);
+    if (!convertedReferenceVolumePlm || !convertedReferenceVolumePlm->have_image())
+    {
+      QString errorMessage("Failed to convert reference volume");
+      qCritical() << Q_FUNC_INFO << ": " << errorMessage;
+      return errorMessage;
+    }
+    cachedReferenceVolumePlm = std::make_shared<Plm_image::Pointer>(convertedReferenceVolumePlm);
+    this->cacheIntermediateResult<Plm_image::Pointer>("ReferenceVolumePlm", referenceVolumeCacheKey,
+      cachedReferenceVolumePlm, referenceVolumeNode->GetImageData()->GetActualMemorySize() * 1024ULL);
+  }
+  Plm_image::Pointer referenceVolumePlm = *cachedReferenceVolumePlm;
   referenceVolumePlm->print();
   // Create ITK output dose volume based on the reference volume
   itk::Image<short, 3>::Pointer referenceVolumeItk = referenceVolumePlm->itk_short();
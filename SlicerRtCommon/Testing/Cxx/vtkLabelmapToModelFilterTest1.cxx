@@ -0,0 +1,153 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SlicerRtCommon includes
+#include "vtkLabelmapToModelFilter.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMassProperties.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  const int LABELMAP_SIZE = 12;
+
+  //----------------------------------------------------------------------------
+  /// Create the undecimated surface of the labelmap with flying edges or with marching cubes
+  bool CreateSurface(vtkImageData* labelmap, bool useFlyingEdges, vtkPolyData* surface)
+  {
+    vtkSmartPointer<vtkLabelmapToModelFilter> labelmapToModel = vtkSmartPointer<vtkLabelmapToModelFilter>::New();
+    labelmapToModel->SetInputLabelmap(labelmap);
+    labelmapToModel->SetUseFlyingEdges(useFlyingEdges);
+    labelmapToModel->SetDecimationMethodToNone();
+    labelmapToModel->Update();
+    surface->DeepCopy(labelmapToModel->GetOutput());
+    return surface->GetNumberOfPolys() > 0;
+  }
+
+  //----------------------------------------------------------------------------
+  bool AreEqualWithTolerance(double a, double b)
+  {
+    return std::fabs(a - b) <= 1e-6 * std::max(1.0, std::fabs(b));
+  }
+
+  //----------------------------------------------------------------------------
+  /// Check that flying edges on the occupied extent creates the same surface as marching cubes on the full extent
+  bool AreFlyingEdgesAndMarchingCubesSurfacesEqual(vtkImageData* labelmap)
+  {
+    vtkNew<vtkPolyData> flyingEdgesSurface;
+    vtkNew<vtkPolyData> marchingCubesSurface;
+    if (!CreateSurface(labelmap, true, flyingEdgesSurface) || !CreateSurface(labelmap, false, marchingCubesSurface))
+    {
+      std::cerr << "Failed to create surface" << std::endl;
+      return false;
+    }
+    if (flyingEdgesSurface->GetNumberOfPolys() != marchingCubesSurface->GetNumberOfPolys())
+    {
+      std::cerr << "Number of triangles with flying edges " << flyingEdgesSurface->GetNumberOfPolys()
+        << " does not match the number with marching cubes " << marchingCubesSurface->GetNumberOfPolys() << std::endl;
+      return false;
+    }
+
+    double flyingEdgesBounds[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    double marchingCubesBounds[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    flyingEdgesSurface->GetBounds(flyingEdgesBounds);
+    marchingCubesSurface->GetBounds(marchingCubesBounds);
+    for (int i = 0; i < 6; ++i)
+    {
+      if (!AreEqualWithTolerance(flyingEdgesBounds[i], marchingCubesBounds[i]))
+      {
+        std::cerr << "Surface bounds with flying edges do not match the bounds with marching cubes" << std::endl;
+        return false;
+      }
+    }
+
+    vtkNew<vtkMassProperties> flyingEdgesProperties;
+    flyingEdgesProperties->SetInputData(flyingEdgesSurface);
+    flyingEdgesProperties->Update();
+    vtkNew<vtkMassProperties> marchingCubesProperties;
+    marchingCubesProperties->SetInputData(marchingCubesSurface);
+    marchingCubesProperties->Update();
+    if ( !AreEqualWithTolerance(flyingEdgesProperties->GetSurfaceArea(), marchingCubesProperties->GetSurfaceArea())
+      || !AreEqualWithTolerance(flyingEdgesProperties->GetVolume(), marchingCubesProperties->GetVolume()) )
+    {
+      std::cerr << "Surface area " << flyingEdgesProperties->GetSurfaceArea() << " and volume " << flyingEdgesProperties->GetVolume()
+        << " with flying edges do not match surface area " << marchingCubesProperties->GetSurfaceArea() << " and volume "
+        << marchingCubesProperties->GetVolume() << " with marching cubes" << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkLabelmapToModelFilterTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkImageData> labelmap;
+  labelmap->SetExtent(0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1, 0, LABELMAP_SIZE - 1);
+  labelmap->SetOrigin(-10.0, 20.0, 5.0);
+  labelmap->SetSpacing(1.0, 1.0, 1.5);
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  unsigned char* voxels = static_cast<unsigned char*>(labelmap->GetScalarPointer());
+
+  // Ball inside the labelmap, the surface is closed
+  for (int k = 0; k < LABELMAP_SIZE; ++k)
+  {
+    for (int j = 0; j < LABELMAP_SIZE; ++j)
+    {
+      for (int i = 0; i < LABELMAP_SIZE; ++i)
+      {
+        bool inside = ((i - 5) * (i - 5) + (j - 6) * (j - 6) + (k - 5) * (k - 5) <= 16);
+        voxels[(k * LABELMAP_SIZE + j) * LABELMAP_SIZE + i] = (inside ? 1 : 0);
+      }
+    }
+  }
+  if (!AreFlyingEdgesAndMarchingCubesSurfacesEqual(labelmap))
+  {
+    std::cerr << __LINE__ << ": Surfaces of structure inside the labelmap do not match" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Box touching the border of the labelmap on three sides, where the padding is clipped to the input extent
+  for (int k = 0; k < LABELMAP_SIZE; ++k)
+  {
+    for (int j = 0; j < LABELMAP_SIZE; ++j)
+    {
+      for (int i = 0; i < LABELMAP_SIZE; ++i)
+      {
+        bool inside = (i <= 4 && j >= 3 && j <= 8);
+        voxels[(k * LABELMAP_SIZE + j) * LABELMAP_SIZE + i] = (inside ? 1 : 0);
+      }
+    }
+  }
+  labelmap->Modified();
+  if (!AreFlyingEdgesAndMarchingCubesSurfacesEqual(labelmap))
+  {
+    std::cerr << __LINE__ << ": Surfaces of structure touching the border of the labelmap do not match" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Labelmap to model filter test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
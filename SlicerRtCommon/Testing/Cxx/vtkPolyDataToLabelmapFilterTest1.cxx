@@ -0,0 +1,132 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SlicerRtCommon includes
+#include "vtkPolyDataToLabelmapFilter.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Rasterize the surface on the reference image grid with the stencil pipeline or with scanline rasterization
+  void CreateLabelmap(vtkPolyData* surface, vtkImageData* referenceImage, bool useScanlineRasterization, vtkImageData* labelmap)
+  {
+    vtkSmartPointer<vtkPolyDataToLabelmapFilter> polyDataToLabelmap = vtkSmartPointer<vtkPolyDataToLabelmapFilter>::New();
+    polyDataToLabelmap->SetInputPolyData(surface);
+    polyDataToLabelmap->SetReferenceImage(referenceImage);
+    polyDataToLabelmap->SetUseReferenceValues(false);
+    polyDataToLabelmap->SetUseScanlineRasterization(useScanlineRasterization);
+    polyDataToLabelmap->SetLabelValue(1);
+    polyDataToLabelmap->SetBackgroundValue(0.0);
+    polyDataToLabelmap->Update();
+    labelmap->DeepCopy(polyDataToLabelmap->GetOutput());
+  }
+
+  //----------------------------------------------------------------------------
+  /// Get label of a voxel, background if the voxel is outside the labelmap
+  int GetLabel(vtkImageData* labelmap, int i, int j, int k)
+  {
+    int extent[6] = { 0, -1, 0, -1, 0, -1 };
+    labelmap->GetExtent(extent);
+    if (i < extent[0] || i > extent[1] || j < extent[2] || j > extent[3] || k < extent[4] || k > extent[5])
+    {
+      return 0;
+    }
+    return static_cast<int>(labelmap->GetScalarComponentAsDouble(i, j, k, 0));
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkPolyDataToLabelmapFilterTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // Sphere not aligned with the voxel grid, inside the reference image
+  vtkNew<vtkSphereSource> sphereSource;
+  sphereSource->SetCenter(10.2, 10.3, 10.4);
+  sphereSource->SetRadius(6.3);
+  sphereSource->SetThetaResolution(64);
+  sphereSource->SetPhiResolution(64);
+  sphereSource->Update();
+
+  vtkNew<vtkImageData> referenceImage;
+  referenceImage->SetExtent(0, 20, 0, 20, 0, 20);
+  referenceImage->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+
+  vtkNew<vtkImageData> stencilLabelmap;
+  CreateLabelmap(sphereSource->GetOutput(), referenceImage, false, stencilLabelmap);
+  vtkNew<vtkImageData> scanlineLabelmap;
+  CreateLabelmap(sphereSource->GetOutput(), referenceImage, true, scanlineLabelmap);
+
+  // Both labelmaps are on the grid of the reference image. The scanline labelmap is cropped to the bounds of the sphere
+  double stencilOrigin[3] = { 0.0, 0.0, 0.0 };
+  double scanlineOrigin[3] = { 0.0, 0.0, 0.0 };
+  stencilLabelmap->GetOrigin(stencilOrigin);
+  scanlineLabelmap->GetOrigin(scanlineOrigin);
+  if (stencilOrigin[0] != 0.0 || stencilOrigin[1] != 0.0 || stencilOrigin[2] != 0.0
+    || scanlineOrigin[0] != 0.0 || scanlineOrigin[1] != 0.0 || scanlineOrigin[2] != 0.0)
+  {
+    std::cerr << __LINE__ << ": Labelmaps are not on the reference image grid" << std::endl;
+    return EXIT_FAILURE;
+  }
+  int scanlineExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  scanlineLabelmap->GetExtent(scanlineExtent);
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    // Sphere is between 3.9 and 16.7 mm along all axes
+    if (scanlineExtent[2*axis] < 3 || scanlineExtent[2*axis+1] > 17)
+    {
+      std::cerr << __LINE__ << ": Scanline labelmap extent (" << scanlineExtent[0] << ", " << scanlineExtent[1] << ", " << scanlineExtent[2] << ", "
+        << scanlineExtent[3] << ", " << scanlineExtent[4] << ", " << scanlineExtent[5] << ") is not cropped to the bounds of the sphere" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Labels may only differ in voxels that are on the surface, where the two rasterizations round differently
+  int stencilExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  stencilLabelmap->GetExtent(stencilExtent);
+  int numberOfStencilVoxels = 0;
+  int numberOfScanlineVoxels = 0;
+  int numberOfDifferentVoxels = 0;
+  for (int k = stencilExtent[4]; k <= stencilExtent[5]; ++k)
+  {
+    for (int j = stencilExtent[2]; j <= stencilExtent[3]; ++j)
+    {
+      for (int i = stencilExtent[0]; i <= stencilExtent[1]; ++i)
+      {
+        int stencilLabel = GetLabel(stencilLabelmap, i, j, k);
+        int scanlineLabel = GetLabel(scanlineLabelmap, i, j, k);
+        numberOfStencilVoxels += (stencilLabel == 1 ? 1 : 0);
+        numberOfScanlineVoxels += (scanlineLabel == 1 ? 1 : 0);
+        numberOfDifferentVoxels += (stencilLabel != scanlineLabel ? 1 : 0);
+      }
+    }
+  }
+  if (numberOfStencilVoxels == 0 || numberOfDifferentVoxels > numberOfStencilVoxels / 100)
+  {
+    std::cerr << __LINE__ << ": Scanline labelmap with " << numberOfScanlineVoxels << " foreground voxels differs from the stencil labelmap with "
+      << numberOfStencilVoxels << " foreground voxels in " << numberOfDifferentVoxels << " voxels" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Poly data to labelmap filter test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
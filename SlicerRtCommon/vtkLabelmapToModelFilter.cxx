@@ -28,6 +28,63 @@
 #include <vtkMarchingCubes.h>
 #include <vtkDecimatePro.h>
 #include <vtkVersion.h>
+#include <vtkExtractVOI.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkQuadricClustering.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Get the extent of the voxels with at least the given value
+  /// \return False if there are no such voxels
+  template<class T>
+  bool GetOccupiedExtent(vtkImageData* image, T* vtkNotUsed(scalarTypePtr), double threshold, int occupiedExtent[6])
+  {
+    int extent[6] = {0,-1,0,-1,0,-1};
+    image->GetExtent(extent);
+    vtkIdType increments[3] = {0,0,0};
+    image->GetIncrements(increments);
+    T* scalarPtr = static_cast<T*>(image->GetScalarPointerForExtent(extent));
+    occupiedExtent[0] = occupiedExtent[2] = occupiedExtent[4] = VTK_INT_MAX;
+    occupiedExtent[1] = occupiedExtent[3] = occupiedExtent[5] = VTK_INT_MIN;
+    for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+      for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+        T* rowPtr = scalarPtr + (k - extent[4]) * increments[2] + (j - extent[2]) * increments[1];
+        int firstI = -1;
+        int lastI = -1;
+        for (int i = extent[0]; i <= extent[1]; ++i)
+        {
+          if (static_cast<double>(rowPtr[(i - extent[0]) * increments[0]]) >= threshold)
+          {
+            if (firstI < 0)
+            {
+              firstI = i;
+            }
+            lastI = i;
+          }
+        }
+        if (firstI < 0)
+        {
+          continue;
+        }
+        occupiedExtent[0] = std::min(occupiedExtent[0], firstI);
+        occupiedExtent[1] = std::max(occupiedExtent[1], lastI);
+        occupiedExtent[2] = std::min(occupiedExtent[2], j);
+        occupiedExtent[3] = std::max(occupiedExtent[3], j);
+        occupiedExtent[4] = std::min(occupiedExtent[4], k);
+        occupiedExtent[5] = std::max(occupiedExtent[5], k);
+      }
+    }
+    return occupiedExtent[0] <= occupiedExtent[1];
+  }
+}
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkLabelmapToModelFilter);
@@ -45,6 +102,8 @@ vtkLabelmapToModelFilter::vtkLabelmapToModelFilter()
 
   this->SetDecimateTargetReduction(0.0);
   this->SetLabelValue(1.0);
+  this->UseFlyingEdges = false;
+  this->DecimationMethod = DecimationPro;
 }
 
 //----------------------------------------------------------------------------
@@ -58,6 +117,8 @@ vtkLabelmapToModelFilter::~vtkLabelmapToModelFilter()
 void vtkLabelmapToModelFilter::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "UseFlyingEdges: " << (this->UseFlyingEdges ? "true" : "false") << "\n";
+  os << indent << "DecimationMethod: " << this->DecimationMethod << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -75,32 +136,113 @@ void vtkLabelmapToModelFilter::Update()
     return;
   }
 
-  // Run marching cubes
-  vtkSmartPointer<vtkMarchingCubes> marchingCubes = vtkSmartPointer<vtkMarchingCubes>::New();
-  marchingCubes->SetInputData(this->InputLabelmap);
-  marchingCubes->SetNumberOfContours(1);
-  marchingCubes->SetValue(0, this->LabelValue/2.0);
-  marchingCubes->ComputeScalarsOff();
-  marchingCubes->ComputeGradientsOff();
-  marchingCubes->ComputeNormalsOff();
-  try
+  vtkSmartPointer<vtkPolyData> surface;
+  if (this->UseFlyingEdges)
   {
-    marchingCubes->Update();
+    // Only process the occupied extent of the labelmap, padded by one voxel within the input extent so that the
+    // surface is the same as the one created by marching cubes on the full extent. Like with marching cubes,
+    // the surface is open where the structure touches the border of the labelmap
+    int occupiedExtent[6] = {0,-1,0,-1,0,-1};
+    bool occupied = false;
+    switch (this->InputLabelmap->GetScalarType())
+    {
+      vtkTemplateMacro( occupied = GetOccupiedExtent( this->InputLabelmap, static_cast<VTK_TT*>(nullptr),
+        this->LabelValue/2.0, occupiedExtent ) );
+      default:
+        vtkErrorMacro("Update: Unsupported input scalar type " << this->InputLabelmap->GetScalarTypeAsString());
+        return;
+    }
+    if (!occupied)
+    {
+      vtkErrorMacro("No polygons can be created!");
+      return;
+    }
+    int inputExtent[6] = {0,-1,0,-1,0,-1};
+    this->InputLabelmap->GetExtent(inputExtent);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      occupiedExtent[2*axis] = std::max(occupiedExtent[2*axis] - 1, inputExtent[2*axis]);
+      occupiedExtent[2*axis+1] = std::min(occupiedExtent[2*axis+1] + 1, inputExtent[2*axis+1]);
+    }
+
+    vtkSmartPointer<vtkExtractVOI> extractVoi = vtkSmartPointer<vtkExtractVOI>::New();
+    extractVoi->SetInputData(this->InputLabelmap);
+    extractVoi->SetVOI(occupiedExtent);
+    vtkSmartPointer<vtkFlyingEdges3D> flyingEdges = vtkSmartPointer<vtkFlyingEdges3D>::New();
+    flyingEdges->SetInputConnection(extractVoi->GetOutputPort());
+    flyingEdges->SetNumberOfContours(1);
+    flyingEdges->SetValue(0, this->LabelValue/2.0);
+    flyingEdges->ComputeScalarsOff();
+    flyingEdges->ComputeGradientsOff();
+    flyingEdges->ComputeNormalsOff();
+    try
+    {
+      flyingEdges->Update();
+    }
+    catch(...)
+    {
+      vtkErrorMacro("Error while running flying edges!");
+      return;
+    }
+    surface = flyingEdges->GetOutput();
   }
-  catch(...)
+  else
   {
-    vtkErrorMacro("Error while running marching cubes!");
-    return;
+    // Run marching cubes
+    vtkSmartPointer<vtkMarchingCubes> marchingCubes = vtkSmartPointer<vtkMarchingCubes>::New();
+    marchingCubes->SetInputData(this->InputLabelmap);
+    marchingCubes->SetNumberOfContours(1);
+    marchingCubes->SetValue(0, this->LabelValue/2.0);
+    marchingCubes->ComputeScalarsOff();
+    marchingCubes->ComputeGradientsOff();
+    marchingCubes->ComputeNormalsOff();
+    try
+    {
+      marchingCubes->Update();
+    }
+    catch(...)
+    {
+      vtkErrorMacro("Error while running marching cubes!");
+      return;
+    }
+    surface = marchingCubes->GetOutput();
   }
-  if (marchingCubes->GetOutput()->GetNumberOfPolys() == 0)
+  if (surface->GetNumberOfPolys() == 0)
   {
     vtkErrorMacro("No polygons can be created!");
     return;
   }
 
   // Decimate
+  if (this->DecimationMethod == DecimationNone)
+  {
+    this->OutputModel->ShallowCopy(surface);
+    return;
+  }
+  else if (this->DecimationMethod == DecimationQuadricClustering)
+  {
+    // Number of clusters is set so that the number of triangles is reduced approximately by the target reduction
+    double bounds[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    surface->GetBounds(bounds);
+    double spacing[3] = {1.0, 1.0, 1.0};
+    this->InputLabelmap->GetSpacing(spacing);
+    double divisionScale = sqrt(std::max(1.0 - this->DecimateTargetReduction, 0.01));
+    int divisions[3] = {1, 1, 1};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      divisions[axis] = std::max(2, static_cast<int>(divisionScale * (bounds[2*axis+1] - bounds[2*axis]) / fabs(spacing[axis]) + 0.5));
+    }
+    vtkSmartPointer<vtkQuadricClustering> clustering = vtkSmartPointer<vtkQuadricClustering>::New();
+    clustering->SetInputData(surface);
+    clustering->AutoAdjustNumberOfDivisionsOff();
+    clustering->SetNumberOfDivisions(divisions);
+    clustering->Update();
+    this->OutputModel->ShallowCopy(clustering->GetOutput());
+    return;
+  }
+
   vtkSmartPointer<vtkDecimatePro> decimator = vtkSmartPointer<vtkDecimatePro>::New();
-  decimator->SetInputData(marchingCubes->GetOutput() );
+  decimator->SetInputData(surface);
   decimator->SetFeatureAngle(60);
   decimator->SplittingOff();
   decimator->PreserveTopologyOn();
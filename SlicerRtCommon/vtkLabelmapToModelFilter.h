@@ -55,6 +55,26 @@ public:
   vtkGetMacro(LabelValue, double);
   vtkSetMacro(LabelValue, double);
 
+  /// Use multithreaded flying edges on the occupied extent of the labelmap instead of marching cubes on the full extent
+  vtkGetMacro(UseFlyingEdges, bool);
+  vtkSetMacro(UseFlyingEdges, bool);
+  vtkBooleanMacro(UseFlyingEdges, bool);
+
+  enum DecimationMethodType
+  {
+    DecimationNone = 0,
+    DecimationPro,
+    DecimationQuadricClustering
+  };
+
+  /// Method used for decimating the extracted surface. DecimatePro by default.
+  /// Quadric clustering is much faster, but less accurate, so it is meant for interactive previews
+  vtkGetMacro(DecimationMethod, int);
+  vtkSetClampMacro(DecimationMethod, int, DecimationNone, DecimationQuadricClustering);
+  void SetDecimationMethodToNone() { this->SetDecimationMethod(DecimationNone); };
+  void SetDecimationMethodToPro() { this->SetDecimationMethod(DecimationPro); };
+  void SetDecimationMethodToQuadricClustering() { this->SetDecimationMethod(DecimationQuadricClustering); };
+
 protected:
   vtkSetObjectMacro(OutputModel, vtkPolyData);
 
@@ -64,6 +84,8 @@ protected:
   double DecimateTargetReduction;
   /// Use this value for the marching cubes
   double LabelValue;
+  bool UseFlyingEdges;
+  int DecimationMethod;
 
 protected:
   vtkLabelmapToModelFilter();
@@ -0,0 +1,414 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#include "vtkMultiLevelMarchingCubes.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkMarchingCubesTriangleCases.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <unordered_map>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  /// Corner offsets of a voxel cell in the order used by vtkMarchingCubesTriangleCases
+  const int CELL_VERTEX_OFFSETS[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+  /// Corner indices of the cell edges. The first corner is always the one with the lower coordinate
+  const int CELL_EDGE_VERTICES[12][2] = { {0,1}, {1,2}, {3,2}, {0,3}, {4,5}, {5,6}, {7,6}, {4,7}, {0,4}, {1,5}, {3,7}, {2,6} };
+  /// Axis along which the cell edges run
+  const int CELL_EDGE_AXES[12] = { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 };
+
+  //----------------------------------------------------------------------------
+  /// Surface of one level extracted from one slab. Points are identified by the global key of the voxel edge they lie on
+  struct SlabSurface
+  {
+    std::vector<double> Points;
+    std::vector<vtkIdType> Triangles;
+    std::unordered_map<vtkIdType, vtkIdType> EdgePointIds;
+  };
+
+  //----------------------------------------------------------------------------
+  template<class T>
+  class MultiLevelMarchingCubesFunctor
+  {
+  public:
+    T* ScalarPtr;
+    vtkIdType Increments[3];
+    int Dimensions[3];
+    int Extent[6];
+    double Origin[3];
+    double Spacing[3];
+    int SlabThickness;
+    const std::vector<double>* Levels;
+    /// Flag requesting the extraction to stop
+    const std::atomic<bool>* AbortExecute;
+    /// Slab surfaces, indexed by slab then level
+    std::vector<std::vector<SlabSurface> >* SlabSurfaces;
+
+    void operator()(vtkIdType beginSlab, vtkIdType endSlab) const
+    {
+      vtkMarchingCubesTriangleCases* triangleCases = vtkMarchingCubesTriangleCases::GetCases();
+      int numberOfLevels = static_cast<int>(this->Levels->size());
+      vtkIdType cornerOffsets[8] = {0,0,0,0,0,0,0,0};
+      for (int corner = 0; corner < 8; ++corner)
+      {
+        cornerOffsets[corner] = CELL_VERTEX_OFFSETS[corner][0] * this->Increments[0]
+          + CELL_VERTEX_OFFSETS[corner][1] * this->Increments[1] + CELL_VERTEX_OFFSETS[corner][2] * this->Increments[2];
+      }
+
+      for (vtkIdType slab = beginSlab; slab < endSlab; ++slab)
+      {
+        if (*this->AbortExecute)
+        {
+          return;
+        }
+        std::vector<SlabSurface>& surfaces = (*this->SlabSurfaces)[slab];
+        int kBegin = static_cast<int>(slab) * this->SlabThickness;
+        int kEnd = std::min(kBegin + this->SlabThickness, this->Dimensions[2] - 1);
+        for (int k = kBegin; k < kEnd; ++k)
+        {
+          for (int j = 0; j < this->Dimensions[1] - 1; ++j)
+          {
+            T* rowPtr = this->ScalarPtr + k * this->Increments[2] + j * this->Increments[1];
+            for (int i = 0; i < this->Dimensions[0] - 1; ++i)
+            {
+              T* cellPtr = rowPtr + i * this->Increments[0];
+              double scalars[8] = {0.0};
+              double minimum = VTK_DOUBLE_MAX;
+              double maximum = VTK_DOUBLE_MIN;
+              for (int corner = 0; corner < 8; ++corner)
+              {
+                scalars[corner] = static_cast<double>(cellPtr[cornerOffsets[corner]]);
+                minimum = std::min(minimum, scalars[corner]);
+                maximum = std::max(maximum, scalars[corner]);
+              }
+
+              for (int level = 0; level < numberOfLevels; ++level)
+              {
+                double value = (*this->Levels)[level];
+                if (minimum >= value || maximum < value)
+                {
+                  continue; // Cell is entirely inside or outside
+                }
+                int caseIndex = 0;
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                  if (scalars[corner] >= value)
+                  {
+                    caseIndex |= (1 << corner);
+                  }
+                }
+
+                SlabSurface& surface = surfaces[level];
+                for (EDGE_LIST* edge = triangleCases[caseIndex].edges; edge[0] > -1; edge += 3)
+                {
+                  for (int triangleVertex = 0; triangleVertex < 3; ++triangleVertex)
+                  {
+                    surface.Triangles.push_back(this->GetEdgePoint(surface, i, j, k, edge[triangleVertex], scalars, value));
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+
+    vtkIdType GetEdgePoint(SlabSurface& surface, int i, int j, int k, int edge, double scalars[8], double value) const
+    {
+      const int* lowerCorner = CELL_VERTEX_OFFSETS[CELL_EDGE_VERTICES[edge][0]];
+      const int* upperCorner = CELL_VERTEX_OFFSETS[CELL_EDGE_VERTICES[edge][1]];
+      int edgeIndex[3] = { i + lowerCorner[0], j + lowerCorner[1], k + lowerCorner[2] };
+      vtkIdType edgeKey = ( (static_cast<vtkIdType>(edgeIndex[2]) * this->Dimensions[1] + edgeIndex[1])
+        * this->Dimensions[0] + edgeIndex[0] ) * 3 + CELL_EDGE_AXES[edge];
+
+      std::unordered_map<vtkIdType, vtkIdType>::iterator pointIt = surface.EdgePointIds.find(edgeKey);
+      if (pointIt != surface.EdgePointIds.end())
+      {
+        return pointIt->second;
+      }
+
+      double lowerValue = scalars[CELL_EDGE_VERTICES[edge][0]];
+      double upperValue = scalars[CELL_EDGE_VERTICES[edge][1]];
+      double t = (upperValue != lowerValue ? (value - lowerValue) / (upperValue - lowerValue) : 0.0);
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        double index = this->Extent[2*axis] + edgeIndex[axis] + t * (upperCorner[axis] - lowerCorner[axis]);
+        surface.Points.push_back(this->Origin[axis] + this->Spacing[axis] * index);
+      }
+      vtkIdType pointId = static_cast<vtkIdType>(surface.Points.size() / 3) - 1;
+      surface.EdgePointIds[edgeKey] = pointId;
+      return pointId;
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  template<class T>
+  void ExtractSlabSurfaces(vtkImageData* image, T* vtkNotUsed(scalarTypePtr), const std::vector<double>& levels,
+    int slabThickness, const std::atomic<bool>* abortExecute, std::vector<std::vector<SlabSurface> >& slabSurfaces)
+  {
+    MultiLevelMarchingCubesFunctor<T> functor;
+    image->GetExtent(functor.Extent);
+    image->GetDimensions(functor.Dimensions);
+    image->GetIncrements(functor.Increments);
+    image->GetOrigin(functor.Origin);
+    image->GetSpacing(functor.Spacing);
+    functor.ScalarPtr = static_cast<T*>(image->GetScalarPointerForExtent(functor.Extent));
+    functor.SlabThickness = slabThickness;
+    functor.Levels = &levels;
+    functor.AbortExecute = abortExecute;
+    functor.SlabSurfaces = &slabSurfaces;
+    vtkSMPTools::For(0, static_cast<vtkIdType>(slabSurfaces.size()), 1, functor);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkMultiLevelMarchingCubes);
+
+//----------------------------------------------------------------------------
+vtkMultiLevelMarchingCubes::vtkMultiLevelMarchingCubes()
+{
+  this->InputImage = nullptr;
+  this->SlabThickness = 8;
+  this->AbortExecute = false;
+}
+
+//----------------------------------------------------------------------------
+vtkMultiLevelMarchingCubes::~vtkMultiLevelMarchingCubes()
+{
+  this->SetInputImage(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiLevelMarchingCubes::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfLevels: " << this->Levels.size() << "\n";
+  for (size_t levelIndex = 0; levelIndex < this->Levels.size(); ++levelIndex)
+  {
+    os << indent << "Level " << levelIndex << ": " << this->Levels[levelIndex] << "\n";
+  }
+  os << indent << "SlabThickness: " << this->SlabThickness << "\n";
+  os << indent << "AbortExecute: " << (this->AbortExecute ? "true" : "false") << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiLevelMarchingCubes::SetAbortExecute(bool abort)
+{
+  // Not calling Modified, as the request may come from another thread while the update is running
+  this->AbortExecute = abort;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMultiLevelMarchingCubes::GetAbortExecute()
+{
+  return this->AbortExecute;
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiLevelMarchingCubes::SetNumberOfLevels(int numberOfLevels)
+{
+  if (numberOfLevels < 0 || numberOfLevels == static_cast<int>(this->Levels.size()))
+  {
+    return;
+  }
+  this->Levels.resize(numberOfLevels, 0.0);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkMultiLevelMarchingCubes::GetNumberOfLevels()
+{
+  return static_cast<int>(this->Levels.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiLevelMarchingCubes::SetLevel(int levelIndex, double value)
+{
+  if (levelIndex < 0)
+  {
+    vtkErrorMacro("SetLevel: Invalid level index " << levelIndex);
+    return;
+  }
+  if (levelIndex >= static_cast<int>(this->Levels.size()))
+  {
+    this->Levels.resize(levelIndex + 1, 0.0);
+  }
+  this->Levels[levelIndex] = value;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+double vtkMultiLevelMarchingCubes::GetLevel(int levelIndex)
+{
+  if (levelIndex < 0 || levelIndex >= static_cast<int>(this->Levels.size()))
+  {
+    vtkErrorMacro("GetLevel: Invalid level index " << levelIndex);
+    return 0.0;
+  }
+  return this->Levels[levelIndex];
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkMultiLevelMarchingCubes::GetOutput(int levelIndex)
+{
+  if (levelIndex < 0 || levelIndex >= static_cast<int>(this->Outputs.size()))
+  {
+    return nullptr;
+  }
+  return this->Outputs[levelIndex];
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiLevelMarchingCubes::Update()
+{
+  int numberOfLevels = static_cast<int>(this->Levels.size());
+  this->Outputs.resize(numberOfLevels);
+  for (int level = 0; level < numberOfLevels; ++level)
+  {
+    if (!this->Outputs[level])
+    {
+      this->Outputs[level] = vtkSmartPointer<vtkPolyData>::New();
+    }
+    this->Outputs[level]->Initialize();
+  }
+
+  if (!this->InputImage || !this->InputImage->GetPointData()->GetScalars())
+  {
+    vtkErrorMacro("Update: Invalid input image");
+    return;
+  }
+  if (this->SlabThickness < 1)
+  {
+    vtkErrorMacro("Update: Invalid slab thickness " << this->SlabThickness);
+    return;
+  }
+  int dimensions[3] = {0,0,0};
+  this->InputImage->GetDimensions(dimensions);
+  if (dimensions[0] < 2 || dimensions[1] < 2 || dimensions[2] < 2 || numberOfLevels == 0)
+  {
+    return; // No cells or no levels, outputs are empty
+  }
+
+  // Extract surface pieces for all levels from each slab in parallel
+  int numberOfCellLayers = dimensions[2] - 1;
+  int numberOfSlabs = (numberOfCellLayers + this->SlabThickness - 1) / this->SlabThickness;
+  std::vector<std::vector<SlabSurface> > slabSurfaces(numberOfSlabs, std::vector<SlabSurface>(numberOfLevels));
+  switch (this->InputImage->GetScalarType())
+  {
+    vtkTemplateMacro( ExtractSlabSurfaces( this->InputImage, static_cast<VTK_TT*>(nullptr),
+      this->Levels, this->SlabThickness, &this->AbortExecute, slabSurfaces ) );
+    default:
+      vtkErrorMacro("Update: Unsupported input scalar type " << this->InputImage->GetScalarTypeAsString());
+      return;
+  }
+
+  // Stitch slabs together. Points on the edges lying in the plane shared by two consecutive slabs
+  // are created by both slabs, so the ones from the upper slab are replaced by those of the lower one.
+  vtkIdType edgeKeysPerPlane = static_cast<vtkIdType>(dimensions[0]) * dimensions[1] * 3;
+  for (int level = 0; level < numberOfLevels && !this->AbortExecute; ++level)
+  {
+    vtkIdType numberOfPoints = 0;
+    vtkIdType numberOfTriangles = 0;
+    for (int slab = 0; slab < numberOfSlabs; ++slab)
+    {
+      numberOfPoints += static_cast<vtkIdType>(slabSurfaces[slab][level].Points.size() / 3);
+      numberOfTriangles += static_cast<vtkIdType>(slabSurfaces[slab][level].Triangles.size() / 3);
+    }
+    if (numberOfTriangles == 0)
+    {
+      continue;
+    }
+
+    vtkNew<vtkPoints> points;
+    points->Allocate(numberOfPoints);
+    vtkNew<vtkCellArray> polys;
+    polys->Allocate(polys->EstimateSize(numberOfTriangles, 3));
+
+    std::unordered_map<vtkIdType, vtkIdType> sharedPlanePointIds; // Top plane of the previous slab
+    for (int slab = 0; slab < numberOfSlabs; ++slab)
+    {
+      SlabSurface& surface = slabSurfaces[slab][level];
+      vtkIdType bottomPlane = static_cast<vtkIdType>(slab) * this->SlabThickness;
+      vtkIdType topPlane = std::min(bottomPlane + this->SlabThickness, static_cast<vtkIdType>(numberOfCellLayers));
+
+      std::vector<vtkIdType> localToOutputPointIds(surface.Points.size() / 3, -1);
+      for (std::unordered_map<vtkIdType, vtkIdType>::iterator edgeIt = surface.EdgePointIds.begin(); edgeIt != surface.EdgePointIds.end(); ++edgeIt)
+      {
+        if (edgeIt->first / edgeKeysPerPlane == bottomPlane && edgeIt->first % 3 != 2)
+        {
+          std::unordered_map<vtkIdType, vtkIdType>::iterator sharedIt = sharedPlanePointIds.find(edgeIt->first);
+          if (sharedIt != sharedPlanePointIds.end())
+          {
+            localToOutputPointIds[edgeIt->second] = sharedIt->second;
+          }
+        }
+      }
+      for (vtkIdType localId = 0; localId < static_cast<vtkIdType>(localToOutputPointIds.size()); ++localId)
+      {
+        if (localToOutputPointIds[localId] < 0)
+        {
+          localToOutputPointIds[localId] = points->InsertNextPoint(&surface.Points[3*localId]);
+        }
+      }
+
+      sharedPlanePointIds.clear();
+      for (std::unordered_map<vtkIdType, vtkIdType>::iterator edgeIt = surface.EdgePointIds.begin(); edgeIt != surface.EdgePointIds.end(); ++edgeIt)
+      {
+        if (edgeIt->first / edgeKeysPerPlane == topPlane && edgeIt->first % 3 != 2)
+        {
+          sharedPlanePointIds[edgeIt->first] = localToOutputPointIds[edgeIt->second];
+        }
+      }
+
+      for (size_t triangleIndex = 0; triangleIndex < surface.Triangles.size(); triangleIndex += 3)
+      {
+        vtkIdType pointIds[3] = { localToOutputPointIds[surface.Triangles[triangleIndex]],
+          localToOutputPointIds[surface.Triangles[triangleIndex+1]], localToOutputPointIds[surface.Triangles[triangleIndex+2]] };
+        polys->InsertNextCell(3, pointIds);
+      }
+
+      // Release slab memory as soon as it is merged
+      std::vector<double>().swap(surface.Points);
+      std::vector<vtkIdType>().swap(surface.Triangles);
+      std::unordered_map<vtkIdType, vtkIdType>().swap(surface.EdgePointIds);
+    }
+
+    this->Outputs[level]->SetPoints(points);
+    this->Outputs[level]->SetPolys(polys);
+  }
+
+  if (this->AbortExecute)
+  {
+    // Do not leave partial results
+    for (int level = 0; level < numberOfLevels; ++level)
+    {
+      this->Outputs[level]->Initialize();
+    }
+  }
+}
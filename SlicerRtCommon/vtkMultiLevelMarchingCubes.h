@@ -0,0 +1,96 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// .NAME vtkMultiLevelMarchingCubes - Extracts iso-surfaces for multiple contour values in one pass
+// .SECTION Description
+
+#ifndef __vtkMultiLevelMarchingCubes_h
+#define __vtkMultiLevelMarchingCubes_h
+
+// VTK includes
+#include <vtkPolyData.h>
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <atomic>
+#include <vector>
+
+#include "vtkSlicerRtCommonWin32Header.h"
+
+/// \ingroup SlicerRt_SlicerRtCommon
+/// \brief Marching cubes producing a separate surface for each contour value while visiting each voxel cell only once.
+///
+/// The volume is split into slabs along the third axis that are processed on separate threads. The slab results are
+/// stitched together so that the output surfaces are identical in topology to the ones that vtkImageMarchingCubes
+/// produces for each contour value separately (same triangle case table, shared points on the cell edges).
+class VTK_SLICERRTCOMMON_EXPORT vtkMultiLevelMarchingCubes : public vtkObject
+{
+public:
+  static vtkMultiLevelMarchingCubes *New();
+  vtkTypeMacro(vtkMultiLevelMarchingCubes, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Run the extraction for all levels
+  virtual void Update();
+
+  /// Get output surface for the level with the given index
+  /// \return Output poly data, nullptr if index is invalid
+  virtual vtkPolyData* GetOutput(int levelIndex);
+
+  /// Set number of contour values. Existing values are kept
+  void SetNumberOfLevels(int numberOfLevels);
+  /// Get number of contour values
+  int GetNumberOfLevels();
+
+  /// Set contour value with the given index. Number of levels is increased if needed
+  void SetLevel(int levelIndex, double value);
+  /// Get contour value with the given index
+  double GetLevel(int levelIndex);
+
+  vtkSetObjectMacro(InputImage, vtkImageData);
+  vtkGetObjectMacro(InputImage, vtkImageData);
+
+  /// Number of cell layers processed by one thread at a time
+  vtkGetMacro(SlabThickness, int);
+  vtkSetMacro(SlabThickness, int);
+
+  /// Request a running update to stop as soon as possible. Can be called from any thread.
+  /// The outputs are empty after an aborted update. The flag is not reset by \sa Update
+  void SetAbortExecute(bool abort);
+  bool GetAbortExecute();
+
+protected:
+  vtkImageData* InputImage;
+  std::vector<double> Levels;
+  std::vector<vtkSmartPointer<vtkPolyData> > Outputs;
+  int SlabThickness;
+  std::atomic<bool> AbortExecute;
+
+protected:
+  vtkMultiLevelMarchingCubes();
+  ~vtkMultiLevelMarchingCubes() override;
+
+private:
+  vtkMultiLevelMarchingCubes(const vtkMultiLevelMarchingCubes&) = delete;
+  void operator=(const vtkMultiLevelMarchingCubes&) = delete;
+};
+
+#endif
@@ -0,0 +1,343 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+#include "vtkPolyDataMultiPlaneCutter.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkTriangleFilter.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+//----------------------------------------------------------------------------
+namespace
+{
+  //----------------------------------------------------------------------------
+  /// Computes the contours of the planes in a range from the triangles bucketed to them
+  class PlaneContourFunctor
+  {
+  public:
+    vtkPoints* InputPoints;
+    int PointDataType;
+    /// Continuous plane index of each input point
+    const std::vector<double>* PlaneCoordinates;
+    /// Point IDs of the triangles, three for each
+    const std::vector<vtkIdType>* Triangles;
+    /// Start of the triangle list of each plane in PlaneTriangleIds. Contains number of planes + 1 elements
+    const std::vector<vtkIdType>* PlaneTriangleOffsets;
+    const std::vector<vtkIdType>* PlaneTriangleIds;
+    std::vector<vtkSmartPointer<vtkPolyData> >* Outputs;
+
+    void operator()(vtkIdType beginPlane, vtkIdType endPlane) const
+    {
+      const std::vector<double>& planeCoordinates = *this->PlaneCoordinates;
+      const std::vector<vtkIdType>& triangles = *this->Triangles;
+      unsigned long long numberOfInputPoints = static_cast<unsigned long long>(planeCoordinates.size());
+
+      std::unordered_map<unsigned long long, vtkIdType> edgePointIds;
+      std::vector<vtkIdType> neighbors; // Two neighbors for each contour point, -1 if none
+      for (vtkIdType plane = beginPlane; plane < endPlane; ++plane)
+      {
+        vtkPolyData* output = (*this->Outputs)[plane];
+        vtkIdType firstTriangle = (*this->PlaneTriangleOffsets)[plane];
+        vtkIdType lastTriangle = (*this->PlaneTriangleOffsets)[plane + 1];
+        if (firstTriangle == lastTriangle)
+        {
+          continue;
+        }
+
+        double planeValue = static_cast<double>(plane);
+        vtkNew<vtkPoints> points;
+        points->SetDataType(this->PointDataType);
+        edgePointIds.clear();
+        neighbors.clear();
+
+        // Intersect triangles with the plane. Points on the plane are considered to be above it, so that
+        // each triangle edge crossing the plane gets exactly one point shared with the neighboring triangle.
+        for (vtkIdType bucketIndex = firstTriangle; bucketIndex < lastTriangle; ++bucketIndex)
+        {
+          const vtkIdType* triangle = &triangles[3 * (*this->PlaneTriangleIds)[bucketIndex]];
+          bool above[3] = { planeCoordinates[triangle[0]] >= planeValue,
+                            planeCoordinates[triangle[1]] >= planeValue,
+                            planeCoordinates[triangle[2]] >= planeValue };
+          if (above[0] == above[1] && above[1] == above[2])
+          {
+            continue;
+          }
+
+          vtkIdType segment[2] = { -1, -1 };
+          int numberOfSegmentPoints = 0;
+          for (int edge = 0; edge < 3; ++edge)
+          {
+            int startVertex = edge;
+            int endVertex = (edge + 1) % 3;
+            if (above[startVertex] == above[endVertex])
+            {
+              continue;
+            }
+            vtkIdType belowId = (above[startVertex] ? triangle[endVertex] : triangle[startVertex]);
+            vtkIdType aboveId = (above[startVertex] ? triangle[startVertex] : triangle[endVertex]);
+            unsigned long long edgeKey = static_cast<unsigned long long>(belowId) * numberOfInputPoints
+              + static_cast<unsigned long long>(aboveId);
+
+            vtkIdType pointId = -1;
+            std::unordered_map<unsigned long long, vtkIdType>::iterator pointIt = edgePointIds.find(edgeKey);
+            if (pointIt != edgePointIds.end())
+            {
+              pointId = pointIt->second;
+            }
+            else
+            {
+              double belowPoint[3] = {0.0, 0.0, 0.0};
+              double abovePoint[3] = {0.0, 0.0, 0.0};
+              this->InputPoints->GetPoint(belowId, belowPoint);
+              this->InputPoints->GetPoint(aboveId, abovePoint);
+              double belowValue = planeCoordinates[belowId];
+              double t = (planeValue - belowValue) / (planeCoordinates[aboveId] - belowValue);
+              double point[3] = { belowPoint[0] + t * (abovePoint[0] - belowPoint[0]),
+                                  belowPoint[1] + t * (abovePoint[1] - belowPoint[1]),
+                                  belowPoint[2] + t * (abovePoint[2] - belowPoint[2]) };
+              pointId = points->InsertNextPoint(point);
+              edgePointIds[edgeKey] = pointId;
+              neighbors.push_back(-1);
+              neighbors.push_back(-1);
+            }
+            segment[numberOfSegmentPoints++] = pointId;
+          }
+
+          // Register the segment at both of its points. Non-manifold connections are ignored
+          for (int end = 0; end < 2; ++end)
+          {
+            vtkIdType* pointNeighbors = &neighbors[2 * segment[end]];
+            vtkIdType otherId = segment[1 - end];
+            if (pointNeighbors[0] < 0)
+            {
+              pointNeighbors[0] = otherId;
+            }
+            else if (pointNeighbors[1] < 0)
+            {
+              pointNeighbors[1] = otherId;
+            }
+          }
+        }
+
+        // Join segments into polylines. Open chains are traced from their ends first, then the closed loops
+        vtkNew<vtkCellArray> lines;
+        vtkNew<vtkIdList> lineIds;
+        vtkIdType numberOfContourPoints = points->GetNumberOfPoints();
+        std::vector<bool> visited(numberOfContourPoints, false);
+        for (int pass = 0; pass < 2; ++pass)
+        {
+          for (vtkIdType startId = 0; startId < numberOfContourPoints; ++startId)
+          {
+            if (visited[startId] || (pass == 0 && neighbors[2 * startId + 1] >= 0))
+            {
+              continue;
+            }
+            lineIds->Reset();
+            vtkIdType previousId = -1;
+            vtkIdType currentId = startId;
+            while (currentId >= 0 && !visited[currentId])
+            {
+              visited[currentId] = true;
+              lineIds->InsertNextId(currentId);
+              vtkIdType nextId = (neighbors[2 * currentId] != previousId ? neighbors[2 * currentId] : neighbors[2 * currentId + 1]);
+              previousId = currentId;
+              currentId = nextId;
+            }
+            if (currentId == startId)
+            {
+              lineIds->InsertNextId(startId); // Close loop
+            }
+            if (lineIds->GetNumberOfIds() > 1)
+            {
+              lines->InsertNextCell(lineIds);
+            }
+          }
+        }
+
+        output->SetPoints(points);
+        output->SetLines(lines);
+      }
+    }
+  };
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkPolyDataMultiPlaneCutter);
+
+//----------------------------------------------------------------------------
+vtkPolyDataMultiPlaneCutter::vtkPolyDataMultiPlaneCutter()
+{
+  this->InputPolyData = nullptr;
+  this->Origin[0] = this->Origin[1] = this->Origin[2] = 0.0;
+  this->PlaneStep[0] = this->PlaneStep[1] = 0.0;
+  this->PlaneStep[2] = 1.0;
+  this->NumberOfPlanes = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkPolyDataMultiPlaneCutter::~vtkPolyDataMultiPlaneCutter()
+{
+  this->SetInputPolyData(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkPolyDataMultiPlaneCutter::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Origin: " << this->Origin[0] << ", " << this->Origin[1] << ", " << this->Origin[2] << "\n";
+  os << indent << "PlaneStep: " << this->PlaneStep[0] << ", " << this->PlaneStep[1] << ", " << this->PlaneStep[2] << "\n";
+  os << indent << "NumberOfPlanes: " << this->NumberOfPlanes << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkPolyDataMultiPlaneCutter::GetOutput(int planeIndex)
+{
+  if (planeIndex < 0 || planeIndex >= static_cast<int>(this->Outputs.size()))
+  {
+    return nullptr;
+  }
+  return this->Outputs[planeIndex];
+}
+
+//----------------------------------------------------------------------------
+void vtkPolyDataMultiPlaneCutter::Update()
+{
+  int numberOfPlanes = std::max(this->NumberOfPlanes, 0);
+  this->Outputs.resize(numberOfPlanes);
+  for (int plane = 0; plane < numberOfPlanes; ++plane)
+  {
+    if (!this->Outputs[plane])
+    {
+      this->Outputs[plane] = vtkSmartPointer<vtkPolyData>::New();
+    }
+    this->Outputs[plane]->Initialize();
+  }
+
+  if (!this->InputPolyData)
+  {
+    vtkErrorMacro("Update: Invalid input poly data");
+    return;
+  }
+  double planeStepLength2 = vtkMath::Dot(this->PlaneStep, this->PlaneStep);
+  if (planeStepLength2 <= 0.0)
+  {
+    vtkErrorMacro("Update: Invalid plane step");
+    return;
+  }
+
+  // Triangle strips and polygons are split into triangles
+  vtkSmartPointer<vtkPolyData> surface = this->InputPolyData;
+  if (surface->GetNumberOfStrips() > 0)
+  {
+    vtkNew<vtkTriangleFilter> triangleFilter;
+    triangleFilter->SetInputData(surface);
+    triangleFilter->PassVertsOff();
+    triangleFilter->PassLinesOff();
+    triangleFilter->Update();
+    surface = triangleFilter->GetOutput();
+  }
+  vtkPoints* inputPoints = surface->GetPoints();
+  if (numberOfPlanes == 0 || !inputPoints || surface->GetNumberOfPolys() == 0)
+  {
+    return; // Outputs are empty
+  }
+
+  // Continuous plane index of each point
+  vtkIdType numberOfInputPoints = inputPoints->GetNumberOfPoints();
+  std::vector<double> planeCoordinates(numberOfInputPoints);
+  for (vtkIdType pointId = 0; pointId < numberOfInputPoints; ++pointId)
+  {
+    double point[3] = {0.0, 0.0, 0.0};
+    inputPoints->GetPoint(pointId, point);
+    double relativePoint[3] = { point[0] - this->Origin[0], point[1] - this->Origin[1], point[2] - this->Origin[2] };
+    planeCoordinates[pointId] = vtkMath::Dot(relativePoint, this->PlaneStep) / planeStepLength2;
+  }
+
+  // Collect triangles (polygons are fan triangulated)
+  std::vector<vtkIdType> triangles;
+  triangles.reserve(3 * surface->GetNumberOfPolys());
+  vtkCellArray* polys = surface->GetPolys();
+  vtkNew<vtkIdList> cellPointIds;
+  polys->InitTraversal();
+  while (polys->GetNextCell(cellPointIds))
+  {
+    for (vtkIdType index = 2; index < cellPointIds->GetNumberOfIds(); ++index)
+    {
+      triangles.push_back(cellPointIds->GetId(0));
+      triangles.push_back(cellPointIds->GetId(index - 1));
+      triangles.push_back(cellPointIds->GetId(index));
+    }
+  }
+  vtkIdType numberOfTriangles = static_cast<vtkIdType>(triangles.size() / 3);
+
+  // Bucket triangles by the range of planes they span (counting sort)
+  std::vector<int> firstPlanes(numberOfTriangles);
+  std::vector<int> lastPlanes(numberOfTriangles);
+  std::vector<vtkIdType> planeTriangleOffsets(numberOfPlanes + 1, 0);
+  for (vtkIdType triangleIndex = 0; triangleIndex < numberOfTriangles; ++triangleIndex)
+  {
+    const vtkIdType* triangle = &triangles[3 * triangleIndex];
+    double minimum = std::min(planeCoordinates[triangle[0]], std::min(planeCoordinates[triangle[1]], planeCoordinates[triangle[2]]));
+    double maximum = std::max(planeCoordinates[triangle[0]], std::max(planeCoordinates[triangle[1]], planeCoordinates[triangle[2]]));
+    int firstPlane = static_cast<int>(std::max(std::ceil(minimum), 0.0));
+    int lastPlane = static_cast<int>(std::min(std::floor(maximum), static_cast<double>(numberOfPlanes - 1)));
+    firstPlanes[triangleIndex] = firstPlane;
+    lastPlanes[triangleIndex] = lastPlane;
+    for (int plane = firstPlane; plane <= lastPlane; ++plane)
+    {
+      ++planeTriangleOffsets[plane + 1];
+    }
+  }
+  for (int plane = 0; plane < numberOfPlanes; ++plane)
+  {
+    planeTriangleOffsets[plane + 1] += planeTriangleOffsets[plane];
+  }
+  std::vector<vtkIdType> planeTriangleIds(planeTriangleOffsets[numberOfPlanes]);
+  std::vector<vtkIdType> insertPositions(planeTriangleOffsets.begin(), planeTriangleOffsets.end() - 1);
+  for (vtkIdType triangleIndex = 0; triangleIndex < numberOfTriangles; ++triangleIndex)
+  {
+    for (int plane = firstPlanes[triangleIndex]; plane <= lastPlanes[triangleIndex]; ++plane)
+    {
+      planeTriangleIds[insertPositions[plane]++] = triangleIndex;
+    }
+  }
+
+  // Compute contours of all planes
+  PlaneContourFunctor functor;
+  functor.InputPoints = inputPoints;
+  functor.PointDataType = inputPoints->GetDataType();
+  functor.PlaneCoordinates = &planeCoordinates;
+  functor.Triangles = &triangles;
+  functor.PlaneTriangleOffsets = &planeTriangleOffsets;
+  functor.PlaneTriangleIds = &planeTriangleIds;
+  functor.Outputs = &this->Outputs;
+  vtkSMPTools::For(0, static_cast<vtkIdType>(numberOfPlanes), functor);
+}
@@ -0,0 +1,88 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, PerkLab, Queen's University
+  and was supported through the Applied Cancer Research Unit program of Cancer Care
+  Ontario with funds provided by the Ontario Ministry of Health and Long-Term Care
+
+==============================================================================*/
+
+// .NAME vtkPolyDataMultiPlaneCutter - Cuts a surface with a stack of parallel equidistant planes in one sweep
+// .SECTION Description
+
+#ifndef __vtkPolyDataMultiPlaneCutter_h
+#define __vtkPolyDataMultiPlaneCutter_h
+
+// VTK includes
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerRtCommonWin32Header.h"
+
+/// \ingroup SlicerRt_SlicerRtCommon
+/// \brief Cuts a triangle surface with a stack of parallel equidistant planes (typically the slices of an image).
+///
+/// Instead of re-scanning every triangle for each plane as a vtkCutter with a changing cut function does, the
+/// triangles are bucketed once by the range of plane indices they span, and then the intersection polylines are
+/// computed for each plane (in parallel) only from the triangles in its bucket. The segments are joined into
+/// polylines similarly to vtkStripper. Closed contours end with the first point repeated.
+class VTK_SLICERRTCOMMON_EXPORT vtkPolyDataMultiPlaneCutter : public vtkObject
+{
+public:
+  static vtkPolyDataMultiPlaneCutter *New();
+  vtkTypeMacro(vtkPolyDataMultiPlaneCutter, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Cut the input surface with all planes
+  virtual void Update();
+
+  /// Get contours of the plane with the given index
+  /// \return Output poly data containing the contours as lines, nullptr if index is invalid
+  virtual vtkPolyData* GetOutput(int planeIndex);
+
+  vtkSetObjectMacro(InputPolyData, vtkPolyData);
+  vtkGetObjectMacro(InputPolyData, vtkPolyData);
+
+  /// Point on the first plane
+  vtkSetVector3Macro(Origin, double);
+  vtkGetVector3Macro(Origin, double);
+
+  /// Vector between two consecutive planes. It is also the plane normal
+  vtkSetVector3Macro(PlaneStep, double);
+  vtkGetVector3Macro(PlaneStep, double);
+
+  /// Number of planes
+  vtkSetMacro(NumberOfPlanes, int);
+  vtkGetMacro(NumberOfPlanes, int);
+
+protected:
+  vtkPolyData* InputPolyData;
+  double Origin[3];
+  double PlaneStep[3];
+  int NumberOfPlanes;
+  std::vector<vtkSmartPointer<vtkPolyData> > Outputs;
+
+protected:
+  vtkPolyDataMultiPlaneCutter();
+  ~vtkPolyDataMultiPlaneCutter() override;
+
+private:
+  vtkPolyDataMultiPlaneCutter(const vtkPolyDataMultiPlaneCutter&) = delete;
+  void operator=(const vtkPolyDataMultiPlaneCutter&) = delete;
+};
+
+#endif
@@ -19,18 +19,23 @@
 ==============================================================================*/
 
 #include "vtkPolyDataToLabelmapFilter.h"
+#include "vtkPolyDataMultiPlaneCutter.h"
 
 #include <algorithm>
 #include <math.h>
+#include <utility>
 
 // VTK includes
 #include <vtkVersion.h>
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
 #include <vtkImageCast.h>
 #include <vtkImageStencil.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkPolyDataNormals.h>
 #include <vtkPolyDataToImageStencil.h>
+#include <vtkSMPTools.h>
 #include <vtkSmartPointer.h>
 #include <vtkStripper.h>
 #include <vtkTriangleFilter.h>
@@ -48,6 +53,99 @@ namespace
       extentsA[4] == extentsB[4] &&
       extentsA[5] == extentsB[5];
   }
+
+  //----------------------------------------------------------------------------
+  /// Fills the voxels inside the contours of each slice using even-odd scanline filling
+  class ScanlineFillFunctor
+  {
+  public:
+    vtkPolyDataMultiPlaneCutter* Cutter;
+    unsigned char* OutputPtr;
+    vtkIdType Increments[3];
+    int Extent[6];
+    double Origin[3];
+    double Spacing[3];
+    unsigned char LabelValue;
+
+    void operator()(vtkIdType beginSlice, vtkIdType endSlice) const
+    {
+      std::vector<std::pair<int, double> > crossings; // Row and column of the contour crossings of the rows
+      vtkNew<vtkIdList> lineIds;
+      for (vtkIdType slice = beginSlice; slice < endSlice; ++slice)
+      {
+        vtkPolyData* contours = this->Cutter->GetOutput(static_cast<int>(slice));
+        if (!contours || contours->GetNumberOfLines() == 0)
+        {
+          continue;
+        }
+        vtkPoints* points = contours->GetPoints();
+        vtkCellArray* lines = contours->GetLines();
+
+        // Collect crossings. Each segment contains its lower end but not the upper one, so that
+        // a row going through a contour vertex crosses only once
+        crossings.clear();
+        lines->InitTraversal();
+        while (lines->GetNextCell(lineIds))
+        {
+          vtkIdType numberOfIds = lineIds->GetNumberOfIds();
+          if (numberOfIds < 2)
+          {
+            continue;
+          }
+          // Open contours are closed
+          vtkIdType numberOfSegments = (lineIds->GetId(0) == lineIds->GetId(numberOfIds-1) ? numberOfIds-1 : numberOfIds);
+          for (vtkIdType segment = 0; segment < numberOfSegments; ++segment)
+          {
+            double pointA[3] = {0.0, 0.0, 0.0};
+            double pointB[3] = {0.0, 0.0, 0.0};
+            points->GetPoint(lineIds->GetId(segment), pointA);
+            points->GetPoint(lineIds->GetId((segment+1) % numberOfIds), pointB);
+            double xA = (pointA[0] - this->Origin[0]) / this->Spacing[0];
+            double yA = (pointA[1] - this->Origin[1]) / this->Spacing[1];
+            double xB = (pointB[0] - this->Origin[0]) / this->Spacing[0];
+            double yB = (pointB[1] - this->Origin[1]) / this->Spacing[1];
+            if (yA == yB)
+            {
+              continue;
+            }
+            if (yA > yB)
+            {
+              std::swap(xA, xB);
+              std::swap(yA, yB);
+            }
+            int firstRow = std::max(static_cast<int>(ceil(yA)), this->Extent[2]);
+            int lastRow = std::min(static_cast<int>(ceil(yB)) - 1, this->Extent[3]);
+            for (int row = firstRow; row <= lastRow; ++row)
+            {
+              crossings.push_back(std::make_pair(row, xA + (row - yA) * (xB - xA) / (yB - yA)));
+            }
+          }
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        // Fill voxels between pairs of crossings in each row
+        unsigned char* slicePtr = this->OutputPtr + slice * this->Increments[2];
+        size_t crossingIndex = 0;
+        while (crossingIndex + 1 < crossings.size())
+        {
+          int row = crossings[crossingIndex].first;
+          if (crossings[crossingIndex+1].first != row)
+          {
+            ++crossingIndex; // Unpaired crossing
+            continue;
+          }
+          int firstColumn = std::max(static_cast<int>(ceil(crossings[crossingIndex].second)), this->Extent[0]);
+          int lastColumn = std::min(static_cast<int>(floor(crossings[crossingIndex+1].second)), this->Extent[1]);
+          unsigned char* rowPtr = slicePtr + (row - this->Extent[2]) * this->Increments[1];
+          for (int column = firstColumn; column <= lastColumn; ++column)
+          {
+            rowPtr[column - this->Extent[0]] = this->LabelValue;
+          }
+          crossingIndex += 2;
+        }
+      }
+    }
+  };
 }
 
 //----------------------------------------------------------------------------
@@ -61,6 +159,7 @@ vtkPolyDataToLabelmapFilter::vtkPolyDataToLabelmapFilter()
 , LabelValue(2)
 , BackgroundValue(0.0)
 , UseReferenceValues(true)
+, UseScanlineRasterization(false)
 {
   this->SetInputPolyData(vtkSmartPointer<vtkPolyData>::New());
   this->SetOutputLabelmap(vtkSmartPointer<vtkImageData>::New());
@@ -102,6 +201,12 @@ void vtkPolyDataToLabelmapFilter::Update()
     return;
   }
 
+  if (this->UseScanlineRasterization && !this->UseReferenceValues)
+  {
+    this->RasterizeScanlines();
+    return;
+  }
+
   vtkNew<vtkPolyDataNormals> normalFilter;
   normalFilter->SetInputData(this->InputPolyData);
   normalFilter->ConsistencyOn();
@@ -280,3 +385,65 @@ void vtkPolyDataToLabelmapFilter::CopyArraysToVectors( std::vector<int> &extentV
     originVector.push_back(origin[i]);
   }
 }
+
+//----------------------------------------------------------------------------
+void vtkPolyDataToLabelmapFilter::RasterizeScanlines()
+{
+  double origin[3] = {0.0, 0.0, 0.0};
+  double spacing[3] = {1.0, 1.0, 1.0};
+  this->ReferenceImageData->GetOrigin(origin);
+  this->ReferenceImageData->GetSpacing(spacing);
+
+  // Output covers the voxels of the reference image that are within the bounds of the input
+  int extent[6] = {0, -1, 0, -1, 0, -1};
+  if (this->InputPolyData->GetPoints() && this->InputPolyData->GetNumberOfPoints() > 0)
+  {
+    double bounds[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    this->InputPolyData->GetPoints()->ComputeBounds();
+    this->InputPolyData->GetPoints()->GetBounds(bounds);
+    int referenceExtent[6] = {0, -1, 0, -1, 0, -1};
+    this->ReferenceImageData->GetExtent(referenceExtent);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      extent[2*axis] = std::max(referenceExtent[2*axis],
+        static_cast<int>(ceil((bounds[2*axis] - origin[axis]) / spacing[axis])) );
+      extent[2*axis+1] = std::min(referenceExtent[2*axis+1],
+        static_cast<int>(floor((bounds[2*axis+1] - origin[axis]) / spacing[axis])) );
+    }
+  }
+
+  vtkSmartPointer<vtkImageData> labelmap = vtkSmartPointer<vtkImageData>::New();
+  labelmap->SetOrigin(origin);
+  labelmap->SetSpacing(spacing);
+  labelmap->SetExtent(extent);
+  if (extent[0] > extent[1] || extent[2] > extent[3] || extent[4] > extent[5])
+  {
+    // Input is empty, is between voxels, or is outside the reference image
+    this->OutputLabelmap->ShallowCopy(labelmap);
+    return;
+  }
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  unsigned char* labelmapPtr = static_cast<unsigned char*>(labelmap->GetScalarPointer());
+  std::fill(labelmapPtr, labelmapPtr + labelmap->GetNumberOfPoints(), static_cast<unsigned char>(this->BackgroundValue));
+
+  // Contours of the surface on the voxel slices
+  int numberOfSlices = extent[5] - extent[4] + 1;
+  vtkNew<vtkPolyDataMultiPlaneCutter> cutter;
+  cutter->SetInputPolyData(this->InputPolyData);
+  cutter->SetOrigin(origin[0], origin[1], origin[2] + extent[4] * spacing[2]);
+  cutter->SetPlaneStep(0.0, 0.0, spacing[2]);
+  cutter->SetNumberOfPlanes(numberOfSlices);
+  cutter->Update();
+
+  ScanlineFillFunctor functor;
+  functor.Cutter = cutter.GetPointer();
+  functor.OutputPtr = labelmapPtr;
+  labelmap->GetIncrements(functor.Increments);
+  labelmap->GetExtent(functor.Extent);
+  labelmap->GetOrigin(functor.Origin);
+  labelmap->GetSpacing(functor.Spacing);
+  functor.LabelValue = static_cast<unsigned char>(this->LabelValue);
+  vtkSMPTools::For(0, static_cast<vtkIdType>(numberOfSlices), functor);
+
+  this->OutputLabelmap->ShallowCopy(labelmap);
+}
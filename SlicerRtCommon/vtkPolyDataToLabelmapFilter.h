@@ -30,6 +30,7 @@
 
 // STD includes
 #include <cstdlib>
+#include <vector>
 
 #include "vtkSlicerRtCommonWin32Header.h"
 
@@ -61,6 +62,10 @@ public:
   vtkSetMacro(UseReferenceValues, bool);
   vtkBooleanMacro(UseReferenceValues, bool);
 
+  vtkGetMacro(UseScanlineRasterization, bool);
+  vtkSetMacro(UseScanlineRasterization, bool);
+  vtkBooleanMacro(UseScanlineRasterization, bool);
+
 protected:
   vtkSetObjectMacro(OutputLabelmap, vtkImageData);
   vtkSetObjectMacro(ReferenceImageData, vtkImageData);
@@ -73,6 +78,10 @@ protected:
   /// Helper function to copy values from the arry into the vector
   void CopyArraysToVectors( std::vector<int> &extentVector, int extents[6], std::vector<double> &originVector, double origin[3] );
 
+  /// Rasterize the input directly into an unsigned char labelmap on the reference image grid, cropped to the
+  /// bounds of the input poly data. The contours of the surface on the voxel slices are scan-converted in parallel
+  void RasterizeScanlines();
+
 protected:
   vtkPolyData* InputPolyData;
   vtkImageData* OutputLabelmap;
@@ -81,6 +90,11 @@ protected:
   double BackgroundValue;
   bool UseReferenceValues;
 
+  /// Flag determining whether the labelmap is created by scan-converting the contours of the surface on each slice
+  /// instead of the stencil pipeline. The output is allocated only once, and it is cropped to the bounds of the input
+  /// (and aligned with the reference image grid). Only used if UseReferenceValues is off. False by default
+  bool UseScanlineRasterization;
+
 protected:
   vtkPolyDataToLabelmapFilter();
   ~vtkPolyDataToLabelmapFilter();